@@ -0,0 +1,470 @@
+/****
+* Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+* All rights reserved.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Measures the overhead of the test framework itself. The same source is built
+// against unit_test.h (cpp_test_bench) and against catch_test.h when Catch is
+// available (cpp_test_bench_catch, CPP_TEST_BENCH_CATCH defined).
+//
+//    cpp_test_bench [--output=<file>] [--baseline=<file>] [--tolerance=<percent>] [--cpu=<n>] [--force]
+//
+// Each result is printed as "<metric> <value> <unit>". When a baseline is given
+// the run fails if any metric regressed by more than the tolerance. The results
+// written with --output start with the fingerprint of the host, a baseline with
+// another fingerprint or without one is refused rather than compared, unless
+// --force is given. --cpu pins the benchmarks to one CPU.
+
+#if defined(CPP_TEST_BENCH_CATCH)
+#define CATCH_CONFIG_RUNNER
+#include "catch_test.h"
+#define bench_method(name, tag)                          test_method_id(name, tag)
+#else
+#include "unit_test.h"
+#define bench_method(name, tag)                          test_method(name, tag)
+#endif
+#include "unit_test_benchmark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+   using bench_clock = std::chrono::steady_clock;
+
+   const uint64_t passing_count = 1000000;
+   const uint64_t failing_count = 10000;
+   const size_t registration_count = 10000;
+   const int repetitions = 5;
+
+   std::atomic<uint64_t> allocated_bytes(0);
+
+   struct bench_result
+   {
+      std::string name_;
+      double value_;
+      std::string unit_;
+   };
+
+   std::vector<bench_result>& results()
+   {
+      static std::vector<bench_result> values;
+      return values;
+   }
+
+   void record(const std::string& name, double value, const std::string& unit)
+   {
+      results().push_back(bench_result{ name, value, unit });
+   }
+
+   double elapsed_ns(bench_clock::time_point start)
+   {
+      return double(std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock::now() - start).count());
+   }
+
+   // Warms up until the runs agree, then runs the loop a few times and keeps the fastest
+   // run, which is the least disturbed one.
+   template <typename _TLoop>
+   double fastest_ns(_TLoop loop)
+   {
+      std::vector<double> warmup;
+      bench_clock::time_point begin = bench_clock::now();
+      while (!aes::test::benchmark::is_steady(warmup) && elapsed_ns(begin) < aes::test::benchmark::settings().max_warmup_time_ * 1e9)
+      {
+         bench_clock::time_point start = bench_clock::now();
+         loop();
+         warmup.push_back(elapsed_ns(start));
+      }
+
+      double best = 0;
+      for (int i = 0; i < repetitions; ++i)
+      {
+         bench_clock::time_point start = bench_clock::now();
+         loop();
+         double ns = elapsed_ns(start);
+         best = i == 0 ? ns : std::min(best, ns);
+      }
+
+      return best;
+   }
+
+   class null_buffer : public std::streambuf
+   {
+   protected:
+      int overflow(int c) override
+      {
+         return c;
+      }
+   };
+
+   // Silences std::cout and std::cerr while failing assertions are reported.
+   class silence_output
+   {
+   public:
+      silence_output()
+         : buffer_()
+         , out_(std::cout.rdbuf(&buffer_))
+         , error_(std::cerr.rdbuf(&buffer_))
+      {
+      }
+      ~silence_output()
+      {
+         std::cout.rdbuf(out_);
+         std::cerr.rdbuf(error_);
+      }
+
+   private:
+      null_buffer buffer_;
+      std::streambuf* out_;
+      std::streambuf* error_;
+   };
+
+   // Timestamps of the first and last empty test run, used to measure the cost per test.
+   class empty_test_timer
+   {
+   public:
+      void tick() noexcept
+      {
+         last_ = bench_clock::now();
+         if (runs_++ == 0)
+         {
+            first_ = last_;
+         }
+      }
+
+      double ns_per_test() const noexcept
+      {
+         return runs_ > 1 ? double(std::chrono::duration_cast<std::chrono::nanoseconds>(last_ - first_).count()) / (runs_ - 1) : 0.0;
+      }
+
+   private:
+      size_t runs_ = 0;
+      bench_clock::time_point first_;
+      bench_clock::time_point last_;
+   };
+
+   empty_test_timer empty_tests;
+
+   std::vector<std::string>& empty_test_names()
+   {
+      static std::vector<std::string> names;
+      return names;
+   }
+
+   bool write_results(const std::string& file_name)
+   {
+      std::ofstream file(file_name);
+      file << "fingerprint " << aes::test::benchmark::fingerprint(aes::test::benchmark::host()) << std::endl;
+      for (const bench_result& result : results())
+      {
+         file << result.name_ << " " << result.value_ << " " << result.unit_ << std::endl;
+      }
+
+      return bool(file);
+   }
+
+   int compare_with_baseline(const std::string& file_name, double tolerance, bool force)
+   {
+      std::ifstream file(file_name);
+      std::string name;
+      std::string unit;
+      std::string fingerprint;
+      double baseline = 0;
+      int regressions = 0;
+
+      if (!file)
+      {
+         std::cerr << "Error: unable to open the baseline " << file_name << std::endl;
+         return -1;
+      }
+
+      // The fingerprint comes first, a baseline without one cannot tell where it was measured.
+      if (!(file >> name >> fingerprint) || name != "fingerprint")
+      {
+         std::cerr << (force ? "Warning" : "Error") << ": the baseline " << file_name << " has no fingerprint, write it again with --output" << std::endl;
+         if (!force)
+         {
+            return -1;
+         }
+         file.clear();
+         file.seekg(0);
+      }
+      else if (fingerprint != aes::test::benchmark::fingerprint(aes::test::benchmark::host()))
+      {
+         std::cerr << (force ? "Warning" : "Error") << ": the baseline " << file_name << " was measured on another host or build (fingerprint " << fingerprint << ")" << std::endl;
+         if (!force)
+         {
+            return -1;
+         }
+      }
+
+      while (file >> name)
+      {
+         if (!(file >> baseline >> unit))
+         {
+            break;
+         }
+
+         for (const bench_result& result : results())
+         {
+            // Throughputs ("per_s") regress when they drop, every other unit when it grows.
+            bool regressed = unit == "per_s" ? result.value_ < baseline * (1.0 - tolerance) : result.value_ > baseline * (1.0 + tolerance);
+            if (result.name_ == name && regressed)
+            {
+               std::cerr << "REGRESSION " << name << " " << result.value_ << " " << unit << " (baseline " << baseline << ")" << std::endl;
+               ++regressions;
+            }
+         }
+      }
+
+      return regressions;
+   }
+}
+
+// The replaced allocation functions are a matching pair over malloc and free. They are
+// kept out of line, otherwise the compiler pairs the inlined free with the new expression.
+#if defined(__GNUC__)
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+
+BENCH_NOINLINE void* operator new(size_t size)
+{
+   allocated_bytes += size;
+   if (void* memory = std::malloc(size ? size : 1))
+   {
+      return memory;
+   }
+   throw std::bad_alloc();
+}
+
+BENCH_NOINLINE void operator delete(void* memory) noexcept
+{
+   std::free(memory);
+}
+
+BENCH_NOINLINE void operator delete(void* memory, size_t) noexcept
+{
+   std::free(memory);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////
+// assertion benchmarks, written against the common macros of both backends
+
+bench_method(bench_passing_assertions, "[bench] Cost of a passing assertion")
+{
+   double ns = fastest_ns([&]()
+   {
+      for (uint64_t i = 0; i < passing_count; ++i)
+      {
+         assert_equal("Passing assertion", i, i);
+      }
+   });
+
+   record("passing_assert", ns / passing_count, "ns");
+   record("passing_asserts", passing_count / (ns / 1e9), "per_s");
+}
+
+bench_method(bench_failing_assertions, "[bench] Cost of a failing assertion")
+{
+   silence_output silence;
+   double ns = fastest_ns([&]()
+   {
+      for (uint64_t i = 0; i < failing_count; ++i)
+      {
+         assert_equal("Failing assertion", i, i + 1);
+      }
+   });
+
+   record("failing_assert", ns / failing_count, "ns");
+   record("failing_asserts", failing_count / (ns / 1e9), "per_s");
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////
+// registration and per test benchmarks, specific to each backend
+
+#if defined(CPP_TEST_BENCH_CATCH)
+
+namespace
+{
+   std::vector<std::unique_ptr<Catch::AutoReg>> registrations;
+
+   void register_empty_tests()
+   {
+      registrations.reserve(registration_count);
+      uint64_t bytes = allocated_bytes;
+      bench_clock::time_point start = bench_clock::now();
+      for (size_t i = 0; i < registration_count; ++i)
+      {
+         registrations.emplace_back(new Catch::AutoReg(Catch::makeTestInvoker(+[]() { empty_tests.tick(); }),
+                                                       Catch::SourceLineInfo(__FILE__, i),
+                                                       Catch::StringRef(),
+                                                       Catch::NameAndTags{ empty_test_names()[i].c_str(), "[empty]" }));
+      }
+      record("registration", elapsed_ns(start) / registration_count, "ns");
+      record("memory_per_test", double(allocated_bytes - bytes) / registration_count, "bytes");
+   }
+
+   int run_tests(int, char** argv)
+   {
+      const char* arguments[] = { argv[0], "--order", "decl" };
+      Catch::Session session;
+      session.applyCommandLine(3, arguments);
+
+      silence_output silence;
+      return session.run();
+   }
+}
+
+#else
+
+namespace
+{
+   std::ostream null_stream(nullptr);
+
+   class bench_suite_singleton
+   {
+   public:
+      static aes::test::test_suite_base<bench_suite_singleton, logger>& get()
+      {
+         static logger log(null_stream, null_stream, aes::test::log::level::error);
+         static aes::test::test_suite_base<bench_suite_singleton, logger> suite(log);
+         return suite;
+      }
+   };
+
+   class empty_test : public aes::test::unit_test_base<bench_suite_singleton, logger>
+   {
+   public:
+      empty_test(const std::string& name) : unit_test_base(name, "[empty]") {}
+
+   private:
+      void run_tests(aes::test::assert_base<logger>&) override
+      {
+         empty_tests.tick();
+      }
+   };
+
+   std::vector<std::unique_ptr<empty_test>> registrations;
+
+   void register_empty_tests()
+   {
+      registrations.reserve(registration_count);
+      uint64_t bytes = allocated_bytes;
+      bench_clock::time_point start = bench_clock::now();
+      for (size_t i = 0; i < registration_count; ++i)
+      {
+         registrations.emplace_back(new empty_test(empty_test_names()[i]));
+      }
+      record("registration", elapsed_ns(start) / registration_count, "ns");
+      record("memory_per_test", double(allocated_bytes - bytes) / registration_count, "bytes");
+   }
+
+   int run_tests(int, char**)
+   {
+      aes::test::test_suite_singleton::get().test_logger().log_level(aes::test::log::level::error);
+      {
+         silence_output silence;
+         aes::test::test_suite_singleton::get().run("Framework benchmark");
+      }
+      bench_suite_singleton::get().run("Empty tests");
+      return 0;
+   }
+}
+
+#endif
+
+int main(int argc, char** argv)
+{
+   std::string output;
+   std::string baseline;
+   double tolerance = 0.5;
+   int cpu = -1;
+   bool force = false;
+
+   for (int i = 1; i < argc; ++i)
+   {
+      std::string argument(argv[i]);
+      if (argument.compare(0, 9, "--output=") == 0)
+      {
+         output = argument.substr(9);
+      }
+      else if (argument.compare(0, 11, "--baseline=") == 0)
+      {
+         baseline = argument.substr(11);
+      }
+      else if (argument.compare(0, 12, "--tolerance=") == 0)
+      {
+         tolerance = std::strtod(argument.c_str() + 12, nullptr) / 100.0;
+      }
+      else if (argument.compare(0, 6, "--cpu=") == 0)
+      {
+         cpu = std::atoi(argument.c_str() + 6);
+      }
+      else if (argument == "--force")
+      {
+         force = true;
+      }
+      else
+      {
+         std::cerr << "Error: invalid or unknown argument " << argument << std::endl;
+         return -1;
+      }
+   }
+
+   for (size_t i = 0; i < registration_count; ++i)
+   {
+      std::stringstream ss;
+      ss << "empty_test_" << i;
+      empty_test_names().push_back(ss.str());
+   }
+
+   aes::test::benchmark::pinned_thread pinned(cpu);
+   if (cpu >= 0 && !pinned.pinned())
+   {
+      std::cerr << "Warning: unable to pin the benchmarks to cpu " << cpu << std::endl;
+   }
+   std::cerr << "Environment: " << aes::test::benchmark::describe(aes::test::benchmark::host()) << std::endl;
+
+   register_empty_tests();
+   run_tests(argc, argv);
+   record("test_run", empty_tests.ns_per_test(), "ns");
+
+   for (const bench_result& result : results())
+   {
+      std::cout << result.name_ << " " << result.value_ << " " << result.unit_ << std::endl;
+   }
+
+   if (!output.empty() && !write_results(output))
+   {
+      std::cerr << "Error: unable to write the results to " << output << std::endl;
+      return -1;
+   }
+
+   return baseline.empty() ? 0 : compare_with_baseline(baseline, tolerance, force);
+}
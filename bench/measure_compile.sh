@@ -0,0 +1,63 @@
+#!/bin/bash
+
+# Measures the compile time and object size added by 1000 assertions for one backend.
+# Usage: measure_compile.sh [native|library|lean|catch]
+#
+# An empty test file and a file with 1000 assertions are compiled and the difference
+# between both is reported as "<metric> <value> <unit>", like cpp_test_bench does.
+# The library backend is the native one compiled with AES_TEST_LIBRARY, whose runtime
+# is built once into cpp_test_runtime, so the time of the whole file is reported too.
+# The lean backend is the native one compiled with AES_TEST_LEAN.
+
+backend=${1:-native}
+count=1000
+benchDir=$(cd "$(dirname "$0")" && pwd)
+srcDir="$benchDir/../src"
+catchDir=${CATCH_INCLUDE:-"$benchDir/../3rdparty/catch/single_include"}
+workDir=$(mktemp -d)
+compiler=${CXX:-c++}
+
+defines=""
+method="test_method"
+if [ "$backend" == "catch" ]; then
+   header="catch_test.h"
+   method="test_method_id"
+elif [ "$backend" == "library" ]; then
+   header="unit_test.h"
+   defines="-DAES_TEST_LIBRARY"
+elif [ "$backend" == "lean" ]; then
+   header="unit_test.h"
+   defines="-DAES_TEST_LEAN"
+else
+   header="unit_test.h"
+fi
+
+generate()
+{
+   echo "#include \"$header\""
+   echo "$method(generated_test, \"Generated assertions\")"
+   echo "{"
+   echo "   int value = 0;"
+   for ((i = 0; i < $1; i++)); do
+      echo "   assert_equal(\"Generated assertion $i\", $i, value + $i);"
+   done
+   echo "}"
+}
+
+measure()
+{
+   generate $1 > "$workDir/generated_$1.cpp"
+   local start=$(date +%s.%N)
+   $compiler -std=c++14 -O0 $defines -I"$srcDir" -I"$catchDir" -c "$workDir/generated_$1.cpp" -o "$workDir/generated_$1.o" || exit 1
+   local end=$(date +%s.%N)
+   echo "$(awk "BEGIN { print $end - $start }") $(stat -c %s "$workDir/generated_$1.o")"
+}
+
+read emptyTime emptySize <<< "$(measure 0)"
+read fullTime fullSize <<< "$(measure $count)"
+rm -rf "$workDir"
+
+echo "compile_time_per_1k_asserts $(awk "BEGIN { print $fullTime - $emptyTime }") s"
+echo "object_size_per_1k_asserts $((fullSize - emptySize)) bytes"
+echo "compile_time_of_1k_asserts_file $fullTime s"
+echo "object_size_of_1k_asserts_file $fullSize bytes"
@@ -18,10 +18,38 @@
 #pragma once
 
 #include "catch.hpp"
+#include "unit_test_async.h"
 
 #define test_method(name, tag)                           TEST_CASE(name, tag)
+// A test named by an identifier, as the test_method of unit_test.h
+#define test_method_id(name, tag)                        TEST_CASE(#name, tag)
 #define test_section(message)                            SECTION(message)
 
+// Catch assertions are not thread safe, so the iterations of a stress test run on a single thread
+#define stress_method(name, tag, threads, iterations)    \
+   static void stress_##name(uint64_t iteration);        \
+   TEST_CASE(#name, tag)                                 \
+   {                                                     \
+      for (uint64_t i = 0; i < uint64_t(iterations); ++i) \
+      {                                                  \
+         stress_##name(i);                               \
+      }                                                  \
+   }                                                     \
+   static void stress_##name(uint64_t iteration)
+
+// Asynchronous tests run one at a time, each on its own event loop
+#define async_test_method(name, tag)                     \
+   static void async_##name(aes::test::async::event_loop& loop, aes::test::async::completion done); \
+   TEST_CASE(#name, tag)                                 \
+   {                                                     \
+      aes::test::async::event_loop loop;                 \
+      bool completed = false;                            \
+      async_##name(loop, [&completed]() { completed = true; }); \
+      loop.run();                                        \
+      CHECK(completed);                                  \
+   }                                                     \
+   static void async_##name(aes::test::async::event_loop& loop, aes::test::async::completion done)
+
 
 ///////////////////////////////////////////////////////////////////////////////////
 // assert macros
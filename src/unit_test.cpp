@@ -0,0 +1,22 @@
+/****
+ * Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Runtime of the library mode: the non template functions and the common template
+// instantiations of the framework, see unit_test_config.h
+#define AES_TEST_BUILD_LIBRARY
+#include "unit_test.h"
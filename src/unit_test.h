@@ -17,32 +17,98 @@
  */
 #pragma once
 
+#include "unit_test_config.h"
 #include <string>
 #include <vector>
 #include <algorithm>
 #include <sstream>
 #include <map>
+#include <set>
+#include <deque>
+#include <memory>
 #include <iomanip>
+#if defined(AES_TEST_IMPLEMENTATION)
 #include <iostream>
+#include <fstream>
+#else
+#include <ostream>
+#endif
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <exception>
+#include <iterator>
+#include <type_traits>
+#if defined(__linux__)
+#include <pthread.h>
+#endif
+#include "unit_test_format.h"
+#include "unit_test_diff.h"
+#include "unit_test_result_log.h"
+#include "unit_test_async.h"
+#include "unit_test_distributed.h"
+#include "unit_test_topology.h"
+#include "unit_test_module.h"
+#include "unit_test_coverage.h"
+#include "unit_test_resources.h"
+#include "unit_test_metrics.h"
+#include "unit_test_trace.h"
+#include "unit_test_flight.h"
+#include "unit_test_benchmark.h"
+#include "unit_test_snapshot.h"
 
 #define test_main(title)                                 main_test_function(title)
 #define test_method(name, description)                   unit_test_method(name, description)
 #define test_method_list(name, description, type, list)  unit_test_method_list(name, description, type, list)
-#define test_section(message)
+#define memory_heavy_test_method(name, description)      unit_memory_heavy_test_method(name, description)
+#define stress_method(name, description, threads, iterations) unit_stress_method(name, description, threads, iterations)
+#define async_test_method(name, description)             unit_async_test_method(name, description)
+#define complexity_method(name, description, declared, first_size, last_size) unit_complexity_method(name, description, declared, first_size, last_size)
+#if defined(AES_TEST_COROUTINES)
+#define coroutine_test_method(name, description)         unit_coroutine_test_method(name, description)
+#endif
+#define test_section(message)                            if (aes::test::section_guard<typename std::remove_reference<decltype(assert)>::type> unit_test_section{ assert, message })
 
 ///////////////////////////////////////////////////////////////////////////////////
 // assert macros
+//
+// With AES_TEST_LEAN defined, the common assertions do not build the message and the
+// file name at each call: the site registers its message, file and line once in a
+// constant table entry and only passes that entry and the values. The text is read from
+// the entry when the assertion is logged, so a passing assertion costs a comparison.
+// The message is evaluated twice, for the entry and for the call, so it must not have side
+// effects. A const char array is kept by the entry as a literal and must outlive the test.
+#if defined(AES_TEST_LEAN)
+#if defined(__GNUC__)
+// A statement expression rather than a lambda, which adds a function and its unwind table per site.
+#define AES_TEST_SITE(message)                           aes::test::site_ref{ __extension__ ({ static const aes::test::site where = { aes::test::site_literal(message), __FILE__, __LINE__ }; &where; }), aes::test::site_text(message) }
+#else
+#define AES_TEST_SITE(message)                           aes::test::site_ref{ [&]() noexcept -> const aes::test::site* { static const aes::test::site where = { aes::test::site_literal(message), __FILE__, __LINE__ }; return &where; }(), aes::test::site_text(message) }
+#endif
+#define assert_equal(message, expected, actual)          assert.equal(AES_TEST_SITE(message), expected, actual)
+#define assert_not_equal(message, expected, actual)      assert.not_equal(AES_TEST_SITE(message), expected, actual)
+#define assert_not_null(message, actual)                 assert.not_null(AES_TEST_SITE(message), (void*)(actual))
+#define assert_is_true(message, actual)                  assert.is_true(AES_TEST_SITE(message), (actual))
+#define assert_is_false(message, actual)                 assert.is_false(AES_TEST_SITE(message), (actual))
+#define assert_pass(message)                             assert.pass(AES_TEST_SITE(message))
+#define assert_fail(message)                             assert.fail(AES_TEST_SITE(message))
+#else
 #define assert_equal(message, expected, actual)          assert.equal(__FILE__, __LINE__, message, expected, actual)
 #define assert_not_equal(message, expected, actual)      assert.not_equal(__FILE__, __LINE__, message, expected, actual)
-#define assert_not_null(message, actual)                 assert.generic(__FILE__, __LINE__, "Not null", message, (void*)nullptr, (void*)(actual), [](void* expected, void* value) { return expected != value; })
+#define assert_not_null(message, actual)                 assert.not_null(__FILE__, __LINE__, message, (void*)(actual))
+#define assert_is_true(message, actual)                  assert.is_true(__FILE__, __LINE__, message, (actual))
+#define assert_is_false(message, actual)                 assert.is_false(__FILE__, __LINE__, message, (actual))
+#define assert_pass(message)                             assert.pass(__FILE__, __LINE__, message)
+#define assert_fail(message)                             assert.fail(__FILE__, __LINE__, message)
+#endif
 #define assert_uint64_t_equal(message, expected, actual) assert_equal(message, uint64_t(expected), uint64_t(actual))
 #define assert_uint32_t_equal(message, expected, actual) assert_equal(message, uint32_t(expected), uint32_t(actual))
 #define assert_enum_equal(message, expected, actual)     assert_uint32_t_equal(message, expected, actual)
 #define assert_size_t_equal(message, expected, actual)   assert_equal(message, size_t(expected), size_t(actual))
-#define assert_is_true(message, actual)                  assert.generic(__FILE__, __LINE__, "Is true", message, true, (actual), [](bool expected, bool value) { return expected == value; })
-#define assert_is_false(message, actual)                 assert.generic(__FILE__, __LINE__, "Is false", message, false, (actual), [](bool expected, bool value) { return expected == value; })
-#define assert_pass(message)                             assert.pass(__FILE__, __LINE__, message)
-#define assert_fail(message)                             assert.fail(__FILE__, __LINE__, message)
 #define assert_string_empty(message, actual)             assert_equal(message, std::string(), actual)
 #define assert_vector_equal(message, expected, actual)   assert.vector_equal(__FILE__, __LINE__, message, expected, actual)
 #define assert_vector_empty(message, actual)             assert_size_t_equal(message, 0, actual.size())
@@ -50,10 +116,18 @@
 #define assert_ptr_null(message, actual)                 assert_ptr_equal(message, nullptr, actual)
 #define assert_ptr_not_equal(message, expected, actual)  assert_not_equal(message, ((void*)expected), ((void*)actual))
 #define assert_ptr_not_null(message, actual)             assert_ptr_not_equal(message, nullptr, actual)
+#define assert_matches_snapshot(name, actual)            assert.matches_snapshot(__FILE__, __LINE__, name, actual)
+#define assert_all_of(message, range, pred)              assert.all_of(__FILE__, __LINE__, message, range, pred, 1)
+#define assert_none_of(message, range, pred)             assert.none_of(__FILE__, __LINE__, message, range, pred, 1)
+#define assert_count_if(message, expected, range, pred)  assert.count_if(__FILE__, __LINE__, message, expected, range, pred, 1)
+#define assert_all_of_parallel(message, range, pred)     assert.all_of(__FILE__, __LINE__, message, range, pred, 0)
+#define assert_none_of_parallel(message, range, pred)    assert.none_of(__FILE__, __LINE__, message, range, pred, 0)
+#define assert_count_if_parallel(message, expected, range, pred) assert.count_if(__FILE__, __LINE__, message, expected, range, pred, 0)
 
 ///////////////////////////////////////////////////////////////////////////////////
 // useful macros
 #define array_size(test_array, struct_type)              (sizeof(test_array) / sizeof(struct_type))
+#define test_log(component, log_level, message)          aes::test::test_suite_singleton::get().test_logger().log(component, aes::test::log::log_level, message)
 
 
 namespace aes
@@ -71,7 +145,40 @@ namespace aes
                                 _TFunction operation);
          size_t find_min_pos(size_t pos1, size_t pos2, size_t end_pos = std::string::npos);
          size_t find_max_pos(size_t pos1, size_t pos2, size_t end_pos = std::string::npos);
+         std::string trim(const std::string& value);
+         bool match_option(const std::string& argument, const std::string& name, std::string& value);
          int unit_test_main(int argc, char** argv, const char* title);
+
+         struct range_scan
+         {
+            size_t size_;
+            size_t count_;                   // elements for which the predicate is not the wanted value
+            std::vector<size_t> offenders_;  // indices of the first of them, in order
+            size_t thrown_;                  // index of the first element whose predicate threw, size_ when none did
+            std::string error_;              // what it threw
+         };
+
+         template <typename _TRange, typename _TPredicate>
+         range_scan scan_range(const _TRange& range, _TPredicate pred, bool wanted, size_t max_offenders, unsigned threads);
+
+         class spin_barrier
+         {
+         public:
+            spin_barrier(unsigned count) noexcept;
+            spin_barrier(const spin_barrier&) = delete;
+            ~spin_barrier() noexcept = default;
+
+         public:
+            spin_barrier& operator=(const spin_barrier&) = delete;
+
+         public:
+            void wait() noexcept;
+
+         private:
+            const unsigned count_;
+            std::atomic<unsigned> waiting_;
+            std::atomic<unsigned> generation_;
+         };
       }
 
       namespace log
@@ -86,6 +193,151 @@ namespace aes
             debug = 31
          };
 
+         enum class capture_mode
+         {
+            none,     // records are written straight to the logger streams
+            spill,    // records are kept in memory and spilled to a temporary file past the limit
+            tail      // only the last 'limit' bytes of records are kept
+         };
+
+         // The records of both streams are kept in one buffer, in the order they were logged,
+         // each behind a tag byte telling its stream.
+         class capture_stream
+         {
+         public:
+            capture_stream() noexcept;
+            capture_stream(const capture_stream&) = delete;
+            ~capture_stream() noexcept;
+
+         public:
+            capture_stream& operator=(const capture_stream&) = delete;
+
+         public:
+            void append(bool is_error, const std::string& record, capture_mode mode, size_t limit) noexcept;
+            template <typename _TOut, typename _TError>
+            void flush(_TOut& out, _TError& error) noexcept;
+            void clear() noexcept;
+            uint64_t size() const noexcept;
+
+         private:
+            static bool is_tag(const std::string& text, size_t index) noexcept;
+            void spill() noexcept;
+
+         private:
+            std::string buffer_;
+            std::FILE* spill_file_;
+            uint64_t spilled_;
+            uint64_t truncated_;
+            uint64_t tags_;                  // tag bytes kept, they are not part of the records
+         };
+
+         class capture_buffer
+         {
+         public:
+            capture_buffer(capture_mode mode = capture_mode::spill, size_t limit = 1024 * 1024) noexcept;
+            capture_buffer(const capture_buffer&) = delete;
+            ~capture_buffer() noexcept = default;
+
+         public:
+            capture_buffer& operator=(const capture_buffer&) = delete;
+
+         public:
+            template <typename T>
+            void append(bool is_error, const T& message) noexcept;
+            template <typename _TOut, typename _TError>
+            void flush(_TOut& out, _TError& error) noexcept;
+            void clear() noexcept;
+
+         public:
+            capture_mode mode() const noexcept;
+            void mode(capture_mode new_mode) noexcept;
+            size_t limit() const noexcept;
+            void limit(size_t new_limit) noexcept;
+            uint64_t size() const noexcept;
+
+         private:
+            capture_mode mode_;
+            size_t limit_;
+            capture_stream records_;
+         };
+
+         bool parse_level(const std::string& name, level& parsed) noexcept;
+
+         // A named component with a level of its own, the level is resolved from the rules of
+         // the categories when the component is created and every time the rules change.
+         class category
+         {
+         public:
+            category(const std::string& name);
+            category(const category&) = delete;
+            ~category() noexcept;
+
+         public:
+            category& operator=(const category&) = delete;
+
+         public:
+            bool should_log(level message_level) const noexcept
+            {
+               return (level_.load(std::memory_order_relaxed) & message_level) == message_level;
+            }
+
+            const std::string& name() const noexcept;
+            level log_level() const noexcept;
+            void log_level(level new_level) noexcept;
+
+         private:
+            std::string name_;
+            std::atomic<int> level_;
+         };
+
+         // Rules "<name>:<level>" separated by commas: the name is a test, a file, a component,
+         // a prefix ending with '*', or '*' alone for everything else. The longest match wins.
+         class categories
+         {
+         public:
+            static categories& get() noexcept;
+
+         public:
+            bool configure(const std::string& rules);
+            bool level_of(const std::string& name, level& found) const;
+            level level_of(const std::string& test, const std::string& file, level fallback) const;
+            void attach(category* component);
+            void detach(category* component) noexcept;
+
+         private:
+            struct rule
+            {
+               std::string pattern_;
+               level level_;
+            };
+
+         private:
+            categories() noexcept;
+            bool find(const std::string& name, level& found, size_t& length) const noexcept;
+
+         private:
+            mutable std::mutex lock_;
+            std::vector<rule> rules_;
+            std::vector<category*> components_;
+         };
+
+         // Applies the level of the categories of a test to the logger while it runs.
+         template <typename _TLogger>
+         class level_guard
+         {
+         public:
+            level_guard(_TLogger& logger, const std::string& test, const std::string& file);
+            level_guard(const level_guard&) = delete;
+            ~level_guard() noexcept;
+
+         public:
+            level_guard& operator=(const level_guard&) = delete;
+
+         private:
+            _TLogger& logger_;
+            level previous_;
+         };
+
          template <typename _TOut, typename _TError>
          class logger_base
          {
@@ -111,6 +363,8 @@ namespace aes
             void log_trace(const T& message) const noexcept;
             template <typename T>
             void log_debug(const T& message) const noexcept;
+            template <typename T>
+            void log(const category& component, level message_level, const T& message) const noexcept;
 
          public:
             bool should_log_error() const noexcept;
@@ -124,6 +378,11 @@ namespace aes
             level log_level() const noexcept;
             void log_level(level new_level) noexcept;
 
+         public:
+            void begin_capture(capture_buffer& buffer) noexcept;
+            void end_capture(bool emit) noexcept;
+            bool is_capturing() const noexcept;
+
          private:
             template <typename T, typename _TShouldLog, typename _TStream>
             void log(const T& message, _TShouldLog should_log_func, _TStream& stream) const noexcept;
@@ -132,14 +391,90 @@ namespace aes
             _TOut& out_;
             _TError&  error_;
             level level_;
+            capture_buffer* capture_;
          };
       }
 
+      // Entry of an assertion site in lean mode, constant initialized when its message is a
+      // literal. Other messages are built by the call and passed along with the entry.
+      struct site
+      {
+         const char* message_;
+         const char* file_;
+         int line_;
+      };
+
+      struct site_ref
+      {
+         const site* site_;
+         const std::string* text_;             // message of the call when it is not a literal
+
+         std::string message() const;
+         std::string file() const;
+      };
+
+      // A mutable char buffer is not a literal: its text is copied into a temporary of the
+      // call, which lives until the end of the assertion.
+      template <size_t _Size>
+      constexpr const char* site_literal(const char (&message)[_Size]) noexcept;
+      template <size_t _Size>
+      constexpr const char* site_literal(char (&message)[_Size]) noexcept;
+      constexpr const char* site_literal(const std::string& message) noexcept;
+      template <size_t _Size>
+      constexpr const std::string* site_text(const char (&message)[_Size]) noexcept;
+      template <size_t _Size>
+      const std::string* site_text(char (&message)[_Size], std::string&& text = std::string());
+      const std::string* site_text(const std::string& message) noexcept;
+
+      // Every run of a test body enters at most one section of each level, the body is run
+      // again until every section has been entered once, as with Catch.
+      class section_tracker
+      {
+      public:
+         struct section
+         {
+            std::string name_;
+            size_t parent_;
+            size_t depth_;
+            std::vector<size_t> children_;
+            bool complete_;
+            bool entered_child_;        // a child has been entered in the current run
+            uint64_t passed_;
+            uint64_t failed_;
+            std::chrono::nanoseconds elapsed_;
+            uint64_t start_passed_;
+            uint64_t start_failed_;
+            std::chrono::steady_clock::time_point start_;
+         };
+
+      public:
+         section_tracker() noexcept;
+
+      public:
+         void filter(const std::vector<std::string>& path);
+         void restart() noexcept;
+         void begin_run() noexcept;
+         bool end_run() noexcept;
+         bool enter(const std::string& name, uint64_t passed, uint64_t failed);
+         void leave(uint64_t passed, uint64_t failed) noexcept;
+
+      public:
+         const std::vector<section>& sections() const noexcept;
+
+      private:
+         std::vector<section> sections_;       // the test itself is the first section
+         std::vector<std::string> filter_;
+         size_t current_;
+         bool active_;                         // sections outside a run, as in stress tests, are always entered
+         bool entered_;
+      };
+
       template <typename _TLogger>
       class assert_base
       {
       public:
          assert_base(_TLogger& logger) noexcept;
+         assert_base(_TLogger& logger, const assert_base& parent) noexcept;
          assert_base(const assert_base&) = default;
          ~assert_base() noexcept = default;
 
@@ -159,19 +494,52 @@ namespace aes
          bool generic(const std::string& file, int line, const std::string& assert_type, const std::string& message, const T& expected, const T& actual, bool result) noexcept;
          template <typename T>
          bool generic(const std::string& file, int line, const std::string& assert_type, const std::string& message, const T& actual, bool result) noexcept;
+         bool is_true(const std::string& file, int line, const std::string& message, bool actual) noexcept;
+         bool is_false(const std::string& file, int line, const std::string& message, bool actual) noexcept;
+         bool not_null(const std::string& file, int line, const std::string& message, void* actual) noexcept;
          bool pass(const std::string& file, int line, const std::string& message) noexcept;
          bool fail(const std::string& file, int line, const std::string& message) noexcept;
          template <typename T>
          bool vector_equal(const std::string& file, int line, const std::string& message, const std::vector<T>& expected, const std::vector<T>& actual) noexcept;
+         template <typename T>
+         bool matches_snapshot(const std::string& file, int line, const std::string& name, const T& actual) noexcept;
+         bool matches_snapshot(const std::string& file, int line, const std::string& name, const void* data, size_t size) noexcept;
+         template <typename _TRange, typename _TPredicate>
+         bool all_of(const std::string& file, int line, const std::string& message, const _TRange& range, _TPredicate pred, unsigned threads) noexcept;
+         template <typename _TRange, typename _TPredicate>
+         bool none_of(const std::string& file, int line, const std::string& message, const _TRange& range, _TPredicate pred, unsigned threads) noexcept;
+         template <typename _TRange, typename _TPredicate>
+         bool count_if(const std::string& file, int line, const std::string& message, size_t expected, const _TRange& range, _TPredicate pred, unsigned threads) noexcept;
+         template <typename T>
+         bool equal(const site_ref& where, const T& expected, const T& actual) noexcept;
+         template <typename T>
+         bool not_equal(const site_ref& where, const T& expected, const T& actual) noexcept;
+         bool is_true(const site_ref& where, bool actual) noexcept;
+         bool is_false(const site_ref& where, bool actual) noexcept;
+         bool not_null(const site_ref& where, void* actual) noexcept;
+         bool pass(const site_ref& where) noexcept;
+         bool fail(const site_ref& where) noexcept;
+
+      public:
+         template <typename _TBody>
+         void run_sections(_TBody body);
+         bool enter_section(const std::string& name);
+         void leave_section() noexcept;
+         section_tracker& sections() noexcept;
 
       public:
          uint64_t passed() const noexcept;
          uint64_t failed() const noexcept;
          uint64_t total() const noexcept;
+         void result_log(aes::test::result_log::writer* writer, uint32_t test) noexcept;
+         void merge(const assert_base& other) noexcept;
 
       private:
-         std::string file_name(const std::string file_path) noexcept;
+         static const char* file_name(const std::string& file_path) noexcept;
+         template <typename _TRange>
+         bool log_range(const std::string& file, int line, const std::string& assert_type, const std::string& message, const _TRange& range, const aes::test::utils::range_scan& scan, bool result, const char* found) noexcept;
          void log_result(const std::string& file, int line, bool result, const std::string& message) noexcept;
+         bool passed_quietly() noexcept;
          void log_fail(const std::string& file, int line, const std::string& message) noexcept;
          void log_success(const std::string& file, int line, const std::string& message) noexcept;
 
@@ -179,6 +547,28 @@ namespace aes
          _TLogger& logger_;
          uint64_t passed_;
          uint64_t failed_;
+         aes::test::result_log::writer* result_log_;
+         uint32_t test_id_;
+         section_tracker sections_;
+      };
+
+      template <typename _TAssert>
+      class section_guard
+      {
+      public:
+         section_guard(_TAssert& assert, const std::string& name);
+         section_guard(const section_guard&) = delete;
+         ~section_guard() noexcept;
+
+      public:
+         section_guard& operator=(const section_guard&) = delete;
+
+      public:
+         explicit operator bool() const noexcept;
+
+      private:
+         _TAssert& assert_;
+         bool entered_;
       };
 
       template <typename _TSuiteSingleton, typename _TLogger>
@@ -194,21 +584,154 @@ namespace aes
 
       public:
          bool run_test();
+         void start_test(aes::test::async::event_loop& loop);
+         virtual bool is_async() const noexcept;
 
       public:
          const std::string& name() const noexcept;
          const std::string& description() const noexcept;
+         const std::string& source_file() const noexcept;
+         void source_file(const std::string& new_file);
+         bool memory_heavy() const noexcept;
+         void memory_heavy(bool is_memory_heavy) noexcept;
          uint64_t passed() const noexcept;
          uint64_t failed() const noexcept;
          uint64_t total() const noexcept;
+         void result_log(aes::test::result_log::writer* writer, uint32_t test) noexcept;
+         void section_filter(const std::vector<std::string>& path);
+         const std::vector<section_tracker::section>& sections() noexcept;
 
       private:
          virtual void run_tests(assert_base<_TLogger>& assert) = 0;
+         virtual void start_tests(assert_base<_TLogger>& assert, aes::test::async::event_loop& loop);
 
       private:
          assert_base<_TLogger> assert_;
          std::string name_;
          std::string description_;
+         std::string source_file_;
+         bool memory_heavy_;                                   // kept apart from the others of its NUMA node in distributed runs
+      };
+
+      template <typename _TSuiteSingleton, typename _TLogger>
+      class async_test_base : public unit_test_base<_TSuiteSingleton, _TLogger>
+      {
+      public:
+         async_test_base(const std::string& name, const std::string description) noexcept;
+         async_test_base(const async_test_base&) = default;
+         virtual ~async_test_base() noexcept = default;
+
+      public:
+         async_test_base& operator=(const async_test_base&) = default;
+
+      public:
+         virtual bool is_async() const noexcept;
+         bool is_completed() const noexcept;
+         aes::test::async::duration timeout() const noexcept;
+         void timeout(aes::test::async::duration new_timeout) noexcept;
+
+      private:
+         enum class state
+         {
+            idle,
+            running,
+            completed
+         };
+
+      private:
+         virtual void run_tests(assert_base<_TLogger>& assert);
+         virtual void start_tests(assert_base<_TLogger>& assert, aes::test::async::event_loop& loop);
+         virtual void run_async(assert_base<_TLogger>& assert, aes::test::async::event_loop& loop, aes::test::async::completion done) = 0;
+         virtual void end_async();
+         void start(assert_base<_TLogger>& assert, aes::test::async::event_loop& loop, bool metered);
+         void complete(const assert_base<_TLogger>& assert) noexcept;
+
+      private:
+         state state_;
+         aes::test::async::duration timeout_;                 // the test fails when it has not completed by then
+         std::chrono::steady_clock::time_point started_;
+         uint64_t failed_before_;                             // failed asserts of the test when it was started
+         bool metered_;                                       // started on the event loop of the suite, counted in the metrics by the test
+      };
+
+      class stress_settings
+      {
+      public:
+         static stress_settings& get() noexcept;
+
+      public:
+         unsigned threads() const noexcept;
+         void threads(unsigned new_threads) noexcept;
+         bool pin_threads() const noexcept;
+         void pin_threads(bool pin) noexcept;
+
+      private:
+         stress_settings() noexcept;
+
+      private:
+         unsigned threads_;      // overrides the number of threads of every stress test when not 0
+         bool pin_threads_;
+      };
+
+      template <typename _TSuiteSingleton, typename _TLogger>
+      class stress_test_base : public unit_test_base<_TSuiteSingleton, _TLogger>
+      {
+      public:
+         stress_test_base(const std::string& name, const std::string description, unsigned threads, uint64_t iterations) noexcept;
+         stress_test_base(const stress_test_base&) = default;
+         virtual ~stress_test_base() noexcept = default;
+
+      public:
+         stress_test_base& operator=(const stress_test_base&) = default;
+
+      public:
+         unsigned threads() const noexcept;
+         uint64_t iterations() const noexcept;
+
+      private:
+         struct thread_result
+         {
+            uint64_t iterations_;
+            uint64_t first_failure_;
+            double seconds_;
+         };
+
+      private:
+         virtual void run_tests(assert_base<_TLogger>& assert);
+         virtual void run_stress(assert_base<_TLogger>& assert, uint64_t iteration) = 0;
+         void run_thread(assert_base<_TLogger>& assert, aes::test::utils::spin_barrier& barrier, thread_result& result);
+
+      private:
+         unsigned threads_;
+         uint64_t iterations_;
+      };
+
+      template <typename _TSuiteSingleton, typename _TLogger>
+      class complexity_test_base : public unit_test_base<_TSuiteSingleton, _TLogger>
+      {
+      public:
+         complexity_test_base(const std::string& name, const std::string description, aes::test::benchmark::complexity declared, uint64_t first_size, uint64_t last_size) noexcept;
+         complexity_test_base(const complexity_test_base&) = default;
+         virtual ~complexity_test_base() noexcept = default;
+
+      public:
+         complexity_test_base& operator=(const complexity_test_base&) = default;
+
+      public:
+         aes::test::benchmark::complexity declared() const noexcept;
+         const std::vector<aes::test::benchmark::sample>& samples() const noexcept;
+
+      private:
+         virtual void run_tests(assert_base<_TLogger>& assert);
+         virtual void run_complexity(assert_base<_TLogger>& assert, aes::test::benchmark::state& state) = 0;
+         double run_once(assert_base<_TLogger>& assert, uint64_t size);
+         aes::test::benchmark::statistics run_size(assert_base<_TLogger>& assert, uint64_t size);
+
+      private:
+         aes::test::benchmark::complexity declared_;
+         uint64_t first_size_;
+         uint64_t last_size_;
+         std::vector<aes::test::benchmark::sample> samples_;
       };
 
       template <typename _TSuiteSingleton, typename _TLogger>
@@ -225,6 +748,28 @@ namespace aes
       public:
          bool register_test(unit_test_base<_TSuiteSingleton, _TLogger>* test) noexcept;
          bool run(const std::string& title);
+#if defined(AES_TEST_DISTRIBUTED)
+         bool run_coordinator(const std::string& title, aes::test::distributed::listener& listener, aes::test::distributed::process_group& workers);
+         bool run_worker(aes::test::distributed::channel& coordinator, int node = -1);
+         void memory_heavy_per_node(unsigned limit) noexcept;
+#endif
+#if defined(AES_TEST_MODULES)
+         std::vector<aes::test::module::test_info> list() const;
+         bool run_captured(const std::string& name, aes::test::module::result& outcome);
+         bool run_module(const std::string& title, aes::test::module::suite& module, const std::vector<std::string>& tests, std::set<std::string>& failing);
+         bool run_modules(const std::string& title, const std::vector<aes::test::module::suite*>& modules, unsigned threads);
+#endif
+         void shard(unsigned index, unsigned count) noexcept;
+         void select(const std::set<std::string>& names);
+         void filter(const std::string& test, const std::vector<std::string>& sections);
+         void coverage_dump(const std::string& directory);
+         void capture_output(aes::test::log::capture_mode mode, size_t limit) noexcept;
+         void result_log(aes::test::result_log::writer* writer) noexcept;
+         void virtual_time(bool is_virtual) noexcept;
+#if defined(AES_TEST_RESOURCES)
+         void isolate(const aes::test::resources::limits& limits) noexcept;
+         void report_resources(bool report) noexcept;
+#endif
 
       public:
          _TLogger& test_logger() const noexcept;
@@ -232,11 +777,43 @@ namespace aes
          uint64_t failed() const noexcept;
          uint64_t total() const noexcept;
 
+      private:
+         bool in_shard(size_t ordinal) const noexcept;
+         bool is_selected(const unit_test_base<_TSuiteSingleton, _TLogger>* test) const;
+         bool run_one(unit_test_base<_TSuiteSingleton, _TLogger>* test, uint64_t& passed, uint64_t& failed, std::string& resources);
+#if defined(AES_TEST_MODULES)
+         bool run_captured(unit_test_base<_TSuiteSingleton, _TLogger>* test, aes::test::module::result& outcome);
+#endif
+#if defined(AES_TEST_RESOURCES)
+         bool run_isolated(unit_test_base<_TSuiteSingleton, _TLogger>* test, uint64_t& passed, uint64_t& failed, std::string& resources);
+#endif
+         void log_output(const std::string& output, size_t out_size) const;
+         void log_test(const std::string& name, uint64_t passed, uint64_t failed, time_t seconds, const std::string& details = std::string()) const;
+         void log_sections(unit_test_base<_TSuiteSingleton, _TLogger>* test) const;
+         void log_total(const std::string& title) const;
+
       private:
          _TLogger& logger_;
          uint64_t passed_;
          uint64_t failed_;
          std::multimap<const std::string, unit_test_base<_TSuiteSingleton, _TLogger>*> map_;
+         aes::test::log::capture_buffer capture_;
+         aes::test::result_log::writer* result_log_;
+         aes::test::async::event_loop loop_;
+         unsigned shard_index_;
+         unsigned shard_count_;
+         bool is_selection_;
+         std::set<std::string> selection_;
+         std::map<std::string, std::vector<std::string>> section_filters_;
+         std::string coverage_dump_;
+#if defined(AES_TEST_DISTRIBUTED)
+         unsigned memory_heavy_per_node_;                      // memory-heavy tests run at the same time on a NUMA node, 0 for no limit
+#endif
+#if defined(AES_TEST_RESOURCES)
+         bool isolate_;
+         bool report_resources_;
+         aes::test::resources::limits limits_;
+#endif
       };
 
       class test_suite_singleton
@@ -251,23 +828,47 @@ using logger = aes::test::log::logger_base<std::ostream, std::ostream>;
 using test_assert = aes::test::assert_base<logger>;
 using unit_test = aes::test::unit_test_base<aes::test::test_suite_singleton, logger>;
 using test_suite = aes::test::test_suite_base<aes::test::test_suite_singleton, logger>;
+using stress_test = aes::test::stress_test_base<aes::test::test_suite_singleton, logger>;
+using async_test = aes::test::async_test_base<aes::test::test_suite_singleton, logger>;
+using complexity_test = aes::test::complexity_test_base<aes::test::test_suite_singleton, logger>;
 
 #define unit_test_method(name, description)                                   \
 class unit_test_##name : public unit_test                                     \
 {                                                                             \
    public:                                                                    \
-      unit_test_##name() : unit_test("  " #name " ", description) {}          \
+      unit_test_##name() : unit_test("  " #name " ", description) { source_file(__FILE__); } \
+   private:                                                                   \
+      virtual void run_tests(test_assert& assert);                            \
+      void run_body(test_assert& assert);                                     \
+};                                                                            \
+static unit_test_##name unit_test_obj_##name;                                 \
+void unit_test_##name::run_tests(test_assert& assert)                         \
+{                                                                             \
+   assert.run_sections([&]() { run_body(assert); });                          \
+}                                                                             \
+void unit_test_##name::run_body(test_assert& assert)
+
+#define unit_memory_heavy_test_method(name, description)                      \
+class unit_test_##name : public unit_test                                     \
+{                                                                             \
+   public:                                                                    \
+      unit_test_##name() : unit_test("  " #name " ", description) { source_file(__FILE__); memory_heavy(true); } \
    private:                                                                   \
       virtual void run_tests(test_assert& assert);                            \
+      void run_body(test_assert& assert);                                     \
 };                                                                            \
 static unit_test_##name unit_test_obj_##name;                                 \
-void unit_test_##name::run_tests(test_assert& assert)
+void unit_test_##name::run_tests(test_assert& assert)                         \
+{                                                                             \
+   assert.run_sections([&]() { run_body(assert); });                          \
+}                                                                             \
+void unit_test_##name::run_body(test_assert& assert)
 
 #define unit_test_method_list(name, description, list_type, list)             \
 class unit_test_##name : public unit_test                                     \
 {                                                                             \
    public:                                                                    \
-      unit_test_##name() : unit_test("  " #name " ", description) {}          \
+      unit_test_##name() : unit_test("  " #name " ", description) { source_file(__FILE__); } \
    private:                                                                   \
       virtual void run_tests(test_assert& assert);                            \
       void run_tests(test_assert& assert, list_type& input);                  \
@@ -275,18 +876,78 @@ class unit_test_##name : public unit_test                                     \
 static unit_test_##name unit_test_obj_##name;                                 \
 void unit_test_##name::run_tests(test_assert& assert)                         \
 {                                                                             \
-   std::for_each(list.begin(), list.end(), [&](list_type& input)  \
+   std::for_each(list.begin(), list.end(), [&](list_type& input)              \
    {                                                                          \
-      run_tests(assert, input);                                               \
+      assert.run_sections([&]() { run_tests(assert, input); });               \
    });                                                                        \
 }                                                                             \
 void unit_test_##name::run_tests(test_assert& assert, list_type& input)
 
+#define unit_stress_method(name, description, threads, iterations)            \
+class unit_test_##name : public stress_test                                   \
+{                                                                             \
+   public:                                                                    \
+      unit_test_##name() : stress_test("  " #name " ", description, threads, iterations) { source_file(__FILE__); } \
+   private:                                                                   \
+      virtual void run_stress(test_assert& assert, uint64_t iteration);       \
+};                                                                            \
+static unit_test_##name unit_test_obj_##name;                                 \
+void unit_test_##name::run_stress(test_assert& assert, uint64_t iteration)
+
+#define unit_complexity_method(name, description, declared, first_size, last_size) \
+class unit_test_##name : public complexity_test                               \
+{                                                                             \
+   public:                                                                    \
+      unit_test_##name() : complexity_test("  " #name " ", description, aes::test::benchmark::complexity::declared, first_size, last_size) { source_file(__FILE__); } \
+   private:                                                                   \
+      virtual void run_complexity(test_assert& assert, aes::test::benchmark::state& state); \
+};                                                                            \
+static unit_test_##name unit_test_obj_##name;                                 \
+void unit_test_##name::run_complexity(test_assert& assert, aes::test::benchmark::state& state)
+
+#define unit_async_test_method(name, description)                             \
+class unit_test_##name : public async_test                                    \
+{                                                                             \
+   public:                                                                    \
+      unit_test_##name() : async_test("  " #name " ", description) { source_file(__FILE__); } \
+   private:                                                                   \
+      virtual void run_async(test_assert& assert, aes::test::async::event_loop& loop, aes::test::async::completion done); \
+};                                                                            \
+static unit_test_##name unit_test_obj_##name;                                 \
+void unit_test_##name::run_async(test_assert& assert, aes::test::async::event_loop& loop, aes::test::async::completion done)
+
+#define unit_coroutine_test_method(name, description)                         \
+class unit_test_##name : public async_test                                    \
+{                                                                             \
+   public:                                                                    \
+      unit_test_##name() : async_test("  " #name " ", description) { source_file(__FILE__); } \
+   private:                                                                   \
+      virtual void run_async(test_assert& assert, aes::test::async::event_loop& loop, aes::test::async::completion done) \
+      {                                                                       \
+         task_ = run_coroutine(assert, loop);                                 \
+         task_.start(done);                                                   \
+      }                                                                       \
+      virtual void end_async() { task_ = aes::test::async::task(); }         \
+      aes::test::async::task run_coroutine(test_assert& assert, aes::test::async::event_loop& loop); \
+      aes::test::async::task task_;                                           \
+};                                                                            \
+static unit_test_##name unit_test_obj_##name;                                 \
+aes::test::async::task unit_test_##name::run_coroutine(test_assert& assert, aes::test::async::event_loop& loop)
+
+#if defined(AES_TEST_MODULE)
+// Built as a test module, the runner loading it calls the entry point instead of main.
+#define main_test_function(title)                                                           \
+   extern "C" aes::test::module::suite* aes_test_module(aes::test::module::fixtures* kept)  \
+   {                                                                                        \
+      return aes::test::module::enter(aes::test::test_suite_singleton::get(), kept, title); \
+   }
+#else
 #define main_test_function(title)                                                           \
    int main(int argc, char** argv)                                                          \
    {                                                                                        \
       return aes::test::utils::unit_test_main(argc, argv, title); \
    }
+#endif
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -322,18 +983,369 @@ inline _TFunction aes::test::utils::for_each_if(_TIterator first,
    return operation;
 }
 
-inline size_t aes::test::utils::find_min_pos(size_t pos1, size_t pos2, size_t end_pos)
+// The predicate runs in a plain loop, without the logging of an assertion per element. Ranges
+// with random access iterators are split between the threads, 0 for the number of cores, as
+// long as each thread has enough elements to be worth starting; the predicate must then be
+// callable concurrently. A predicate that throws stops the scan of its part of the range, the
+// element is reported rather than the exception leaving a thread. A part whose thread cannot
+// be started is scanned by the calling thread.
+template <typename _TRange, typename _TPredicate>
+inline aes::test::utils::range_scan aes::test::utils::scan_range(const _TRange& range, _TPredicate pred, bool wanted, size_t max_offenders, unsigned threads)
+{
+   using iterator = decltype(std::begin(range));
+   const size_t grain = 16384;
+
+   auto first = std::begin(range);
+   size_t size = size_t(std::distance(first, std::end(range)));
+   range_scan scan = { size, 0, std::vector<size_t>(), size, std::string() };
+   auto chunk = [&pred, wanted, max_offenders](iterator begin, size_t from, size_t to, range_scan& part) noexcept
+   {
+      size_t index = from;
+      try
+      {
+         for (; index < to; ++index, ++begin)
+         {
+            if (bool(pred(*begin)) != wanted)
+            {
+               if (part.count_++ < max_offenders)
+               {
+                  part.offenders_.push_back(index);
+               }
+            }
+         }
+      }
+      catch (const std::exception& e)
+      {
+         part.thrown_ = index;
+         part.error_ = e.what();
+      }
+      catch (...)
+      {
+         part.thrown_ = index;
+         part.error_ = "unknown exception";
+      }
+   };
+
+   bool random_access = std::is_base_of<std::random_access_iterator_tag, typename std::iterator_traits<iterator>::iterator_category>::value;
+   unsigned count = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+   count = unsigned(std::min<size_t>(count, scan.size_ / grain));
+   if (!random_access || count < 2)
+   {
+      chunk(first, 0, scan.size_, scan);
+      return scan;
+   }
+
+   std::vector<range_scan> parts(count, range_scan{ 0, 0, std::vector<size_t>(), size, std::string() });
+   std::vector<std::thread> pool;
+   pool.reserve(count);
+   for (unsigned i = 0; i < count; ++i)
+   {
+      size_t from = scan.size_ * i / count;
+      size_t to = scan.size_ * (i + 1) / count;
+      try
+      {
+         pool.emplace_back([&chunk, &parts, first, from, to, i]() { chunk(std::next(first, from), from, to, parts[i]); });
+      }
+      catch (const std::exception&)
+      {
+         chunk(std::next(first, from), from, to, parts[i]);
+      }
+   }
+   for (std::thread& thread : pool)
+   {
+      thread.join();
+   }
+   for (const range_scan& part : parts)
+   {
+      if (part.thrown_ < scan.thrown_)
+      {
+         scan.thrown_ = part.thrown_;
+         scan.error_ = part.error_;
+      }
+      scan.count_ += part.count_;
+      for (size_t index : part.offenders_)
+      {
+         if (scan.offenders_.size() < max_offenders)
+         {
+            scan.offenders_.push_back(index);
+         }
+      }
+   }
+   return scan;
+}
+
+#if defined(AES_TEST_IMPLEMENTATION)
+AES_TEST_INLINE size_t aes::test::utils::find_min_pos(size_t pos1, size_t pos2, size_t end_pos)
 {
    return pos1 == end_pos ? pos2 : pos2 == end_pos ? pos1 : std::min(pos1, pos2);
 }
 
-inline size_t aes::test::utils::find_max_pos(size_t pos1, size_t pos2, size_t end_pos)
+AES_TEST_INLINE size_t aes::test::utils::find_max_pos(size_t pos1, size_t pos2, size_t end_pos)
 {
    return pos1 == end_pos ? pos2 : pos2 == end_pos ? pos1 : std::max(pos1, pos2);
 }
 
+AES_TEST_INLINE std::string aes::test::utils::trim(const std::string& value)
+{
+   size_t first = value.find_first_not_of(" \t");
+   size_t last = value.find_last_not_of(" \t");
+   return first == std::string::npos ? std::string() : value.substr(first, last - first + 1);
+}
 
-///////////////////////////////////////////////////////////////////////////////////
+AES_TEST_INLINE bool aes::test::utils::match_option(const std::string& argument, const std::string& name, std::string& value)
+{
+   std::string option("--" + name);
+   bool result = false;
+
+   if (argument == option)
+   {
+      value.clear();
+      result = true;
+   }
+   else if (argument.compare(0, option.size() + 1, option + "=") == 0)
+   {
+      value = argument.substr(option.size() + 1);
+      result = true;
+   }
+
+   return result;
+}
+
+AES_TEST_INLINE aes::test::utils::spin_barrier::spin_barrier(unsigned count) noexcept
+   : count_(count)
+   , waiting_(0)
+   , generation_(0)
+{
+}
+
+AES_TEST_INLINE void aes::test::utils::spin_barrier::wait() noexcept
+{
+   unsigned generation = generation_.load(std::memory_order_acquire);
+
+   if (waiting_.fetch_add(1, std::memory_order_acq_rel) + 1 == count_)
+   {
+      waiting_.store(0, std::memory_order_relaxed);
+      generation_.fetch_add(1, std::memory_order_release);
+   }
+   else
+   {
+      // Spin to release all the threads as close together as possible, but yield
+      // from time to time in case there are more threads than cores.
+      for (unsigned spin = 1; generation_.load(std::memory_order_acquire) == generation; ++spin)
+      {
+         if ((spin & 0x3ff) == 0)
+         {
+            std::this_thread::yield();
+         }
+      }
+   }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////
+// capture_stream implementation
+
+AES_TEST_INLINE aes::test::log::capture_stream::capture_stream() noexcept
+   : buffer_()
+   , spill_file_(nullptr)
+   , spilled_(0)
+   , truncated_(0)
+   , tags_(0)
+{
+}
+
+AES_TEST_INLINE aes::test::log::capture_stream::~capture_stream() noexcept
+{
+   if (spill_file_)
+   {
+      std::fclose(spill_file_);
+   }
+}
+
+AES_TEST_INLINE void aes::test::log::capture_stream::append(bool is_error, const std::string& record, capture_mode mode, size_t limit) noexcept
+{
+   buffer_.push_back(is_error ? '\x02' : '\x01');
+   buffer_.append(record);
+   buffer_.push_back('\n');
+   tags_++;
+
+   if (buffer_.size() > limit)
+   {
+      if (mode == capture_mode::spill)
+      {
+         spill();
+      }
+      else if (buffer_.size() > 2 * limit)
+      {
+         // Trimming only once the buffer doubled keeps the cost amortised constant per record.
+         size_t cut = buffer_.size() - limit;
+         while (cut < buffer_.size() && !is_tag(buffer_, cut))
+         {
+            cut++;
+         }
+         size_t tags = 0;
+         for (size_t index = 0; index < cut; ++index)
+         {
+            tags += is_tag(buffer_, index) ? 1 : 0;
+         }
+         truncated_ += cut - tags;
+         tags_ -= tags;
+         buffer_.erase(0, cut);
+      }
+   }
+}
+#endif
+
+template <typename _TOut, typename _TError>
+inline void aes::test::log::capture_stream::flush(_TOut& out, _TError& error) noexcept
+{
+   if (truncated_ > 0)
+   {
+      out << "... " << truncated_ << " bytes of captured output truncated ...\n";
+   }
+
+   // A tag at the start of a line switches the stream the following text is written to.
+   bool line_start = true;
+   bool to_error = false;
+   auto write = [&](const char* data, size_t size)
+   {
+      size_t begin = 0;
+      for (size_t index = 0; index < size; ++index)
+      {
+         if (line_start && (data[index] == '\x01' || data[index] == '\x02'))
+         {
+            to_error ? error.write(data + begin, index - begin) : out.write(data + begin, index - begin);
+            to_error = data[index] == '\x02';
+            begin = index + 1;
+         }
+         line_start = data[index] == '\n';
+      }
+      to_error ? error.write(data + begin, size - begin) : out.write(data + begin, size - begin);
+   };
+
+   if (spill_file_ && spilled_ > 0)
+   {
+      char chunk[64 * 1024];
+      size_t read = 0;
+
+      std::fflush(spill_file_);
+      std::rewind(spill_file_);
+      while ((read = std::fread(chunk, 1, sizeof(chunk), spill_file_)) > 0)
+      {
+         write(chunk, read);
+      }
+   }
+
+   write(buffer_.data(), buffer_.size());
+   out.flush();
+   error.flush();
+   clear();
+}
+
+#if defined(AES_TEST_IMPLEMENTATION)
+AES_TEST_INLINE void aes::test::log::capture_stream::clear() noexcept
+{
+   buffer_.clear();
+   truncated_ = 0;
+   tags_ = 0;
+   if (spill_file_ && spilled_ > 0)
+   {
+      std::fclose(spill_file_);
+      spill_file_ = nullptr;
+   }
+   spilled_ = 0;
+}
+
+AES_TEST_INLINE uint64_t aes::test::log::capture_stream::size() const noexcept
+{
+   return spilled_ + buffer_.size() - tags_;
+}
+
+AES_TEST_INLINE bool aes::test::log::capture_stream::is_tag(const std::string& text, size_t index) noexcept
+{
+   return (text[index] == '\x01' || text[index] == '\x02') && (index == 0 || text[index - 1] == '\n');
+}
+
+AES_TEST_INLINE void aes::test::log::capture_stream::spill() noexcept
+{
+   if (!spill_file_)
+   {
+      spill_file_ = std::tmpfile();
+   }
+
+   if (spill_file_ && std::fwrite(buffer_.data(), 1, buffer_.size(), spill_file_) == buffer_.size())
+   {
+      spilled_ += buffer_.size();
+      buffer_.clear();
+   }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////
+// capture_buffer implementation
+
+AES_TEST_INLINE aes::test::log::capture_buffer::capture_buffer(capture_mode mode, size_t limit) noexcept
+   : mode_(mode)
+   , limit_(limit)
+   , records_()
+{
+}
+#endif
+
+template <typename T>
+inline void aes::test::log::capture_buffer::append(bool is_error, const T& message) noexcept
+{
+   std::stringstream ss;
+   ss << message;
+   records_.append(is_error, ss.str(), mode_, limit_);
+}
+
+template <>
+inline void aes::test::log::capture_buffer::append<std::string>(bool is_error, const std::string& message) noexcept
+{
+   records_.append(is_error, message, mode_, limit_);
+}
+
+template <typename _TOut, typename _TError>
+inline void aes::test::log::capture_buffer::flush(_TOut& out, _TError& error) noexcept
+{
+   records_.flush(out, error);
+}
+
+#if defined(AES_TEST_IMPLEMENTATION)
+AES_TEST_INLINE void aes::test::log::capture_buffer::clear() noexcept
+{
+   records_.clear();
+}
+
+AES_TEST_INLINE aes::test::log::capture_mode aes::test::log::capture_buffer::mode() const noexcept
+{
+   return mode_;
+}
+
+AES_TEST_INLINE void aes::test::log::capture_buffer::mode(capture_mode new_mode) noexcept
+{
+   mode_ = new_mode;
+}
+
+AES_TEST_INLINE size_t aes::test::log::capture_buffer::limit() const noexcept
+{
+   return limit_;
+}
+
+AES_TEST_INLINE void aes::test::log::capture_buffer::limit(size_t new_limit) noexcept
+{
+   limit_ = new_limit;
+}
+
+AES_TEST_INLINE uint64_t aes::test::log::capture_buffer::size() const noexcept
+{
+   return records_.size();
+}
+#endif
+
+
+///////////////////////////////////////////////////////////////////////////////////
 // logger_base implementation
 
 template <typename _TOut, typename _TError>
@@ -347,6 +1359,7 @@ inline aes::test::log::logger_base<_TOut, _TError>::logger_base(_TOut& out_write
    : out_(out_writer)
    , error_(error_writer)
    , level_(level)
+   , capture_(nullptr)
 {
 }
 
@@ -392,6 +1405,20 @@ inline void aes::test::log::logger_base<_TOut, _TError>::log_debug(const T& mess
    log(message, [this]() { return should_log_debug(); }, out_);
 }
 
+template <typename _TOut, typename _TError>
+template <typename T>
+inline void aes::test::log::logger_base<_TOut, _TError>::log(const category& component, level message_level, const T& message) const noexcept
+{
+   if (message_level == error)
+   {
+      log(message, [&]() { return component.should_log(message_level); }, error_);
+   }
+   else
+   {
+      log(message, [&]() { return component.should_log(message_level); }, out_);
+   }
+}
+
 template <typename _TOut, typename _TError>
 inline bool aes::test::log::logger_base<_TOut, _TError>::should_log_error() const noexcept
 {
@@ -447,6 +1474,33 @@ inline void aes::test::log::logger_base<_TOut, _TError>::log_level(level new_lev
    level_ = new_level;
 }
 
+template <typename _TOut, typename _TError>
+inline void aes::test::log::logger_base<_TOut, _TError>::begin_capture(capture_buffer& buffer) noexcept
+{
+   buffer.clear();
+   capture_ = &buffer;
+}
+
+template <typename _TOut, typename _TError>
+inline void aes::test::log::logger_base<_TOut, _TError>::end_capture(bool emit) noexcept
+{
+   if (capture_)
+   {
+      if (emit)
+      {
+         capture_->flush(out_, error_);
+      }
+      capture_->clear();
+      capture_ = nullptr;
+   }
+}
+
+template <typename _TOut, typename _TError>
+inline bool aes::test::log::logger_base<_TOut, _TError>::is_capturing() const noexcept
+{
+   return capture_ != nullptr;
+}
+
 template <typename _TOut, typename _TError>
 template <typename T, typename _TShouldLog, typename _TStream>
 inline void aes::test::log::logger_base<_TOut, _TError>::log(const T& message,
@@ -455,304 +1509,2488 @@ inline void aes::test::log::logger_base<_TOut, _TError>::log(const T& message,
 {
    if (should_log_func())
    {
-      stream << message << std::endl;
+      if (capture_)
+      {
+         capture_->append(static_cast<const void*>(&stream) == static_cast<const void*>(&error_), message);
+      }
+      else
+      {
+         stream << message << std::endl;
+      }
+   }
+   else if (aes::test::flight::recorder::get().enabled())
+   {
+      aes::test::flight::recorder::get().record(message);
    }
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// assert class implementation
+// log categories implementation
 
-template <typename _TLogger>
-inline aes::test::assert_base<_TLogger>::assert_base(_TLogger& logger) noexcept
-   : logger_(logger)
-   , passed_(0)
-   , failed_(0)
+#if defined(AES_TEST_IMPLEMENTATION)
+AES_TEST_INLINE bool aes::test::log::parse_level(const std::string& name, level& parsed) noexcept
 {
-}
+   static const struct { const char* name_; level level_; } levels[] =
+   {
+      { "error", error }, { "warning", warning }, { "information", information }, { "info", information },
+      { "verbose", verbose }, { "trace", trace }, { "debug", debug }
+   };
 
-template <typename _TLogger>
-template <typename T>
-inline bool aes::test::assert_base<_TLogger>::equal(const std::string& file, int line, const std::string& message, const T& expected, const T& actual) noexcept
-{
-   return generic(file, line, "Equal", message, expected, actual, expected == actual);
+   for (const auto& entry : levels)
+   {
+      if (name == entry.name_)
+      {
+         parsed = entry.level_;
+         return true;
+      }
+   }
+   return false;
 }
 
-template <typename _TLogger>
-template <typename T>
-inline bool aes::test::assert_base<_TLogger>::not_equal(const std::string& file, int line, const std::string& message, const T& expected, const T& actual) noexcept
+AES_TEST_INLINE aes::test::log::category::category(const std::string& name)
+   : name_(name)
+   , level_(information)
 {
-   return generic(file, line, "Not equal", message, expected, actual, expected != actual);
+   categories::get().attach(this);
 }
 
-template <typename _TLogger>
-template <typename T, typename _TPredicate>
-inline bool aes::test::assert_base<_TLogger>::generic(const std::string& file,
-                                                      int line,
-                                                      const std::string& assert_type,
-                                                      const std::string& message,
-                                                      const T& expected,
-                                                      const T& actual,
-                                                      _TPredicate pred) noexcept
+AES_TEST_INLINE aes::test::log::category::~category() noexcept
 {
-   return generic(file, line, assert_type, message, expected, actual, pred(expected, actual));
+   categories::get().detach(this);
 }
 
-template <typename _TLogger>
-template <typename T, typename _TPredicate>
-inline bool aes::test::assert_base<_TLogger>::generic(const std::string& file,
-                                                      int line,
-                                                      const std::string& assert_type,
-                                                      const std::string& message,
-                                                      const T& actual,
-                                                      _TPredicate pred) noexcept
+AES_TEST_INLINE const std::string& aes::test::log::category::name() const noexcept
 {
-   return generic(file, line, assert_type, message, actual, pred(actual));
+   return name_;
 }
 
-template <typename _TLogger>
-template <typename T>
-inline bool aes::test::assert_base<_TLogger>::generic(const std::string& file,
-                                                      int line,
-                                                      const std::string& assert_type,
-                                                      const std::string& message,
-                                                      const T& expected,
-                                                      const T& actual,
-                                                      bool result) noexcept
+AES_TEST_INLINE aes::test::log::level aes::test::log::category::log_level() const noexcept
 {
-   std::stringstream ss;
-   ss << assert_type << ": " << message << ".";
-   if (!result)
-   {
-      ss << " Expected: " << expected << ". Actual: " << actual << ".";
-   }
-
-   log_result(file, line, result, ss.str());
-   return result;
+   return static_cast<level>(level_.load(std::memory_order_relaxed));
 }
 
-template <typename _TLogger>
-template <typename T>
-inline bool aes::test::assert_base<_TLogger>::generic(const std::string& file,
-                                                      int line,
-                                                      const std::string& assert_type,
-                                                      const std::string& message,
-                                                      const T& actual,
-                                                      bool result) noexcept
+AES_TEST_INLINE void aes::test::log::category::log_level(level new_level) noexcept
 {
-   std::stringstream ss;
-   ss << assert_type << ": " << message << ".";
-   if (!result)
-   {
-      ss << " Actual: " << actual << ".";
-   }
-
-   log_result(file, line, result, ss.str());
-   return result;
+   level_.store(new_level, std::memory_order_relaxed);
 }
 
-template <typename _TLogger>
-inline bool aes::test::assert_base<_TLogger>::pass(const std::string& file, int line, const std::string& message) noexcept
+AES_TEST_INLINE aes::test::log::categories& aes::test::log::categories::get() noexcept
 {
-   std::stringstream ss;
-   ss << "Assert passed logged with message: " << message << ".";
-   log_result(file, line, true, ss.str());
-   return true;
+   static categories instance;
+   return instance;
 }
 
-template <typename _TLogger>
-inline bool aes::test::assert_base<_TLogger>::fail(const std::string& file, int line, const std::string& message) noexcept
+AES_TEST_INLINE aes::test::log::categories::categories() noexcept
+   : lock_()
+   , rules_()
+   , components_()
 {
-   std::stringstream ss;
-   ss << "Assert failed logged with message: " << message << ".";
-   log_result(file, line, false, ss.str());
-   return false;
 }
 
-template <typename _TLogger>
-template <typename T>
-inline bool aes::test::assert_base<_TLogger>::vector_equal(const std::string& file, int line, const std::string& message, const std::vector<T>& expected, const std::vector<T>& actual) noexcept
+AES_TEST_INLINE bool aes::test::log::categories::configure(const std::string& rules)
 {
-   bool result = false;
-   std::stringstream ss;
-   ss << message << ": Size of the vectors are equal";
-   if ((result = generic(file, line, "Vector assert", ss.str(), expected.size(), actual.size(), [](size_t expected, size_t actual) { return expected == actual; })))
+   std::vector<rule> parsed;
+   std::stringstream ss(rules);
+   std::string item;
+
+   while (std::getline(ss, item, ','))
    {
-      for (size_t i = 0; i < expected.size(); i++)
+      size_t colon = item.rfind(':');
+      level found = information;
+      if (colon == std::string::npos || colon == 0 || !parse_level(item.substr(colon + 1), found))
       {
-         ss.str("");
-         ss << message << ": Value of vector at index " << i << " should be equal";
-         result &= generic(file, line, "Vector assert", ss.str(), expected[i], actual[i], [](const T& expected, const T& actual) { return expected == actual; });
+         return false;
       }
+      parsed.push_back(rule{ item.substr(0, colon), found });
    }
 
-   return result;
+   std::lock_guard<std::mutex> lock(lock_);
+   rules_.swap(parsed);
+   for (category* component : components_)
+   {
+      size_t length = 0;
+      level found = information;
+      component->log_level(find(component->name(), found, length) ? found : information);
+   }
+   return true;
+}
+
+AES_TEST_INLINE bool aes::test::log::categories::level_of(const std::string& name, level& found) const
+{
+   std::lock_guard<std::mutex> lock(lock_);
+   size_t length = 0;
+   return find(name, found, length);
+}
+
+AES_TEST_INLINE aes::test::log::level aes::test::log::categories::level_of(const std::string& test, const std::string& file, level fallback) const
+{
+   std::lock_guard<std::mutex> lock(lock_);
+   if (rules_.empty())
+   {
+      return fallback;
+   }
+
+   // A rule naming the test beats a rule naming its file, which beats the fallback of the logger.
+   size_t index = aes::test::utils::find_max_pos(file.find_last_of("\\"), file.find_last_of("/"));
+   std::string file_name(index != std::string::npos ? file.substr(index + 1) : file);
+   size_t test_length = 0;
+   size_t file_length = 0;
+   level test_level = fallback;
+   level file_level = fallback;
+   bool by_test = find(test, test_level, test_length);
+   bool by_file = !file_name.empty() && find(file_name, file_level, file_length);
+
+   if (by_test && (!by_file || test_length >= file_length))
+   {
+      return test_level;
+   }
+   return by_file ? file_level : fallback;
+}
+
+AES_TEST_INLINE void aes::test::log::categories::attach(category* component)
+{
+   std::lock_guard<std::mutex> lock(lock_);
+   size_t length = 0;
+   level found = information;
+   if (find(component->name(), found, length))
+   {
+      component->log_level(found);
+   }
+   components_.push_back(component);
+}
+
+AES_TEST_INLINE void aes::test::log::categories::detach(category* component) noexcept
+{
+   std::lock_guard<std::mutex> lock(lock_);
+   components_.erase(std::remove(components_.begin(), components_.end(), component), components_.end());
+}
+
+AES_TEST_INLINE bool aes::test::log::categories::find(const std::string& name, level& found, size_t& length) const noexcept
+{
+   bool matched = false;
+
+   // An exact name counts one more than a prefix of the same length; '*' alone matches with length 0.
+   for (const rule& r : rules_)
+   {
+      bool is_prefix = !r.pattern_.empty() && r.pattern_.back() == '*';
+      size_t size = is_prefix ? r.pattern_.size() - 1 : r.pattern_.size();
+      bool match = is_prefix ? name.compare(0, size, r.pattern_, 0, size) == 0 : name == r.pattern_;
+      size_t score = is_prefix ? size : size + 1;
+      if (match && (!matched || score >= length))
+      {
+         matched = true;
+         found = r.level_;
+         length = score;
+      }
+   }
+   return matched;
 }
+#endif
 
 template <typename _TLogger>
-inline uint64_t aes::test::assert_base<_TLogger>::passed() const noexcept
+inline aes::test::log::level_guard<_TLogger>::level_guard(_TLogger& logger, const std::string& test, const std::string& file)
+   : logger_(logger)
+   , previous_(logger.log_level())
 {
-   return passed_;
+   logger_.log_level(categories::get().level_of(test, file, previous_));
 }
 
 template <typename _TLogger>
-inline uint64_t aes::test::assert_base<_TLogger>::failed() const noexcept
+inline aes::test::log::level_guard<_TLogger>::~level_guard() noexcept
+{
+   logger_.log_level(previous_);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// site struct implementation
+
+template <size_t _Size>
+inline constexpr const char* aes::test::site_literal(const char (&message)[_Size]) noexcept
+{
+   return message;
+}
+
+template <size_t _Size>
+inline constexpr const char* aes::test::site_literal(char (&)[_Size]) noexcept
+{
+   return nullptr;
+}
+
+inline constexpr const char* aes::test::site_literal(const std::string&) noexcept
+{
+   return nullptr;
+}
+
+template <size_t _Size>
+inline constexpr const std::string* aes::test::site_text(const char (&)[_Size]) noexcept
+{
+   return nullptr;
+}
+
+template <size_t _Size>
+inline const std::string* aes::test::site_text(char (&message)[_Size], std::string&& text)
+{
+   text.assign(message, std::find(message, message + _Size, '\0'));
+   return &text;
+}
+
+inline const std::string* aes::test::site_text(const std::string& message) noexcept
+{
+   return &message;
+}
+
+#if defined(AES_TEST_IMPLEMENTATION)
+AES_TEST_INLINE std::string aes::test::site_ref::message() const
+{
+   return text_ ? *text_ : std::string(site_->message_);
+}
+
+AES_TEST_INLINE std::string aes::test::site_ref::file() const
+{
+   return site_->file_;
+}
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// assert class implementation
+
+template <typename _TLogger>
+inline aes::test::assert_base<_TLogger>::assert_base(_TLogger& logger) noexcept
+   : logger_(logger)
+   , passed_(0)
+   , failed_(0)
+   , result_log_(nullptr)
+   , test_id_(0)
+   , sections_()
 {
-   return failed_;
 }
 
+// An assert of another logger, the thread of a stress test, writing into the result log of its parent.
 template <typename _TLogger>
-inline uint64_t aes::test::assert_base<_TLogger>::total() const noexcept
+inline aes::test::assert_base<_TLogger>::assert_base(_TLogger& logger, const assert_base& parent) noexcept
+   : logger_(logger)
+   , passed_(0)
+   , failed_(0)
+   , result_log_(parent.result_log_)
+   , test_id_(parent.test_id_)
+   , sections_()
 {
-   return failed_ + passed_;
 }
 
 template <typename _TLogger>
-inline std::string aes::test::assert_base<_TLogger>::file_name(const std::string file_path) noexcept
+template <typename T>
+inline bool aes::test::assert_base<_TLogger>::equal(const std::string& file, int line, const std::string& message, const T& expected, const T& actual) noexcept
 {
-   std::string name(file_path);
-   size_t index = aes::test::utils::find_max_pos(file_path.find_last_of("\\"), file_path.find_last_of("/"));
+   return generic(file, line, "Equal", message, expected, actual, expected == actual);
+}
+
+template <typename _TLogger>
+template <typename T>
+inline bool aes::test::assert_base<_TLogger>::not_equal(const std::string& file, int line, const std::string& message, const T& expected, const T& actual) noexcept
+{
+   return generic(file, line, "Not equal", message, expected, actual, expected != actual);
+}
+
+template <typename _TLogger>
+template <typename T, typename _TPredicate>
+inline bool aes::test::assert_base<_TLogger>::generic(const std::string& file,
+                                                      int line,
+                                                      const std::string& assert_type,
+                                                      const std::string& message,
+                                                      const T& expected,
+                                                      const T& actual,
+                                                      _TPredicate pred) noexcept
+{
+   return generic(file, line, assert_type, message, expected, actual, pred(expected, actual));
+}
+
+template <typename _TLogger>
+template <typename T, typename _TPredicate>
+inline bool aes::test::assert_base<_TLogger>::generic(const std::string& file,
+                                                      int line,
+                                                      const std::string& assert_type,
+                                                      const std::string& message,
+                                                      const T& actual,
+                                                      _TPredicate pred) noexcept
+{
+   return generic(file, line, assert_type, message, actual, pred(actual));
+}
+
+template <typename _TLogger>
+template <typename T>
+inline bool aes::test::assert_base<_TLogger>::generic(const std::string& file,
+                                                      int line,
+                                                      const std::string& assert_type,
+                                                      const std::string& message,
+                                                      const T& expected,
+                                                      const T& actual,
+                                                      bool result) noexcept
+{
+   if (result && !logger_.should_log_verbose())
+   {
+      log_result(file, line, result, message);
+      return result;
+   }
 
-   if (index != std::string::npos)
+   aes::test::format::buffer ss;
+   ss.append(assert_type);
+   ss.append(": ", 2);
+   ss.append(message);
+   ss.append('.');
+   if (!result && aes::test::diff::applies(expected, actual))
+   {
+      ss.append(" Difference (-expected +actual):");
+      aes::test::diff::append(ss, expected, actual);
+   }
+   else if (!result)
    {
-      name = file_path.substr(index + 1);
+      ss.append(" Expected: ");
+      aes::test::format::append(ss, expected);
+      ss.append(". Actual: ");
+      aes::test::format::append(ss, actual);
+      ss.append('.');
    }
 
-   return name;
+   log_result(file, line, result, ss.str());
+   return result;
 }
 
 template <typename _TLogger>
-void aes::test::assert_base<_TLogger>::log_result(const std::string& file, int line, bool result, const std::string& message) noexcept
+template <typename T>
+inline bool aes::test::assert_base<_TLogger>::generic(const std::string& file,
+                                                      int line,
+                                                      const std::string& assert_type,
+                                                      const std::string& message,
+                                                      const T& actual,
+                                                      bool result) noexcept
 {
-   if (result)
+   if (result && !logger_.should_log_verbose())
    {
-      passed_++;
-      log_success(file, line, message);
+      log_result(file, line, result, message);
+      return result;
    }
-   else
+
+   aes::test::format::buffer ss;
+   ss.append(assert_type);
+   ss.append(": ", 2);
+   ss.append(message);
+   ss.append('.');
+   if (!result)
    {
-      failed_++;
-      log_fail(file, line, message);
+      ss.append(" Actual: ");
+      aes::test::format::append(ss, actual);
+      ss.append('.');
    }
+
+   log_result(file, line, result, ss.str());
+   return result;
 }
 
+// Unlike a predicate lambda, which is a new type at every call site, these members are
+// instantiated once per logger.
 template <typename _TLogger>
-inline void aes::test::assert_base<_TLogger>::log_fail(const std::string& file, int line, const std::string& message) noexcept
+inline bool aes::test::assert_base<_TLogger>::is_true(const std::string& file, int line, const std::string& message, bool actual) noexcept
 {
-   std::stringstream ss;
-   ss << "FAIL " << file_name(file) << " " << line << " " << message;
-   logger_.log_error(ss.str());
+   return generic(file, line, "Is true", message, true, actual, actual);
 }
 
 template <typename _TLogger>
-inline void aes::test::assert_base<_TLogger>::log_success(const std::string& file, int line, const std::string& message) noexcept
+inline bool aes::test::assert_base<_TLogger>::is_false(const std::string& file, int line, const std::string& message, bool actual) noexcept
 {
-   std::stringstream ss;
-   ss << "PASS " << file_name(file) << " " << line << " " << message;
-   logger_.log_verbose(ss.str());
+   return generic(file, line, "Is false", message, false, actual, !actual);
+}
+
+template <typename _TLogger>
+inline bool aes::test::assert_base<_TLogger>::not_null(const std::string& file, int line, const std::string& message, void* actual) noexcept
+{
+   return generic(file, line, "Not null", message, static_cast<void*>(nullptr), actual, actual != nullptr);
+}
+
+template <typename _TLogger>
+inline bool aes::test::assert_base<_TLogger>::pass(const std::string& file, int line, const std::string& message) noexcept
+{
+   aes::test::format::buffer ss;
+   ss.append("Assert passed logged with message: ");
+   ss.append(message);
+   ss.append('.');
+   log_result(file, line, true, ss.str());
+   return true;
+}
+
+template <typename _TLogger>
+inline bool aes::test::assert_base<_TLogger>::fail(const std::string& file, int line, const std::string& message) noexcept
+{
+   aes::test::format::buffer ss;
+   ss.append("Assert failed logged with message: ");
+   ss.append(message);
+   ss.append('.');
+   log_result(file, line, false, ss.str());
+   return false;
+}
+
+template <typename _TLogger>
+template <typename T>
+inline bool aes::test::assert_base<_TLogger>::vector_equal(const std::string& file, int line, const std::string& message, const std::vector<T>& expected, const std::vector<T>& actual) noexcept
+{
+   bool result = false;
+   aes::test::format::buffer ss;
+   ss.append(message);
+   ss.append(": Size of the vectors are equal");
+   if (expected.size() != actual.size() && aes::test::diff::applies(expected, actual))
+   {
+      // The elements after an insertion or a removal would all differ, the difference says more.
+      aes::test::format::buffer text;
+      text.append("Vector assert: ");
+      text.append(ss.str());
+      text.append(". Expected: ");
+      aes::test::format::append(text, expected.size());
+      text.append(". Actual: ");
+      aes::test::format::append(text, actual.size());
+      text.append(". Difference (-expected +actual):");
+      aes::test::diff::append(text, expected, actual);
+      log_result(file, line, false, text.str());
+      return false;
+   }
+   if ((result = generic(file, line, "Vector assert", ss.str(), expected.size(), actual.size(), [](size_t expected, size_t actual) { return expected == actual; })))
+   {
+      for (size_t i = 0; i < expected.size(); i++)
+      {
+         ss.clear();
+         ss.append(message);
+         ss.append(": Value of vector at index ");
+         aes::test::format::append(ss, i);
+         ss.append(" should be equal");
+         result &= generic(file, line, "Vector assert", ss.str(), expected[i], actual[i], [](const T& expected, const T& actual) { return expected == actual; });
+      }
+   }
+
+   return result;
+}
+
+template <typename _TLogger>
+template <typename T>
+inline bool aes::test::assert_base<_TLogger>::matches_snapshot(const std::string& file, int line, const std::string& name, const T& actual) noexcept
+{
+   return matches_snapshot(file, line, name, static_cast<const void*>(actual.data()), actual.size() * sizeof(*actual.data()));
+}
+
+// A range assertion counts as one assertion whatever the size of the range.
+template <typename _TLogger>
+template <typename _TRange, typename _TPredicate>
+inline bool aes::test::assert_base<_TLogger>::all_of(const std::string& file, int line, const std::string& message, const _TRange& range, _TPredicate pred, unsigned threads) noexcept
+{
+   aes::test::utils::range_scan scan = aes::test::utils::scan_range(range, pred, true, aes::test::format::settings().max_offenders_, threads);
+   return log_range(file, line, "All of", message, range, scan, scan.count_ == 0 && scan.thrown_ == scan.size_, " do not match");
+}
+
+template <typename _TLogger>
+template <typename _TRange, typename _TPredicate>
+inline bool aes::test::assert_base<_TLogger>::none_of(const std::string& file, int line, const std::string& message, const _TRange& range, _TPredicate pred, unsigned threads) noexcept
+{
+   aes::test::utils::range_scan scan = aes::test::utils::scan_range(range, pred, false, aes::test::format::settings().max_offenders_, threads);
+   return log_range(file, line, "None of", message, range, scan, scan.count_ == 0 && scan.thrown_ == scan.size_, " match");
+}
+
+template <typename _TLogger>
+template <typename _TRange, typename _TPredicate>
+inline bool aes::test::assert_base<_TLogger>::count_if(const std::string& file, int line, const std::string& message, size_t expected, const _TRange& range, _TPredicate pred, unsigned threads) noexcept
+{
+   aes::test::utils::range_scan scan = aes::test::utils::scan_range(range, pred, false, aes::test::format::settings().max_offenders_, threads);
+   if (scan.thrown_ < scan.size_)
+   {
+      return log_range(file, line, "Count if", message, range, scan, false, " match");
+   }
+   if (scan.count_ == expected)
+   {
+      return log_range(file, line, "Count if", message, range, scan, true, " match");
+   }
+
+   aes::test::format::buffer ss;
+   ss.append(message);
+   ss.append(". Expected: ");
+   aes::test::format::append(ss, expected);
+   ss.append(". Actual: ");
+   aes::test::format::append(ss, scan.count_);
+   return log_range(file, line, "Count if", ss.str(), range, scan, false, " match");
+}
+
+// The lean assertions only build their text when it is logged, see AES_TEST_LEAN.
+template <typename _TLogger>
+template <typename T>
+inline bool aes::test::assert_base<_TLogger>::equal(const site_ref& where, const T& expected, const T& actual) noexcept
+{
+   bool result = expected == actual;
+   return (result && passed_quietly()) || generic(where.file(), where.site_->line_, "Equal", where.message(), expected, actual, result);
+}
+
+template <typename _TLogger>
+template <typename T>
+inline bool aes::test::assert_base<_TLogger>::not_equal(const site_ref& where, const T& expected, const T& actual) noexcept
+{
+   bool result = expected != actual;
+   return (result && passed_quietly()) || generic(where.file(), where.site_->line_, "Not equal", where.message(), expected, actual, result);
+}
+
+template <typename _TLogger>
+inline bool aes::test::assert_base<_TLogger>::is_true(const site_ref& where, bool actual) noexcept
+{
+   return (actual && passed_quietly()) || is_true(where.file(), where.site_->line_, where.message(), actual);
+}
+
+template <typename _TLogger>
+inline bool aes::test::assert_base<_TLogger>::is_false(const site_ref& where, bool actual) noexcept
+{
+   return (!actual && passed_quietly()) || is_false(where.file(), where.site_->line_, where.message(), actual);
+}
+
+template <typename _TLogger>
+inline bool aes::test::assert_base<_TLogger>::not_null(const site_ref& where, void* actual) noexcept
+{
+   return (actual != nullptr && passed_quietly()) || not_null(where.file(), where.site_->line_, where.message(), actual);
+}
+
+template <typename _TLogger>
+inline bool aes::test::assert_base<_TLogger>::pass(const site_ref& where) noexcept
+{
+   return passed_quietly() || pass(where.file(), where.site_->line_, where.message());
+}
+
+template <typename _TLogger>
+inline bool aes::test::assert_base<_TLogger>::fail(const site_ref& where) noexcept
+{
+   return fail(where.file(), where.site_->line_, where.message());
 }
 
+template <typename _TLogger>
+inline bool aes::test::assert_base<_TLogger>::matches_snapshot(const std::string& file, int line, const std::string& name, const void* data, size_t size) noexcept
+{
+   aes::test::format::buffer ss;
+   aes::test::snapshot::result compared = {};
+
+   ss.append("Snapshot: ");
+   ss.append(name);
+   try
+   {
+      compared = aes::test::snapshot::compare(name, data, size);
+   }
+   catch (const std::exception& e)
+   {
+      ss.append(" could not be compared: ");
+      ss.append(e.what());
+      log_result(file, line, false, ss.str());
+      return false;
+   }
+
+   if (!compared.found_)
+   {
+      ss.append(compared.updated_ ? " could not be written to " : " not found at ");
+      ss.append(aes::test::snapshot::path(name));
+      ss.append(", run with --update-snapshots to create it.");
+   }
+   else if (compared.updated_)
+   {
+      ss.append(" updated.");
+   }
+   else if (compared.matched_)
+   {
+      ss.append(" matches.");
+   }
+   else
+   {
+      // The regions are reported as [begin, end) byte offsets.
+      ss.append(" differs. Expected size: ");
+      aes::test::format::append(ss, compared.expected_size_);
+      ss.append(". Actual size: ");
+      aes::test::format::append(ss, static_cast<uint64_t>(size));
+      ss.append(". Differences at");
+      for (size_t i = 0; i < compared.differences_.size(); i++)
+      {
+         ss.append(i ? ", [" : " [");
+         aes::test::format::append(ss, compared.differences_[i].begin_);
+         ss.append(", ");
+         aes::test::format::append(ss, compared.differences_[i].end_);
+         ss.append(')');
+      }
+      if (compared.difference_count_ > compared.differences_.size())
+      {
+         ss.append(" and ");
+         aes::test::format::append(ss, compared.difference_count_ - compared.differences_.size());
+         ss.append(" more regions");
+      }
+      ss.append('.');
+   }
+
+   log_result(file, line, compared.found_ && compared.matched_, ss.str());
+   return compared.found_ && compared.matched_;
+}
+
+template <typename _TLogger>
+inline uint64_t aes::test::assert_base<_TLogger>::passed() const noexcept
+{
+   return passed_;
+}
+
+template <typename _TLogger>
+inline uint64_t aes::test::assert_base<_TLogger>::failed() const noexcept
+{
+   return failed_;
+}
+
+template <typename _TLogger>
+inline uint64_t aes::test::assert_base<_TLogger>::total() const noexcept
+{
+   return failed_ + passed_;
+}
+
+template <typename _TLogger>
+inline void aes::test::assert_base<_TLogger>::result_log(aes::test::result_log::writer* writer, uint32_t test) noexcept
+{
+   result_log_ = writer;
+   test_id_ = test;
+}
+
+template <typename _TLogger>
+inline void aes::test::assert_base<_TLogger>::merge(const assert_base& other) noexcept
+{
+   passed_ += other.passed_;
+   failed_ += other.failed_;
+}
+
+template <typename _TLogger>
+template <typename _TBody>
+inline void aes::test::assert_base<_TLogger>::run_sections(_TBody body)
+{
+   sections_.restart();
+   do
+   {
+      sections_.begin_run();
+      body();
+   } while (sections_.end_run());
+}
+
+template <typename _TLogger>
+inline bool aes::test::assert_base<_TLogger>::enter_section(const std::string& name)
+{
+   return sections_.enter(name, passed_, failed_);
+}
+
+template <typename _TLogger>
+inline void aes::test::assert_base<_TLogger>::leave_section() noexcept
+{
+   sections_.leave(passed_, failed_);
+}
+
+template <typename _TLogger>
+inline aes::test::section_tracker& aes::test::assert_base<_TLogger>::sections() noexcept
+{
+   return sections_;
+}
+
+template <typename _TLogger>
+inline const char* aes::test::assert_base<_TLogger>::file_name(const std::string& file_path) noexcept
+{
+   size_t index = aes::test::utils::find_max_pos(file_path.find_last_of("\\"), file_path.find_last_of("/"));
+
+   return index != std::string::npos ? file_path.c_str() + index + 1 : file_path.c_str();
+}
+
+// "All of: <message>. 12 of 1000 elements do not match: [3] 7, [12] 9 and 10 more." with the first offenders only,
+// preceded by "Predicate threw at element [5]: <what>." when the predicate threw.
+template <typename _TLogger>
+template <typename _TRange>
+inline bool aes::test::assert_base<_TLogger>::log_range(const std::string& file,
+                                                         int line,
+                                                         const std::string& assert_type,
+                                                         const std::string& message,
+                                                         const _TRange& range,
+                                                         const aes::test::utils::range_scan& scan,
+                                                         bool result,
+                                                         const char* found) noexcept
+{
+   if (result && !logger_.should_log_verbose())
+   {
+      log_result(file, line, result, message);
+      return result;
+   }
+
+   aes::test::format::buffer ss;
+   ss.append(assert_type);
+   ss.append(": ", 2);
+   ss.append(message);
+   ss.append('.');
+   if (!result && scan.thrown_ < scan.size_)
+   {
+      ss.append(" Predicate threw at element [");
+      aes::test::format::append(ss, scan.thrown_);
+      ss.append("]: ");
+      ss.append(scan.error_);
+      ss.append('.');
+   }
+   if (!result && scan.count_ > 0)
+   {
+      ss.append(' ');
+      aes::test::format::append(ss, scan.count_);
+      ss.append(" of ");
+      aes::test::format::append(ss, scan.size_);
+      ss.append(scan.count_ == 1 ? " element" : " elements");
+      ss.append(found);
+      ss.append(':');
+      auto element = std::begin(range);
+      size_t position = 0;
+      for (size_t index : scan.offenders_)
+      {
+         std::advance(element, index - position);
+         position = index;
+         ss.append(index == scan.offenders_.front() ? " [" : ", [");
+         aes::test::format::append(ss, index);
+         ss.append("] ");
+         aes::test::format::append(ss, *element);
+      }
+      if (scan.count_ > scan.offenders_.size())
+      {
+         ss.append(" and ");
+         aes::test::format::append(ss, scan.count_ - scan.offenders_.size());
+         ss.append(" more");
+      }
+      ss.append('.');
+   }
+
+   log_result(file, line, result, ss.str());
+   return result;
+}
+
+// Counts a passed assertion when nothing would be logged of it, without its text.
+template <typename _TLogger>
+inline bool aes::test::assert_base<_TLogger>::passed_quietly() noexcept
+{
+   if (result_log_ || logger_.should_log_verbose() || aes::test::flight::recorder::get().enabled())
+   {
+      return false;
+   }
+
+   aes::test::metrics::registry::get().assertion(true);
+   passed_++;
+   return true;
+}
+
+template <typename _TLogger>
+void aes::test::assert_base<_TLogger>::log_result(const std::string& file, int line, bool result, const std::string& message) noexcept
+{
+   aes::test::metrics::registry::get().assertion(result);
+   if (result_log_)
+   {
+      result_log_->log_result(test_id_, file, line, result);
+   }
+
+   if (result)
+   {
+      passed_++;
+      log_success(file, line, message);
+   }
+   else
+   {
+      failed_++;
+      log_fail(file, line, message);
+   }
+}
+
+template <typename _TLogger>
+inline void aes::test::assert_base<_TLogger>::log_fail(const std::string& file, int line, const std::string& message) noexcept
+{
+   aes::test::format::buffer ss;
+   ss.append("FAIL ", 5);
+   ss.append(file_name(file));
+   ss.append(' ');
+   aes::test::format::append_integer(ss, static_cast<long long>(line));
+   ss.append(' ');
+   ss.append(message);
+
+   // The records hidden by the level of the logger since the last failure of the thread come first.
+   if (aes::test::flight::recorder::get().enabled())
+   {
+      std::vector<std::string> records(aes::test::flight::recorder::get().take());
+      if (!records.empty())
+      {
+         logger_.log_error("FLIGHT " + std::to_string(records.size()) + " records before the failure");
+         for (const std::string& record : records)
+         {
+            logger_.log_error("  " + record);
+         }
+      }
+   }
+   logger_.log_error(ss.str());
+   if (aes::test::trace::recorder::get().enabled())
+   {
+      aes::test::trace::recorder::get().instant("failure", ss.str());
+   }
+}
+
+template <typename _TLogger>
+inline void aes::test::assert_base<_TLogger>::log_success(const std::string& file, int line, const std::string& message) noexcept
+{
+   if (!logger_.should_log_verbose() && !aes::test::flight::recorder::get().enabled())
+   {
+      return;
+   }
+
+   aes::test::format::buffer ss;
+   ss.append("PASS ", 5);
+   ss.append(file_name(file));
+   ss.append(' ');
+   aes::test::format::append_integer(ss, static_cast<long long>(line));
+   ss.append(' ');
+   ss.append(message);
+   logger_.log_verbose(ss.str());
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// section_tracker class implementation
+
+#if defined(AES_TEST_IMPLEMENTATION)
+AES_TEST_INLINE aes::test::section_tracker::section_tracker() noexcept
+   : sections_()
+   , filter_()
+   , current_(0)
+   , active_(false)
+   , entered_(false)
+{
+}
+
+AES_TEST_INLINE void aes::test::section_tracker::filter(const std::vector<std::string>& path)
+{
+   filter_ = path;
+}
+
+AES_TEST_INLINE void aes::test::section_tracker::restart() noexcept
+{
+   if (sections_.empty())
+   {
+      sections_.push_back(section{ std::string(), 0, 0, {}, false, false, 0, 0, std::chrono::nanoseconds(0), 0, 0, {} });
+   }
+   for (section& s : sections_)
+   {
+      s.complete_ = false;
+   }
+   active_ = true;
+}
+
+AES_TEST_INLINE void aes::test::section_tracker::begin_run() noexcept
+{
+   for (section& s : sections_)
+   {
+      s.entered_child_ = false;
+   }
+   current_ = 0;
+   entered_ = false;
+}
+
+AES_TEST_INLINE bool aes::test::section_tracker::end_run() noexcept
+{
+   const std::vector<size_t>& children = sections_[0].children_;
+   bool complete = std::all_of(children.begin(), children.end(), [this](size_t child) { return sections_[child].complete_; });
+
+   // A run entering no section cannot make progress, the other sections are conditional.
+   active_ = entered_ && !complete;
+   return active_;
+}
+
+AES_TEST_INLINE bool aes::test::section_tracker::enter(const std::string& name, uint64_t passed, uint64_t failed)
+{
+   if (!active_)
+   {
+      return true;
+   }
+
+   section& parent = sections_[current_];
+   if (parent.depth_ < filter_.size() && filter_[parent.depth_] != name)
+   {
+      return false;
+   }
+
+   auto it = std::find_if(parent.children_.begin(), parent.children_.end(), [&](size_t child) { return sections_[child].name_ == name; });
+   size_t index = it != parent.children_.end() ? *it : sections_.size();
+   if (it == parent.children_.end())
+   {
+      size_t depth = parent.depth_ + 1;
+      sections_[current_].children_.push_back(index);
+      sections_.push_back(section{ name, current_, depth, {}, false, false, 0, 0, std::chrono::nanoseconds(0), 0, 0, {} });
+   }
+
+   if (sections_[index].complete_ || sections_[current_].entered_child_)
+   {
+      return false;
+   }
+
+   sections_[current_].entered_child_ = true;
+   current_ = index;
+   entered_ = true;
+
+   section& entered = sections_[index];
+   entered.start_passed_ = passed;
+   entered.start_failed_ = failed;
+   entered.start_ = std::chrono::steady_clock::now();
+   return true;
+}
+
+AES_TEST_INLINE void aes::test::section_tracker::leave(uint64_t passed, uint64_t failed) noexcept
+{
+   if (!active_ || current_ == 0)
+   {
+      return;
+   }
+
+   section& left = sections_[current_];
+   std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+   left.elapsed_ += std::chrono::duration_cast<std::chrono::nanoseconds>(now - left.start_);
+   if (aes::test::trace::recorder::get().enabled())
+   {
+      aes::test::trace::recorder::get().complete("section", left.name_, left.start_, now);
+   }
+   left.passed_ += passed - left.start_passed_;
+   left.failed_ += failed - left.start_failed_;
+   left.complete_ = std::all_of(left.children_.begin(), left.children_.end(), [this](size_t child) { return sections_[child].complete_; });
+   current_ = left.parent_;
+}
+
+AES_TEST_INLINE const std::vector<aes::test::section_tracker::section>& aes::test::section_tracker::sections() const noexcept
+{
+   return sections_;
+}
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// section_guard class implementation
+
+template <typename _TAssert>
+inline aes::test::section_guard<_TAssert>::section_guard(_TAssert& assert, const std::string& name)
+   : assert_(assert)
+   , entered_(assert.enter_section(name))
+{
+}
+
+template <typename _TAssert>
+inline aes::test::section_guard<_TAssert>::~section_guard() noexcept
+{
+   if (entered_)
+   {
+      assert_.leave_section();
+   }
+}
+
+template <typename _TAssert>
+inline aes::test::section_guard<_TAssert>::operator bool() const noexcept
+{
+   return entered_;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// unit_test_base class implementation
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline aes::test::unit_test_base<_TSuiteSingleton, _TLogger>::unit_test_base(const std::string& name, const std::string description) noexcept
+   : assert_(_TSuiteSingleton::get().test_logger())
+   , name_(name)
+   , description_(description)
+   , source_file_()
+   , memory_heavy_(false)
+{
+   _TSuiteSingleton::get().register_test(this);
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline bool aes::test::unit_test_base<_TSuiteSingleton, _TLogger>::run_test()
+{
+   // The rules of the log categories naming the test or its file apply while it runs.
+   aes::test::log::level_guard<_TLogger> levels(_TSuiteSingleton::get().test_logger(), aes::test::utils::trim(name_), source_file_);
+   run_tests(assert_);
+   return failed() == 0;
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline void aes::test::unit_test_base<_TSuiteSingleton, _TLogger>::start_test(aes::test::async::event_loop& loop)
+{
+   start_tests(assert_, loop);
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline bool aes::test::unit_test_base<_TSuiteSingleton, _TLogger>::is_async() const noexcept
+{
+   return false;
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline void aes::test::unit_test_base<_TSuiteSingleton, _TLogger>::start_tests(assert_base<_TLogger>&, aes::test::async::event_loop&)
+{
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline const std::string& aes::test::unit_test_base<_TSuiteSingleton, _TLogger>::name() const noexcept
+{
+   return name_;
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline const std::string& aes::test::unit_test_base<_TSuiteSingleton, _TLogger>::description() const noexcept
+{
+   return description_;
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline const std::string& aes::test::unit_test_base<_TSuiteSingleton, _TLogger>::source_file() const noexcept
+{
+   return source_file_;
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline void aes::test::unit_test_base<_TSuiteSingleton, _TLogger>::source_file(const std::string& new_file)
+{
+   source_file_ = new_file;
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline bool aes::test::unit_test_base<_TSuiteSingleton, _TLogger>::memory_heavy() const noexcept
+{
+   return memory_heavy_;
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline void aes::test::unit_test_base<_TSuiteSingleton, _TLogger>::memory_heavy(bool is_memory_heavy) noexcept
+{
+   memory_heavy_ = is_memory_heavy;
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline uint64_t aes::test::unit_test_base<_TSuiteSingleton, _TLogger>::passed() const noexcept
+{
+   return assert_.passed();
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline uint64_t aes::test::unit_test_base<_TSuiteSingleton, _TLogger>::failed() const noexcept
+{
+   return assert_.failed();
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline uint64_t aes::test::unit_test_base<_TSuiteSingleton, _TLogger>::total() const noexcept
+{
+   return assert_.total();
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline void aes::test::unit_test_base<_TSuiteSingleton, _TLogger>::result_log(aes::test::result_log::writer* writer, uint32_t test) noexcept
+{
+   assert_.result_log(writer, test);
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline void aes::test::unit_test_base<_TSuiteSingleton, _TLogger>::section_filter(const std::vector<std::string>& path)
+{
+   assert_.sections().filter(path);
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline const std::vector<aes::test::section_tracker::section>& aes::test::unit_test_base<_TSuiteSingleton, _TLogger>::sections() noexcept
+{
+   return assert_.sections().sections();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// async_test_base class implementation
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline aes::test::async_test_base<_TSuiteSingleton, _TLogger>::async_test_base(const std::string& name, const std::string description) noexcept
+   : unit_test_base<_TSuiteSingleton, _TLogger>(name, description)
+   , state_(state::idle)
+   , timeout_(std::chrono::seconds(60))
+   , started_()
+   , failed_before_(0)
+   , metered_(false)
+{
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline bool aes::test::async_test_base<_TSuiteSingleton, _TLogger>::is_async() const noexcept
+{
+   return true;
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline bool aes::test::async_test_base<_TSuiteSingleton, _TLogger>::is_completed() const noexcept
+{
+   return state_ == state::completed;
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline aes::test::async::duration aes::test::async_test_base<_TSuiteSingleton, _TLogger>::timeout() const noexcept
+{
+   return timeout_;
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline void aes::test::async_test_base<_TSuiteSingleton, _TLogger>::timeout(aes::test::async::duration new_timeout) noexcept
+{
+   timeout_ = new_timeout;
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline void aes::test::async_test_base<_TSuiteSingleton, _TLogger>::run_tests(assert_base<_TLogger>& assert)
+{
+   // A test that has not been started on the event loop of the suite runs on its own loop,
+   // the suite meters it as any other test.
+   if (state_ == state::idle)
+   {
+      aes::test::async::event_loop loop;
+      start(assert, loop, false);
+      loop.run();
+   }
+
+   if (state_ != state::completed)
+   {
+      assert.fail(__FILE__, __LINE__, "Asynchronous test did not complete");
+      complete(assert);
+   }
+   state_ = state::idle;
+   end_async();
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline void aes::test::async_test_base<_TSuiteSingleton, _TLogger>::start_tests(assert_base<_TLogger>& assert, aes::test::async::event_loop& loop)
+{
+   start(assert, loop, true);
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline void aes::test::async_test_base<_TSuiteSingleton, _TLogger>::start(assert_base<_TLogger>& assert, aes::test::async::event_loop& loop, bool metered)
+{
+   // Every callback of the test runs in its context: an exception or the timeout fails
+   // the test, and completing it drops the callbacks it left on the loop.
+   std::shared_ptr<aes::test::async::context> owner = std::make_shared<aes::test::async::context>([this, &assert](std::exception_ptr error)
+   {
+      try
+      {
+         std::rethrow_exception(error);
+      }
+      catch (const aes::test::async::timeout_error& e)
+      {
+         assert.fail(__FILE__, __LINE__, std::string("Asynchronous test ") + e.what());
+      }
+      catch (const std::exception& e)
+      {
+         assert.fail(__FILE__, __LINE__, std::string("Unhandled exception: ") + e.what());
+      }
+      catch (...)
+      {
+         assert.fail(__FILE__, __LINE__, "Unhandled exception");
+      }
+      complete(assert);
+   }, timeout_);
+
+   state_ = state::running;
+   started_ = std::chrono::steady_clock::now();
+   failed_before_ = assert.failed();
+   metered_ = metered;
+   if (metered_)
+   {
+      aes::test::metrics::registry::get().begin_async_test();
+   }
+   std::weak_ptr<aes::test::async::context> context(owner);
+   loop.start(owner, [this, &assert, &loop, context]()
+   {
+      // The span of an asynchronous test runs until its completion, interleaved with the others.
+      std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+      run_async(assert, loop, [this, &assert, started, context]()
+      {
+         aes::test::trace::recorder::get().complete("async", this->name(), started, std::chrono::steady_clock::now());
+         complete(assert);
+         if (std::shared_ptr<aes::test::async::context> completed = context.lock())
+         {
+            completed->cancel();
+         }
+      });
+   });
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline void aes::test::async_test_base<_TSuiteSingleton, _TLogger>::complete(const assert_base<_TLogger>& assert) noexcept
+{
+   // A test completes once, either through its completion or through its first failure.
+   if (metered_ && state_ == state::running)
+   {
+      aes::test::metrics::registry::get().end_async_test(this->name(), assert.failed() > failed_before_, std::chrono::steady_clock::now() - started_);
+   }
+   state_ = state::completed;
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline void aes::test::async_test_base<_TSuiteSingleton, _TLogger>::end_async()
+{
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// stress_settings class implementation
+
+#if defined(AES_TEST_IMPLEMENTATION)
+AES_TEST_INLINE aes::test::stress_settings& aes::test::stress_settings::get() noexcept
+{
+   static stress_settings settings;
+   return settings;
+}
+
+AES_TEST_INLINE aes::test::stress_settings::stress_settings() noexcept
+   : threads_(0)
+   , pin_threads_(false)
+{
+}
+
+AES_TEST_INLINE unsigned aes::test::stress_settings::threads() const noexcept
+{
+   return threads_;
+}
+
+AES_TEST_INLINE void aes::test::stress_settings::threads(unsigned new_threads) noexcept
+{
+   threads_ = new_threads;
+}
+
+AES_TEST_INLINE bool aes::test::stress_settings::pin_threads() const noexcept
+{
+   return pin_threads_;
+}
+
+AES_TEST_INLINE void aes::test::stress_settings::pin_threads(bool pin) noexcept
+{
+   pin_threads_ = pin;
+}
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// stress_test_base class implementation
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline aes::test::stress_test_base<_TSuiteSingleton, _TLogger>::stress_test_base(const std::string& name, const std::string description, unsigned threads, uint64_t iterations) noexcept
+   : unit_test_base<_TSuiteSingleton, _TLogger>(name, description)
+   , threads_(threads)
+   , iterations_(iterations)
+{
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline unsigned aes::test::stress_test_base<_TSuiteSingleton, _TLogger>::threads() const noexcept
+{
+   unsigned threads = aes::test::stress_settings::get().threads();
+   return std::max(1u, threads ? threads : threads_);
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline uint64_t aes::test::stress_test_base<_TSuiteSingleton, _TLogger>::iterations() const noexcept
+{
+   return iterations_;
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline void aes::test::stress_test_base<_TSuiteSingleton, _TLogger>::run_tests(assert_base<_TLogger>& assert)
+{
+   const unsigned count = threads();
+   aes::test::utils::spin_barrier barrier(count);
+   std::vector<thread_result> results(count, thread_result{ 0, 0, 0.0 });
+   std::vector<aes::test::log::capture_buffer> buffers(count);
+   std::vector<_TLogger> loggers(count, _TSuiteSingleton::get().test_logger());
+   std::vector<assert_base<_TLogger>> asserts;
+   std::vector<std::thread> threads;
+
+   // Every thread reports through its own assert and captured logger, so the threads
+   // never contend on the logger streams; the records are written after the join.
+   asserts.reserve(count);
+   for (unsigned i = 0; i < count; ++i)
+   {
+      loggers[i].begin_capture(buffers[i]);
+      asserts.emplace_back(loggers[i], assert);
+   }
+
+   for (unsigned i = 0; i < count; ++i)
+   {
+      threads.emplace_back([this, &asserts, &barrier, &results, i]()
+      {
+         if (aes::test::trace::recorder::get().enabled())
+         {
+            aes::test::trace::recorder::get().name_thread(aes::test::utils::trim(this->name()) + " thread " + std::to_string(i));
+         }
+         run_thread(asserts[i], barrier, results[i]);
+      });
+#if defined(__linux__)
+      if (aes::test::stress_settings::get().pin_threads())
+      {
+         cpu_set_t cpus;
+         CPU_ZERO(&cpus);
+         CPU_SET(i % std::max(1u, std::thread::hardware_concurrency()), &cpus);
+         pthread_setaffinity_np(threads.back().native_handle(), sizeof(cpus), &cpus);
+      }
+#endif
+   }
+
+   uint64_t first_failure = iterations_;
+   for (unsigned i = 0; i < count; ++i)
+   {
+      threads[i].join();
+      first_failure = std::min(first_failure, results[i].first_failure_);
+   }
+
+   // As the output of the test, the output of the threads is only kept when the test
+   // is captured and fails.
+   _TLogger& logger = _TSuiteSingleton::get().test_logger();
+   bool emit = !logger.is_capturing() || first_failure < iterations_;
+   for (unsigned i = 0; i < count; ++i)
+   {
+      loggers[i].end_capture(emit);
+      assert.merge(asserts[i]);
+   }
+
+   std::stringstream ss;
+   ss << "STRESS " << count << " threads x " << iterations_ << " iterations";
+   if (first_failure < iterations_)
+   {
+      ss << ", first failure at iteration " << first_failure;
+   }
+   logger.log_information(ss.str());
+
+   for (unsigned i = 0; i < count; ++i)
+   {
+      ss.str("");
+      ss << "  thread " << i << ": " << std::fixed << std::setprecision(0) << (results[i].seconds_ > 0 ? results[i].iterations_ / results[i].seconds_ : 0.0) << " iterations/s";
+      if (results[i].first_failure_ < iterations_)
+      {
+         ss << ", first failure at iteration " << results[i].first_failure_;
+      }
+      logger.log_information(ss.str());
+   }
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline void aes::test::stress_test_base<_TSuiteSingleton, _TLogger>::run_thread(assert_base<_TLogger>& assert, aes::test::utils::spin_barrier& barrier, thread_result& result)
+{
+   result.first_failure_ = iterations_;
+   barrier.wait();
+
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+   for (uint64_t iteration = 0; iteration < iterations_; ++iteration)
+   {
+      uint64_t failed = assert.failed();
+
+      // Every iteration starts from the barrier to maximise the overlap between threads.
+      barrier.wait();
+      try
+      {
+         run_stress(assert, iteration);
+      }
+      catch (const std::exception& e)
+      {
+         assert.fail(__FILE__, __LINE__, std::string("Unhandled exception: ") + e.what());
+      }
+      catch (...)
+      {
+         assert.fail(__FILE__, __LINE__, "Unhandled exception");
+      }
+
+      if (assert.failed() != failed && result.first_failure_ == iterations_)
+      {
+         result.first_failure_ = iteration;
+      }
+      result.iterations_++;
+   }
+   std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+   result.seconds_ = std::chrono::duration<double>(end - start).count();
+   aes::test::trace::recorder::get().complete("stress", this->name(), start, end);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// complexity_test_base class implementation
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline aes::test::complexity_test_base<_TSuiteSingleton, _TLogger>::complexity_test_base(const std::string& name,
+                                                                                        const std::string description,
+                                                                                        aes::test::benchmark::complexity declared,
+                                                                                        uint64_t first_size,
+                                                                                        uint64_t last_size) noexcept
+   : unit_test_base<_TSuiteSingleton, _TLogger>(name, description)
+   , declared_(declared)
+   , first_size_(first_size)
+   , last_size_(last_size)
+   , samples_()
+{
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline aes::test::benchmark::complexity aes::test::complexity_test_base<_TSuiteSingleton, _TLogger>::declared() const noexcept
+{
+   return declared_;
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline const std::vector<aes::test::benchmark::sample>& aes::test::complexity_test_base<_TSuiteSingleton, _TLogger>::samples() const noexcept
+{
+   return samples_;
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline void aes::test::complexity_test_base<_TSuiteSingleton, _TLogger>::run_tests(assert_base<_TLogger>& assert)
+{
+   const aes::test::benchmark::environment& host = aes::test::benchmark::host();
+   aes::test::benchmark::pinned_thread pinned(aes::test::benchmark::settings().cpu_);
+   _TLogger& logger = _TSuiteSingleton::get().test_logger();
+   std::vector<aes::test::benchmark::statistics> sizes;
+
+   if (aes::test::benchmark::settings().cpu_ >= 0 && !pinned.pinned())
+   {
+      logger.log_warning("BENCHMARK not pinned to cpu " + std::to_string(aes::test::benchmark::settings().cpu_));
+   }
+   if (host.governor_ != "performance" && host.governor_ != "unknown")
+   {
+      logger.log_warning("BENCHMARK frequency governor " + host.governor_ + ", the timings follow the load");
+   }
+   if (host.turbo_ == "on")
+   {
+      logger.log_warning("BENCHMARK turbo on, the timings follow the temperature");
+   }
+
+   samples_.clear();
+   for (uint64_t size : aes::test::benchmark::sizes(first_size_, last_size_, aes::test::benchmark::settings().multiplier_))
+   {
+      uint64_t failed = assert.failed();
+      sizes.push_back(run_size(assert, size));
+      samples_.push_back(aes::test::benchmark::sample{ size, sizes.back().fastest_ns_ });
+      if (assert.failed() != failed)
+      {
+         // A body failing its own checks has nothing worth fitting.
+         return;
+      }
+   }
+
+   aes::test::benchmark::fit measured = aes::test::benchmark::best_fit(samples_);
+   std::stringstream ss;
+   ss << "COMPLEXITY " << aes::test::benchmark::name(measured.complexity_) << " rms " << std::fixed << std::setprecision(1) << measured.rms_ * 100 << "%"
+      << ", declared " << aes::test::benchmark::name(declared_) << " rms " << aes::test::benchmark::fit_to(samples_, declared_).rms_ * 100 << "%";
+   logger.log_information(ss.str());
+   logger.log_information("  " + aes::test::benchmark::describe(host) + (pinned.pinned() ? ", pinned to cpu " + std::to_string(aes::test::benchmark::settings().cpu_) : ""));
+   for (size_t i = 0; i < samples_.size(); i++)
+   {
+      ss.str("");
+      ss << "  n " << samples_[i].size_ << ": " << std::setprecision(0) << samples_[i].ns_ << "ns";
+      if (sizes[i].rejected_)
+      {
+         ss << ", " << sizes[i].rejected_ << " of " << sizes[i].kept_ + sizes[i].rejected_ << " runs rejected";
+      }
+      logger.log_information(ss.str());
+   }
+
+   assert.generic(__FILE__, __LINE__, "Complexity", "Measured complexity is not worse than declared",
+                  std::string(aes::test::benchmark::name(declared_)), std::string(aes::test::benchmark::name(measured.complexity_)),
+                  measured.complexity_ <= declared_);
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline double aes::test::complexity_test_base<_TSuiteSingleton, _TLogger>::run_once(assert_base<_TLogger>& assert, uint64_t size)
+{
+   aes::test::benchmark::state state(size);
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+   run_complexity(assert, state);
+   std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+   return state.measured() ? state.elapsed_ns() : std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline aes::test::benchmark::statistics aes::test::complexity_test_base<_TSuiteSingleton, _TLogger>::run_size(assert_base<_TLogger>& assert, uint64_t size)
+{
+   const aes::test::benchmark::options& options = aes::test::benchmark::settings();
+   std::vector<double> runs;
+   std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+   // Warmup, until the last runs agree or the time is up.
+   while (!aes::test::benchmark::is_steady(runs) && std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count() < options.max_warmup_time_)
+   {
+      runs.push_back(run_once(assert, size));
+   }
+
+   runs.clear();
+   std::chrono::steady_clock::time_point measured = std::chrono::steady_clock::now();
+   while (runs.size() < options.max_runs_ &&
+          (runs.size() < options.min_runs_ || std::chrono::duration<double>(std::chrono::steady_clock::now() - measured).count() < options.min_time_))
+   {
+      runs.push_back(run_once(assert, size));
+   }
+
+   aes::test::trace::recorder::get().complete("complexity", this->name() + " n " + std::to_string(size), begin, std::chrono::steady_clock::now());
+   return aes::test::benchmark::robust(runs);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// test_suite_base class implementation
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::test_suite_base(_TLogger& logger) noexcept
+   : logger_(logger)
+   , passed_(0)
+   , failed_(0)
+   , map_()
+   , capture_(aes::test::log::capture_mode::none)
+   , result_log_(nullptr)
+   , loop_()
+   , shard_index_(0)
+   , shard_count_(1)
+   , is_selection_(false)
+   , selection_()
+   , section_filters_()
+   , coverage_dump_()
+#if defined(AES_TEST_DISTRIBUTED)
+   , memory_heavy_per_node_(0)
+#endif
+#if defined(AES_TEST_RESOURCES)
+   , isolate_(false)
+   , report_resources_(false)
+   , limits_{ 0, 0 }
+#endif
+{
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline bool aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::register_test(unit_test_base<_TSuiteSingleton, _TLogger>* test) noexcept
+{
+   bool result = false;
+
+   if (test)
+   {
+      map_.insert(std::pair<const std::string, unit_test_base<_TSuiteSingleton, _TLogger>*>(test->name(), test));
+      result = true;
+   }
+
+   return result;
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline bool aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::run(const std::string& title)
+{
+   typename std::multimap<const std::string, unit_test_base<_TSuiteSingleton, _TLogger>*>::iterator it;
+
+   logger_.log_information(title);
+   logger_.log_information("--------------------------------------------------------------");
+
+   // Asynchronous tests are all started on the event loop first, so they are in flight
+   // together; their results are then reported in order with the other tests. Coverage
+   // is dumped per test and isolated tests run in a process of their own, so in these
+   // modes they run one at a time on their own loop.
+   std::map<const unit_test_base<_TSuiteSingleton, _TLogger>*, uint32_t> async_tests;
+   bool coverage = !coverage_dump_.empty() && aes::test::coverage::available();
+   bool one_at_a_time = coverage;
+#if defined(AES_TEST_RESOURCES)
+   one_at_a_time |= isolate_;
+#endif
+   size_t ordinal = 0;
+   uint64_t planned = 0;
+   for (it = map_.begin(); it != map_.end(); ++it)
+   {
+      planned += is_selected(it->second) && in_shard(ordinal) ? 1 : 0;
+      if (is_selected(it->second) && in_shard(ordinal++) && it->second->is_async() && !one_at_a_time)
+      {
+         uint32_t test_id = result_log_ ? result_log_->begin_test(aes::test::utils::trim(it->second->name())) : 0;
+         it->second->result_log(result_log_, test_id);
+         async_tests[it->second] = test_id;
+         it->second->start_test(loop_);
+      }
+   }
+   aes::test::metrics::registry::get().plan(planned);
+   loop_.run();
+
+   ordinal = 0;
+   for (it = map_.begin(); it != map_.end(); ++it)
+   {
+      if (!is_selected(it->second) || !in_shard(ordinal++))
+      {
+         continue;
+      }
+
+      bool capture = capture_.mode() != aes::test::log::capture_mode::none;
+      if (capture)
+      {
+         logger_.begin_capture(capture_);
+      }
+
+      uint32_t test_id = 0;
+      if (result_log_)
+      {
+         auto async_test = async_tests.find(it->second);
+         test_id = async_test != async_tests.end() ? async_test->second : result_log_->begin_test(aes::test::utils::trim(it->second->name()));
+         it->second->result_log(result_log_, test_id);
+      }
+
+      if (coverage)
+      {
+         aes::test::coverage::reset();
+      }
+
+      auto section_filter = section_filters_.find(aes::test::utils::trim(it->second->name()));
+      it->second->section_filter(section_filter != section_filters_.end() ? section_filter->second : std::vector<std::string>());
+
+      uint64_t passed = 0;
+      uint64_t failed = 0;
+      std::string resources;
+      bool result = false;
+      time_t start = time(0);
+      {
+         // Tests run on the event loop of the suite have been metered from their start to their completion.
+         aes::test::trace::span traced("test", it->second->name());
+         bool metered = async_tests.find(it->second) != async_tests.end();
+         if (!metered)
+         {
+            aes::test::metrics::registry::get().begin_test(0);
+         }
+         result = run_one(it->second, passed, failed, resources);
+         if (!metered)
+         {
+            aes::test::metrics::registry::get().end_test(0, it->second->name(), failed > 0);
+         }
+      }
+      time_t end = time(0);
+
+      if (coverage)
+      {
+         aes::test::coverage::dump(coverage_dump_ + "/" + aes::test::utils::trim(it->second->name()));
+      }
+
+      if (result_log_)
+      {
+         result_log_->end_test(test_id);
+         it->second->result_log(nullptr, 0);
+      }
+
+      if (capture)
+      {
+         logger_.end_capture(!result);
+      }
+
+      passed_ += passed;
+      failed_ += failed;
+      log_test(it->second->name(), passed, failed, end - start, resources);
+      log_sections(it->second);
+   }
+
+   log_total(title);
+   return failed() == 0;
+}
+
+#if defined(AES_TEST_DISTRIBUTED)
+template <typename _TSuiteSingleton, typename _TLogger>
+inline bool aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::run_coordinator(const std::string& title,
+                                                                                      aes::test::distributed::listener& listener,
+                                                                                      aes::test::distributed::process_group& workers)
+{
+   struct worker
+   {
+      std::unique_ptr<aes::test::distributed::channel> channel_;
+      unit_test_base<_TSuiteSingleton, _TLogger>* test_;    // test being run, null when idle
+      bool waiting_;                                        // asked for a test while none was pending
+      std::string result_;                                  // RESULT line whose output has not been received yet
+      size_t number_;                                       // in the order the workers connected
+      uint32_t lane_;                                       // of the worker in the trace
+      std::chrono::steady_clock::time_point started_;       // of the test being run
+      int node_;                                            // NUMA node of a placed worker, -1 when unknown
+   };
+
+   std::deque<unit_test_base<_TSuiteSingleton, _TLogger>*> pending;
+   std::map<const unit_test_base<_TSuiteSingleton, _TLogger>*, size_t> indexes;   // of the tests in the suite, the same in every worker
+   std::vector<std::string> logs;                           // result logs of the workers, appended to the result log after the run
+   std::map<unit_test_base<_TSuiteSingleton, _TLogger>*, unsigned> attempts;
+   std::map<int, unsigned> memory_heavy;                    // running on each node
+   std::vector<worker> connected;
+   size_t running = 0;
+   size_t numbered = 0;
+
+   logger_.log_information(title);
+   logger_.log_information("--------------------------------------------------------------");
+
+   size_t ordinal = 0;
+   size_t index = 0;
+   for (auto it = map_.begin(); it != map_.end(); ++it)
+   {
+      indexes[it->second] = index++;
+      if (is_selected(it->second) && in_shard(ordinal++))
+      {
+         pending.push_back(it->second);
+      }
+   }
+   aes::test::metrics::registry::get().plan(pending.size());
+
+   auto fail_test = [this](unit_test_base<_TSuiteSingleton, _TLogger>* test, const std::string& reason)
+   {
+      logger_.log_error("Error: " + reason + " " + aes::test::utils::trim(test->name()));
+      failed_++;
+      aes::test::metrics::registry::get().assertions(0, 1);
+      log_test(test->name(), 0, 1, 0);
+      if (result_log_)
+      {
+         uint32_t test_id = result_log_->begin_test(aes::test::utils::trim(test->name()));
+         result_log_->log_result(test_id, __FILE__, __LINE__, false);
+         result_log_->end_test(test_id);
+      }
+   };
+
+   // A memory-heavy test waits for a worker on a node running less of them than the limit,
+   // the workers whose node is unknown take any test.
+   auto fits = [this, &memory_heavy](const worker& w, const unit_test_base<_TSuiteSingleton, _TLogger>* test)
+   {
+      return !test->memory_heavy() || memory_heavy_per_node_ == 0 || w.node_ < 0 || memory_heavy[w.node_] < memory_heavy_per_node_;
+   };
+
+   auto placed = [&memory_heavy](const worker& w, bool started)
+   {
+      if (w.test_->memory_heavy() && w.node_ >= 0)
+      {
+         if (started)
+         {
+            memory_heavy[w.node_]++;
+         }
+         else
+         {
+            memory_heavy[w.node_]--;
+         }
+      }
+   };
+
+   // Tests are named by their index, so the tests sharing a name are told apart.
+   auto dispatch = [&pending, &running, &placed, &indexes](worker& w, typename std::deque<unit_test_base<_TSuiteSingleton, _TLogger>*>::iterator test)
+   {
+      w.test_ = *test;
+      w.waiting_ = false;
+      w.started_ = std::chrono::steady_clock::now();
+      pending.erase(test);
+      running++;
+      placed(w, true);
+      aes::test::metrics::registry::get().begin_test(w.number_);
+      if (!w.channel_->send("RUN " + std::to_string(indexes[w.test_]) + " " + aes::test::utils::trim(w.test_->name()) + "\n"))
+      {
+         w.channel_->close();
+      }
+   };
+
+   // The test of a lost worker is given to another worker once; a test that loses two
+   // workers most likely crashes them and is reported as failed.
+   auto lose = [&](worker& w)
+   {
+      w.channel_->close();
+      if (w.test_)
+      {
+         running--;
+         placed(w, false);
+         aes::test::metrics::registry::get().cancel_test(w.number_);
+         aes::test::trace::recorder::get().complete("lost", w.test_->name(), w.started_, std::chrono::steady_clock::now(), w.lane_);
+         if (attempts[w.test_]++ == 0)
+         {
+            pending.push_front(w.test_);
+         }
+         else
+         {
+            fail_test(w.test_, "worker lost while running");
+         }
+         w.test_ = nullptr;
+      }
+   };
+
+   auto process = [&](worker& w)
+   {
+      std::string line;
+      while (w.channel_->is_open())
+      {
+         if (w.result_.empty())
+         {
+            if (!w.channel_->read_line(line))
+            {
+               break;
+            }
+            if (line == "NEXT" && !w.test_)
+            {
+               w.waiting_ = true;
+            }
+            else if (line.compare(0, 5, "NODE ") == 0 && !w.test_)
+            {
+               w.node_ = std::atoi(line.c_str() + 5);
+            }
+            else if (line.compare(0, 4, "LOG ") == 0 && !w.test_)
+            {
+               logs.push_back(line.substr(4));
+            }
+            else if (line.compare(0, 7, "RESULT ") == 0 && w.test_)
+            {
+               w.result_ = line;
+            }
+            else
+            {
+               lose(w);
+            }
+            continue;
+         }
+
+         uint64_t passed = 0;
+         uint64_t failed = 0;
+         time_t seconds = 0;
+         size_t out_size = 0;
+         size_t error_size = 0;
+         std::string output;
+         std::stringstream header(w.result_.substr(7));
+         header >> passed >> failed >> seconds >> out_size >> error_size;
+         if (!w.channel_->read_bytes(out_size + error_size, output))
+         {
+            break;
+         }
+
+         log_output(output, out_size);
+         passed_ += passed;
+         failed_ += failed;
+         log_test(w.test_->name(), passed, failed, seconds);
+         aes::test::metrics::registry::get().assertions(passed, failed);
+         aes::test::metrics::registry::get().end_test(w.number_, w.test_->name(), failed > 0);
+         aes::test::trace::recorder::get().complete("test", w.test_->name(), w.started_, std::chrono::steady_clock::now(), w.lane_);
+         if (failed > 0)
+         {
+            aes::test::trace::recorder::get().instant("failure", w.test_->name(), w.lane_);
+         }
+         placed(w, false);
+         w.test_ = nullptr;
+         w.result_.clear();
+         running--;
+      }
+   };
+
+   while (!pending.empty() || running > 0)
+   {
+      for (worker& w : connected)
+      {
+         if (w.waiting_ && w.channel_->is_open())
+         {
+            auto test = std::find_if(pending.begin(), pending.end(), [&](const unit_test_base<_TSuiteSingleton, _TLogger>* candidate) { return fits(w, candidate); });
+            if (test != pending.end())
+            {
+               dispatch(w, test);
+            }
+         }
+      }
+      for (worker& w : connected)
+      {
+         if (!w.channel_->is_open())
+         {
+            lose(w);
+         }
+      }
+      connected.erase(std::remove_if(connected.begin(), connected.end(), [](const worker& w) { return !w.channel_->is_open(); }), connected.end());
+
+      if (connected.empty() && workers.spawned() > 0 && workers.running() == 0)
+      {
+         // Every local worker exited, so nobody is left to run the remaining tests.
+         for (unit_test_base<_TSuiteSingleton, _TLogger>* test : pending)
+         {
+            fail_test(test, "no worker left to run");
+         }
+         pending.clear();
+         continue;
+      }
+
+      std::vector<pollfd> fds(1, pollfd{ listener.fd(), POLLIN, 0 });
+      for (const worker& w : connected)
+      {
+         fds.push_back(pollfd{ w.channel_->fd(), POLLIN, 0 });
+      }
+      if (::poll(fds.data(), nfds_t(fds.size()), 100) <= 0)
+      {
+         continue;
+      }
+
+      for (size_t i = 1; i < fds.size(); ++i)
+      {
+         if (fds[i].revents != 0)
+         {
+            if (connected[i - 1].channel_->receive())
+            {
+               process(connected[i - 1]);
+            }
+            else
+            {
+               lose(connected[i - 1]);
+            }
+         }
+      }
+
+      if (fds[0].revents & POLLIN)
+      {
+         int fd = listener.accept();
+         if (fd >= 0)
+         {
+            size_t number = numbered++;
+            uint32_t lane = aes::test::trace::recorder::get().enabled() ? aes::test::trace::recorder::get().lane("worker " + std::to_string(number)) : 0;
+            connected.push_back(worker{ std::unique_ptr<aes::test::distributed::channel>(new aes::test::distributed::channel(fd)), nullptr, false, std::string(), number, lane, {}, -1 });
+         }
+      }
+   }
+
+   for (worker& w : connected)
+   {
+      w.channel_->send("QUIT\n");
+      w.channel_->close();
+   }
+   workers.wait();
+
+   // The records of the workers are synced after each of their tests, so every result received is in their logs.
+   for (const std::string& log : logs)
+   {
+      if (result_log_ && !result_log_->append(log))
+      {
+         logger_.log_error("Error: unable to append the result log of a worker " + log);
+      }
+      std::remove(log.c_str());
+   }
+
+   log_total(title);
+   return failed() == 0;
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline bool aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::run_worker(aes::test::distributed::channel& coordinator, int node)
+{
+   if (node >= 0 && !coordinator.send("NODE " + std::to_string(node) + "\n"))
+   {
+      return false;
+   }
+   if (result_log_ && result_log_->is_open() && !coordinator.send("LOG " + result_log_->path() + "\n"))
+   {
+      return false;
+   }
+
+   while (coordinator.send("NEXT\n"))
+   {
+      std::string line;
+      while (!coordinator.read_line(line))
+      {
+         if (!coordinator.receive())
+         {
+            return false;
+         }
+      }
+      if (line.compare(0, 4, "RUN ") != 0)
+      {
+         return line == "QUIT";
+      }
+
+      // The output of a test is always captured, it is sent to the coordinator with the result.
+      aes::test::module::result outcome = { 0, 1, 0, std::string(), std::string() };
+      size_t name = line.find(' ', 4);
+      size_t index = size_t(std::strtoull(line.c_str() + 4, nullptr, 10));
+      auto test = map_.begin();
+      std::advance(test, std::min(index, map_.size()));
+      if (name == std::string::npos || test == map_.end() || aes::test::utils::trim(test->second->name()) != line.substr(name + 1))
+      {
+         outcome.error_ = "Error: unknown test " + line.substr(4) + "\n";
+      }
+      else
+      {
+         run_captured(test->second, outcome);
+      }
+      if (result_log_)
+      {
+         result_log_->sync();
+      }
+
+      std::stringstream result;
+      result << "RESULT " << outcome.passed_ << " " << outcome.failed_ << " " << outcome.seconds_ << " " << outcome.out_.size() << " " << outcome.error_.size() << "\n" << outcome.out_ << outcome.error_;
+      if (!coordinator.send(result.str()))
+      {
+         return false;
+      }
+   }
+
+   return false;
+}
+#endif
+
+#if defined(AES_TEST_MODULES)
+template <typename _TSuiteSingleton, typename _TLogger>
+inline std::vector<aes::test::module::test_info> aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::list() const
+{
+   std::vector<aes::test::module::test_info> tests;
+   for (auto it = map_.begin(); it != map_.end(); ++it)
+   {
+      tests.push_back(aes::test::module::test_info{ aes::test::utils::trim(it->second->name()), it->second->source_file() });
+   }
+   return tests;
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline bool aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::run_captured(const std::string& name, aes::test::module::result& outcome)
+{
+   outcome = aes::test::module::result{ 0, 1, 0, std::string(), std::string() };
+   auto test = std::find_if(map_.begin(), map_.end(), [&name](const std::pair<const std::string, unit_test_base<_TSuiteSingleton, _TLogger>*>& candidate)
+   {
+      return aes::test::utils::trim(candidate.second->name()) == name;
+   });
+   if (test == map_.end())
+   {
+      outcome.error_ = "Error: unknown test " + name + "\n";
+      return false;
+   }
+
+   return run_captured(test->second, outcome);
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline bool aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::run_captured(unit_test_base<_TSuiteSingleton, _TLogger>* test, aes::test::module::result& outcome)
+{
+   // The output of a passing test is dropped when the suite captures it, else it is kept.
+   bool capture = capture_.mode() != aes::test::log::capture_mode::none;
+   bool coverage = !coverage_dump_.empty() && aes::test::coverage::available();
+   aes::test::log::capture_buffer buffer(capture ? capture_.mode() : aes::test::log::capture_mode::spill, capture_.limit());
+   std::stringstream out;
+   std::stringstream error;
+   uint64_t passed = test->passed();
+   uint64_t failed = test->failed();
+   uint32_t test_id = result_log_ ? result_log_->begin_test(aes::test::utils::trim(test->name())) : 0;
+   test->result_log(result_log_, test_id);
+   if (coverage)
+   {
+      aes::test::coverage::reset();
+   }
+   logger_.begin_capture(buffer);
+   time_t start = time(0);
+   test->run_test();
+   outcome.seconds_ = time(0) - start;
+   if (coverage)
+   {
+      aes::test::coverage::dump(coverage_dump_ + "/" + aes::test::utils::trim(test->name()));
+   }
+   if (result_log_)
+   {
+      result_log_->end_test(test_id);
+      test->result_log(nullptr, 0);
+   }
+
+   // The asserts of a test add up over its runs, a test is run again by a watching runner.
+   outcome.passed_ = test->passed() - passed;
+   outcome.failed_ = test->failed() - failed;
+   bool result = outcome.failed_ == 0;
+   if (!capture || !result)
+   {
+      buffer.flush(out, error);
+   }
+   logger_.end_capture(false);
+   outcome.out_ = out.str();
+   outcome.error_ = error.str();
+   passed_ += outcome.passed_;
+   failed_ += outcome.failed_;
+   return result;
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline bool aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::run_module(const std::string& title,
+                                                                                aes::test::module::suite& module,
+                                                                                const std::vector<std::string>& tests,
+                                                                                std::set<std::string>& failing)
+{
+   // The totals are those of this run, a watching runner reruns the module over and over.
+   passed_ = 0;
+   failed_ = 0;
+   failing.clear();
+   logger_.log_information(title);
+   logger_.log_information("--------------------------------------------------------------");
+
+   for (const std::string& test : tests)
+   {
+      aes::test::module::result outcome;
+      module.run(test, outcome);
+      log_output(outcome.out_ + outcome.error_, outcome.out_.size());
+      passed_ += outcome.passed_;
+      failed_ += outcome.failed_;
+      log_test("  " + test + " ", outcome.passed_, outcome.failed_, outcome.seconds_);
+      if (outcome.failed_ > 0)
+      {
+         failing.insert(test);
+      }
+   }
+
+   log_total(title);
+   return failed() == 0;
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline bool aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::run_modules(const std::string& title,
+                                                                                 const std::vector<aes::test::module::suite*>& modules,
+                                                                                 unsigned threads)
+{
+   struct module_run
+   {
+      aes::test::module::suite* suite_;
+      std::vector<aes::test::module::test_info> tests_;
+      std::vector<aes::test::module::result> results_;
+      size_t started_;                                      // tests handed to a thread
+      size_t completed_;
+      bool busy_;                                           // a test of the module is running
+      std::chrono::steady_clock::time_point start_;
+   };
+
+   std::vector<module_run> runs;
+   for (aes::test::module::suite* module : modules)
+   {
+      std::vector<aes::test::module::test_info> tests(module->tests());
+      runs.push_back(module_run{ module, tests, std::vector<aes::test::module::result>(tests.size()), 0, 0, false, std::chrono::steady_clock::now() });
+   }
+
+   passed_ = 0;
+   failed_ = 0;
+   logger_.log_information(title);
+   logger_.log_information("--------------------------------------------------------------");
+
+   // A module is reported as a whole once its last test is over, its tests in their order.
+   auto report = [this](const module_run& run)
+   {
+      const int width = 5;
+      uint64_t passed = 0;
+      uint64_t failed = 0;
+      for (size_t i = 0; i < run.tests_.size(); ++i)
+      {
+         const aes::test::module::result& outcome = run.results_[i];
+         log_output(outcome.out_ + outcome.error_, outcome.out_.size());
+         log_test("  " + run.tests_[i].name_ + " ", outcome.passed_, outcome.failed_, outcome.seconds_);
+         passed += outcome.passed_;
+         failed += outcome.failed_;
+      }
+      passed_ += passed;
+      failed_ += failed;
+
+      std::stringstream ss;
+      ss << std::setiosflags(std::ios::left);
+      ss << "MODULE " << std::setw(width) << passed + failed << " Passed " << std::setw(width) << passed << " Failed " << std::setw(width) << failed << " " << run.suite_->title();
+      ss << " (" << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - run.start_).count() << "ms)";
+      ss << std::resetiosflags(std::ios::left);
+      logger_.log_information(ss.str());
+   };
+
+   for (const module_run& run : runs)
+   {
+      if (run.tests_.empty())
+      {
+         report(run);
+      }
+   }
+
+   // The tests of a module share the logger and the totals of its suite, so a module runs one
+   // test at a time; the threads go to the idle module with the most tests left.
+   std::mutex lock;
+   std::condition_variable idle;
+   auto work = [&]()
+   {
+      std::unique_lock<std::mutex> guard(lock);
+      for (;;)
+      {
+         module_run* next = nullptr;
+         bool left = false;
+         for (module_run& run : runs)
+         {
+            left |= run.started_ < run.tests_.size();
+            if (!run.busy_ && run.started_ < run.tests_.size() && (!next || run.tests_.size() - run.started_ > next->tests_.size() - next->started_))
+            {
+               next = &run;
+            }
+         }
+         if (!left)
+         {
+            return;
+         }
+         if (!next)
+         {
+            idle.wait(guard);
+            continue;
+         }
+
+         size_t index = next->started_++;
+         next->busy_ = true;
+         if (index == 0)
+         {
+            next->start_ = std::chrono::steady_clock::now();
+         }
+         guard.unlock();
+         aes::test::module::result outcome;
+         next->suite_->run(next->tests_[index].name_, outcome);
+         guard.lock();
+
+         next->results_[index] = std::move(outcome);
+         next->busy_ = false;
+         if (++next->completed_ == next->tests_.size())
+         {
+            report(*next);
+         }
+         idle.notify_all();
+      }
+   };
+
+   unsigned count = std::max(1u, std::min(threads ? threads : std::thread::hardware_concurrency(), unsigned(runs.size())));
+   std::vector<std::thread> pool;
+   for (unsigned i = 1; i < count; ++i)
+   {
+      pool.emplace_back(work);
+   }
+   work();
+   for (std::thread& thread : pool)
+   {
+      thread.join();
+   }
+
+   log_total(title);
+   return failed() == 0;
+}
+#endif
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline bool aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::run_one(unit_test_base<_TSuiteSingleton, _TLogger>* test,
+                                                                             uint64_t& passed,
+                                                                             uint64_t& failed,
+                                                                             std::string& resources)
+{
+#if defined(AES_TEST_RESOURCES)
+   if (isolate_)
+   {
+      return run_isolated(test, passed, failed, resources);
+   }
+   aes::test::resources::usage before = aes::test::resources::self();
+#endif
+
+   bool result = test->run_test();
+   passed = test->passed();
+   failed = test->failed();
+
+#if defined(AES_TEST_RESOURCES)
+   if (report_resources_)
+   {
+      resources = aes::test::resources::describe(aes::test::resources::difference(aes::test::resources::self(), before));
+   }
+#else
+   (void)resources;
+#endif
+   return result;
+}
+
+#if defined(AES_TEST_RESOURCES)
+template <typename _TSuiteSingleton, typename _TLogger>
+inline bool aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::run_isolated(unit_test_base<_TSuiteSingleton, _TLogger>* test,
+                                                                                  uint64_t& passed,
+                                                                                  uint64_t& failed,
+                                                                                  std::string& resources)
+{
+   int fd = -1;
+   aes::test::resources::usage before = aes::test::resources::self();
+   pid_t child = aes::test::resources::fork_limited(limits_, fd);
+
+   passed = 0;
+   failed = 1;
+   if (child < 0)
+   {
+      logger_.log_error("Error: unable to start an isolated process for " + aes::test::utils::trim(test->name()));
+      return false;
+   }
+
+   aes::test::distributed::channel link(fd);
+   if (child == 0)
+   {
+      // The child reports the counts and the output of the test, the result log stays with the suite.
+      aes::test::log::capture_buffer buffer;
+      std::stringstream out;
+      std::stringstream error;
+      test->result_log(nullptr, 0);
+      logger_.end_capture(false);
+      logger_.begin_capture(buffer);
+      try
+      {
+         test->run_test();
+         passed = test->passed();
+         failed = test->failed();
+      }
+      catch (const std::exception& e)
+      {
+         logger_.log_error(std::string("Error: unhandled exception: ") + e.what());
+         passed = test->passed();
+         failed = test->failed() + 1;
+      }
+      buffer.flush(out, error);
+      logger_.end_capture(false);
+
+      std::stringstream result;
+      result << "RESULT " << passed << " " << failed << " " << out.str().size() << " " << error.str().size() << "\n" << out.str() << error.str();
+      link.send(result.str());
+      link.close();
+      ::_exit(0);
+   }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// unit_test_base class implementation
+   std::string line;
+   std::string output;
+   size_t out_size = 0;
+   size_t error_size = 0;
+   bool reported = false;
+   while (!link.read_line(line))
+   {
+      if (!link.receive())
+      {
+         break;
+      }
+   }
+   if (line.compare(0, 7, "RESULT ") == 0)
+   {
+      std::stringstream header(line.substr(7));
+      header >> passed >> failed >> out_size >> error_size;
+      reported = link.read_bytes(out_size + error_size, output);
+   }
+   link.close();
 
-template <typename _TSuiteSingleton, typename _TLogger>
-inline aes::test::unit_test_base<_TSuiteSingleton, _TLogger>::unit_test_base(const std::string& name, const std::string description) noexcept
-   : assert_(_TSuiteSingleton::get().test_logger())
-   , name_(name)
-   , description_(description)
-{
-   _TSuiteSingleton::get().register_test(this);
+   int status = 0;
+   aes::test::resources::usage used = {};
+   aes::test::resources::wait(child, status, used);
+   if (reported)
+   {
+      log_output(output, out_size);
+   }
+   else
+   {
+      std::stringstream ss;
+      ss << "Error: " << aes::test::utils::trim(test->name());
+      if (WIFSIGNALED(status))
+      {
+         int signal = WTERMSIG(status);
+         ss << " killed by signal " << signal << (signal == SIGXCPU || (signal == SIGKILL && limits_.cpu_seconds_) ? " (cpu limit)" : "");
+      }
+      else
+      {
+         ss << " exited with status " << WEXITSTATUS(status) << " without a result";
+      }
+      logger_.log_error(ss.str());
+      passed = 0;
+      failed = 1;
+   }
+   // The assertions of the child were counted in its own copy of the metrics.
+   aes::test::metrics::registry::get().assertions(passed, failed);
+
+   if (report_resources_)
+   {
+      // The counters of the child start from zero, its peak includes the pages of the suite.
+      used.peak_rss_kb_ = std::max<int64_t>(used.peak_rss_kb_ - before.peak_rss_kb_, 0);
+      resources = aes::test::resources::describe(used);
+   }
+   return reported && failed == 0;
 }
+#endif
 
 template <typename _TSuiteSingleton, typename _TLogger>
-inline bool aes::test::unit_test_base<_TSuiteSingleton, _TLogger>::run_test()
+inline void aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::log_output(const std::string& output, size_t out_size) const
 {
-   run_tests(assert_);
-   return failed() == 0;
+   std::string line;
+   std::stringstream out(output.substr(0, out_size));
+   while (std::getline(out, line))
+   {
+      logger_.log_information(line);
+   }
+   std::stringstream error(output.substr(out_size));
+   while (std::getline(error, line))
+   {
+      logger_.log_error(line);
+   }
 }
 
 template <typename _TSuiteSingleton, typename _TLogger>
-inline const std::string& aes::test::unit_test_base<_TSuiteSingleton, _TLogger>::name() const noexcept
+inline void aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::shard(unsigned index, unsigned count) noexcept
 {
-   return name_;
+   shard_index_ = index;
+   shard_count_ = count > 0 ? count : 1;
 }
 
 template <typename _TSuiteSingleton, typename _TLogger>
-inline const std::string& aes::test::unit_test_base<_TSuiteSingleton, _TLogger>::description() const noexcept
+inline void aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::select(const std::set<std::string>& names)
 {
-   return description_;
+   is_selection_ = true;
+   selection_.insert(names.begin(), names.end());
 }
 
 template <typename _TSuiteSingleton, typename _TLogger>
-inline uint64_t aes::test::unit_test_base<_TSuiteSingleton, _TLogger>::passed() const noexcept
+inline void aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::filter(const std::string& test, const std::vector<std::string>& sections)
 {
-   return assert_.passed();
+   is_selection_ = true;
+   selection_.insert(test);
+   section_filters_[test] = sections;
 }
 
 template <typename _TSuiteSingleton, typename _TLogger>
-inline uint64_t aes::test::unit_test_base<_TSuiteSingleton, _TLogger>::failed() const noexcept
+inline void aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::coverage_dump(const std::string& directory)
 {
-   return assert_.failed();
+   coverage_dump_ = directory;
 }
 
 template <typename _TSuiteSingleton, typename _TLogger>
-inline uint64_t aes::test::unit_test_base<_TSuiteSingleton, _TLogger>::total() const noexcept
+inline bool aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::in_shard(size_t ordinal) const noexcept
 {
-   return assert_.total();
+   return ordinal % shard_count_ == shard_index_;
 }
 
-
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// test_suite_base class implementation
-
 template <typename _TSuiteSingleton, typename _TLogger>
-inline aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::test_suite_base(_TLogger& logger) noexcept
-   : logger_(logger)
-   , passed_(0)
-   , failed_(0)
-   , map_()
+inline bool aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::is_selected(const unit_test_base<_TSuiteSingleton, _TLogger>* test) const
 {
+   return !is_selection_ || selection_.count(aes::test::utils::trim(test->name())) > 0;
 }
 
 template <typename _TSuiteSingleton, typename _TLogger>
-inline bool aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::register_test(unit_test_base<_TSuiteSingleton, _TLogger>* test) noexcept
+inline void aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::log_test(const std::string& name, uint64_t passed, uint64_t failed, time_t seconds, const std::string& details) const
 {
-   bool result = false;
-
-   if (test)
-   {
-      map_.insert(std::pair<const std::string, unit_test_base<_TSuiteSingleton, _TLogger>*>(test->name(), test));
-      result = true;
-   }
+   const int width = 5;
 
-   return result;
+   std::stringstream ss;
+   ss << std::setiosflags(std::ios::left);
+   ss << "TEST  " << std::setw(width) << passed + failed << " Passed " << std::setw(width) << passed << " Failed " << std::setw(width) << failed << " " << name << "(" << seconds << "s)" << details;
+   ss << std::resetiosflags(std::ios::left);
+   logger_.log_information(ss.str());
 }
 
 template <typename _TSuiteSingleton, typename _TLogger>
-inline bool aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::run(const std::string& title)
+inline void aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::log_sections(unit_test_base<_TSuiteSingleton, _TLogger>* test) const
 {
    const int width = 5;
-   typename std::multimap<const std::string, unit_test_base<_TSuiteSingleton, _TLogger>*>::iterator it;
+   const std::vector<section_tracker::section>& sections = test->sections();
+   std::vector<size_t> pending;
 
-   logger_.log_information(title);
-   logger_.log_information("--------------------------------------------------------------");
-   for (it = map_.begin(); it != map_.end(); ++it)
+   // Depth first, the children are pushed in reverse to be logged in the order they were found.
+   if (!sections.empty())
    {
-      time_t start = time(0);
-      it->second->run_test();
-      time_t end = time(0);
-
-      uint64_t total = it->second->total();
-      passed_ += it->second->passed();
-      failed_ += it->second->failed();
+      pending.assign(sections[0].children_.rbegin(), sections[0].children_.rend());
+   }
+   while (!pending.empty())
+   {
+      const section_tracker::section& section = sections[pending.back()];
+      pending.pop_back();
+      pending.insert(pending.end(), section.children_.rbegin(), section.children_.rend());
 
       std::stringstream ss;
       ss << std::setiosflags(std::ios::left);
-      ss << "TEST  " << std::setw(width) << total << " Passed " << std::setw(width) << it->second->passed() << " Failed " << std::setw(width) << it->second->failed() << " " << it->second->name() << "(" << (end - start) << "s)";
+      ss << "SECT  " << std::setw(width) << section.passed_ + section.failed_ << " Passed " << std::setw(width) << section.passed_ << " Failed " << std::setw(width) << section.failed_ << " ";
+      ss << std::string(2 * section.depth_, ' ') << section.name_ << " (" << section.elapsed_.count() << "ns)";
       ss << std::resetiosflags(std::ios::left);
       logger_.log_information(ss.str());
    }
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline void aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::log_total(const std::string& title) const
+{
+   const int width = 5;
+
    logger_.log_information("--------------------------------------------------------------");
 
    std::stringstream ss;
@@ -760,9 +3998,50 @@ inline bool aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::run(const st
    ss << "TOTAL " << std::setw(width) << total() << " PASSED " << std::setw(width) << passed() << " FAILED " << std::setw(width) << failed() << "   " << title;
    ss << std::resetiosflags(std::ios::left);
    logger_.log_information(ss.str());
-   return failed() == 0;
 }
 
+template <typename _TSuiteSingleton, typename _TLogger>
+inline void aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::capture_output(aes::test::log::capture_mode mode, size_t limit) noexcept
+{
+   capture_.mode(mode);
+   capture_.limit(limit);
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline void aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::result_log(aes::test::result_log::writer* writer) noexcept
+{
+   result_log_ = writer;
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline void aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::virtual_time(bool is_virtual) noexcept
+{
+   loop_.virtual_time(is_virtual);
+}
+
+#if defined(AES_TEST_DISTRIBUTED)
+template <typename _TSuiteSingleton, typename _TLogger>
+inline void aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::memory_heavy_per_node(unsigned limit) noexcept
+{
+   memory_heavy_per_node_ = limit;
+}
+#endif
+
+#if defined(AES_TEST_RESOURCES)
+template <typename _TSuiteSingleton, typename _TLogger>
+inline void aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::isolate(const aes::test::resources::limits& limits) noexcept
+{
+   isolate_ = true;
+   limits_ = limits;
+}
+
+template <typename _TSuiteSingleton, typename _TLogger>
+inline void aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::report_resources(bool report) noexcept
+{
+   report_resources_ = report;
+}
+#endif
+
 template <typename _TSuiteSingleton, typename _TLogger>
 inline _TLogger& aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::test_logger() const noexcept
 {
@@ -791,7 +4070,8 @@ inline uint64_t aes::test::test_suite_base<_TSuiteSingleton, _TLogger>::total()
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // test_suite_singleton class implementation
 
-inline test_suite& aes::test::test_suite_singleton::get() noexcept
+#if defined(AES_TEST_IMPLEMENTATION)
+AES_TEST_INLINE test_suite& aes::test::test_suite_singleton::get() noexcept
 {
    static logger log(std::cout, std::cerr);
    static test_suite suite(log);
@@ -802,12 +4082,225 @@ inline test_suite& aes::test::test_suite_singleton::get() noexcept
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // unit_test_main function implementation
 
-inline int aes::test::utils::unit_test_main(int argc, char** argv, const char* title)
+AES_TEST_INLINE int aes::test::utils::unit_test_main(int argc, char** argv, const char* title)
 {
+   aes::test::result_log::writer result_log;
+   std::string result_log_path;
+   std::string coordinator;
+   std::string worker;
+   unsigned workers = 0;
+   int worker_node = -1;
+   bool placement = false;
+   bool smt_idle = false;
+   std::vector<std::string> worker_arguments(1, argv[0]);
+   std::string metrics_target;
+   std::string trace_path;
+   std::chrono::milliseconds metrics_interval(1000);
+#if defined(AES_TEST_RESOURCES)
+   aes::test::resources::limits limits = { 0, 0 };
+#endif
+
+   // The rules of the log categories come from the environment, --log replaces them.
+   const char* log_rules = std::getenv("CPP_TEST_LOG");
+   if (log_rules && !aes::test::log::categories::get().configure(log_rules))
+   {
+      aes::test::test_suite_singleton::get().test_logger().log_error(std::string("Error: invalid CPP_TEST_LOG ") + log_rules);
+      return -1;
+   }
+
    for (int i = 1; i < argc; ++i)
    {
       char* str = argv[i];
-      if (str && (*str == '-' || *str == '/'))
+      std::string value;
+      if (str && aes::test::utils::match_option(str, "shard", value))
+      {
+         unsigned index = 0;
+         unsigned count = 0;
+         char separator = 0;
+         std::stringstream ss(value);
+         if (!(ss >> index >> separator >> count) || separator != '/' || count == 0 || index >= count)
+         {
+            std::stringstream error;
+            error << "Error: invalid shard " << argv[i] << ", expected --shard=<index>/<count>";
+            aes::test::test_suite_singleton::get().test_logger().log_error(error.str());
+            return -1;
+         }
+         aes::test::test_suite_singleton::get().shard(index, count);
+      }
+#if defined(AES_TEST_DISTRIBUTED)
+      else if (str && aes::test::utils::match_option(str, "coordinator", value) && !value.empty())
+      {
+         coordinator = value;
+      }
+      else if (str && aes::test::utils::match_option(str, "workers", value))
+      {
+         workers = unsigned(std::strtoul(value.c_str(), nullptr, 10));
+      }
+      else if (str && aes::test::utils::match_option(str, "worker", value) && !value.empty())
+      {
+         worker = value;
+      }
+      else if (str && aes::test::utils::match_option(str, "worker-node", value) && !value.empty())
+      {
+         worker_node = std::atoi(value.c_str());
+      }
+      else if (str && aes::test::utils::match_option(str, "placement", value))
+      {
+         placement = true;
+      }
+      else if (str && aes::test::utils::match_option(str, "smt-idle", value))
+      {
+         placement = true;
+         smt_idle = true;
+      }
+      else if (str && aes::test::utils::match_option(str, "memory-heavy-per-node", value))
+      {
+         aes::test::test_suite_singleton::get().memory_heavy_per_node(unsigned(std::strtoul(value.c_str(), nullptr, 10)));
+      }
+#endif
+      else if (str && aes::test::utils::match_option(str, "tests", value) && !value.empty())
+      {
+         std::ifstream file(value);
+         std::set<std::string> names;
+         std::string name;
+         if (!file)
+         {
+            std::stringstream ss;
+            ss << "Error: unable to open the list of tests " << argv[i];
+            aes::test::test_suite_singleton::get().test_logger().log_error(ss.str());
+            return -1;
+         }
+         while (std::getline(file, name))
+         {
+            if (!aes::test::utils::trim(name).empty())
+            {
+               names.insert(aes::test::utils::trim(name));
+            }
+         }
+         aes::test::test_suite_singleton::get().select(names);
+      }
+      else if (str && aes::test::utils::match_option(str, "filter", value) && !value.empty())
+      {
+         // --filter=<test>[:<section>[:<section>...]]
+         std::vector<std::string> path;
+         std::stringstream ss(value);
+         std::string name;
+         while (std::getline(ss, name, ':'))
+         {
+            path.push_back(name);
+         }
+         aes::test::test_suite_singleton::get().filter(path.front(), std::vector<std::string>(path.begin() + 1, path.end()));
+      }
+      else if (str && aes::test::utils::match_option(str, "coverage-dump", value) && !value.empty())
+      {
+         if (!aes::test::coverage::available())
+         {
+            aes::test::test_suite_singleton::get().test_logger().log_error("Error: --coverage-dump requires a build with gcov instrumentation and AES_TEST_COVERAGE defined");
+            return -1;
+         }
+         aes::test::test_suite_singleton::get().coverage_dump(value);
+      }
+      else if (str && aes::test::utils::match_option(str, "capture", value))
+      {
+         size_t limit = value.empty() ? 1024 * 1024 : size_t(std::strtoull(value.c_str(), nullptr, 10));
+         aes::test::test_suite_singleton::get().capture_output(aes::test::log::capture_mode::spill, limit);
+      }
+      else if (str && aes::test::utils::match_option(str, "capture-tail", value))
+      {
+         size_t limit = value.empty() ? 64 * 1024 : size_t(std::strtoull(value.c_str(), nullptr, 10));
+         aes::test::test_suite_singleton::get().capture_output(aes::test::log::capture_mode::tail, limit);
+      }
+      else if (str && aes::test::utils::match_option(str, "stress", value))
+      {
+         char* end = nullptr;
+         unsigned long threads = std::strtoul(value.c_str(), &end, 10);
+         if (value.empty() || *end != '\0')
+         {
+            aes::test::test_suite_singleton::get().test_logger().log_error("Error: --stress requires a number of threads");
+            return -1;
+         }
+         aes::test::stress_settings::get().threads(unsigned(threads));
+      }
+      else if (str && aes::test::utils::match_option(str, "benchmark-cpu", value))
+      {
+         aes::test::benchmark::settings().cpu_ = std::atoi(value.c_str());
+      }
+      else if (str && aes::test::utils::match_option(str, "stress-pin", value))
+      {
+         aes::test::stress_settings::get().pin_threads(true);
+      }
+      else if (str && aes::test::utils::match_option(str, "virtual-time", value))
+      {
+         aes::test::test_suite_singleton::get().virtual_time(true);
+      }
+      else if (str && aes::test::utils::match_option(str, "metrics", value) && !value.empty())
+      {
+         metrics_target = value;
+      }
+      else if (str && aes::test::utils::match_option(str, "metrics-interval", value) && std::strtoul(value.c_str(), nullptr, 10) > 0)
+      {
+         metrics_interval = std::chrono::milliseconds(std::strtoul(value.c_str(), nullptr, 10));
+      }
+      else if (str && aes::test::utils::match_option(str, "trace", value) && !value.empty())
+      {
+         trace_path = value;
+         aes::test::trace::recorder::get().enable(true);
+         aes::test::trace::recorder::get().name_thread("main");
+      }
+      else if (str && aes::test::utils::match_option(str, "update-snapshots", value))
+      {
+         aes::test::snapshot::settings().update_ = true;
+      }
+      else if (str && aes::test::utils::match_option(str, "snapshot-dir", value))
+      {
+         aes::test::snapshot::settings().directory_ = value;
+      }
+      else if (str && aes::test::utils::match_option(str, "flight-recorder", value))
+      {
+         aes::test::flight::recorder::get().enable(value.empty() ? 64 : std::max<size_t>(1, size_t(std::strtoull(value.c_str(), nullptr, 10))));
+         aes::test::flight::recorder::get().install_signal_handlers();
+      }
+      else if (str && aes::test::utils::match_option(str, "log", value))
+      {
+         if (!aes::test::log::categories::get().configure(value))
+         {
+            std::stringstream ss;
+            ss << "Error: invalid log rules " << argv[i] << ", expected --log=<name>:<level>[,<name>:<level>...]";
+            aes::test::test_suite_singleton::get().test_logger().log_error(ss.str());
+            return -1;
+         }
+      }
+#if defined(AES_TEST_RESOURCES)
+      else if (str && aes::test::utils::match_option(str, "isolate", value))
+      {
+         aes::test::test_suite_singleton::get().isolate(limits);
+      }
+      else if (str && aes::test::utils::match_option(str, "memory-limit", value) && aes::test::resources::parse_size(value, limits.memory_bytes_))
+      {
+         aes::test::test_suite_singleton::get().isolate(limits);
+      }
+      else if (str && aes::test::utils::match_option(str, "cpu-limit", value) && !value.empty())
+      {
+         limits.cpu_seconds_ = std::strtoull(value.c_str(), nullptr, 10);
+         aes::test::test_suite_singleton::get().isolate(limits);
+      }
+      else if (str && aes::test::utils::match_option(str, "rusage", value))
+      {
+         aes::test::test_suite_singleton::get().report_resources(true);
+      }
+#endif
+      else if (str && aes::test::utils::match_option(str, "result-log", value))
+      {
+         result_log_path = value;
+         if (value.empty())
+         {
+            std::stringstream ss;
+            ss << "Error: unable to open the result log " << argv[i];
+            aes::test::test_suite_singleton::get().test_logger().log_error(ss.str());
+            return -1;
+         }
+      }
+      else if (str && (*str == '-' || *str == '/'))
       {
          ++str;
          if (*str == 'v' || *str == 'V')
@@ -829,8 +4322,152 @@ inline int aes::test::utils::unit_test_main(int argc, char** argv, const char* t
          aes::test::test_suite_singleton::get().test_logger().log_error(ss.str());
          return -1;
       }
+
+      // Local workers run with the same settings as the coordinator, on the tests it hands out
+      const char* coordinator_options[] = { "shard", "coordinator", "workers", "worker", "worker-node", "placement", "smt-idle", "memory-heavy-per-node", "metrics", "metrics-interval", "trace" };
+      if (std::none_of(std::begin(coordinator_options), std::end(coordinator_options), [&](const char* name) { return aes::test::utils::match_option(argv[i], name, value); }))
+      {
+         worker_arguments.push_back(argv[i]);
+      }
+   }
+
+   // A worker writes a log of its own next to the one of the coordinator, which appends it after the run.
+   if (!result_log_path.empty())
+   {
+      std::string path = result_log_path;
+#if defined(AES_TEST_DISTRIBUTED)
+      path += worker.empty() ? std::string() : ".worker." + std::to_string(::getpid());
+#endif
+      if (!result_log.open(path))
+      {
+         aes::test::test_suite_singleton::get().test_logger().log_error("Error: unable to open the result log " + path);
+         return -1;
+      }
+      aes::test::test_suite_singleton::get().result_log(&result_log);
+   }
+
+   aes::test::log::level everything = aes::test::log::level::information;
+   if (aes::test::log::categories::get().level_of("*", everything))
+   {
+      aes::test::test_suite_singleton::get().test_logger().log_level(everything);
+   }
+
+   // Published until the end of the run, the last sample is written when it is destroyed.
+   aes::test::metrics::publisher metrics(aes::test::metrics::registry::get());
+   if (!metrics_target.empty())
+   {
+      if (!metrics.open(metrics_target))
+      {
+         aes::test::test_suite_singleton::get().test_logger().log_error("Error: unable to publish the metrics to " + metrics_target);
+         return -1;
+      }
+      metrics.start(metrics_interval);
+   }
+
+   // The trace is written after the run, once every thread has recorded its events.
+   auto write_trace = [&trace_path]()
+   {
+      if (!trace_path.empty() && !aes::test::trace::recorder::get().write(trace_path))
+      {
+         aes::test::test_suite_singleton::get().test_logger().log_error("Error: unable to write the trace to " + trace_path);
+      }
+   };
+
+#if defined(AES_TEST_DISTRIBUTED)
+   if (!worker.empty())
+   {
+      aes::test::distributed::channel channel;
+      if (!channel.connect(worker))
+      {
+         std::stringstream ss;
+         ss << "Error: unable to connect to the coordinator " << worker;
+         aes::test::test_suite_singleton::get().test_logger().log_error(ss.str());
+         return -1;
+      }
+      return aes::test::test_suite_singleton::get().run_worker(channel, worker_node) ? 0 : -1;
+   }
+
+   if (!coordinator.empty())
+   {
+      aes::test::distributed::listener listener;
+      aes::test::distributed::process_group processes;
+      if (!listener.open(coordinator))
+      {
+         std::stringstream ss;
+         ss << "Error: unable to listen on " << coordinator;
+         aes::test::test_suite_singleton::get().test_logger().log_error(ss.str());
+         return -1;
+      }
+
+      // Placed workers are pinned one per CPU and spread over the NUMA nodes.
+      std::vector<aes::test::topology::slot> placements;
+      if (placement)
+      {
+         aes::test::topology::machine topology = aes::test::topology::current();
+         placements = aes::test::topology::plan(topology, workers, smt_idle);
+         std::stringstream ss;
+         ss << "PLACEMENT " << placements.size() << " workers on " << aes::test::topology::describe(topology) << (smt_idle ? ", SMT siblings idle" : "");
+         aes::test::test_suite_singleton::get().test_logger().log_information(ss.str());
+         if (placements.empty())
+         {
+            aes::test::test_suite_singleton::get().test_logger().log_warning("Warning: the CPU topology is unknown, the workers are not placed");
+         }
+      }
+
+      worker_arguments.push_back("--worker=" + listener.address());
+      processes.spawn(worker_arguments, workers, placements);
+      aes::test::test_suite_singleton::get().run_coordinator(title, listener, processes);
+      aes::test::test_suite_singleton::get().result_log(nullptr);
+      write_trace();
+      return int(aes::test::test_suite_singleton::get().failed());
    }
+#endif
 
    aes::test::test_suite_singleton::get().run(title);
+   aes::test::test_suite_singleton::get().result_log(nullptr);
+   write_trace();
    return int(aes::test::test_suite_singleton::get().failed());
 }
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// instantiations compiled once into the library
+
+#if defined(AES_TEST_LIBRARY)
+#if defined(AES_TEST_BUILD_LIBRARY)
+#define AES_TEST_INSTANTIATE template
+#else
+#define AES_TEST_INSTANTIATE extern template
+#endif
+
+AES_TEST_INSTANTIATE class aes::test::log::logger_base<std::ostream, std::ostream>;
+AES_TEST_INSTANTIATE class aes::test::assert_base<logger>;
+AES_TEST_INSTANTIATE class aes::test::unit_test_base<aes::test::test_suite_singleton, logger>;
+AES_TEST_INSTANTIATE class aes::test::stress_test_base<aes::test::test_suite_singleton, logger>;
+AES_TEST_INSTANTIATE class aes::test::async_test_base<aes::test::test_suite_singleton, logger>;
+AES_TEST_INSTANTIATE class aes::test::complexity_test_base<aes::test::test_suite_singleton, logger>;
+AES_TEST_INSTANTIATE class aes::test::test_suite_base<aes::test::test_suite_singleton, logger>;
+
+#define AES_TEST_INSTANTIATE_ASSERTS(T)                                                                                                                                   \
+AES_TEST_INSTANTIATE bool aes::test::assert_base<logger>::equal<T>(const std::string&, int, const std::string&, T const&, T const&) noexcept;                             \
+AES_TEST_INSTANTIATE bool aes::test::assert_base<logger>::not_equal<T>(const std::string&, int, const std::string&, T const&, T const&) noexcept;                         \
+AES_TEST_INSTANTIATE bool aes::test::assert_base<logger>::generic<T>(const std::string&, int, const std::string&, const std::string&, T const&, T const&, bool) noexcept; \
+AES_TEST_INSTANTIATE bool aes::test::assert_base<logger>::equal<T>(const aes::test::site_ref&, T const&, T const&) noexcept;                                              \
+AES_TEST_INSTANTIATE bool aes::test::assert_base<logger>::not_equal<T>(const aes::test::site_ref&, T const&, T const&) noexcept;
+
+AES_TEST_INSTANTIATE_ASSERTS(bool)
+AES_TEST_INSTANTIATE_ASSERTS(char)
+AES_TEST_INSTANTIATE_ASSERTS(int)
+AES_TEST_INSTANTIATE_ASSERTS(unsigned int)
+AES_TEST_INSTANTIATE_ASSERTS(long)
+AES_TEST_INSTANTIATE_ASSERTS(unsigned long)
+AES_TEST_INSTANTIATE_ASSERTS(long long)
+AES_TEST_INSTANTIATE_ASSERTS(unsigned long long)
+AES_TEST_INSTANTIATE_ASSERTS(double)
+AES_TEST_INSTANTIATE_ASSERTS(void*)
+AES_TEST_INSTANTIATE_ASSERTS(std::string)
+
+#undef AES_TEST_INSTANTIATE_ASSERTS
+#undef AES_TEST_INSTANTIATE
+#endif
@@ -0,0 +1,535 @@
+/****
+ * Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "unit_test_config.h"
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define AES_TEST_COROUTINES
+#endif
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////
+// Event loop for asynchronous tests
+//
+// The loop runs posted callbacks and timers on the thread calling run(). With
+// virtual time, the clock jumps straight to the next timer whenever nothing else
+// is ready, so sleeps and timeouts cost no wall clock time.
+//
+// A callback runs in the context it has been posted or scheduled from. The context
+// of a test receives the exceptions of its callbacks and fails the test when its
+// deadline passes; once cancelled, the callbacks left in the context are dropped.
+
+namespace aes
+{
+   namespace test
+   {
+      namespace async
+      {
+         using duration = std::chrono::nanoseconds;
+         using callback = std::function<void()>;
+         using completion = std::function<void()>;
+         using failure = std::function<void(std::exception_ptr)>;
+
+         // Passed to the failure handler of a context whose deadline has passed
+         class timeout_error : public std::runtime_error
+         {
+         public:
+            timeout_error(const std::string& message);
+         };
+
+         class context
+         {
+         public:
+            context(failure on_failure, duration timeout);
+            context(const context&) = delete;
+            ~context() noexcept = default;
+
+         public:
+            context& operator=(const context&) = delete;
+
+         public:
+            void fail(std::exception_ptr error);
+            void cancel() noexcept;
+            bool cancelled() const noexcept;
+            duration timeout() const noexcept;
+
+         private:
+            friend class event_loop;
+
+         private:
+            failure failure_;
+            duration timeout_;
+            duration deadline_;
+            bool cancelled_;
+         };
+
+         class event_loop
+         {
+         public:
+            event_loop(bool virtual_time = false) noexcept;
+            event_loop(const event_loop&) = delete;
+            ~event_loop() noexcept = default;
+
+         public:
+            event_loop& operator=(const event_loop&) = delete;
+
+         public:
+            void post(callback function);
+            void schedule(duration delay, callback function);
+            void start(std::shared_ptr<context> owner, callback function);
+            uint64_t run();
+
+         public:
+            duration now() const noexcept;
+            bool virtual_time() const noexcept;
+            void virtual_time(bool is_virtual) noexcept;
+            bool empty() const noexcept;
+
+         private:
+            struct entry
+            {
+               callback function_;
+               std::shared_ptr<context> context_;
+            };
+
+            struct timer
+            {
+               duration due_;
+               uint64_t sequence_;
+               entry entry_;
+            };
+
+            struct later
+            {
+               bool operator()(const timer& t1, const timer& t2) const noexcept
+               {
+                  return t1.due_ > t2.due_ || (t1.due_ == t2.due_ && t1.sequence_ > t2.sequence_);
+               }
+            };
+
+         private:
+            void execute(entry& current);
+            void expire();
+            void drop_cancelled() noexcept;
+
+         private:
+            std::deque<entry> ready_;
+            std::priority_queue<timer, std::vector<timer>, later> timers_;
+            std::vector<std::shared_ptr<context>> contexts_;   // contexts started on this run, with a deadline
+            std::shared_ptr<context> current_;
+            uint64_t sequence_;
+            bool virtual_time_;
+            duration virtual_now_;
+            std::chrono::steady_clock::time_point start_;
+         };
+
+#if defined(AES_TEST_COROUTINES)
+         // The frame of the coroutine belongs to the task, it is destroyed with the task
+         // whether the coroutine ended or not. An exception of the coroutine is thrown by
+         // the resumption that ended it, in the context of the test.
+         class task
+         {
+         public:
+            struct promise_type
+            {
+               completion done_;
+               std::exception_ptr exception_;
+
+               task get_return_object() noexcept;
+               std::suspend_always initial_suspend() const noexcept;
+               std::suspend_always final_suspend() const noexcept;
+               void return_void() noexcept;
+               void unhandled_exception() noexcept;
+            };
+
+         public:
+            task() noexcept;
+            task(std::coroutine_handle<promise_type> handle) noexcept;
+            task(task&& other) noexcept;
+            task(const task&) = delete;
+            ~task() noexcept;
+
+         public:
+            task& operator=(task&& other) noexcept;
+            task& operator=(const task&) = delete;
+
+         public:
+            void start(completion done);
+            static void resume(std::coroutine_handle<promise_type> handle);
+
+         private:
+            std::coroutine_handle<promise_type> handle_;
+         };
+
+         class sleep_awaiter
+         {
+         public:
+            sleep_awaiter(event_loop& loop, duration delay) noexcept;
+
+         public:
+            bool await_ready() const noexcept;
+            void await_suspend(std::coroutine_handle<task::promise_type> handle);
+            void await_resume() const noexcept;
+
+         private:
+            event_loop& loop_;
+            duration delay_;
+         };
+
+         sleep_awaiter sleep(event_loop& loop, duration delay) noexcept;
+#endif
+      }
+   }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// context class implementation
+
+#if defined(AES_TEST_IMPLEMENTATION)
+AES_TEST_INLINE aes::test::async::timeout_error::timeout_error(const std::string& message)
+   : std::runtime_error(message)
+{
+}
+
+AES_TEST_INLINE aes::test::async::context::context(failure on_failure, duration timeout)
+   : failure_(std::move(on_failure))
+   , timeout_(timeout)
+   , deadline_(0)
+   , cancelled_(false)
+{
+}
+
+// An exception ends the context, the callbacks it has left are dropped.
+AES_TEST_INLINE void aes::test::async::context::fail(std::exception_ptr error)
+{
+   if (!cancelled_)
+   {
+      cancelled_ = true;
+      if (failure_)
+      {
+         failure_(error);
+      }
+   }
+}
+
+AES_TEST_INLINE void aes::test::async::context::cancel() noexcept
+{
+   cancelled_ = true;
+}
+
+AES_TEST_INLINE bool aes::test::async::context::cancelled() const noexcept
+{
+   return cancelled_;
+}
+
+AES_TEST_INLINE aes::test::async::duration aes::test::async::context::timeout() const noexcept
+{
+   return timeout_;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// event_loop class implementation
+
+AES_TEST_INLINE aes::test::async::event_loop::event_loop(bool virtual_time) noexcept
+   : ready_()
+   , timers_()
+   , contexts_()
+   , current_()
+   , sequence_(0)
+   , virtual_time_(virtual_time)
+   , virtual_now_(0)
+   , start_(std::chrono::steady_clock::now())
+{
+}
+
+AES_TEST_INLINE void aes::test::async::event_loop::post(callback function)
+{
+   ready_.push_back(entry{ std::move(function), current_ });
+}
+
+AES_TEST_INLINE void aes::test::async::event_loop::schedule(duration delay, callback function)
+{
+   timers_.push(timer{ now() + std::max(delay, duration(0)), sequence_++, entry{ std::move(function), current_ } });
+}
+
+AES_TEST_INLINE void aes::test::async::event_loop::start(std::shared_ptr<context> owner, callback function)
+{
+   owner->deadline_ = now() + owner->timeout_;
+   contexts_.push_back(owner);
+   ready_.push_back(entry{ std::move(function), std::move(owner) });
+}
+
+AES_TEST_INLINE uint64_t aes::test::async::event_loop::run()
+{
+   uint64_t executed = 0;
+
+   while (!empty())
+   {
+      while (!ready_.empty())
+      {
+         entry current(std::move(ready_.front()));
+         ready_.pop_front();
+         if (!current.context_ || !current.context_->cancelled())
+         {
+            execute(current);
+            ++executed;
+         }
+         expire();
+      }
+
+      drop_cancelled();
+      if (!timers_.empty())
+      {
+         // The clock never moves past the deadline of a context before expiring it.
+         duration due = timers_.top().due_;
+         for (const std::shared_ptr<context>& owner : contexts_)
+         {
+            due = owner->cancelled() ? due : std::min(due, owner->deadline_);
+         }
+         if (virtual_time_)
+         {
+            virtual_now_ = std::max(virtual_now_, due);
+         }
+         else if (due > now())
+         {
+            std::this_thread::sleep_for(due - now());
+         }
+         expire();
+         drop_cancelled();
+
+         // Every timer due by now is moved to the ready queue, in due order.
+         while (!timers_.empty() && timers_.top().due_ <= now())
+         {
+            ready_.push_back(std::move(const_cast<timer&>(timers_.top()).entry_));
+            timers_.pop();
+         }
+      }
+   }
+
+   // Deadlines only apply while the callbacks of their context are pending.
+   contexts_.clear();
+   return executed;
+}
+
+AES_TEST_INLINE aes::test::async::duration aes::test::async::event_loop::now() const noexcept
+{
+   return virtual_time_ ? virtual_now_ : std::chrono::duration_cast<duration>(std::chrono::steady_clock::now() - start_);
+}
+
+AES_TEST_INLINE bool aes::test::async::event_loop::virtual_time() const noexcept
+{
+   return virtual_time_;
+}
+
+AES_TEST_INLINE void aes::test::async::event_loop::virtual_time(bool is_virtual) noexcept
+{
+   if (is_virtual && !virtual_time_)
+   {
+      virtual_now_ = now();
+   }
+   virtual_time_ = is_virtual;
+}
+
+AES_TEST_INLINE bool aes::test::async::event_loop::empty() const noexcept
+{
+   return ready_.empty() && timers_.empty();
+}
+
+// A callback without a context throws out of run(), as before contexts.
+AES_TEST_INLINE void aes::test::async::event_loop::execute(entry& current)
+{
+   current_ = current.context_;
+   try
+   {
+      current.function_();
+   }
+   catch (...)
+   {
+      std::shared_ptr<context> owner(std::move(current_));
+      current_ = nullptr;
+      if (!owner)
+      {
+         throw;
+      }
+      owner->fail(std::current_exception());
+   }
+   current_ = nullptr;
+}
+
+AES_TEST_INLINE void aes::test::async::event_loop::expire()
+{
+   std::vector<std::shared_ptr<context>> expired;
+   duration time = now();
+
+   for (const std::shared_ptr<context>& owner : contexts_)
+   {
+      if (!owner->cancelled() && owner->deadline_ <= time)
+      {
+         expired.push_back(owner);
+      }
+   }
+   for (const std::shared_ptr<context>& owner : expired)
+   {
+      long long milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(owner->timeout_).count();
+      owner->fail(std::make_exception_ptr(timeout_error("timed out after " + std::to_string(milliseconds) + " ms")));
+   }
+}
+
+AES_TEST_INLINE void aes::test::async::event_loop::drop_cancelled() noexcept
+{
+   while (!timers_.empty() && timers_.top().entry_.context_ && timers_.top().entry_.context_->cancelled())
+   {
+      timers_.pop();
+   }
+}
+#endif
+
+
+#if defined(AES_TEST_COROUTINES)
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// coroutine support implementation
+
+#if defined(AES_TEST_IMPLEMENTATION)
+AES_TEST_INLINE aes::test::async::sleep_awaiter::sleep_awaiter(event_loop& loop, duration delay) noexcept
+   : loop_(loop)
+   , delay_(delay)
+{
+}
+
+AES_TEST_INLINE bool aes::test::async::sleep_awaiter::await_ready() const noexcept
+{
+   return false;
+}
+
+AES_TEST_INLINE void aes::test::async::sleep_awaiter::await_suspend(std::coroutine_handle<task::promise_type> handle)
+{
+   loop_.schedule(delay_, [handle]() { task::resume(handle); });
+}
+
+AES_TEST_INLINE void aes::test::async::sleep_awaiter::await_resume() const noexcept
+{
+}
+
+AES_TEST_INLINE aes::test::async::task aes::test::async::task::promise_type::get_return_object() noexcept
+{
+   return task(std::coroutine_handle<promise_type>::from_promise(*this));
+}
+
+AES_TEST_INLINE std::suspend_always aes::test::async::task::promise_type::initial_suspend() const noexcept
+{
+   return {};
+}
+
+AES_TEST_INLINE std::suspend_always aes::test::async::task::promise_type::final_suspend() const noexcept
+{
+   return {};
+}
+
+AES_TEST_INLINE void aes::test::async::task::promise_type::return_void() noexcept
+{
+}
+
+AES_TEST_INLINE void aes::test::async::task::promise_type::unhandled_exception() noexcept
+{
+   exception_ = std::current_exception();
+}
+
+AES_TEST_INLINE aes::test::async::task::task() noexcept
+   : handle_(nullptr)
+{
+}
+
+AES_TEST_INLINE aes::test::async::task::task(std::coroutine_handle<promise_type> handle) noexcept
+   : handle_(handle)
+{
+}
+
+AES_TEST_INLINE aes::test::async::task::task(task&& other) noexcept
+   : handle_(other.handle_)
+{
+   other.handle_ = nullptr;
+}
+
+AES_TEST_INLINE aes::test::async::task::~task() noexcept
+{
+   if (handle_)
+   {
+      handle_.destroy();
+   }
+}
+
+AES_TEST_INLINE aes::test::async::task& aes::test::async::task::operator=(task&& other) noexcept
+{
+   if (this != &other)
+   {
+      if (handle_)
+      {
+         handle_.destroy();
+      }
+      handle_ = other.handle_;
+      other.handle_ = nullptr;
+   }
+   return *this;
+}
+
+AES_TEST_INLINE void aes::test::async::task::start(completion done)
+{
+   handle_.promise().done_ = std::move(done);
+   resume(handle_);
+}
+
+// The coroutine is suspended at its final point once ended, its frame stays with the task.
+AES_TEST_INLINE void aes::test::async::task::resume(std::coroutine_handle<promise_type> handle)
+{
+   handle.resume();
+   if (handle.done())
+   {
+      std::exception_ptr exception(std::move(handle.promise().exception_));
+      if (exception)
+      {
+         std::rethrow_exception(exception);
+      }
+      if (handle.promise().done_)
+      {
+         handle.promise().done_();
+      }
+   }
+}
+
+AES_TEST_INLINE aes::test::async::sleep_awaiter aes::test::async::sleep(event_loop& loop, duration delay) noexcept
+{
+   return sleep_awaiter(loop, delay);
+}
+#endif
+#endif
@@ -0,0 +1,585 @@
+/****
+ * Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "unit_test_config.h"
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#if defined(AES_TEST_IMPLEMENTATION)
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <thread>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/utsname.h>
+#endif
+#endif
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////
+// Complexity benchmarks
+//
+// A complexity benchmark runs its body over a geometric sweep of input sizes and
+// fits the time of every size to c * f(n) for the usual complexity classes, by
+// least squares of the residuals relative to the time. Every size weighs the
+// same, so one disturbed run at the largest size does not decide the class alone.
+// The error of a fit is the root mean square of its relative residuals. The
+// measured class is the simplest one whose error is within settings().tolerance_
+// of the best error: O(n) and O(n log n) differ little over a short sweep, and
+// the noise should not make a linear algorithm look worse than it is.
+//
+// The body builds the input of the size it is given and times the part to measure
+// with state::measure, or reports a time taken by other means, such as a cycle
+// counter or a simulated clock, with state::record; without them the whole body
+// is timed. Each size is first run
+// until settings().window_ runs in a row agree within settings().steady_ (caches
+// and branch predictors warm, the clock raised), then measured until
+// settings().min_time_ is spent. Runs farther from the median than
+// settings().outlier_threshold_ median absolute deviations are rejected, and the
+// fastest run kept is the time of the size: the load of the machine only ever
+// makes a run slower.
+//
+// The environment of a run is captured once: CPU model, cores, kernel, compiler
+// and flags make the fingerprint, which tells whether two results come from the
+// same setup. The frequency governor, the turbo state and the resolution and cost
+// of the clock are reported beside it, and the thread can be pinned to one CPU.
+
+namespace aes
+{
+   namespace test
+   {
+      namespace benchmark
+      {
+         enum class complexity
+         {
+            constant,
+            logarithmic,
+            linear,
+            linearithmic,
+            quadratic
+         };
+
+         struct options
+         {
+            double min_time_;          // seconds spent on every size
+            uint64_t min_runs_;
+            uint64_t max_runs_;
+            double multiplier_;        // between two sizes of a sweep
+            double tolerance_;         // relative error a simpler class may lose to the best fit
+            int cpu_;                  // the benchmarks are pinned to this CPU, -1 when not pinned
+            size_t window_;            // runs in a row that must agree for the warmup to end
+            double steady_;            // relative spread of the window
+            double max_warmup_time_;   // seconds, the warmup ends there even when not steady
+            double outlier_threshold_; // in median absolute deviations
+         };
+
+         struct statistics
+         {
+            double median_ns_;
+            double mean_ns_;           // of the runs kept
+            double fastest_ns_;        // of the runs kept
+            size_t kept_;
+            size_t rejected_;
+         };
+
+         struct environment
+         {
+            std::string cpu_model_;
+            unsigned cores_;
+            std::string kernel_;
+            std::string compiler_;
+            std::string flags_;
+            std::string governor_;     // "unknown" when the system does not tell
+            std::string turbo_;        // "on", "off" or "unknown"
+            double timer_resolution_ns_;
+            double timer_overhead_ns_;
+         };
+
+         struct sample
+         {
+            uint64_t size_;
+            double ns_;
+         };
+
+         struct fit
+         {
+            complexity complexity_;
+            double coefficient_;       // nanoseconds per unit of f(n)
+            double rms_;               // of the residuals relative to the times
+         };
+
+         options& settings() noexcept;
+         const char* name(complexity order) noexcept;
+         std::vector<uint64_t> sizes(uint64_t first, uint64_t last, double multiplier);
+         fit fit_to(const std::vector<sample>& samples, complexity order) noexcept;
+         fit best_fit(const std::vector<sample>& samples) noexcept;
+         bool is_steady(const std::vector<double>& runs) noexcept;
+         statistics robust(std::vector<double> runs);
+         const environment& host();
+         std::string fingerprint(const environment& values);
+         std::string describe(const environment& values);
+
+         // Pins the current thread to a CPU while it lives, the previous affinity is restored after.
+         class pinned_thread
+         {
+         public:
+            pinned_thread(int cpu) noexcept;
+            pinned_thread(const pinned_thread&) = delete;
+            ~pinned_thread() noexcept;
+
+         public:
+            pinned_thread& operator=(const pinned_thread&) = delete;
+
+         public:
+            bool pinned() const noexcept;
+
+         private:
+            bool pinned_;
+#if defined(__linux__)
+            cpu_set_t previous_;
+#endif
+         };
+
+         // Given to the body of a complexity benchmark for one run at one size.
+         class state
+         {
+         public:
+            state(uint64_t size) noexcept;
+            state(const state&) = delete;
+            ~state() noexcept = default;
+
+         public:
+            state& operator=(const state&) = delete;
+
+         public:
+            uint64_t size() const noexcept;
+            std::mt19937_64& random() noexcept;
+            template <typename _TBody>
+            void measure(_TBody body);
+            void record(double ns) noexcept;
+            bool measured() const noexcept;
+            double elapsed_ns() const noexcept;
+
+         private:
+            uint64_t size_;
+            std::mt19937_64 random_;          // seeded with the size, the inputs are the same on every run
+            bool measured_;
+            double elapsed_ns_;
+         };
+      }
+   }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// state class implementation
+
+template <typename _TBody>
+inline void aes::test::benchmark::state::measure(_TBody body)
+{
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+   body();
+   elapsed_ns_ += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+   measured_ = true;
+}
+
+#if defined(AES_TEST_IMPLEMENTATION)
+AES_TEST_INLINE aes::test::benchmark::state::state(uint64_t size) noexcept
+   : size_(size)
+   , random_(size)
+   , measured_(false)
+   , elapsed_ns_(0.0)
+{
+}
+
+AES_TEST_INLINE uint64_t aes::test::benchmark::state::size() const noexcept
+{
+   return size_;
+}
+
+AES_TEST_INLINE std::mt19937_64& aes::test::benchmark::state::random() noexcept
+{
+   return random_;
+}
+
+AES_TEST_INLINE void aes::test::benchmark::state::record(double ns) noexcept
+{
+   elapsed_ns_ += ns;
+   measured_ = true;
+}
+
+AES_TEST_INLINE bool aes::test::benchmark::state::measured() const noexcept
+{
+   return measured_;
+}
+
+AES_TEST_INLINE double aes::test::benchmark::state::elapsed_ns() const noexcept
+{
+   return elapsed_ns_;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// benchmark functions implementation
+
+namespace aes
+{
+   namespace test
+   {
+      namespace benchmark
+      {
+         namespace detail
+         {
+            inline double curve(complexity order, double n) noexcept
+            {
+               switch (order)
+               {
+               case complexity::constant: return 1.0;
+               case complexity::logarithmic: return std::log2(n);
+               case complexity::linear: return n;
+               case complexity::linearithmic: return n * std::log2(n);
+               case complexity::quadratic: return n * n;
+               }
+               return 1.0;
+            }
+         }
+      }
+   }
+}
+
+AES_TEST_INLINE aes::test::benchmark::options& aes::test::benchmark::settings() noexcept
+{
+   static options values = { 0.02, 3, 1000, 2.0, 0.05, -1, 5, 0.05, 0.2, 3.5 };
+   return values;
+}
+
+AES_TEST_INLINE const char* aes::test::benchmark::name(complexity order) noexcept
+{
+   switch (order)
+   {
+   case complexity::constant: return "O(1)";
+   case complexity::logarithmic: return "O(log n)";
+   case complexity::linear: return "O(n)";
+   case complexity::linearithmic: return "O(n log n)";
+   case complexity::quadratic: return "O(n^2)";
+   }
+   return "O(?)";
+}
+
+AES_TEST_INLINE std::vector<uint64_t> aes::test::benchmark::sizes(uint64_t first, uint64_t last, double multiplier)
+{
+   std::vector<uint64_t> values;
+   double size = double(std::max<uint64_t>(first, 1));
+   while (uint64_t(size) <= last)
+   {
+      if (values.empty() || uint64_t(size) != values.back())
+      {
+         values.push_back(uint64_t(size));
+      }
+      size *= std::max(multiplier, 1.01);
+   }
+   if (values.empty() || values.back() != last)
+   {
+      values.push_back(last);
+   }
+   return values;
+}
+
+AES_TEST_INLINE aes::test::benchmark::fit aes::test::benchmark::fit_to(const std::vector<sample>& samples, complexity order) noexcept
+{
+   // Least squares of the relative residuals (y - c * f(n)) / y: c = sum(f / y) / sum((f / y)^2).
+   double ratios = 0.0;
+   double squares = 0.0;
+   for (const sample& s : samples)
+   {
+      double ratio = s.ns_ > 0.0 ? detail::curve(order, double(s.size_)) / s.ns_ : 0.0;
+      ratios += ratio;
+      squares += ratio * ratio;
+   }
+   double coefficient = squares > 0.0 ? ratios / squares : 0.0;
+
+   double residuals = 0.0;
+   for (const sample& s : samples)
+   {
+      double residual = s.ns_ > 0.0 ? 1.0 - coefficient * detail::curve(order, double(s.size_)) / s.ns_ : 0.0;
+      residuals += residual * residual;
+   }
+   return fit{ order, coefficient, std::sqrt(residuals / double(std::max<size_t>(samples.size(), 1))) };
+}
+
+AES_TEST_INLINE aes::test::benchmark::fit aes::test::benchmark::best_fit(const std::vector<sample>& samples) noexcept
+{
+   static const complexity orders[] = { complexity::constant, complexity::logarithmic, complexity::linear, complexity::linearithmic, complexity::quadratic };
+   fit fits[sizeof(orders) / sizeof(orders[0])];
+   double best = 0.0;
+
+   for (size_t i = 0; i < sizeof(orders) / sizeof(orders[0]); i++)
+   {
+      fits[i] = fit_to(samples, orders[i]);
+      best = i == 0 || fits[i].rms_ < best ? fits[i].rms_ : best;
+   }
+   for (const fit& candidate : fits)
+   {
+      if (candidate.rms_ <= best + settings().tolerance_)
+      {
+         return candidate;
+      }
+   }
+   return fits[0];
+}
+
+AES_TEST_INLINE bool aes::test::benchmark::is_steady(const std::vector<double>& runs) noexcept
+{
+   size_t window = std::max<size_t>(settings().window_, 2);
+   if (runs.size() < window)
+   {
+      return false;
+   }
+
+   std::vector<double>::const_iterator first = runs.end() - static_cast<ptrdiff_t>(window);
+   double low = *std::min_element(first, runs.end());
+   double high = *std::max_element(first, runs.end());
+   return high - low <= low * settings().steady_;
+}
+
+AES_TEST_INLINE aes::test::benchmark::statistics aes::test::benchmark::robust(std::vector<double> runs)
+{
+   if (runs.empty())
+   {
+      return statistics{ 0.0, 0.0, 0.0, 0, 0 };
+   }
+
+   std::vector<double> sorted(runs);
+   std::sort(sorted.begin(), sorted.end());
+   double median = sorted[sorted.size() / 2];
+   for (double& run : sorted)
+   {
+      run = std::fabs(run - median);
+   }
+   std::sort(sorted.begin(), sorted.end());
+   double deviation = sorted[sorted.size() / 2];
+
+   // Modified z-score of Iglewicz and Hoaglin, 0.6745 makes the deviation comparable to a standard deviation.
+   double total = 0.0;
+   double fastest = median;
+   size_t kept = 0;
+   for (double run : runs)
+   {
+      if (deviation == 0.0 ? run == median : 0.6745 * std::fabs(run - median) / deviation <= settings().outlier_threshold_)
+      {
+         total += run;
+         fastest = std::min(fastest, run);
+         kept++;
+      }
+   }
+   return statistics{ median, kept ? total / double(kept) : median, fastest, kept, runs.size() - kept };
+}
+
+namespace aes
+{
+   namespace test
+   {
+      namespace benchmark
+      {
+         namespace detail
+         {
+            inline std::string read_first_line(const std::string& path)
+            {
+               std::ifstream file(path);
+               std::string line;
+               std::getline(file, line);
+               return line;
+            }
+
+            inline std::string cpu_model()
+            {
+               std::ifstream file("/proc/cpuinfo");
+               std::string line;
+               while (std::getline(file, line))
+               {
+                  if (line.compare(0, 10, "model name") == 0 || line.compare(0, 9, "Processor") == 0)
+                  {
+                     size_t colon = line.find(':');
+                     size_t begin = colon == std::string::npos ? std::string::npos : line.find_first_not_of(' ', colon + 1);
+                     return begin == std::string::npos ? "unknown" : line.substr(begin);
+                  }
+               }
+               return "unknown";
+            }
+
+            inline std::string turbo_state()
+            {
+               std::string no_turbo(read_first_line("/sys/devices/system/cpu/intel_pstate/no_turbo"));
+               if (!no_turbo.empty())
+               {
+                  return no_turbo == "1" ? "off" : "on";
+               }
+               std::string boost(read_first_line("/sys/devices/system/cpu/cpufreq/boost"));
+               return boost.empty() ? "unknown" : boost == "1" ? "on" : "off";
+            }
+
+            inline std::string compiler_flags()
+            {
+               // The flags seen by the code of the framework, in library mode those of the runtime.
+               std::string flags;
+#if defined(AES_TEST_COMPILE_FLAGS)
+               flags += AES_TEST_COMPILE_FLAGS " ";
+#endif
+#if defined(__OPTIMIZE__)
+               flags += "optimized ";
+#endif
+#if defined(NDEBUG)
+               flags += "NDEBUG ";
+#endif
+#if defined(__SANITIZE_ADDRESS__)
+               flags += "asan ";
+#endif
+#if defined(__AVX512F__)
+               flags += "avx512 ";
+#elif defined(__AVX2__)
+               flags += "avx2 ";
+#elif defined(__SSE4_2__)
+               flags += "sse4.2 ";
+#elif defined(__ARM_NEON)
+               flags += "neon ";
+#endif
+               return flags.empty() ? "none" : flags.substr(0, flags.size() - 1);
+            }
+
+            inline void measure_timer(double& resolution, double& overhead)
+            {
+               // The resolution is the smallest step the clock takes, the overhead the cost of reading it.
+               const int reads = 10000;
+               double smallest = 0.0;
+               std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+               std::chrono::steady_clock::time_point last = start;
+               for (int i = 0; i < reads; i++)
+               {
+                  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                  double step = std::chrono::duration<double, std::nano>(now - last).count();
+                  smallest = step > 0.0 && (smallest == 0.0 || step < smallest) ? step : smallest;
+                  last = now;
+               }
+               resolution = smallest;
+               overhead = std::chrono::duration<double, std::nano>(last - start).count() / reads;
+            }
+         }
+      }
+   }
+}
+
+AES_TEST_INLINE const aes::test::benchmark::environment& aes::test::benchmark::host()
+{
+   static const environment values = []()
+   {
+      environment captured{ detail::cpu_model(), std::thread::hardware_concurrency(), "unknown", "unknown", detail::compiler_flags(), "unknown", detail::turbo_state(), 0.0, 0.0 };
+#if defined(__unix__) || defined(__APPLE__)
+      struct utsname names = {};
+      if (::uname(&names) == 0)
+      {
+         captured.kernel_ = std::string(names.sysname) + " " + names.release + " " + names.machine;
+      }
+#endif
+#if defined(__clang__)
+      captured.compiler_ = "clang " __clang_version__;
+#elif defined(__GNUC__)
+      captured.compiler_ = "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+      captured.compiler_ = "msvc " + std::to_string(_MSC_FULL_VER);
+#endif
+      std::string governor(detail::read_first_line("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor"));
+      captured.governor_ = governor.empty() ? "unknown" : governor;
+      detail::measure_timer(captured.timer_resolution_ns_, captured.timer_overhead_ns_);
+      return captured;
+   }();
+   return values;
+}
+
+AES_TEST_INLINE std::string aes::test::benchmark::fingerprint(const environment& values)
+{
+   // FNV-1a of what makes two results comparable, not of what changes between two runs.
+   static const char digits[] = "0123456789abcdef";
+   std::string identity(values.cpu_model_ + "|" + std::to_string(values.cores_) + "|" + values.kernel_ + "|" + values.compiler_ + "|" + values.flags_);
+   uint64_t hash = 14695981039346656037ULL;
+   for (char c : identity)
+   {
+      hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+   }
+
+   std::string text(16, '0');
+   for (size_t i = 0; i < 16; i++)
+   {
+      text[15 - i] = digits[(hash >> (4 * i)) & 0xf];
+   }
+   return text;
+}
+
+AES_TEST_INLINE std::string aes::test::benchmark::describe(const environment& values)
+{
+   return "fingerprint " + fingerprint(values) +
+          ", cpu " + values.cpu_model_ + " x " + std::to_string(values.cores_) +
+          ", kernel " + values.kernel_ +
+          ", compiler " + values.compiler_ + " (" + values.flags_ + ")" +
+          ", governor " + values.governor_ +
+          ", turbo " + values.turbo_ +
+          ", timer " + std::to_string(static_cast<long long>(values.timer_resolution_ns_ + 0.5)) + "ns" +
+          " read in " + std::to_string(static_cast<long long>(values.timer_overhead_ns_ + 0.5)) + "ns";
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// pinned_thread class implementation
+
+AES_TEST_INLINE aes::test::benchmark::pinned_thread::pinned_thread(int cpu) noexcept
+   : pinned_(false)
+{
+#if defined(__linux__)
+   CPU_ZERO(&previous_);
+   if (cpu >= 0 && cpu < CPU_SETSIZE && ::pthread_getaffinity_np(::pthread_self(), sizeof(previous_), &previous_) == 0)
+   {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(cpu, &cpus);
+      pinned_ = ::pthread_setaffinity_np(::pthread_self(), sizeof(cpus), &cpus) == 0;
+   }
+#else
+   (void)cpu;
+#endif
+}
+
+AES_TEST_INLINE aes::test::benchmark::pinned_thread::~pinned_thread() noexcept
+{
+#if defined(__linux__)
+   if (pinned_)
+   {
+      ::pthread_setaffinity_np(::pthread_self(), sizeof(previous_), &previous_);
+   }
+#endif
+}
+
+AES_TEST_INLINE bool aes::test::benchmark::pinned_thread::pinned() const noexcept
+{
+   return pinned_;
+}
+#endif
@@ -0,0 +1,42 @@
+/****
+ * Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////////
+// Header only and library modes
+//
+// By default the framework is header only: every function is defined inline in
+// the headers. When AES_TEST_LIBRARY is defined, the test files only see the
+// declarations of the non template runtime and the common template instantiations
+// are declared extern; both are compiled once into the cpp_test_runtime library,
+// which is built with AES_TEST_BUILD_LIBRARY. All the files of a test binary must
+// be compiled in the same mode.
+
+#if defined(AES_TEST_BUILD_LIBRARY) && !defined(AES_TEST_LIBRARY)
+#define AES_TEST_LIBRARY
+#endif
+
+#if !defined(AES_TEST_LIBRARY) || defined(AES_TEST_BUILD_LIBRARY)
+#define AES_TEST_IMPLEMENTATION
+#endif
+
+#if defined(AES_TEST_BUILD_LIBRARY)
+#define AES_TEST_INLINE
+#else
+#define AES_TEST_INLINE inline
+#endif
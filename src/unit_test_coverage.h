@@ -0,0 +1,101 @@
+/****
+ * Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "unit_test_config.h"
+#include <string>
+#include <cstdlib>
+
+///////////////////////////////////////////////////////////////////////////////////
+// Per test coverage
+//
+// When the tests are built with gcov instrumentation and AES_TEST_COVERAGE is
+// defined, the counters are reset before each test and dumped after it under a
+// directory of its own. gcov writes the data files under GCOV_PREFIX followed by
+// the absolute path of the object file, so each test gets a full copy of the tree
+// of .gcda files, which cpp_test_coverage turns into a test to line map.
+//
+// The gcov entry points must be linked in strongly: a weak reference does not pull
+// them out of the static gcov library.
+
+#if defined(AES_TEST_COVERAGE)
+extern "C" void __gcov_reset(void);
+extern "C" void __gcov_dump(void);
+#endif
+
+namespace aes
+{
+   namespace test
+   {
+      namespace coverage
+      {
+         bool available() noexcept;
+         void reset() noexcept;
+         bool dump(const std::string& prefix) noexcept;
+      }
+   }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// coverage functions implementation
+
+#if defined(AES_TEST_IMPLEMENTATION)
+AES_TEST_INLINE bool aes::test::coverage::available() noexcept
+{
+#if defined(AES_TEST_COVERAGE)
+   return true;
+#else
+   return false;
+#endif
+}
+
+AES_TEST_INLINE void aes::test::coverage::reset() noexcept
+{
+#if defined(AES_TEST_COVERAGE)
+   __gcov_reset();
+#endif
+}
+
+AES_TEST_INLINE bool aes::test::coverage::dump(const std::string& prefix) noexcept
+{
+#if defined(AES_TEST_COVERAGE)
+   const char* previous = std::getenv("GCOV_PREFIX");
+   std::string saved(previous ? previous : "");
+
+   // gcov reads the prefix on every dump, the one of the process is restored right after.
+   if (::setenv("GCOV_PREFIX", prefix.c_str(), 1) != 0)
+   {
+      return false;
+   }
+   __gcov_dump();
+   if (previous)
+   {
+      ::setenv("GCOV_PREFIX", saved.c_str(), 1);
+   }
+   else
+   {
+      ::unsetenv("GCOV_PREFIX");
+   }
+   return true;
+#else
+   (void)prefix;
+   return false;
+#endif
+}
+#endif
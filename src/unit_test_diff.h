@@ -0,0 +1,604 @@
+/****
+ * Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "unit_test_config.h"
+#include "unit_test_format.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#if defined(AES_TEST_IMPLEMENTATION)
+#include <cstring>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////
+// Differences of the failed assertions
+//
+// Two long strings or vectors that are not equal are reported as a unified diff
+// instead of being written whole. Strings with several lines are compared line
+// by line, other strings character by character and vectors element by element.
+//
+// The edit script comes from the linear space variant of the Myers O(ND)
+// algorithm: the middle of the shortest path is found by searching from both ends
+// and both halves are solved again, in memory proportional to the inputs. The
+// common prefix and suffix are trimmed first, so inputs differing in a few places
+// cost little more than a scan. The search gives up past settings().max_cost_
+// diagonals and reports what is left as replaced, and the diff written is cut at
+// settings().max_output_ characters.
+
+namespace aes
+{
+   namespace test
+   {
+      namespace diff
+      {
+         struct options
+         {
+            size_t context_;                // unchanged units around every hunk
+            size_t max_output_;             // characters of diff in a message
+            size_t max_cost_;               // diagonals searched before giving up on a minimal script
+            size_t min_string_length_;      // shorter strings on one line are written whole
+            size_t min_elements_;           // shorter vectors are written whole
+         };
+
+         options& settings() noexcept;
+
+         enum class operation
+         {
+            equal,
+            remove,
+            insert
+         };
+
+         struct edit
+         {
+            operation operation_;
+            size_t expected_;               // first unit of the run in the expected sequence
+            size_t actual_;                 // first unit of the run in the actual sequence
+            size_t length_;
+         };
+
+         struct hunk
+         {
+            size_t first_;                  // first and last edit of the hunk
+            size_t last_;
+            size_t leading_;                // context before and after
+            size_t trailing_;
+         };
+
+         template <typename _TEqual>
+         std::vector<edit> compute(size_t expected_size, size_t actual_size, _TEqual equal);
+         std::vector<hunk> hunks(const std::vector<edit>& edits, size_t context);
+
+         template <typename T>
+         bool applies(const T& expected, const T& actual) noexcept;
+         bool applies(const std::string& expected, const std::string& actual) noexcept;
+         template <typename T, typename _TAllocator>
+         bool applies(const std::vector<T, _TAllocator>& expected, const std::vector<T, _TAllocator>& actual) noexcept;
+
+         template <typename T>
+         void append(format::buffer& out, const T& expected, const T& actual);
+         void append(format::buffer& out, const std::string& expected, const std::string& actual);
+         template <typename T, typename _TAllocator>
+         void append(format::buffer& out, const std::vector<T, _TAllocator>& expected, const std::vector<T, _TAllocator>& actual);
+      }
+   }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// diff functions implementation
+
+namespace aes
+{
+   namespace test
+   {
+      namespace diff
+      {
+         namespace detail
+         {
+            template <typename _TEqual>
+            class myers
+            {
+            public:
+               myers(_TEqual& equal, size_t budget) noexcept;
+               myers(const myers&) = delete;
+               ~myers() noexcept = default;
+
+            public:
+               myers& operator=(const myers&) = delete;
+
+            public:
+               void run(size_t expected_begin, size_t expected_end, size_t actual_begin, size_t actual_end, std::vector<edit>& edits);
+
+            private:
+               bool split(size_t expected_begin, size_t expected_end, size_t actual_begin, size_t actual_end, size_t& x, size_t& y);
+               static void add(std::vector<edit>& edits, operation op, size_t expected, size_t actual, size_t length);
+
+            private:
+               _TEqual& equal_;
+               size_t budget_;
+               std::vector<ptrdiff_t> forward_;
+               std::vector<ptrdiff_t> backward_;
+            };
+
+            void append_header(format::buffer& out, const std::vector<edit>& edits, const hunk& part);
+            bool append_truncated(format::buffer& out, size_t start, size_t shown, size_t total);
+
+            // Writes the hunks one unit per line, unit(out, from_expected, index) writes a unit.
+            template <typename _TUnit>
+            void append_lines(format::buffer& out, const std::vector<edit>& edits, _TUnit unit)
+            {
+               std::vector<hunk> parts(hunks(edits, settings().context_));
+               size_t start = out.size();
+
+               for (size_t i = 0; i < parts.size(); i++)
+               {
+                  const hunk& part = parts[i];
+                  append_header(out, edits, part);
+
+                  size_t leading = edits[part.first_].expected_ - part.leading_;
+                  for (size_t index = leading; index < edits[part.first_].expected_; index++)
+                  {
+                     out.append("\n ", 2);
+                     unit(out, true, index);
+                  }
+                  for (size_t e = part.first_; e <= part.last_; e++)
+                  {
+                     for (size_t offset = 0; offset < edits[e].length_; offset++)
+                     {
+                        if (append_truncated(out, start, i, parts.size()))
+                        {
+                           return;
+                        }
+                        switch (edits[e].operation_)
+                        {
+                        case operation::equal: out.append("\n ", 2); unit(out, true, edits[e].expected_ + offset); break;
+                        case operation::remove: out.append("\n-", 2); unit(out, true, edits[e].expected_ + offset); break;
+                        case operation::insert: out.append("\n+", 2); unit(out, false, edits[e].actual_ + offset); break;
+                        }
+                     }
+                  }
+                  size_t trailing = edits[part.last_ + 1 < edits.size() ? part.last_ + 1 : part.last_].expected_;
+                  for (size_t index = trailing; index < trailing + part.trailing_; index++)
+                  {
+                     out.append("\n ", 2);
+                     unit(out, true, index);
+                  }
+                  if (i + 1 < parts.size() && append_truncated(out, start, i + 1, parts.size()))
+                  {
+                     return;
+                  }
+               }
+            }
+         }
+      }
+   }
+}
+
+template <typename _TEqual>
+inline aes::test::diff::detail::myers<_TEqual>::myers(_TEqual& equal, size_t budget) noexcept
+   : equal_(equal)
+   , budget_(budget)
+   , forward_()
+   , backward_()
+{
+}
+
+template <typename _TEqual>
+inline void aes::test::diff::detail::myers<_TEqual>::run(size_t expected_begin, size_t expected_end, size_t actual_begin, size_t actual_end, std::vector<edit>& edits)
+{
+   size_t prefix = 0;
+   while (expected_begin + prefix < expected_end && actual_begin + prefix < actual_end && equal_(expected_begin + prefix, actual_begin + prefix))
+   {
+      prefix++;
+   }
+   add(edits, operation::equal, expected_begin, actual_begin, prefix);
+   expected_begin += prefix;
+   actual_begin += prefix;
+
+   size_t suffix = 0;
+   while (expected_end - suffix > expected_begin && actual_end - suffix > actual_begin && equal_(expected_end - suffix - 1, actual_end - suffix - 1))
+   {
+      suffix++;
+   }
+   expected_end -= suffix;
+   actual_end -= suffix;
+
+   size_t x = 0;
+   size_t y = 0;
+   if (expected_begin == expected_end || actual_begin == actual_end ||
+       !split(expected_begin, expected_end, actual_begin, actual_end, x, y) ||
+       (x == 0 && y == 0) || (expected_begin + x == expected_end && actual_begin + y == actual_end))
+   {
+      add(edits, operation::remove, expected_begin, actual_begin, expected_end - expected_begin);
+      add(edits, operation::insert, expected_end, actual_begin, actual_end - actual_begin);
+   }
+   else
+   {
+      run(expected_begin, expected_begin + x, actual_begin, actual_begin + y, edits);
+      run(expected_begin + x, expected_end, actual_begin + y, actual_end, edits);
+   }
+
+   add(edits, operation::equal, expected_end, actual_end, suffix);
+}
+
+template <typename _TEqual>
+inline bool aes::test::diff::detail::myers<_TEqual>::split(size_t expected_begin, size_t expected_end, size_t actual_begin, size_t actual_end, size_t& x, size_t& y)
+{
+   // Both searches advance one edit at a time, from the top left and from the bottom right
+   // corner; the first point one of them reaches on a diagonal the other has passed lies on
+   // a shortest path.
+   const ptrdiff_t n = static_cast<ptrdiff_t>(expected_end - expected_begin);
+   const ptrdiff_t m = static_cast<ptrdiff_t>(actual_end - actual_begin);
+   const ptrdiff_t max_d = (n + m + 1) / 2;
+   const ptrdiff_t offset = max_d + 1;
+   const ptrdiff_t delta = n - m;
+   const bool front = (delta & 1) != 0;
+
+   forward_.assign(static_cast<size_t>(2 * offset + 1), -1);
+   backward_.assign(static_cast<size_t>(2 * offset + 1), -1);
+   ptrdiff_t* v1 = forward_.data() + offset;
+   ptrdiff_t* v2 = backward_.data() + offset;
+   v1[1] = 0;
+   v2[1] = 0;
+
+   // Diagonals that left the grid are skipped in the next rounds.
+   ptrdiff_t k1_start = 0;
+   ptrdiff_t k1_end = 0;
+   ptrdiff_t k2_start = 0;
+   ptrdiff_t k2_end = 0;
+
+   for (ptrdiff_t d = 0; d < max_d; d++)
+   {
+      if (budget_ < static_cast<size_t>(2 * d + 2))
+      {
+         budget_ = 0;
+         return false;
+      }
+      budget_ -= static_cast<size_t>(2 * d + 2);
+
+      for (ptrdiff_t k1 = -d + k1_start; k1 <= d - k1_end; k1 += 2)
+      {
+         ptrdiff_t x1 = (k1 == -d || (k1 != d && v1[k1 - 1] < v1[k1 + 1])) ? v1[k1 + 1] : v1[k1 - 1] + 1;
+         ptrdiff_t y1 = x1 - k1;
+         while (x1 < n && y1 < m && equal_(expected_begin + static_cast<size_t>(x1), actual_begin + static_cast<size_t>(y1)))
+         {
+            x1++;
+            y1++;
+         }
+         v1[k1] = x1;
+
+         if (x1 > n)
+         {
+            k1_end += 2;
+         }
+         else if (y1 > m)
+         {
+            k1_start += 2;
+         }
+         else if (front)
+         {
+            ptrdiff_t k2 = delta - k1;
+            if (k2 >= -offset && k2 <= offset && v2[k2] != -1 && x1 >= n - v2[k2])
+            {
+               x = static_cast<size_t>(x1);
+               y = static_cast<size_t>(y1);
+               return true;
+            }
+         }
+      }
+
+      for (ptrdiff_t k2 = -d + k2_start; k2 <= d - k2_end; k2 += 2)
+      {
+         ptrdiff_t x2 = (k2 == -d || (k2 != d && v2[k2 - 1] < v2[k2 + 1])) ? v2[k2 + 1] : v2[k2 - 1] + 1;
+         ptrdiff_t y2 = x2 - k2;
+         while (x2 < n && y2 < m && equal_(expected_end - 1 - static_cast<size_t>(x2), actual_end - 1 - static_cast<size_t>(y2)))
+         {
+            x2++;
+            y2++;
+         }
+         v2[k2] = x2;
+
+         if (x2 > n)
+         {
+            k2_end += 2;
+         }
+         else if (y2 > m)
+         {
+            k2_start += 2;
+         }
+         else if (!front)
+         {
+            ptrdiff_t k1 = delta - k2;
+            if (k1 >= -offset && k1 <= offset && v1[k1] != -1 && v1[k1] >= n - x2)
+            {
+               x = static_cast<size_t>(v1[k1]);
+               y = static_cast<size_t>(v1[k1] - k1);
+               return true;
+            }
+         }
+      }
+   }
+   return false;
+}
+
+template <typename _TEqual>
+inline void aes::test::diff::detail::myers<_TEqual>::add(std::vector<edit>& edits, operation op, size_t expected, size_t actual, size_t length)
+{
+   if (length == 0)
+   {
+      return;
+   }
+   if (!edits.empty() && edits.back().operation_ == op)
+   {
+      edits.back().length_ += length;
+      return;
+   }
+   if (op == operation::remove && !edits.empty() && edits.back().operation_ == operation::insert)
+   {
+      // The removals of a change go before its insertions, as diff writes them.
+      edit inserted = edits.back();
+      edits.pop_back();
+      add(edits, op, expected, inserted.actual_, length);
+      inserted.expected_ = expected + length;
+      edits.push_back(inserted);
+      return;
+   }
+   edits.push_back(edit{ op, expected, actual, length });
+}
+
+template <typename _TEqual>
+inline std::vector<aes::test::diff::edit> aes::test::diff::compute(size_t expected_size, size_t actual_size, _TEqual equal)
+{
+   std::vector<edit> edits;
+   detail::myers<_TEqual> search(equal, settings().max_cost_);
+   search.run(0, expected_size, 0, actual_size, edits);
+   return edits;
+}
+
+template <typename T>
+inline bool aes::test::diff::applies(const T&, const T&) noexcept
+{
+   return false;
+}
+
+template <typename T, typename _TAllocator>
+inline bool aes::test::diff::applies(const std::vector<T, _TAllocator>& expected, const std::vector<T, _TAllocator>& actual) noexcept
+{
+   // Equal values have no difference to show, a failed Not equal writes them whole.
+   return std::max(expected.size(), actual.size()) >= settings().min_elements_ && !(expected == actual);
+}
+
+template <typename T>
+inline void aes::test::diff::append(format::buffer&, const T&, const T&)
+{
+}
+
+template <typename T, typename _TAllocator>
+inline void aes::test::diff::append(format::buffer& out, const std::vector<T, _TAllocator>& expected, const std::vector<T, _TAllocator>& actual)
+{
+   std::vector<edit> edits(compute(expected.size(), actual.size(), [&](size_t e, size_t a) { return bool(expected[e] == actual[a]); }));
+   detail::append_lines(out, edits, [&](format::buffer& line, bool from_expected, size_t index)
+   {
+      format::append(line, from_expected ? expected[index] : actual[index]);
+   });
+}
+
+#if defined(AES_TEST_IMPLEMENTATION)
+AES_TEST_INLINE aes::test::diff::options& aes::test::diff::settings() noexcept
+{
+   static options values = { 3, 4096, 16 * 1024 * 1024, 64, 8 };
+   return values;
+}
+
+AES_TEST_INLINE std::vector<aes::test::diff::hunk> aes::test::diff::hunks(const std::vector<edit>& edits, size_t context)
+{
+   // A run of equal units short enough to be the context of both of its neighbours joins their hunks.
+   std::vector<hunk> parts;
+   size_t i = 0;
+   while (i < edits.size())
+   {
+      if (edits[i].operation_ == operation::equal)
+      {
+         i++;
+         continue;
+      }
+
+      size_t last = i;
+      for (size_t j = i + 1; j < edits.size(); j++)
+      {
+         if (edits[j].operation_ != operation::equal)
+         {
+            last = j;
+         }
+         else if (j + 1 == edits.size() || edits[j].length_ > 2 * context)
+         {
+            break;
+         }
+      }
+
+      size_t leading = i > 0 ? std::min(context, edits[i - 1].length_) : 0;
+      size_t trailing = last + 1 < edits.size() ? std::min(context, edits[last + 1].length_) : 0;
+      parts.push_back(hunk{ i, last, leading, trailing });
+      i = last + 1;
+   }
+   return parts;
+}
+
+AES_TEST_INLINE bool aes::test::diff::applies(const std::string& expected, const std::string& actual) noexcept
+{
+   return (std::max(expected.size(), actual.size()) >= settings().min_string_length_ ||
+           expected.find('\n') != std::string::npos || actual.find('\n') != std::string::npos) &&
+          expected != actual;
+}
+
+namespace aes
+{
+   namespace test
+   {
+      namespace diff
+      {
+         namespace detail
+         {
+            struct line
+            {
+               size_t begin_;
+               size_t size_;
+               uint64_t hash_;
+            };
+
+            inline std::vector<line> split_lines(const std::string& text)
+            {
+               std::vector<line> lines;
+               size_t begin = 0;
+               while (true)
+               {
+                  size_t end = text.find('\n', begin);
+                  size_t size = (end == std::string::npos ? text.size() : end) - begin;
+
+                  // FNV-1a, the lines compare by hash first.
+                  uint64_t hash = 14695981039346656037ULL;
+                  for (size_t i = begin; i < begin + size; i++)
+                  {
+                     hash = (hash ^ static_cast<unsigned char>(text[i])) * 1099511628211ULL;
+                  }
+                  lines.push_back(line{ begin, size, hash });
+
+                  if (end == std::string::npos)
+                  {
+                     return lines;
+                  }
+                  begin = end + 1;
+               }
+            }
+
+            inline void append_range(format::buffer& out, size_t begin, size_t count)
+            {
+               // Ranges are 1 based as in diff, an empty range is written after the unit before it.
+               format::append_integer(out, static_cast<unsigned long long>(count ? begin + 1 : begin));
+               out.append(',');
+               format::append_integer(out, static_cast<unsigned long long>(count));
+            }
+
+            inline void append_characters(format::buffer& out, const std::string& expected, const std::string& actual, const std::vector<edit>& edits)
+            {
+               std::vector<hunk> parts(hunks(edits, settings().context_));
+               size_t start = out.size();
+
+               for (size_t i = 0; i < parts.size(); i++)
+               {
+                  const hunk& part = parts[i];
+                  append_header(out, edits, part);
+                  out.append("\n ", 2);
+
+                  size_t leading = edits[part.first_].expected_ - part.leading_;
+                  format::append_string(out, expected.data() + leading, part.leading_);
+                  for (size_t e = part.first_; e <= part.last_; e++)
+                  {
+                     switch (edits[e].operation_)
+                     {
+                     case operation::equal:
+                        format::append_string(out, expected.data() + edits[e].expected_, edits[e].length_);
+                        break;
+                     case operation::remove:
+                        out.append("[-", 2);
+                        format::append_string(out, expected.data() + edits[e].expected_, edits[e].length_);
+                        out.append("-]", 2);
+                        break;
+                     case operation::insert:
+                        out.append("{+", 2);
+                        format::append_string(out, actual.data() + edits[e].actual_, edits[e].length_);
+                        out.append("+}", 2);
+                        break;
+                     }
+                  }
+                  if (part.trailing_)
+                  {
+                     format::append_string(out, expected.data() + edits[part.last_ + 1].expected_, part.trailing_);
+                  }
+                  if (i + 1 < parts.size() && append_truncated(out, start, i + 1, parts.size()))
+                  {
+                     return;
+                  }
+               }
+            }
+         }
+      }
+   }
+}
+
+AES_TEST_INLINE void aes::test::diff::detail::append_header(format::buffer& out, const std::vector<edit>& edits, const hunk& part)
+{
+   const edit& first = edits[part.first_];
+   const edit& last = edits[part.last_];
+   size_t expected_begin = first.expected_ - part.leading_;
+   size_t actual_begin = first.actual_ - part.leading_;
+   size_t expected_end = last.expected_ + (last.operation_ != operation::insert ? last.length_ : 0) + part.trailing_;
+   size_t actual_end = last.actual_ + (last.operation_ != operation::remove ? last.length_ : 0) + part.trailing_;
+
+   out.append("\n@@ -", 5);
+   append_range(out, expected_begin, expected_end - expected_begin);
+   out.append(" +", 2);
+   append_range(out, actual_begin, actual_end - actual_begin);
+   out.append(" @@", 3);
+}
+
+AES_TEST_INLINE bool aes::test::diff::detail::append_truncated(format::buffer& out, size_t start, size_t shown, size_t total)
+{
+   if (out.size() - start < settings().max_output_)
+   {
+      return false;
+   }
+
+   out.append("\n...(diff truncated, ");
+   format::append_integer(out, static_cast<unsigned long long>(total - shown));
+   out.append(" of ");
+   format::append_integer(out, static_cast<unsigned long long>(total));
+   out.append(" hunks not shown)");
+   return true;
+}
+
+AES_TEST_INLINE void aes::test::diff::append(format::buffer& out, const std::string& expected, const std::string& actual)
+{
+   if (expected.find('\n') == std::string::npos && actual.find('\n') == std::string::npos)
+   {
+      std::vector<edit> edits(compute(expected.size(), actual.size(), [&](size_t e, size_t a) { return expected[e] == actual[a]; }));
+      detail::append_characters(out, expected, actual, edits);
+      return;
+   }
+
+   std::vector<detail::line> expected_lines(detail::split_lines(expected));
+   std::vector<detail::line> actual_lines(detail::split_lines(actual));
+   std::vector<edit> edits(compute(expected_lines.size(), actual_lines.size(), [&](size_t e, size_t a)
+   {
+      const detail::line& left = expected_lines[e];
+      const detail::line& right = actual_lines[a];
+      return left.hash_ == right.hash_ && left.size_ == right.size_ &&
+             std::memcmp(expected.data() + left.begin_, actual.data() + right.begin_, left.size_) == 0;
+   }));
+   detail::append_lines(out, edits, [&](format::buffer& line, bool from_expected, size_t index)
+   {
+      const detail::line& unit = from_expected ? expected_lines[index] : actual_lines[index];
+      format::append_string(line, (from_expected ? expected : actual).data() + unit.begin_, unit.size_);
+   });
+}
+#endif
@@ -0,0 +1,559 @@
+/****
+ * Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "unit_test_config.h"
+#if defined(__unix__) || defined(__APPLE__)
+#define AES_TEST_DISTRIBUTED
+
+#include "unit_test_topology.h"
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+///////////////////////////////////////////////////////////////////////////////////
+// Distributed test runs
+//
+// A coordinator hands the tests of the suite out to workers, one at a time, over a
+// TCP or a Unix socket. Workers are the same test binary, started locally by the
+// coordinator or by hand on other hosts. The protocol is line based:
+//
+//    worker      -> coordinator : NODE <node>, once before the first NEXT of a placed worker
+//    worker      -> coordinator : LOG <path>, once before the first NEXT of a worker writing a result log
+//    worker      -> coordinator : NEXT
+//    coordinator -> worker      : RUN <test index> <test name> | QUIT
+//    worker      -> coordinator : RESULT <passed> <failed> <seconds> <out size> <error size>
+//                                 followed by the captured output and error bytes
+//
+// Addresses are either 'unix:<path>' or '<host>:<port>'. A coordinator listening on every
+// interface hands out the name of its host to the workers.
+
+namespace aes
+{
+   namespace test
+   {
+      namespace distributed
+      {
+         class channel
+         {
+         public:
+            channel(int fd = -1) noexcept;
+            channel(const channel&) = delete;
+            ~channel() noexcept;
+
+         public:
+            channel& operator=(const channel&) = delete;
+
+         public:
+            bool connect(const std::string& address) noexcept;
+            void close() noexcept;
+            bool is_open() const noexcept;
+            int fd() const noexcept;
+            bool send_timeout(std::chrono::milliseconds timeout) noexcept;
+
+         public:
+            bool send(const std::string& data) noexcept;
+            bool receive() noexcept;
+            bool read_line(std::string& line) noexcept;
+            bool read_bytes(size_t size, std::string& data) noexcept;
+
+         private:
+            int fd_;
+            std::string buffer_;
+         };
+
+         class listener
+         {
+         public:
+            listener() noexcept;
+            listener(const listener&) = delete;
+            ~listener() noexcept;
+
+         public:
+            listener& operator=(const listener&) = delete;
+
+         public:
+            bool open(const std::string& address) noexcept;
+            void close() noexcept;
+            int accept() noexcept;
+            int fd() const noexcept;
+            const std::string& address() const noexcept;
+
+         private:
+            int fd_;
+            std::string address_;
+            std::string path_;
+         };
+
+         class process_group
+         {
+         public:
+            process_group() noexcept;
+            process_group(const process_group&) = delete;
+            ~process_group() noexcept;
+
+         public:
+            process_group& operator=(const process_group&) = delete;
+
+         public:
+            bool spawn(const std::vector<std::string>& arguments, unsigned count, const std::vector<aes::test::topology::slot>& placements = {}) noexcept;
+            unsigned running() noexcept;
+            unsigned spawned() const noexcept;
+            void wait() noexcept;
+
+         private:
+            std::vector<pid_t> processes_;
+            unsigned spawned_;
+         };
+
+         bool split_address(const std::string& address, std::string& host, std::string& port);
+         std::string advertised_host(const std::string& host);
+      }
+   }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// address functions implementation
+
+#if defined(AES_TEST_IMPLEMENTATION)
+AES_TEST_INLINE bool aes::test::distributed::split_address(const std::string& address, std::string& host, std::string& port)
+{
+   size_t colon = address.rfind(':');
+   if (colon == std::string::npos || colon + 1 == address.size())
+   {
+      return false;
+   }
+
+   host = address.substr(0, colon);
+   port = address.substr(colon + 1);
+   return true;
+}
+
+// A wildcard host cannot be connected to, the name of the host is handed out when it resolves,
+// the loopback address otherwise.
+AES_TEST_INLINE std::string aes::test::distributed::advertised_host(const std::string& host)
+{
+   if (!host.empty() && host != "0.0.0.0" && host != "::" && host != "[::]")
+   {
+      return host;
+   }
+
+   char name[256] = {};
+   addrinfo hints = {};
+   addrinfo* info = nullptr;
+   hints.ai_socktype = SOCK_STREAM;
+   if (::gethostname(name, sizeof(name) - 1) == 0 && ::getaddrinfo(name, nullptr, &hints, &info) == 0)
+   {
+      ::freeaddrinfo(info);
+      return name;
+   }
+   return "127.0.0.1";
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// channel class implementation
+
+AES_TEST_INLINE aes::test::distributed::channel::channel(int fd) noexcept
+   : fd_(fd)
+   , buffer_()
+{
+}
+
+AES_TEST_INLINE aes::test::distributed::channel::~channel() noexcept
+{
+   close();
+}
+
+AES_TEST_INLINE bool aes::test::distributed::channel::connect(const std::string& address) noexcept
+{
+   close();
+
+   if (address.compare(0, 5, "unix:") == 0)
+   {
+      sockaddr_un addr = {};
+      std::string path = address.substr(5);
+      if (path.size() >= sizeof(addr.sun_path) || (fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+      {
+         return false;
+      }
+
+      addr.sun_family = AF_UNIX;
+      std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+      if (::connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+      {
+         close();
+      }
+      return is_open();
+   }
+
+   std::string host;
+   std::string port;
+   addrinfo hints = {};
+   addrinfo* info = nullptr;
+   hints.ai_family = AF_UNSPEC;
+   hints.ai_socktype = SOCK_STREAM;
+   if (!split_address(address, host, port) || ::getaddrinfo(host.c_str(), port.c_str(), &hints, &info) != 0)
+   {
+      return false;
+   }
+
+   for (addrinfo* it = info; it && fd_ < 0; it = it->ai_next)
+   {
+      if ((fd_ = ::socket(it->ai_family, it->ai_socktype, it->ai_protocol)) >= 0 && ::connect(fd_, it->ai_addr, it->ai_addrlen) != 0)
+      {
+         close();
+      }
+   }
+   ::freeaddrinfo(info);
+
+   if (fd_ >= 0)
+   {
+      // Messages are small and answered right away, so they must not wait for Nagle's algorithm.
+      int one = 1;
+      ::setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+   }
+   return is_open();
+}
+
+AES_TEST_INLINE void aes::test::distributed::channel::close() noexcept
+{
+   if (fd_ >= 0)
+   {
+      ::close(fd_);
+      fd_ = -1;
+   }
+   buffer_.clear();
+}
+
+AES_TEST_INLINE bool aes::test::distributed::channel::is_open() const noexcept
+{
+   return fd_ >= 0;
+}
+
+AES_TEST_INLINE int aes::test::distributed::channel::fd() const noexcept
+{
+   return fd_;
+}
+
+AES_TEST_INLINE bool aes::test::distributed::channel::send_timeout(std::chrono::milliseconds timeout) noexcept
+{
+   // A send blocked longer than the timeout fails, a peer that does not read cannot hang the sender.
+   struct timeval limit = {};
+   limit.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+   limit.tv_usec = static_cast<suseconds_t>((timeout.count() % 1000) * 1000);
+   return fd_ >= 0 && ::setsockopt(fd_, SOL_SOCKET, SO_SNDTIMEO, &limit, sizeof(limit)) == 0;
+}
+
+AES_TEST_INLINE bool aes::test::distributed::channel::send(const std::string& data) noexcept
+{
+#if defined(MSG_NOSIGNAL)
+   const int flags = MSG_NOSIGNAL;
+#else
+   const int flags = 0;
+#endif
+   size_t sent = 0;
+
+   while (fd_ >= 0 && sent < data.size())
+   {
+      ssize_t result = ::send(fd_, data.data() + sent, data.size() - sent, flags);
+      if (result < 0 && errno == EINTR)
+      {
+         continue;
+      }
+      if (result <= 0)
+      {
+         return false;
+      }
+      sent += size_t(result);
+   }
+
+   return fd_ >= 0;
+}
+
+AES_TEST_INLINE bool aes::test::distributed::channel::receive() noexcept
+{
+   char chunk[64 * 1024];
+   ssize_t result = 0;
+
+   do
+   {
+      result = fd_ >= 0 ? ::recv(fd_, chunk, sizeof(chunk), 0) : 0;
+   } while (result < 0 && errno == EINTR);
+
+   if (result <= 0)
+   {
+      return false;
+   }
+
+   buffer_.append(chunk, size_t(result));
+   return true;
+}
+
+AES_TEST_INLINE bool aes::test::distributed::channel::read_line(std::string& line) noexcept
+{
+   size_t end = buffer_.find('\n');
+   if (end == std::string::npos)
+   {
+      return false;
+   }
+
+   line.assign(buffer_, 0, end);
+   buffer_.erase(0, end + 1);
+   return true;
+}
+
+AES_TEST_INLINE bool aes::test::distributed::channel::read_bytes(size_t size, std::string& data) noexcept
+{
+   if (buffer_.size() < size)
+   {
+      return false;
+   }
+
+   data.assign(buffer_, 0, size);
+   buffer_.erase(0, size);
+   return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// listener class implementation
+
+AES_TEST_INLINE aes::test::distributed::listener::listener() noexcept
+   : fd_(-1)
+   , address_()
+   , path_()
+{
+}
+
+AES_TEST_INLINE aes::test::distributed::listener::~listener() noexcept
+{
+   close();
+}
+
+AES_TEST_INLINE bool aes::test::distributed::listener::open(const std::string& address) noexcept
+{
+   close();
+
+   if (address.compare(0, 5, "unix:") == 0)
+   {
+      sockaddr_un addr = {};
+      std::string path = address.substr(5);
+      if (path.size() >= sizeof(addr.sun_path) || (fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+      {
+         return false;
+      }
+
+      addr.sun_family = AF_UNIX;
+      std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+      ::unlink(path.c_str());
+      if (::bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd_, SOMAXCONN) != 0)
+      {
+         close();
+         return false;
+      }
+
+      path_ = path;
+      address_ = address;
+      return true;
+   }
+
+   std::string host;
+   std::string port;
+   addrinfo hints = {};
+   addrinfo* info = nullptr;
+   hints.ai_family = AF_UNSPEC;
+   hints.ai_socktype = SOCK_STREAM;
+   hints.ai_flags = AI_PASSIVE;
+   if (!split_address(address, host, port) || ::getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &info) != 0)
+   {
+      return false;
+   }
+
+   for (addrinfo* it = info; it && fd_ < 0; it = it->ai_next)
+   {
+      int one = 1;
+      if ((fd_ = ::socket(it->ai_family, it->ai_socktype, it->ai_protocol)) >= 0 &&
+          (::setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 || ::bind(fd_, it->ai_addr, it->ai_addrlen) != 0 || ::listen(fd_, SOMAXCONN) != 0))
+      {
+         close();
+      }
+   }
+   ::freeaddrinfo(info);
+
+   if (fd_ < 0)
+   {
+      return false;
+   }
+
+   // Port 0 lets the system pick a free port, the address handed to the workers has the actual one.
+   sockaddr_storage bound = {};
+   socklen_t size = sizeof(bound);
+   char name[NI_MAXHOST] = {};
+   char service[NI_MAXSERV] = {};
+   if (::getsockname(fd_, reinterpret_cast<sockaddr*>(&bound), &size) == 0 &&
+       ::getnameinfo(reinterpret_cast<sockaddr*>(&bound), size, name, sizeof(name), service, sizeof(service), NI_NUMERICHOST | NI_NUMERICSERV) == 0)
+   {
+      address_ = advertised_host(host) + ":" + service;
+   }
+   else
+   {
+      address_ = address;
+   }
+   return true;
+}
+
+AES_TEST_INLINE void aes::test::distributed::listener::close() noexcept
+{
+   if (fd_ >= 0)
+   {
+      ::close(fd_);
+      fd_ = -1;
+   }
+   if (!path_.empty())
+   {
+      ::unlink(path_.c_str());
+      path_.clear();
+   }
+}
+
+AES_TEST_INLINE int aes::test::distributed::listener::accept() noexcept
+{
+   int fd = -1;
+
+   do
+   {
+      fd = fd_ >= 0 ? ::accept(fd_, nullptr, nullptr) : -1;
+   } while (fd < 0 && errno == EINTR);
+
+   if (fd >= 0 && path_.empty())
+   {
+      int one = 1;
+      ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+   }
+   return fd;
+}
+
+AES_TEST_INLINE int aes::test::distributed::listener::fd() const noexcept
+{
+   return fd_;
+}
+
+AES_TEST_INLINE const std::string& aes::test::distributed::listener::address() const noexcept
+{
+   return address_;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// process_group class implementation
+
+AES_TEST_INLINE aes::test::distributed::process_group::process_group() noexcept
+   : processes_()
+   , spawned_(0)
+{
+}
+
+AES_TEST_INLINE aes::test::distributed::process_group::~process_group() noexcept
+{
+   wait();
+}
+
+AES_TEST_INLINE bool aes::test::distributed::process_group::spawn(const std::vector<std::string>& arguments, unsigned count, const std::vector<aes::test::topology::slot>& placements) noexcept
+{
+   for (unsigned i = 0; i < count; ++i)
+   {
+      // A placed worker is told its node, the coordinator keeps the memory-heavy tests of each node apart.
+      std::vector<std::string> worker(arguments);
+      if (i < placements.size())
+      {
+         worker.push_back("--worker-node=" + std::to_string(placements[i].node_));
+      }
+      std::vector<char*> argv;
+      for (const std::string& argument : worker)
+      {
+         argv.push_back(const_cast<char*>(argument.c_str()));
+      }
+      argv.push_back(nullptr);
+
+      pid_t pid = ::fork();
+      if (pid < 0)
+      {
+         return false;
+      }
+      if (pid == 0)
+      {
+         // The affinity and the memory policy are kept by execvp.
+         if (i < placements.size())
+         {
+            aes::test::topology::bind(placements[i]);
+         }
+         ::execvp(argv[0], argv.data());
+         ::_exit(127);
+      }
+      processes_.push_back(pid);
+      ++spawned_;
+   }
+
+   return true;
+}
+
+AES_TEST_INLINE unsigned aes::test::distributed::process_group::running() noexcept
+{
+   processes_.erase(std::remove_if(processes_.begin(), processes_.end(), [](pid_t pid)
+   {
+      int status = 0;
+      return ::waitpid(pid, &status, WNOHANG) != 0;
+   }), processes_.end());
+
+   return unsigned(processes_.size());
+}
+
+AES_TEST_INLINE unsigned aes::test::distributed::process_group::spawned() const noexcept
+{
+   return spawned_;
+}
+
+AES_TEST_INLINE void aes::test::distributed::process_group::wait() noexcept
+{
+   for (pid_t pid : processes_)
+   {
+      int status = 0;
+      while (::waitpid(pid, &status, 0) < 0 && errno == EINTR)
+      {
+      }
+   }
+   processes_.clear();
+}
+#endif
+#endif
@@ -0,0 +1,374 @@
+/****
+ * Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "unit_test_config.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#if defined(AES_TEST_IMPLEMENTATION)
+#include <csignal>
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////
+// Flight recorder
+//
+// The records a logger does not write because of its level are copied into a
+// ring of fixed size slots owned by the thread, without going through a stream.
+// When an assertion fails, the records of its thread come out before the failure;
+// on a fatal signal the rings of every thread are written to the standard error
+// with async-signal-safe calls only.
+//
+// A ring is allocated the first time its thread records and goes back to a free
+// list when the thread ends, so stress tests starting threads over and over reuse
+// the same rings. The rings are never released, the signal handler may read them
+// until the process is gone.
+
+namespace aes
+{
+   namespace test
+   {
+      namespace flight
+      {
+         class recorder
+         {
+         public:
+            static const size_t record_size_ = 256;        // longer records are truncated
+            static const size_t max_rings_ = 1024;         // threads recording at the same time
+
+         public:
+            recorder() noexcept;
+            recorder(const recorder&) = delete;
+            ~recorder() noexcept = default;
+
+         public:
+            recorder& operator=(const recorder&) = delete;
+
+         public:
+            static recorder& get() noexcept;
+
+         public:
+            bool enabled() const noexcept
+            {
+               return capacity_.load(std::memory_order_relaxed) != 0;
+            }
+
+            void enable(size_t records) noexcept;
+            size_t capacity() const noexcept;
+            template <typename T>
+            void record(const T& message) noexcept;
+            void record(const char* data, size_t size) noexcept;
+            std::vector<std::string> take();
+            bool install_signal_handlers() noexcept;
+            void dump_all(int fd) const noexcept;
+
+         private:
+            struct ring
+            {
+               std::atomic<bool> free_;
+               std::atomic<uint64_t> next_;
+               uint64_t first_;                              // records before it were already dumped
+               size_t capacity_;
+               char* slots_;
+            };
+
+         private:
+            ring* local() noexcept;
+            ring* acquire() noexcept;
+            static void release(ring* owned) noexcept;
+
+         private:
+            const uint64_t id_;                               // tells the recorders apart in the thread caches
+            std::atomic<size_t> capacity_;
+            std::atomic<ring*> rings_[max_rings_];
+            std::atomic<size_t> ring_count_;
+         };
+      }
+   }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// recorder class implementation
+
+template <typename T>
+inline void aes::test::flight::recorder::record(const T& message) noexcept
+{
+   std::stringstream ss;
+   ss << message;
+   std::string text(ss.str());
+   record(text.data(), text.size());
+}
+
+template <>
+inline void aes::test::flight::recorder::record<std::string>(const std::string& message) noexcept
+{
+   record(message.data(), message.size());
+}
+
+#if defined(AES_TEST_IMPLEMENTATION)
+namespace aes
+{
+   namespace test
+   {
+      namespace flight
+      {
+         namespace detail
+         {
+            inline void write_all(int fd, const char* data, size_t size) noexcept
+            {
+#if defined(__unix__) || defined(__APPLE__)
+               while (size > 0)
+               {
+                  ssize_t written = ::write(fd, data, size);
+                  if (written <= 0)
+                  {
+                     return;
+                  }
+                  data += written;
+                  size -= size_t(written);
+               }
+#else
+               (void)fd;
+               (void)data;
+               (void)size;
+#endif
+            }
+
+            inline void write_number(int fd, uint64_t value) noexcept
+            {
+               char digits[24];
+               size_t size = 0;
+               do
+               {
+                  digits[sizeof(digits) - ++size] = char('0' + value % 10);
+                  value /= 10;
+               } while (value > 0);
+               write_all(fd, digits + sizeof(digits) - size, size);
+            }
+
+            inline uint64_t next_recorder_id() noexcept
+            {
+               static std::atomic<uint64_t> next(0);
+               return ++next;
+            }
+
+            extern "C" inline void on_fatal_signal(int signal_number)
+            {
+               static const char header[] = "FLIGHT fatal signal ";
+               write_all(2, header, sizeof(header) - 1);
+               write_number(2, uint64_t(signal_number));
+               write_all(2, "\n", 1);
+               recorder::get().dump_all(2);
+
+               // The handler was reset by SA_RESETHAND, the signal now does what it would have done.
+               std::raise(signal_number);
+            }
+         }
+      }
+   }
+}
+
+AES_TEST_INLINE aes::test::flight::recorder::recorder() noexcept
+   : id_(detail::next_recorder_id())
+   , capacity_(0)
+   , ring_count_(0)
+{
+   for (std::atomic<ring*>& owned : rings_)
+   {
+      owned.store(nullptr, std::memory_order_relaxed);
+   }
+}
+
+AES_TEST_INLINE aes::test::flight::recorder& aes::test::flight::recorder::get() noexcept
+{
+   static recorder flight;
+   return flight;
+}
+
+AES_TEST_INLINE void aes::test::flight::recorder::enable(size_t records) noexcept
+{
+   capacity_.store(records, std::memory_order_relaxed);
+}
+
+AES_TEST_INLINE size_t aes::test::flight::recorder::capacity() const noexcept
+{
+   return capacity_.load(std::memory_order_relaxed);
+}
+
+AES_TEST_INLINE void aes::test::flight::recorder::record(const char* data, size_t size) noexcept
+{
+   ring* owned = enabled() ? local() : nullptr;
+   if (!owned)
+   {
+      return;
+   }
+
+   uint64_t index = owned->next_.load(std::memory_order_relaxed);
+   char* slot = owned->slots_ + (index % owned->capacity_) * record_size_;
+   size = size < record_size_ - 1 ? size : record_size_ - 1;
+   std::memcpy(slot, data, size);
+   slot[size] = '\0';
+   owned->next_.store(index + 1, std::memory_order_release);
+}
+
+AES_TEST_INLINE std::vector<std::string> aes::test::flight::recorder::take()
+{
+   std::vector<std::string> records;
+   ring* owned = enabled() ? local() : nullptr;
+   if (!owned)
+   {
+      return records;
+   }
+
+   uint64_t next = owned->next_.load(std::memory_order_relaxed);
+   uint64_t first = next - owned->first_ > owned->capacity_ ? next - owned->capacity_ : owned->first_;
+   for (uint64_t index = first; index < next; index++)
+   {
+      records.emplace_back(owned->slots_ + (index % owned->capacity_) * record_size_);
+   }
+   owned->first_ = next;
+   return records;
+}
+
+AES_TEST_INLINE bool aes::test::flight::recorder::install_signal_handlers() noexcept
+{
+#if defined(__unix__) || defined(__APPLE__)
+   struct sigaction action = {};
+   action.sa_handler = detail::on_fatal_signal;
+   action.sa_flags = SA_RESETHAND;
+   sigemptyset(&action.sa_mask);
+
+   bool installed = true;
+   for (int signal_number : { SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL })
+   {
+      installed &= ::sigaction(signal_number, &action, nullptr) == 0;
+   }
+   return installed;
+#else
+   return false;
+#endif
+}
+
+AES_TEST_INLINE void aes::test::flight::recorder::dump_all(int fd) const noexcept
+{
+   size_t count = ring_count_.load(std::memory_order_acquire);
+   for (size_t i = 0; i < count && i < max_rings_; i++)
+   {
+      const ring* owned = rings_[i].load(std::memory_order_acquire);
+      if (!owned)
+      {
+         continue;
+      }
+
+      uint64_t next = owned->next_.load(std::memory_order_acquire);
+      uint64_t first = next > owned->capacity_ ? next - owned->capacity_ : 0;
+      if (first == next)
+      {
+         continue;
+      }
+
+      static const char header[] = "FLIGHT thread ";
+      detail::write_all(fd, header, sizeof(header) - 1);
+      detail::write_number(fd, uint64_t(i));
+      detail::write_all(fd, "\n", 1);
+      for (uint64_t index = first; index < next; index++)
+      {
+         const char* slot = owned->slots_ + (index % owned->capacity_) * record_size_;
+         detail::write_all(fd, "  ", 2);
+         detail::write_all(fd, slot, std::strlen(slot));
+         detail::write_all(fd, "\n", 1);
+      }
+   }
+}
+
+AES_TEST_INLINE aes::test::flight::recorder::ring* aes::test::flight::recorder::local() noexcept
+{
+   // The holder gives the ring of the thread back when the thread ends.
+   struct holder
+   {
+      uint64_t owner_;
+      ring* owned_;
+      ~holder() noexcept
+      {
+         release(owned_);
+      }
+   };
+   static thread_local holder local_ring = { 0, nullptr };
+
+   if (local_ring.owner_ != id_ || !local_ring.owned_ || local_ring.owned_->capacity_ != capacity())
+   {
+      release(local_ring.owned_);
+      local_ring.owner_ = id_;
+      local_ring.owned_ = acquire();
+   }
+   return local_ring.owned_;
+}
+
+AES_TEST_INLINE aes::test::flight::recorder::ring* aes::test::flight::recorder::acquire() noexcept
+{
+   size_t count = ring_count_.load(std::memory_order_acquire);
+   for (size_t i = 0; i < count && i < max_rings_; i++)
+   {
+      ring* owned = rings_[i].load(std::memory_order_acquire);
+      bool expected = true;
+      if (owned && owned->capacity_ == capacity() && owned->free_.compare_exchange_strong(expected, false))
+      {
+         owned->first_ = owned->next_.load(std::memory_order_relaxed);
+         return owned;
+      }
+   }
+
+   size_t index = ring_count_.fetch_add(1, std::memory_order_acq_rel);
+   if (index >= max_rings_)
+   {
+      return nullptr;
+   }
+
+   ring* owned = new (std::nothrow) ring;
+   char* slots = new (std::nothrow) char[capacity() * record_size_];
+   if (!owned || !slots)
+   {
+      delete owned;
+      delete[] slots;
+      return nullptr;
+   }
+   owned->free_.store(false, std::memory_order_relaxed);
+   owned->next_.store(0, std::memory_order_relaxed);
+   owned->first_ = 0;
+   owned->capacity_ = capacity();
+   owned->slots_ = slots;
+   rings_[index].store(owned, std::memory_order_release);
+   return owned;
+}
+
+AES_TEST_INLINE void aes::test::flight::recorder::release(ring* owned) noexcept
+{
+   if (owned)
+   {
+      owned->free_.store(true, std::memory_order_release);
+   }
+}
+#endif
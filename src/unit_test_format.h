@@ -0,0 +1,685 @@
+/****
+ * Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "unit_test_config.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#if defined(AES_TEST_IMPLEMENTATION)
+#include <clocale>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#endif
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#if __has_include(<string_view>)
+#include <string_view>
+#define AES_TEST_STRING_VIEW
+#endif
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////
+// Value formatting
+//
+// The values of the assertion messages are written into a buffer leased from a
+// small per thread pool, so building a message does not allocate once the pool is
+// warm. The output does not depend on the global locale.
+//
+// Booleans, characters, integers, floating points (shortest round trip), strings,
+// pointers, enums, pairs, tuples and containers have built in formatters. A type
+// with an operator<< of its own keeps using it. A type gets a formatter of its own
+// by specializing aes::test::format::formatter:
+//
+//    template <>
+//    struct aes::test::format::formatter<point>
+//    {
+//       static void format(aes::test::format::buffer& out, const point& value)
+//       {
+//          out.append('(');
+//          aes::test::format::append(out, value.x_);
+//          ...
+//       }
+//    };
+
+namespace aes
+{
+   namespace test
+   {
+      namespace format
+      {
+         struct options
+         {
+            size_t max_string_length_;
+            size_t max_elements_;
+            size_t max_offenders_;           // elements reported by a failed range assertion
+         };
+
+         options& settings() noexcept;
+
+         class buffer
+         {
+         public:
+            buffer() noexcept;
+            buffer(const buffer&) = delete;
+            ~buffer() noexcept;
+
+         public:
+            buffer& operator=(const buffer&) = delete;
+
+         public:
+            void append(const char* text, size_t length);
+            void append(const char* text);
+            void append(const std::string& text);
+            void append(char c);
+            void clear() noexcept;
+
+         public:
+            const std::string& str() const noexcept;
+            size_t size() const noexcept;
+
+         private:
+            struct pool
+            {
+               static const size_t size_ = 4;
+
+               std::string texts_[size_];
+               size_t used_;
+            };
+
+            static pool& thread_pool() noexcept;
+
+         private:
+            std::string* text_;
+            std::string own_;
+         };
+
+         void append_bool(buffer& out, bool value);
+         void append_char(buffer& out, char value);
+         void append_integer(buffer& out, long long value);
+         void append_integer(buffer& out, unsigned long long value);
+         void append_floating(buffer& out, float value);
+         void append_floating(buffer& out, double value);
+         void append_floating(buffer& out, long double value);
+         void append_string(buffer& out, const char* text, size_t length);
+         void append_pointer(buffer& out, const void* value);
+
+         template <typename T, typename = void>
+         struct formatter;
+
+         template <typename T>
+         void append(buffer& out, const T& value);
+         template <typename T>
+         std::string to_string(const T& value);
+
+         namespace detail
+         {
+            template <typename...>
+            struct make_void
+            {
+               using type = void;
+            };
+
+            template <typename... T>
+            using void_t = typename make_void<T...>::type;
+
+            template <typename T, typename = void>
+            struct is_range : std::false_type
+            {
+            };
+
+            template <typename T>
+            struct is_range<T, void_t<decltype(std::begin(std::declval<const T&>())), decltype(std::end(std::declval<const T&>()))>> : std::true_type
+            {
+            };
+
+            template <typename T, typename = void>
+            struct is_streamable : std::false_type
+            {
+            };
+
+            template <typename T>
+            struct is_streamable<T, void_t<decltype(std::declval<std::ostream&>() << std::declval<const T&>())>> : std::true_type
+            {
+            };
+
+            template <typename T>
+            struct is_tuple : std::false_type
+            {
+            };
+
+            template <typename T1, typename T2>
+            struct is_tuple<std::pair<T1, T2>> : std::true_type
+            {
+            };
+
+            template <typename... T>
+            struct is_tuple<std::tuple<T...>> : std::true_type
+            {
+            };
+
+            template <typename T>
+            struct is_string : std::false_type
+            {
+            };
+
+            template <typename _TTraits, typename _TAllocator>
+            struct is_string<std::basic_string<char, _TTraits, _TAllocator>> : std::true_type
+            {
+            };
+
+#if defined(AES_TEST_STRING_VIEW)
+            template <typename _TTraits>
+            struct is_string<std::basic_string_view<char, _TTraits>> : std::true_type
+            {
+            };
+#endif
+
+            enum class kind
+            {
+               boolean,
+               character,
+               integer,
+               floating,
+               enumeration,
+               string,
+               c_string,
+               char_array,
+               null,
+               pointer,
+               tuple,
+               range,
+               stream,
+               opaque
+            };
+
+            template <typename T>
+            constexpr kind kind_of() noexcept
+            {
+               return std::is_same<T, bool>::value ? kind::boolean
+                    : std::is_same<T, char>::value ? kind::character
+                    : std::is_integral<T>::value ? kind::integer
+                    : std::is_floating_point<T>::value ? kind::floating
+                    : std::is_enum<T>::value ? kind::enumeration
+                    : is_string<T>::value ? kind::string
+                    : std::is_same<T, char*>::value || std::is_same<T, const char*>::value ? kind::c_string
+                    : std::is_array<T>::value && std::is_same<typename std::remove_cv<typename std::remove_extent<T>::type>::type, char>::value ? kind::char_array
+                    : std::is_same<T, std::nullptr_t>::value ? kind::null
+                    : std::is_pointer<T>::value ? kind::pointer
+                    : is_streamable<T>::value ? kind::stream
+                    : is_tuple<T>::value ? kind::tuple
+                    : is_range<T>::value ? kind::range
+                    : kind::opaque;
+            }
+
+            template <kind _Kind>
+            using kind_tag = std::integral_constant<kind, _Kind>;
+
+            template <typename T>
+            void format_value(buffer& out, const T& value, kind_tag<kind::boolean>)
+            {
+               append_bool(out, value);
+            }
+
+            template <typename T>
+            void format_value(buffer& out, const T& value, kind_tag<kind::character>)
+            {
+               append_char(out, value);
+            }
+
+            template <typename T>
+            void format_value(buffer& out, const T& value, kind_tag<kind::integer>)
+            {
+               using integer = typename std::conditional<std::is_signed<T>::value, long long, unsigned long long>::type;
+               append_integer(out, static_cast<integer>(value));
+            }
+
+            template <typename T>
+            void format_value(buffer& out, const T& value, kind_tag<kind::floating>)
+            {
+               append_floating(out, value);
+            }
+
+            template <typename T>
+            void format_value(buffer& out, const T& value, kind_tag<kind::enumeration>)
+            {
+               using underlying = typename std::underlying_type<T>::type;
+               format_value(out, static_cast<underlying>(value), kind_tag<kind_of<underlying>()>());
+            }
+
+            template <typename T>
+            void format_value(buffer& out, const T& value, kind_tag<kind::string>)
+            {
+               append_string(out, value.data(), value.size());
+            }
+
+            template <typename T>
+            void format_value(buffer& out, const T& value, kind_tag<kind::c_string>)
+            {
+               if (value)
+               {
+                  append_string(out, value, std::strlen(value));
+               }
+               else
+               {
+                  out.append("nullptr");
+               }
+            }
+
+            template <typename T>
+            void format_value(buffer& out, const T& value, kind_tag<kind::char_array>)
+            {
+               // A literal ends with its terminator, a filled array may not have one.
+               size_t length = 0;
+               while (length < std::extent<T>::value && value[length] != '\0')
+               {
+                  length++;
+               }
+               append_string(out, value, length);
+            }
+
+            template <typename T>
+            void format_value(buffer& out, const T&, kind_tag<kind::null>)
+            {
+               out.append("nullptr");
+            }
+
+            template <typename T>
+            void format_value(buffer& out, const T& value, kind_tag<kind::pointer>)
+            {
+               append_pointer(out, reinterpret_cast<const void*>(value));
+            }
+
+            template <typename T, size_t... _Index>
+            void format_elements(buffer& out, const T& value, std::index_sequence<_Index...>)
+            {
+               int expand[] = { 0, ((_Index > 0 ? out.append(", ", 2) : (void)0), append(out, std::get<_Index>(value)), 0)... };
+               (void)expand;
+            }
+
+            template <typename T>
+            void format_value(buffer& out, const T& value, kind_tag<kind::tuple>)
+            {
+               out.append('(');
+               format_elements(out, value, std::make_index_sequence<std::tuple_size<T>::value>());
+               out.append(')');
+            }
+
+            template <typename T>
+            void format_value(buffer& out, const T& value, kind_tag<kind::range>)
+            {
+               size_t count = 0;
+               out.append('{');
+               for (const auto& element : value)
+               {
+                  if (count == settings().max_elements_)
+                  {
+                     out.append(count ? ", ..." : " ...");
+                     break;
+                  }
+                  out.append(count ? ", " : " ");
+                  append(out, element);
+                  count++;
+               }
+               out.append(" }");
+            }
+
+            template <typename T>
+            void format_value(buffer& out, const T& value, kind_tag<kind::stream>)
+            {
+               std::ostringstream ss;
+               ss.imbue(std::locale::classic());
+               ss << value;
+               out.append(ss.str());
+            }
+
+            template <typename T>
+            void format_value(buffer& out, const T&, kind_tag<kind::opaque>)
+            {
+               out.append("<unprintable>");
+            }
+         }
+
+         template <typename T, typename>
+         struct formatter
+         {
+            static void format(buffer& out, const T& value)
+            {
+               detail::format_value(out, value, detail::kind_tag<detail::kind_of<T>()>());
+            }
+         };
+      }
+   }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// format functions implementation
+
+template <typename T>
+inline void aes::test::format::append(buffer& out, const T& value)
+{
+   formatter<T>::format(out, value);
+}
+
+template <typename T>
+inline std::string aes::test::format::to_string(const T& value)
+{
+   buffer out;
+   append(out, value);
+   return out.str();
+}
+
+#if defined(AES_TEST_IMPLEMENTATION)
+AES_TEST_INLINE aes::test::format::options& aes::test::format::settings() noexcept
+{
+   static options values = { 1024, 32, 10 };
+   return values;
+}
+
+AES_TEST_INLINE void aes::test::format::append_bool(buffer& out, bool value)
+{
+   out.append(value ? "true" : "false");
+}
+
+AES_TEST_INLINE void aes::test::format::append_char(buffer& out, char value)
+{
+   append_string(out, &value, 1);
+}
+
+AES_TEST_INLINE void aes::test::format::append_integer(buffer& out, long long value)
+{
+   if (value < 0)
+   {
+      out.append('-');
+      // Negated as unsigned, so the smallest value does not overflow.
+      append_integer(out, 0ULL - static_cast<unsigned long long>(value));
+   }
+   else
+   {
+      append_integer(out, static_cast<unsigned long long>(value));
+   }
+}
+
+AES_TEST_INLINE void aes::test::format::append_integer(buffer& out, unsigned long long value)
+{
+   char digits[24];
+   char* end = digits + sizeof(digits);
+   char* first = end;
+
+   do
+   {
+      *--first = static_cast<char>('0' + value % 10);
+      value /= 10;
+   } while (value);
+
+   out.append(first, static_cast<size_t>(end - first));
+}
+
+namespace aes
+{
+   namespace test
+   {
+      namespace format
+      {
+         namespace detail
+         {
+            template <typename T>
+            bool append_special(buffer& out, T value)
+            {
+               if (std::isnan(value))
+               {
+                  out.append("nan");
+               }
+               else if (std::isinf(value))
+               {
+                  out.append(value < 0 ? "-inf" : "inf");
+               }
+               else
+               {
+                  return false;
+               }
+               return true;
+            }
+
+            // The first precision whose output reads back as the same value is the shortest one,
+            // the digits10 first try already succeeds for every value written in a short decimal.
+            template <typename T, typename _TParse>
+            void append_shortest(buffer& out, T value, const char* format, _TParse parse)
+            {
+               char digits[64];
+               int length = 0;
+
+               for (int precision = std::numeric_limits<T>::digits10; precision <= std::numeric_limits<T>::max_digits10; precision++)
+               {
+                  length = std::snprintf(digits, sizeof(digits), format, precision, value);
+                  if (parse(digits) == value)
+                  {
+                     break;
+                  }
+               }
+
+               // snprintf follows the global locale, the output does not.
+               char point = std::localeconv()->decimal_point[0];
+               if (point != '.')
+               {
+                  std::replace(digits, digits + length, point, '.');
+               }
+               out.append(digits, static_cast<size_t>(length));
+            }
+         }
+      }
+   }
+}
+
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+AES_TEST_INLINE void aes::test::format::append_floating(buffer& out, float value)
+{
+   char digits[64];
+   if (!detail::append_special(out, value))
+   {
+      out.append(digits, static_cast<size_t>(std::to_chars(digits, digits + sizeof(digits), value).ptr - digits));
+   }
+}
+
+AES_TEST_INLINE void aes::test::format::append_floating(buffer& out, double value)
+{
+   char digits[64];
+   if (!detail::append_special(out, value))
+   {
+      out.append(digits, static_cast<size_t>(std::to_chars(digits, digits + sizeof(digits), value).ptr - digits));
+   }
+}
+#else
+AES_TEST_INLINE void aes::test::format::append_floating(buffer& out, float value)
+{
+   if (!detail::append_special(out, value))
+   {
+      detail::append_shortest(out, value, "%.*g", [](const char* text) { return std::strtof(text, nullptr); });
+   }
+}
+
+AES_TEST_INLINE void aes::test::format::append_floating(buffer& out, double value)
+{
+   if (!detail::append_special(out, value))
+   {
+      detail::append_shortest(out, value, "%.*g", [](const char* text) { return std::strtod(text, nullptr); });
+   }
+}
+#endif
+
+AES_TEST_INLINE void aes::test::format::append_floating(buffer& out, long double value)
+{
+   if (!detail::append_special(out, value))
+   {
+      detail::append_shortest(out, value, "%.*Lg", [](const char* text) { return std::strtold(text, nullptr); });
+   }
+}
+
+AES_TEST_INLINE void aes::test::format::append_string(buffer& out, const char* text, size_t length)
+{
+   static const char hex[] = "0123456789abcdef";
+   size_t shown = std::min(length, settings().max_string_length_);
+   size_t begin = 0;
+
+   // Printable runs are copied at once, control characters are escaped.
+   for (size_t i = 0; i < shown; i++)
+   {
+      unsigned char c = static_cast<unsigned char>(text[i]);
+      if (c >= 0x20 && c != 0x7f)
+      {
+         continue;
+      }
+
+      out.append(text + begin, i - begin);
+      begin = i + 1;
+      switch (c)
+      {
+      case '\0': out.append("\\0", 2); break;
+      case '\t': out.append("\\t", 2); break;
+      case '\n': out.append("\\n", 2); break;
+      case '\r': out.append("\\r", 2); break;
+      default:
+         out.append("\\x", 2);
+         out.append(hex[c >> 4]);
+         out.append(hex[c & 0xf]);
+         break;
+      }
+   }
+   out.append(text + begin, shown - begin);
+
+   if (shown < length)
+   {
+      out.append("...(");
+      append_integer(out, static_cast<unsigned long long>(length));
+      out.append(" chars)");
+   }
+}
+
+AES_TEST_INLINE void aes::test::format::append_pointer(buffer& out, const void* value)
+{
+   static const char hex[] = "0123456789abcdef";
+   char digits[2 * sizeof(uintptr_t)];
+   char* end = digits + sizeof(digits);
+   char* first = end;
+   uintptr_t address = reinterpret_cast<uintptr_t>(value);
+
+   if (!value)
+   {
+      out.append("nullptr");
+      return;
+   }
+
+   do
+   {
+      *--first = hex[address & 0xf];
+      address >>= 4;
+   } while (address);
+
+   out.append("0x", 2);
+   out.append(first, static_cast<size_t>(end - first));
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// buffer class implementation
+
+AES_TEST_INLINE aes::test::format::buffer::buffer() noexcept
+   : text_(nullptr)
+   , own_()
+{
+   pool& texts = thread_pool();
+
+   // Buffers live on the stack, so the leases are returned in the reverse order.
+   if (texts.used_ < pool::size_)
+   {
+      text_ = &texts.texts_[texts.used_++];
+      text_->clear();
+   }
+   else
+   {
+      text_ = &own_;
+   }
+}
+
+AES_TEST_INLINE aes::test::format::buffer::~buffer() noexcept
+{
+   if (text_ != &own_)
+   {
+      // A huge message does not keep its memory for the rest of the thread.
+      if (text_->capacity() > 64 * 1024)
+      {
+         std::string().swap(*text_);
+      }
+      thread_pool().used_--;
+   }
+}
+
+AES_TEST_INLINE void aes::test::format::buffer::append(const char* text, size_t length)
+{
+   text_->append(text, length);
+}
+
+AES_TEST_INLINE void aes::test::format::buffer::append(const char* text)
+{
+   text_->append(text);
+}
+
+AES_TEST_INLINE void aes::test::format::buffer::append(const std::string& text)
+{
+   text_->append(text);
+}
+
+AES_TEST_INLINE void aes::test::format::buffer::append(char c)
+{
+   text_->push_back(c);
+}
+
+AES_TEST_INLINE void aes::test::format::buffer::clear() noexcept
+{
+   text_->clear();
+}
+
+AES_TEST_INLINE const std::string& aes::test::format::buffer::str() const noexcept
+{
+   return *text_;
+}
+
+AES_TEST_INLINE size_t aes::test::format::buffer::size() const noexcept
+{
+   return text_->size();
+}
+
+AES_TEST_INLINE aes::test::format::buffer::pool& aes::test::format::buffer::thread_pool() noexcept
+{
+   static thread_local pool texts = { {}, 0 };
+   return texts;
+}
+#endif
@@ -0,0 +1,31 @@
+/****
+ * Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////////
+// Header of the test files linked with the cpp_test_runtime library
+//
+// It declares the framework without defining its runtime, see unit_test_config.h.
+// Defining AES_TEST_LIBRARY for the whole test target has the same effect and lets
+// the test files keep including unit_test.h.
+
+#if !defined(AES_TEST_LIBRARY)
+#define AES_TEST_LIBRARY
+#endif
+
+#include "unit_test.h"
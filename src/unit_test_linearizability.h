@@ -0,0 +1,343 @@
+/****
+ * Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////////
+// Linearizability checking
+//
+// history_recorder records the invocation and response of operations executed by
+// many threads against a concurrent object. Each thread appends to its own buffer,
+// so recording takes no lock. Every invoked operation must have responded before
+// the history is checked.
+//
+// checker verifies that a history is linearizable against a sequential model,
+// using the Wing & Gong search with the state cache described by Lowe. The model
+// is a class with the following members:
+//
+//    using state_type = ...;    // copyable and equality comparable
+//    using input_type = ...;
+//    using output_type = ...;
+//    static bool step(state_type& state, const input_type& input, const output_type& output);
+//
+// step applies the operation to the state and returns whether the sequential object
+// would have produced the same output.
+//
+// The set of linearized operations is identified in the cache by a 64 bits Zobrist
+// hash instead of a full bitset, which keeps the cache small enough for histories of
+// hundreds of thousands of operations; a collision is astronomically unlikely.
+
+namespace aes
+{
+   namespace test
+   {
+      namespace linearizability
+      {
+         template <typename _TInput, typename _TOutput>
+         struct operation
+         {
+            unsigned thread_;
+            _TInput input_;
+            _TOutput output_;
+            uint64_t invoke_;       // nanoseconds since the recorder has been created
+            uint64_t response_;
+         };
+
+         template <typename _TInput, typename _TOutput>
+         class history_recorder
+         {
+         public:
+            using operation_type = operation<_TInput, _TOutput>;
+
+         public:
+            history_recorder(unsigned threads, size_t reserve = 1024);
+            history_recorder(const history_recorder&) = delete;
+            ~history_recorder() noexcept = default;
+
+         public:
+            history_recorder& operator=(const history_recorder&) = delete;
+
+         public:
+            size_t invoke(unsigned thread, const _TInput& input);
+            void respond(unsigned thread, size_t operation, const _TOutput& output) noexcept;
+            std::vector<operation_type> history() const;
+
+         private:
+            uint64_t now() const noexcept;
+
+         private:
+            struct thread_buffer
+            {
+               std::vector<operation_type> operations_;
+               char padding_[64];      // keeps the buffers of two threads off the same cache line
+            };
+
+         private:
+            std::vector<std::unique_ptr<thread_buffer>> buffers_;
+            std::chrono::steady_clock::time_point epoch_;
+         };
+
+         template <typename _TModel>
+         class checker
+         {
+         public:
+            using state_type = typename _TModel::state_type;
+            using input_type = typename _TModel::input_type;
+            using output_type = typename _TModel::output_type;
+            using operation_type = operation<input_type, output_type>;
+
+         public:
+            checker(const state_type& initial_state = state_type());
+            checker(const checker&) = default;
+            ~checker() noexcept = default;
+
+         public:
+            checker& operator=(const checker&) = default;
+
+         public:
+            bool check(const std::vector<operation_type>& history);
+            uint64_t steps() const noexcept;
+
+         private:
+            struct entry
+            {
+               size_t operation_;
+               bool is_call_;
+               size_t match_;
+               size_t previous_;
+               size_t next_;
+            };
+
+         private:
+            void lift(std::vector<entry>& entries, size_t call) noexcept;
+            void unlift(std::vector<entry>& entries, size_t call) noexcept;
+            bool cache_insert(uint64_t hash, const state_type& state);
+
+         private:
+            state_type initial_state_;
+            std::unordered_map<uint64_t, std::vector<state_type>> cache_;
+            uint64_t steps_;
+         };
+      }
+   }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// history_recorder class implementation
+
+template <typename _TInput, typename _TOutput>
+inline aes::test::linearizability::history_recorder<_TInput, _TOutput>::history_recorder(unsigned threads, size_t reserve)
+   : buffers_()
+   , epoch_(std::chrono::steady_clock::now())
+{
+   for (unsigned i = 0; i < threads; ++i)
+   {
+      buffers_.emplace_back(new thread_buffer());
+      buffers_.back()->operations_.reserve(reserve);
+   }
+}
+
+template <typename _TInput, typename _TOutput>
+inline size_t aes::test::linearizability::history_recorder<_TInput, _TOutput>::invoke(unsigned thread, const _TInput& input)
+{
+   std::vector<operation_type>& operations = buffers_[thread]->operations_;
+   operations.push_back(operation_type{ thread, input, _TOutput(), now(), UINT64_MAX });
+   return operations.size() - 1;
+}
+
+template <typename _TInput, typename _TOutput>
+inline void aes::test::linearizability::history_recorder<_TInput, _TOutput>::respond(unsigned thread, size_t operation, const _TOutput& output) noexcept
+{
+   operation_type& op = buffers_[thread]->operations_[operation];
+   op.response_ = now();
+   op.output_ = output;
+}
+
+template <typename _TInput, typename _TOutput>
+inline std::vector<typename aes::test::linearizability::history_recorder<_TInput, _TOutput>::operation_type> aes::test::linearizability::history_recorder<_TInput, _TOutput>::history() const
+{
+   std::vector<operation_type> result;
+
+   for (const std::unique_ptr<thread_buffer>& buffer : buffers_)
+   {
+      std::copy_if(buffer->operations_.begin(), buffer->operations_.end(), std::back_inserter(result), [](const operation_type& op) { return op.response_ != UINT64_MAX; });
+   }
+
+   return result;
+}
+
+template <typename _TInput, typename _TOutput>
+inline uint64_t aes::test::linearizability::history_recorder<_TInput, _TOutput>::now() const noexcept
+{
+   return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch_).count());
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// checker class implementation
+
+template <typename _TModel>
+inline aes::test::linearizability::checker<_TModel>::checker(const state_type& initial_state)
+   : initial_state_(initial_state)
+   , cache_()
+   , steps_(0)
+{
+}
+
+template <typename _TModel>
+inline bool aes::test::linearizability::checker<_TModel>::check(const std::vector<operation_type>& history)
+{
+   const size_t count = history.size();
+   const size_t head = 2 * count;
+   std::vector<entry> entries(2 * count + 1);
+   std::vector<size_t> order(2 * count);
+   std::vector<uint64_t> keys(count);
+   std::vector<std::pair<size_t, state_type>> stack;
+   std::mt19937_64 random(count);
+   state_type state(initial_state_);
+   uint64_t hash = 0;
+
+   cache_.clear();
+   steps_ = 0;
+
+   // Entries 2i and 2i + 1 are the call and the return of operation i. They are linked
+   // in time order, calls before returns on equal timestamps, behind a head sentinel.
+   for (size_t i = 0; i < count; ++i)
+   {
+      entries[2 * i] = entry{ i, true, 2 * i + 1, 0, 0 };
+      entries[2 * i + 1] = entry{ i, false, 2 * i, 0, 0 };
+      order[2 * i] = 2 * i;
+      order[2 * i + 1] = 2 * i + 1;
+      keys[i] = random();
+   }
+   std::sort(order.begin(), order.end(), [&history](size_t e1, size_t e2)
+   {
+      uint64_t t1 = e1 % 2 ? history[e1 / 2].response_ : history[e1 / 2].invoke_;
+      uint64_t t2 = e2 % 2 ? history[e2 / 2].response_ : history[e2 / 2].invoke_;
+      return t1 < t2 || (t1 == t2 && e1 % 2 < e2 % 2);
+   });
+
+   size_t previous = head;
+   for (size_t index : order)
+   {
+      entries[previous].next_ = index;
+      entries[index].previous_ = previous;
+      previous = index;
+   }
+   entries[previous].next_ = head;
+   entries[head].previous_ = previous;
+
+   size_t current = entries[head].next_;
+   while (entries[head].next_ != head)
+   {
+      ++steps_;
+      const entry& e = entries[current];
+      if (e.is_call_)
+      {
+         const operation_type& op = history[e.operation_];
+         state_type next_state(state);
+         if (_TModel::step(next_state, op.input_, op.output_))
+         {
+            hash ^= keys[e.operation_];
+            if (cache_insert(hash, next_state))
+            {
+               stack.emplace_back(current, std::move(state));
+               state = std::move(next_state);
+               lift(entries, current);
+               current = entries[head].next_;
+               continue;
+            }
+            hash ^= keys[e.operation_];
+         }
+         current = e.next_;
+      }
+      else
+      {
+         // The return of an operation is reached before its call could be linearized,
+         // so the last linearized operation has to be undone.
+         if (stack.empty())
+         {
+            return false;
+         }
+
+         size_t call = stack.back().first;
+         state = std::move(stack.back().second);
+         stack.pop_back();
+         hash ^= keys[entries[call].operation_];
+         unlift(entries, call);
+         current = entries[call].next_;
+      }
+   }
+
+   return true;
+}
+
+template <typename _TModel>
+inline uint64_t aes::test::linearizability::checker<_TModel>::steps() const noexcept
+{
+   return steps_;
+}
+
+template <typename _TModel>
+inline void aes::test::linearizability::checker<_TModel>::lift(std::vector<entry>& entries, size_t call) noexcept
+{
+   entry& e = entries[call];
+   entries[e.previous_].next_ = e.next_;
+   entries[e.next_].previous_ = e.previous_;
+
+   entry& match = entries[e.match_];
+   entries[match.previous_].next_ = match.next_;
+   entries[match.next_].previous_ = match.previous_;
+}
+
+template <typename _TModel>
+inline void aes::test::linearizability::checker<_TModel>::unlift(std::vector<entry>& entries, size_t call) noexcept
+{
+   // Relinking in the reverse order of lift restores the list exactly.
+   entry& match = entries[entries[call].match_];
+   entries[match.previous_].next_ = entries[call].match_;
+   entries[match.next_].previous_ = entries[call].match_;
+
+   entry& e = entries[call];
+   entries[e.previous_].next_ = call;
+   entries[e.next_].previous_ = call;
+}
+
+template <typename _TModel>
+inline bool aes::test::linearizability::checker<_TModel>::cache_insert(uint64_t hash, const state_type& state)
+{
+   std::vector<state_type>& bucket = cache_[hash];
+
+   if (std::find(bucket.begin(), bucket.end(), state) != bucket.end())
+   {
+      return false;
+   }
+
+   bucket.push_back(state);
+   return true;
+}
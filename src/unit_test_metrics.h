@@ -0,0 +1,581 @@
+/****
+ * Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "unit_test_config.h"
+#include "unit_test_distributed.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(AES_TEST_IMPLEMENTATION)
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////
+// Live metrics of a test run
+//
+// The suite and the assertions update a registry of atomic counters; the
+// assertion counters are sharded per thread so stress tests do not contend on a
+// single cache line. A publisher thread samples the registry and writes it as
+// OpenMetrics text, either to a file replaced atomically at every interval or as
+// the answer to every HTTP request on a Unix or TCP socket, for Prometheus to
+// scrape. Rates, such as the assertions per second and the utilization of each
+// worker, are computed between two samples. The table of the workers grows by
+// chunks as workers are numbered, a chunk once published is never moved.
+
+namespace aes
+{
+   namespace test
+   {
+      namespace metrics
+      {
+         struct snapshot
+         {
+            std::chrono::steady_clock::time_point time_;
+            uint64_t passed_;
+            uint64_t failed_;
+            uint64_t planned_;
+            uint64_t completed_;
+            uint64_t failed_tests_;
+            int64_t running_;
+            uint64_t slowest_ns_;
+            std::string slowest_name_;
+            std::vector<uint64_t> busy_ns_;
+         };
+
+         class registry
+         {
+         public:
+            static const size_t shard_count_ = 16;
+            static const size_t first_chunk_ = 64;              // workers in the first chunk of the table, each next chunk doubles
+            static const size_t chunk_count_ = sizeof(size_t) * 8 - 6;
+
+         public:
+            registry() noexcept;
+            registry(const registry&) = delete;
+            ~registry() noexcept;
+
+         public:
+            registry& operator=(const registry&) = delete;
+
+         public:
+            static registry& get() noexcept;
+
+         public:
+            void assertion(bool passed) noexcept
+            {
+               shard& counters = shards_[thread_shard()];
+               (passed ? counters.passed_ : counters.failed_).fetch_add(1, std::memory_order_relaxed);
+            }
+
+            void assertions(uint64_t passed, uint64_t failed) noexcept
+            {
+               shard& counters = shards_[thread_shard()];
+               counters.passed_.fetch_add(passed, std::memory_order_relaxed);
+               counters.failed_.fetch_add(failed, std::memory_order_relaxed);
+            }
+
+            void plan(uint64_t tests) noexcept;
+            void begin_test(size_t worker) noexcept;
+            void end_test(size_t worker, const std::string& name, bool failed) noexcept;
+            void cancel_test(size_t worker) noexcept;
+            void begin_async_test() noexcept;
+            void end_async_test(const std::string& name, bool failed, std::chrono::nanoseconds duration) noexcept;
+            snapshot sample() const;
+
+         private:
+            struct alignas(64) shard
+            {
+               std::atomic<uint64_t> passed_;
+               std::atomic<uint64_t> failed_;
+            };
+
+            struct alignas(64) worker_state
+            {
+               std::atomic<uint64_t> busy_ns_;
+               std::atomic<int64_t> started_ns_;         // -1 while the worker is idle
+            };
+
+            struct chunk
+            {
+               char* storage_;                            // over-allocated, the states start on a cache line
+               worker_state* states_;
+            };
+
+         private:
+            static size_t thread_shard() noexcept
+            {
+               static std::atomic<size_t> next(0);
+               static thread_local size_t index = next.fetch_add(1, std::memory_order_relaxed) % shard_count_;
+               return index;
+            }
+
+            int64_t elapsed_ns() const noexcept;
+            worker_state* find_worker(size_t worker) const noexcept;
+            worker_state* add_worker(size_t worker) noexcept;
+            void completed(const std::string& name, bool failed, uint64_t duration) noexcept;
+
+         private:
+            shard shards_[shard_count_];
+            std::atomic<chunk*> chunks_[chunk_count_];
+            worker_state overflow_;                           // of the workers whose chunk cannot be allocated
+            std::atomic<size_t> used_workers_;
+            std::atomic<uint64_t> planned_;
+            std::atomic<uint64_t> completed_;
+            std::atomic<uint64_t> failed_tests_;
+            std::atomic<int64_t> running_;
+            std::atomic<uint64_t> slowest_ns_;
+            mutable std::mutex slowest_lock_;                 // only taken when a test is slower than every other
+            std::string slowest_name_;
+            std::chrono::steady_clock::time_point start_;
+         };
+
+         std::string render(const snapshot& now, const snapshot& previous);
+
+         class publisher
+         {
+         public:
+            publisher(registry& metrics) noexcept;
+            publisher(const publisher&) = delete;
+            ~publisher() noexcept;
+
+         public:
+            publisher& operator=(const publisher&) = delete;
+
+         public:
+            bool open(const std::string& target);
+            void start(std::chrono::milliseconds interval);
+            void stop() noexcept;
+            bool publish();
+
+         private:
+            void run(std::chrono::milliseconds interval);
+            std::string next_sample();
+
+         private:
+            registry& metrics_;
+            std::string path_;
+#if defined(AES_TEST_DISTRIBUTED)
+            aes::test::distributed::listener listener_;
+#endif
+            bool serve_;
+            snapshot previous_;
+            std::thread thread_;
+            std::atomic<bool> stop_;
+         };
+      }
+   }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// registry class implementation
+
+#if defined(AES_TEST_IMPLEMENTATION)
+AES_TEST_INLINE aes::test::metrics::registry::registry() noexcept
+   : used_workers_(0)
+   , planned_(0)
+   , completed_(0)
+   , failed_tests_(0)
+   , running_(0)
+   , slowest_ns_(0)
+   , slowest_lock_()
+   , slowest_name_()
+   , start_(std::chrono::steady_clock::now())
+{
+   for (shard& counters : shards_)
+   {
+      counters.passed_ = 0;
+      counters.failed_ = 0;
+   }
+   for (std::atomic<chunk*>& entry : chunks_)
+   {
+      entry = nullptr;
+   }
+   overflow_.busy_ns_ = 0;
+   overflow_.started_ns_ = -1;
+}
+
+AES_TEST_INLINE aes::test::metrics::registry::~registry() noexcept
+{
+   for (std::atomic<chunk*>& entry : chunks_)
+   {
+      chunk* allocated = entry.load();
+      if (allocated)
+      {
+         delete[] allocated->storage_;
+         delete allocated;
+      }
+   }
+}
+
+AES_TEST_INLINE aes::test::metrics::registry& aes::test::metrics::registry::get() noexcept
+{
+   static registry metrics;
+   return metrics;
+}
+
+AES_TEST_INLINE void aes::test::metrics::registry::plan(uint64_t tests) noexcept
+{
+   // Suites run one after the other add their tests to the plan.
+   planned_.fetch_add(tests, std::memory_order_relaxed);
+}
+
+AES_TEST_INLINE void aes::test::metrics::registry::begin_test(size_t worker) noexcept
+{
+   worker_state* state = add_worker(worker);
+   size_t used = used_workers_.load(std::memory_order_relaxed);
+   while (used <= worker && !used_workers_.compare_exchange_weak(used, worker + 1, std::memory_order_release, std::memory_order_relaxed))
+   {
+   }
+
+   state->started_ns_.store(elapsed_ns(), std::memory_order_relaxed);
+   running_.fetch_add(1, std::memory_order_relaxed);
+}
+
+AES_TEST_INLINE void aes::test::metrics::registry::end_test(size_t worker, const std::string& name, bool failed) noexcept
+{
+   worker_state* state = add_worker(worker);
+   int64_t started = state->started_ns_.exchange(-1, std::memory_order_relaxed);
+   uint64_t duration = started >= 0 ? static_cast<uint64_t>(elapsed_ns() - started) : 0;
+
+   state->busy_ns_.fetch_add(duration, std::memory_order_relaxed);
+   running_.fetch_sub(1, std::memory_order_relaxed);
+   completed(name, failed, duration);
+}
+
+AES_TEST_INLINE void aes::test::metrics::registry::cancel_test(size_t worker) noexcept
+{
+   worker_state* state = add_worker(worker);
+   int64_t started = state->started_ns_.exchange(-1, std::memory_order_relaxed);
+
+   state->busy_ns_.fetch_add(started >= 0 ? static_cast<uint64_t>(elapsed_ns() - started) : 0, std::memory_order_relaxed);
+   running_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+AES_TEST_INLINE void aes::test::metrics::registry::begin_async_test() noexcept
+{
+   // Asynchronous tests interleave on the event loop, they are running without keeping a worker busy.
+   running_.fetch_add(1, std::memory_order_relaxed);
+}
+
+AES_TEST_INLINE void aes::test::metrics::registry::end_async_test(const std::string& name, bool failed, std::chrono::nanoseconds duration) noexcept
+{
+   running_.fetch_sub(1, std::memory_order_relaxed);
+   completed(name, failed, static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0)));
+}
+
+AES_TEST_INLINE void aes::test::metrics::registry::completed(const std::string& name, bool failed, uint64_t duration) noexcept
+{
+   completed_.fetch_add(1, std::memory_order_relaxed);
+   if (failed)
+   {
+      failed_tests_.fetch_add(1, std::memory_order_relaxed);
+   }
+
+   uint64_t slowest = slowest_ns_.load(std::memory_order_relaxed);
+   if (duration > slowest)
+   {
+      std::lock_guard<std::mutex> lock(slowest_lock_);
+      if (duration > slowest_ns_.load(std::memory_order_relaxed))
+      {
+         slowest_ns_.store(duration, std::memory_order_relaxed);
+         slowest_name_ = name;
+      }
+   }
+}
+
+AES_TEST_INLINE aes::test::metrics::snapshot aes::test::metrics::registry::sample() const
+{
+   snapshot values;
+   int64_t now = elapsed_ns();
+
+   values.time_ = start_ + std::chrono::nanoseconds(now);
+   values.passed_ = 0;
+   values.failed_ = 0;
+   for (const shard& counters : shards_)
+   {
+      values.passed_ += counters.passed_.load(std::memory_order_relaxed);
+      values.failed_ += counters.failed_.load(std::memory_order_relaxed);
+   }
+   values.planned_ = planned_.load(std::memory_order_relaxed);
+   values.completed_ = completed_.load(std::memory_order_relaxed);
+   values.failed_tests_ = failed_tests_.load(std::memory_order_relaxed);
+   values.running_ = running_.load(std::memory_order_relaxed);
+   {
+      std::lock_guard<std::mutex> lock(slowest_lock_);
+      values.slowest_ns_ = slowest_ns_.load(std::memory_order_relaxed);
+      values.slowest_name_ = slowest_name_;
+   }
+
+   // A test in progress counts as busy up to now.
+   size_t used = used_workers_.load(std::memory_order_acquire);
+   for (size_t i = 0; i < used; i++)
+   {
+      const worker_state* state = find_worker(i);
+      int64_t started = state ? state->started_ns_.load(std::memory_order_relaxed) : -1;
+      uint64_t busy = state ? state->busy_ns_.load(std::memory_order_relaxed) : 0;
+      values.busy_ns_.push_back(busy + (started >= 0 && now > started ? static_cast<uint64_t>(now - started) : 0));
+   }
+
+   return values;
+}
+
+AES_TEST_INLINE int64_t aes::test::metrics::registry::elapsed_ns() const noexcept
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count();
+}
+
+AES_TEST_INLINE aes::test::metrics::registry::worker_state* aes::test::metrics::registry::find_worker(size_t worker) const noexcept
+{
+   // Chunk k holds first_chunk_ << k workers, it starts at worker (first_chunk_ << k) - first_chunk_.
+   size_t position = worker + first_chunk_;
+   size_t index = 0;
+   while (index + 1 < chunk_count_ && (position >> 1) >= (first_chunk_ << index))
+   {
+      index++;
+   }
+
+   chunk* allocated = chunks_[index].load(std::memory_order_acquire);
+   return allocated ? allocated->states_ + (position - (first_chunk_ << index)) : nullptr;
+}
+
+AES_TEST_INLINE aes::test::metrics::registry::worker_state* aes::test::metrics::registry::add_worker(size_t worker) noexcept
+{
+   worker_state* state = find_worker(worker);
+   if (state || worker > std::numeric_limits<size_t>::max() - first_chunk_)
+   {
+      return state ? state : &overflow_;
+   }
+
+   size_t position = worker + first_chunk_;
+   size_t index = 0;
+   while (index + 1 < chunk_count_ && (position >> 1) >= (first_chunk_ << index))
+   {
+      index++;
+   }
+
+   // Two threads may allocate the same chunk, the one that publishes it first wins.
+   size_t count = first_chunk_ << index;
+   chunk* allocated = new (std::nothrow) chunk{ new (std::nothrow) char[count * sizeof(worker_state) + alignof(worker_state)], nullptr };
+   if (!allocated || !allocated->storage_)
+   {
+      delete allocated;
+      return &overflow_;
+   }
+   uintptr_t address = reinterpret_cast<uintptr_t>(allocated->storage_);
+   allocated->states_ = reinterpret_cast<worker_state*>((address + alignof(worker_state) - 1) & ~uintptr_t(alignof(worker_state) - 1));
+   for (size_t i = 0; i < count; i++)
+   {
+      new (&allocated->states_[i]) worker_state();
+      allocated->states_[i].busy_ns_.store(0, std::memory_order_relaxed);
+      allocated->states_[i].started_ns_.store(-1, std::memory_order_relaxed);
+   }
+
+   chunk* expected = nullptr;
+   if (!chunks_[index].compare_exchange_strong(expected, allocated, std::memory_order_acq_rel))
+   {
+      delete[] allocated->storage_;
+      delete allocated;
+   }
+   return find_worker(worker);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// render function implementation
+
+AES_TEST_INLINE std::string aes::test::metrics::render(const snapshot& now, const snapshot& previous)
+{
+   double seconds = std::chrono::duration_cast<std::chrono::duration<double>>(now.time_ - previous.time_).count();
+   double rate = seconds > 0 ? double((now.passed_ + now.failed_) - (previous.passed_ + previous.failed_)) / seconds : 0.0;
+   size_t first = now.slowest_name_.find_first_not_of(' ');
+   size_t last = now.slowest_name_.find_last_not_of(' ');
+   std::string name(first != std::string::npos ? now.slowest_name_.substr(first, last - first + 1) : std::string());
+   std::stringstream ss;
+
+   // Label values escape backslashes, quotes and new lines.
+   std::string label;
+   for (char c : name)
+   {
+      label += c == '\\' ? "\\\\" : c == '"' ? "\\\"" : c == '\n' ? "\\n" : std::string(1, c);
+   }
+
+   ss.imbue(std::locale::classic());
+   ss << "# TYPE cpp_test_tests_planned gauge\n";
+   ss << "cpp_test_tests_planned " << now.planned_ << "\n";
+   ss << "# TYPE cpp_test_tests_completed counter\n";
+   ss << "cpp_test_tests_completed_total " << now.completed_ << "\n";
+   ss << "# TYPE cpp_test_tests_failed counter\n";
+   ss << "cpp_test_tests_failed_total " << now.failed_tests_ << "\n";
+   ss << "# TYPE cpp_test_tests_running gauge\n";
+   ss << "cpp_test_tests_running " << now.running_ << "\n";
+   ss << "# TYPE cpp_test_assertions counter\n";
+   ss << "cpp_test_assertions_total{result=\"passed\"} " << now.passed_ << "\n";
+   ss << "cpp_test_assertions_total{result=\"failed\"} " << now.failed_ << "\n";
+   ss << "# TYPE cpp_test_assertions_per_second gauge\n";
+   ss << "cpp_test_assertions_per_second " << rate << "\n";
+   ss << "# TYPE cpp_test_worker_busy_seconds counter\n";
+   for (size_t i = 0; i < now.busy_ns_.size(); i++)
+   {
+      ss << "cpp_test_worker_busy_seconds_total{worker=\"" << i << "\"} " << double(now.busy_ns_[i]) / 1e9 << "\n";
+   }
+   ss << "# TYPE cpp_test_worker_utilization gauge\n";
+   for (size_t i = 0; i < now.busy_ns_.size(); i++)
+   {
+      uint64_t before = i < previous.busy_ns_.size() ? previous.busy_ns_[i] : 0;
+      ss << "cpp_test_worker_utilization{worker=\"" << i << "\"} " << (seconds > 0 ? double(now.busy_ns_[i] - before) / 1e9 / seconds : 0.0) << "\n";
+   }
+   ss << "# TYPE cpp_test_slowest_test_seconds gauge\n";
+   ss << "cpp_test_slowest_test_seconds{test=\"" << label << "\"} " << double(now.slowest_ns_) / 1e9 << "\n";
+   ss << "# EOF\n";
+   return ss.str();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// publisher class implementation
+
+AES_TEST_INLINE aes::test::metrics::publisher::publisher(registry& metrics) noexcept
+   : metrics_(metrics)
+   , path_()
+#if defined(AES_TEST_DISTRIBUTED)
+   , listener_()
+#endif
+   , serve_(false)
+   , previous_(metrics.sample())
+   , thread_()
+   , stop_(false)
+{
+}
+
+AES_TEST_INLINE aes::test::metrics::publisher::~publisher() noexcept
+{
+   stop();
+}
+
+AES_TEST_INLINE bool aes::test::metrics::publisher::open(const std::string& target)
+{
+#if defined(AES_TEST_DISTRIBUTED)
+   // unix:<path> and <host>:<port> are served, anything else is a file.
+   std::string host;
+   std::string port;
+   bool is_address = target.compare(0, 5, "unix:") == 0 ||
+                     (aes::test::distributed::split_address(target, host, port) && !port.empty() && port.find_first_not_of("0123456789") == std::string::npos);
+   if (is_address)
+   {
+      serve_ = listener_.open(target);
+      return serve_;
+   }
+#endif
+
+   path_ = target;
+   return publish();
+}
+
+AES_TEST_INLINE void aes::test::metrics::publisher::start(std::chrono::milliseconds interval)
+{
+   stop_ = false;
+   thread_ = std::thread([this, interval]() { run(interval); });
+}
+
+AES_TEST_INLINE void aes::test::metrics::publisher::stop() noexcept
+{
+   if (thread_.joinable())
+   {
+      stop_ = true;
+      thread_.join();
+      publish();
+   }
+}
+
+AES_TEST_INLINE bool aes::test::metrics::publisher::publish()
+{
+   if (path_.empty())
+   {
+      return true;
+   }
+
+   // The file is replaced in one step, a reader never sees half of it.
+   std::string temporary(path_ + ".tmp");
+   {
+      std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+      file << next_sample();
+      if (!file)
+      {
+         return false;
+      }
+   }
+   return std::rename(temporary.c_str(), path_.c_str()) == 0;
+}
+
+AES_TEST_INLINE void aes::test::metrics::publisher::run(std::chrono::milliseconds interval)
+{
+   const std::chrono::milliseconds tick(std::min<int64_t>(interval.count(), 50));
+   std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now() + interval;
+
+   while (!stop_)
+   {
+#if defined(AES_TEST_DISTRIBUTED)
+      if (serve_)
+      {
+         struct pollfd entry = { listener_.fd(), POLLIN, 0 };
+         if (::poll(&entry, 1, static_cast<int>(tick.count())) > 0)
+         {
+            // Any request gets the current sample, the request itself is not parsed. A client
+            // that does not read the answer times out, it cannot keep stop() waiting.
+            aes::test::distributed::channel client(listener_.accept());
+            std::string body(next_sample());
+            client.send_timeout(std::chrono::milliseconds(100));
+            struct pollfd request = { client.fd(), POLLIN, 0 };
+            if (::poll(&request, 1, 100) > 0)
+            {
+               client.receive();
+            }
+            client.send("HTTP/1.0 200 OK\r\nContent-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\nContent-Length: " +
+                        std::to_string(body.size()) + "\r\n\r\n" + body);
+         }
+         continue;
+      }
+#endif
+      std::this_thread::sleep_for(tick);
+      if (std::chrono::steady_clock::now() >= next)
+      {
+         publish();
+         next += interval;
+      }
+   }
+}
+
+AES_TEST_INLINE std::string aes::test::metrics::publisher::next_sample()
+{
+   snapshot now(metrics_.sample());
+   std::string text(render(now, previous_));
+   previous_ = now;
+   return text;
+}
+#endif
@@ -0,0 +1,560 @@
+/****
+ * Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "unit_test_config.h"
+#if defined(__unix__) || defined(__APPLE__)
+#define AES_TEST_MODULES
+
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+#include <typeinfo>
+#include <vector>
+#if defined(AES_TEST_IMPLEMENTATION)
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <dlfcn.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#endif
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////
+// Test modules
+//
+// A test module is a test binary built as a loadable library: compiled with
+// AES_TEST_MODULE defined, test_main exports the entry point aes_test_module in
+// place of main. A runner loads the module with dlopen and runs its tests in the
+// runner process, so a rerun pays for neither the process startup nor the static
+// initialization of the runner. The tests of a module register into the suite of
+// the module, which keeps its own copy of the framework statics; modules are
+// compiled with -fno-gnu-unique and linked with -Bsymbolic for that.
+//
+// A module is loaded from a private copy of its file, the build can rewrite the
+// file while the previous version still runs. Fixtures kept with fixtures::keep
+// belong to the runner and survive the reloads. They are found again by their
+// name, type name and size, so a fixture whose type changes must change its name.
+// The code destroying a fixture is in the module that built it: every fixture
+// remembers its module, and a module replaced by a reload stays loaded until none
+// of its fixtures remain.
+
+namespace aes
+{
+   namespace test
+   {
+      namespace module
+      {
+         struct test_info
+         {
+            std::string name_;
+            std::string source_file_;
+         };
+
+         struct result
+         {
+            uint64_t passed_;
+            uint64_t failed_;
+            time_t seconds_;
+            std::string out_;                // output of the test, when it is not dropped by the capture
+            std::string error_;
+         };
+
+         class fixtures
+         {
+         public:
+            fixtures() noexcept;
+            fixtures(const fixtures&) = delete;
+            ~fixtures() noexcept;
+
+         public:
+            fixtures& operator=(const fixtures&) = delete;
+
+         public:
+            // The fixtures of the runner that loaded the module, else those of the process.
+            static fixtures& get() noexcept;
+            static void runner(fixtures* kept) noexcept;
+
+         public:
+            template <typename T, typename _TFactory>
+            T& keep(const std::string& name, _TFactory factory);
+            size_t size() const;
+            std::vector<const void*> modules() const;
+            void clear() noexcept;
+
+         private:
+            struct entry
+            {
+               std::string type_;
+               size_t size_;
+               void* object_;
+               void (*destroy_)(void*);
+               const void* module_;                 // a static of the module that built the fixture
+            };
+
+         private:
+            static fixtures*& loaded() noexcept;
+
+         private:
+            mutable std::mutex lock_;
+            std::map<std::string, entry> entries_;
+         };
+
+         // What a runner sees of a loaded module, implemented over the suite of the module.
+         class suite
+         {
+         public:
+            suite() noexcept = default;
+            suite(const suite&) = delete;
+            virtual ~suite() noexcept = default;
+
+         public:
+            suite& operator=(const suite&) = delete;
+
+         public:
+            virtual std::string title() const = 0;
+            virtual std::vector<test_info> tests() const = 0;
+            virtual bool run(const std::string& test, result& outcome) = 0;
+         };
+
+         template <typename _TSuite>
+         class suite_of : public suite
+         {
+         public:
+            suite_of(_TSuite& tests, const std::string& title) noexcept;
+            suite_of(const suite_of&) = delete;
+            virtual ~suite_of() noexcept = default;
+
+         public:
+            suite_of& operator=(const suite_of&) = delete;
+
+         public:
+            virtual std::string title() const;
+            virtual std::vector<test_info> tests() const;
+            virtual bool run(const std::string& test, result& outcome);
+
+         private:
+            _TSuite& tests_;
+            std::string title_;
+         };
+
+         typedef suite* (*entry_point)(fixtures* kept);
+
+         template <typename _TSuite>
+         suite* enter(_TSuite& tests, fixtures* kept, const char* title);
+
+         class library
+         {
+         public:
+            library() noexcept;
+            library(const library&) = delete;
+            ~library() noexcept;
+
+         public:
+            library& operator=(const library&) = delete;
+
+         public:
+            bool open(const std::string& path, fixtures& kept, std::string& error);
+            void close() noexcept;
+            void retire() noexcept;
+            bool is_open() const noexcept;
+            bool is_loaded() const noexcept;
+            bool built(const fixtures& kept) const noexcept;
+            suite& get() noexcept;
+
+         private:
+            void* handle_;
+            const void* base_;                      // address the module is loaded at
+            suite* suite_;
+         };
+
+         // Reports when a file is written and closed, or replaced, with inotify on linux
+         // and by polling its modification time elsewhere.
+         class watcher
+         {
+         public:
+            watcher() noexcept;
+            watcher(const watcher&) = delete;
+            ~watcher() noexcept;
+
+         public:
+            watcher& operator=(const watcher&) = delete;
+
+         public:
+            bool open(const std::string& path);
+            void close() noexcept;
+            bool wait(int timeout_ms) noexcept;
+
+         private:
+            bool changed(int timeout_ms) noexcept;
+
+         private:
+            int fd_;
+            std::string path_;
+            std::string name_;
+            time_t modified_;
+         };
+
+         time_t modified(const std::string& path) noexcept;
+      }
+   }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// fixtures class implementation
+
+template <typename T, typename _TFactory>
+inline T& aes::test::module::fixtures::keep(const std::string& name, _TFactory factory)
+{
+   std::lock_guard<std::mutex> lock(lock_);
+   auto found = entries_.find(name);
+   if (found != entries_.end() && found->second.type_ == typeid(T).name() && found->second.size_ == sizeof(T))
+   {
+      return *static_cast<T*>(found->second.object_);
+   }
+   if (found != entries_.end())
+   {
+      found->second.destroy_(found->second.object_);
+      entries_.erase(found);
+   }
+
+   T* object = factory();
+   entries_[name] = entry{ typeid(T).name(), sizeof(T), object, [](void* kept) { delete static_cast<T*>(kept); }, &loaded() };
+   return *object;
+}
+
+#if defined(AES_TEST_IMPLEMENTATION)
+AES_TEST_INLINE aes::test::module::fixtures::fixtures() noexcept
+   : lock_()
+   , entries_()
+{
+}
+
+AES_TEST_INLINE aes::test::module::fixtures::~fixtures() noexcept
+{
+   clear();
+}
+
+AES_TEST_INLINE aes::test::module::fixtures& aes::test::module::fixtures::get() noexcept
+{
+   static fixtures process;
+   return loaded() ? *loaded() : process;
+}
+
+AES_TEST_INLINE void aes::test::module::fixtures::runner(fixtures* kept) noexcept
+{
+   loaded() = kept;
+}
+
+AES_TEST_INLINE size_t aes::test::module::fixtures::size() const
+{
+   std::lock_guard<std::mutex> lock(lock_);
+   return entries_.size();
+}
+
+AES_TEST_INLINE std::vector<const void*> aes::test::module::fixtures::modules() const
+{
+   std::lock_guard<std::mutex> lock(lock_);
+   std::vector<const void*> built;
+   for (const auto& kept : entries_)
+   {
+      built.push_back(kept.second.module_);
+   }
+   return built;
+}
+
+AES_TEST_INLINE void aes::test::module::fixtures::clear() noexcept
+{
+   std::lock_guard<std::mutex> lock(lock_);
+   for (auto& kept : entries_)
+   {
+      kept.second.destroy_(kept.second.object_);
+   }
+   entries_.clear();
+}
+
+AES_TEST_INLINE aes::test::module::fixtures*& aes::test::module::fixtures::loaded() noexcept
+{
+   static fixtures* kept = nullptr;
+   return kept;
+}
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// suite_of class implementation
+
+template <typename _TSuite>
+inline aes::test::module::suite_of<_TSuite>::suite_of(_TSuite& tests, const std::string& title) noexcept
+   : tests_(tests)
+   , title_(title)
+{
+}
+
+template <typename _TSuite>
+inline std::string aes::test::module::suite_of<_TSuite>::title() const
+{
+   return title_;
+}
+
+template <typename _TSuite>
+inline std::vector<aes::test::module::test_info> aes::test::module::suite_of<_TSuite>::tests() const
+{
+   return tests_.list();
+}
+
+template <typename _TSuite>
+inline bool aes::test::module::suite_of<_TSuite>::run(const std::string& test, result& outcome)
+{
+   return tests_.run_captured(test, outcome);
+}
+
+template <typename _TSuite>
+inline aes::test::module::suite* aes::test::module::enter(_TSuite& tests, fixtures* kept, const char* title)
+{
+   fixtures::runner(kept);
+   return new suite_of<_TSuite>(tests, title);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// library class implementation
+
+#if defined(AES_TEST_IMPLEMENTATION)
+AES_TEST_INLINE aes::test::module::library::library() noexcept
+   : handle_(nullptr)
+   , base_(nullptr)
+   , suite_(nullptr)
+{
+}
+
+AES_TEST_INLINE aes::test::module::library::~library() noexcept
+{
+   close();
+}
+
+AES_TEST_INLINE bool aes::test::module::library::open(const std::string& path, fixtures& kept, std::string& error)
+{
+   // A private copy under a unique name, dlopen would return a module already loaded under the same name.
+   std::ifstream in(path, std::ios::binary);
+   std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+   char copy[] = "/tmp/cpp_test_module_XXXXXX.so";
+   int fd = in ? ::mkstemps(copy, 3) : -1;
+   if (fd < 0)
+   {
+      error = "unable to copy " + path;
+      return false;
+   }
+   bool copied = ::write(fd, contents.data(), contents.size()) == ssize_t(contents.size());
+   ::close(fd);
+   if (!copied)
+   {
+      ::unlink(copy);
+      error = "unable to copy " + path + " to " + std::string(copy);
+      return false;
+   }
+
+   close();
+   handle_ = ::dlopen(copy, RTLD_NOW | RTLD_LOCAL);
+   ::unlink(copy);
+   if (!handle_)
+   {
+      const char* reason = ::dlerror();
+      error = reason ? reason : "unable to load " + path;
+      return false;
+   }
+
+   entry_point entry = reinterpret_cast<entry_point>(::dlsym(handle_, "aes_test_module"));
+   Dl_info info = {};
+   base_ = entry && ::dladdr(reinterpret_cast<void*>(entry), &info) ? info.dli_fbase : nullptr;
+   suite_ = entry ? entry(&kept) : nullptr;
+   if (!suite_)
+   {
+      error = path + " is not a test module, aes_test_module is missing";
+      close();
+      return false;
+   }
+   return true;
+}
+
+AES_TEST_INLINE void aes::test::module::library::close() noexcept
+{
+   retire();
+   if (handle_)
+   {
+      ::dlclose(handle_);
+   }
+   handle_ = nullptr;
+   base_ = nullptr;
+}
+
+AES_TEST_INLINE void aes::test::module::library::retire() noexcept
+{
+   // The tests are gone, the code stays loaded for the fixtures the module built.
+   delete suite_;
+   suite_ = nullptr;
+}
+
+AES_TEST_INLINE bool aes::test::module::library::is_open() const noexcept
+{
+   return suite_ != nullptr;
+}
+
+AES_TEST_INLINE bool aes::test::module::library::is_loaded() const noexcept
+{
+   return handle_ != nullptr;
+}
+
+AES_TEST_INLINE bool aes::test::module::library::built(const fixtures& kept) const noexcept
+{
+   if (!base_)
+   {
+      return false;
+   }
+
+   for (const void* module : kept.modules())
+   {
+      Dl_info info = {};
+      if (::dladdr(module, &info) && info.dli_fbase == base_)
+      {
+         return true;
+      }
+   }
+   return false;
+}
+
+AES_TEST_INLINE aes::test::module::suite& aes::test::module::library::get() noexcept
+{
+   return *suite_;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// watcher class implementation
+
+AES_TEST_INLINE aes::test::module::watcher::watcher() noexcept
+   : fd_(-1)
+   , path_()
+   , name_()
+   , modified_(0)
+{
+}
+
+AES_TEST_INLINE aes::test::module::watcher::~watcher() noexcept
+{
+   close();
+}
+
+AES_TEST_INLINE bool aes::test::module::watcher::open(const std::string& path)
+{
+   close();
+   path_ = path;
+   modified_ = modified(path);
+   size_t slash = path.rfind('/');
+   name_ = slash == std::string::npos ? path : path.substr(slash + 1);
+#if defined(__linux__)
+   // The directory is watched, the linker may replace the file rather than rewrite it.
+   std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+   fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+   if (fd_ < 0 || ::inotify_add_watch(fd_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0)
+   {
+      close();
+      return false;
+   }
+#endif
+   return true;
+}
+
+AES_TEST_INLINE void aes::test::module::watcher::close() noexcept
+{
+   if (fd_ >= 0)
+   {
+      ::close(fd_);
+   }
+   fd_ = -1;
+}
+
+AES_TEST_INLINE bool aes::test::module::watcher::wait(int timeout_ms) noexcept
+{
+   if (!changed(timeout_ms))
+   {
+      return false;
+   }
+
+   // A build writes the file in a burst of events, the last one is waited for.
+   while (changed(50))
+   {
+   }
+   return true;
+}
+
+AES_TEST_INLINE bool aes::test::module::watcher::changed(int timeout_ms) noexcept
+{
+#if defined(__linux__)
+   if (fd_ >= 0)
+   {
+      pollfd events = { fd_, POLLIN, 0 };
+      if (::poll(&events, 1, timeout_ms) <= 0)
+      {
+         return false;
+      }
+
+      bool found = false;
+      alignas(inotify_event) char buffer[4096];
+      ssize_t size = 0;
+      while ((size = ::read(fd_, buffer, sizeof(buffer))) > 0)
+      {
+         for (char* next = buffer; next < buffer + size;)
+         {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(next);
+            found |= event->len > 0 && name_ == event->name;
+            next += sizeof(inotify_event) + event->len;
+         }
+      }
+      return found;
+   }
+#endif
+
+   // Without inotify the modification time is polled.
+   for (int waited = 0; timeout_ms < 0 || waited <= timeout_ms; waited += 20)
+   {
+      time_t now = modified(path_);
+      if (now != modified_)
+      {
+         modified_ = now;
+         return true;
+      }
+      ::usleep(20 * 1000);
+   }
+   return false;
+}
+
+AES_TEST_INLINE time_t aes::test::module::modified(const std::string& path) noexcept
+{
+   struct stat status;
+   return ::stat(path.c_str(), &status) == 0 ? status.st_mtime : 0;
+}
+#endif
+#endif
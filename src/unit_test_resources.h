@@ -0,0 +1,206 @@
+/****
+ * Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "unit_test_config.h"
+#if defined(__unix__) || defined(__APPLE__)
+#define AES_TEST_RESOURCES
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+///////////////////////////////////////////////////////////////////////////////////
+// Per test resources
+//
+// The resources used by a test are taken from getrusage. A test run in the suite
+// process only moves the peak RSS when it goes above every previous test; a test
+// isolated in a child process reports its own peak, above the size of the suite
+// at fork time.
+//
+// The limits are enforced in isolated children only, with RLIMIT_AS for the memory
+// and RLIMIT_CPU for the processor time, so a test going over them is killed or
+// fails to allocate without taking the suite down.
+
+namespace aes
+{
+   namespace test
+   {
+      namespace resources
+      {
+         struct usage
+         {
+            int64_t peak_rss_kb_;
+            uint64_t minor_faults_;
+            uint64_t major_faults_;
+            uint64_t voluntary_switches_;
+            uint64_t involuntary_switches_;
+         };
+
+         struct limits
+         {
+            uint64_t memory_bytes_;      // 0 when the memory is not limited
+            uint64_t cpu_seconds_;       // 0 when the processor time is not limited
+         };
+
+         usage self() noexcept;
+         usage difference(const usage& after, const usage& before) noexcept;
+         pid_t fork_limited(const limits& child_limits, int& fd) noexcept;
+         bool wait(pid_t child, int& status, usage& child_usage) noexcept;
+         bool parse_size(const std::string& text, uint64_t& size) noexcept;
+         std::string describe(const usage& used);
+      }
+   }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// resources functions implementation
+
+#if defined(AES_TEST_IMPLEMENTATION)
+namespace aes
+{
+   namespace test
+   {
+      namespace resources
+      {
+         namespace detail
+         {
+            inline usage from_rusage(const struct rusage& values) noexcept
+            {
+               // ru_maxrss is in kilobytes, except on macOS where it is in bytes.
+#if defined(__APPLE__)
+               int64_t peak = static_cast<int64_t>(values.ru_maxrss / 1024);
+#else
+               int64_t peak = static_cast<int64_t>(values.ru_maxrss);
+#endif
+               return usage{ peak,
+                             static_cast<uint64_t>(values.ru_minflt),
+                             static_cast<uint64_t>(values.ru_majflt),
+                             static_cast<uint64_t>(values.ru_nvcsw),
+                             static_cast<uint64_t>(values.ru_nivcsw) };
+            }
+         }
+      }
+   }
+}
+
+AES_TEST_INLINE aes::test::resources::usage aes::test::resources::self() noexcept
+{
+   struct rusage values = {};
+   getrusage(RUSAGE_SELF, &values);
+   return detail::from_rusage(values);
+}
+
+AES_TEST_INLINE aes::test::resources::usage aes::test::resources::difference(const usage& after, const usage& before) noexcept
+{
+   return usage{ after.peak_rss_kb_ > before.peak_rss_kb_ ? after.peak_rss_kb_ - before.peak_rss_kb_ : 0,
+                 after.minor_faults_ - before.minor_faults_,
+                 after.major_faults_ - before.major_faults_,
+                 after.voluntary_switches_ - before.voluntary_switches_,
+                 after.involuntary_switches_ - before.involuntary_switches_ };
+}
+
+AES_TEST_INLINE pid_t aes::test::resources::fork_limited(const limits& child_limits, int& fd) noexcept
+{
+   int fds[2];
+   if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+   {
+      return -1;
+   }
+
+   pid_t child = ::fork();
+   if (child == 0)
+   {
+      ::close(fds[0]);
+      fd = fds[1];
+      if (child_limits.memory_bytes_)
+      {
+         struct rlimit memory = { static_cast<rlim_t>(child_limits.memory_bytes_), static_cast<rlim_t>(child_limits.memory_bytes_) };
+         ::setrlimit(RLIMIT_AS, &memory);
+      }
+      if (child_limits.cpu_seconds_)
+      {
+         // The soft limit raises SIGXCPU, the hard one a second later SIGKILL.
+         struct rlimit cpu = { static_cast<rlim_t>(child_limits.cpu_seconds_), static_cast<rlim_t>(child_limits.cpu_seconds_ + 1) };
+         ::setrlimit(RLIMIT_CPU, &cpu);
+      }
+      return 0;
+   }
+
+   ::close(fds[1]);
+   if (child < 0)
+   {
+      ::close(fds[0]);
+      return -1;
+   }
+   fd = fds[0];
+   return child;
+}
+
+AES_TEST_INLINE bool aes::test::resources::wait(pid_t child, int& status, usage& child_usage) noexcept
+{
+   struct rusage values = {};
+   pid_t result;
+
+   do
+   {
+      result = ::wait4(child, &status, 0, &values);
+   } while (result < 0 && errno == EINTR);
+
+   child_usage = detail::from_rusage(values);
+   return result == child;
+}
+
+AES_TEST_INLINE bool aes::test::resources::parse_size(const std::string& text, uint64_t& size) noexcept
+{
+   char* end = nullptr;
+   unsigned long long value = std::strtoull(text.c_str(), &end, 10);
+
+   if (end == text.c_str())
+   {
+      return false;
+   }
+
+   switch (*end)
+   {
+   case 'G': case 'g': value <<= 10; // fall through
+   case 'M': case 'm': value <<= 10; // fall through
+   case 'K': case 'k': value <<= 10; end++; break;
+   default: break;
+   }
+
+   size = value;
+   return *end == '\0';
+}
+
+AES_TEST_INLINE std::string aes::test::resources::describe(const usage& used)
+{
+   return " rss +" + std::to_string(used.peak_rss_kb_) + "KB" +
+          " faults " + std::to_string(used.minor_faults_) + "/" + std::to_string(used.major_faults_) +
+          " switches " + std::to_string(used.voluntary_switches_) + "/" + std::to_string(used.involuntary_switches_);
+}
+#endif
+#endif
@@ -0,0 +1,542 @@
+/****
+ * Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "unit_test_config.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+///////////////////////////////////////////////////////////////////////////////////
+// Binary result log
+//
+// The log is a magic header followed by records. Each record is a type byte and
+// a list of LEB128 varints. Strings (test names and file names) are written once
+// in a 'string' record and referred to by id afterwards, timestamps are stored as
+// the delta in nanoseconds from the previous record.
+//
+//    string : id, length, bytes
+//    begin  : test id, name id, time delta
+//    pass   : test id, file id, line, time delta
+//    fail   : test id, file id, line, time delta
+//    end    : test id, time delta
+//
+// The writer may be shared by the threads of a stress test. The reader trusts nothing
+// of the file: a size past its end, an id out of sequence or an unknown record stops
+// the reading and marks the log as corrupt.
+
+namespace aes
+{
+   namespace test
+   {
+      namespace result_log
+      {
+         enum class record_type : uint8_t
+         {
+            string = 1,
+            begin = 2,
+            pass = 3,
+            fail = 4,
+            end = 5
+         };
+
+         struct record
+         {
+            record_type type;
+            uint32_t test;
+            uint32_t id;         // name id for 'begin' records, file id for 'pass' and 'fail' records
+            uint32_t line;
+            uint64_t time;       // nanoseconds since the log has been opened
+         };
+
+         class writer
+         {
+         public:
+            writer() noexcept;
+            writer(const writer&) = delete;
+            ~writer() noexcept;
+
+         public:
+            writer& operator=(const writer&) = delete;
+
+         public:
+            bool open(const std::string& path) noexcept;
+            void close() noexcept;
+            bool is_open() const noexcept;
+            const std::string& path() const noexcept;
+
+         public:
+            uint32_t begin_test(const std::string& name) noexcept;
+            void end_test(uint32_t test) noexcept;
+            void log_result(uint32_t test, const std::string& file, int line, bool result) noexcept;
+            void sync() noexcept;
+            bool append(const std::string& path) noexcept;
+
+         private:
+            uint32_t intern(const std::string& value) noexcept;
+            uint64_t time_delta() noexcept;
+            void put_type(record_type type) noexcept;
+            void put_varint(uint64_t value) noexcept;
+            void put_bytes(const char* data, size_t size) noexcept;
+            void flush() noexcept;
+
+         private:
+            std::mutex lock_;
+            std::FILE* file_;
+            std::string path_;
+            std::vector<char> buffer_;
+            size_t used_;
+            std::unordered_map<std::string, uint32_t> strings_;
+            std::string last_file_;
+            uint32_t last_file_id_;
+            uint32_t next_test_;
+            std::chrono::steady_clock::time_point start_;
+            uint64_t last_time_;
+         };
+
+         class reader
+         {
+         public:
+            reader() noexcept;
+            reader(const reader&) = delete;
+            ~reader() noexcept;
+
+         public:
+            reader& operator=(const reader&) = delete;
+
+         public:
+            bool open(const std::string& path) noexcept;
+            void close() noexcept;
+            bool next(record& result) noexcept;
+            bool corrupt() const noexcept;
+            const std::string& string(uint32_t id) const noexcept;
+
+         private:
+            bool get_varint(uint64_t& value) noexcept;
+            bool fail() noexcept;
+
+         private:
+            std::FILE* file_;
+            std::vector<std::string> strings_;
+            uint64_t time_;
+            uint64_t size_;
+            uint64_t tests_;                 // tests begun, the next begin record has this id
+            bool corrupt_;
+         };
+
+         const char magic[] = "AESRLOG1";
+         const size_t magic_size = sizeof(magic) - 1;
+      }
+   }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// writer class implementation
+
+#if defined(AES_TEST_IMPLEMENTATION)
+AES_TEST_INLINE aes::test::result_log::writer::writer() noexcept
+   : lock_()
+   , file_(nullptr)
+   , path_()
+   , buffer_(256 * 1024)
+   , used_(0)
+   , strings_()
+   , last_file_()
+   , last_file_id_(0)
+   , next_test_(0)
+   , start_(std::chrono::steady_clock::now())
+   , last_time_(0)
+{
+}
+
+AES_TEST_INLINE aes::test::result_log::writer::~writer() noexcept
+{
+   close();
+}
+
+AES_TEST_INLINE bool aes::test::result_log::writer::open(const std::string& path) noexcept
+{
+   close();
+   file_ = std::fopen(path.c_str(), "wb");
+   if (file_)
+   {
+      path_ = path;
+      strings_.clear();
+      last_file_.clear();
+      next_test_ = 0;
+      start_ = std::chrono::steady_clock::now();
+      last_time_ = 0;
+      put_bytes(magic, magic_size);
+   }
+
+   return file_ != nullptr;
+}
+
+AES_TEST_INLINE void aes::test::result_log::writer::close() noexcept
+{
+   if (file_)
+   {
+      flush();
+      std::fclose(file_);
+      file_ = nullptr;
+   }
+}
+
+AES_TEST_INLINE bool aes::test::result_log::writer::is_open() const noexcept
+{
+   return file_ != nullptr;
+}
+
+AES_TEST_INLINE const std::string& aes::test::result_log::writer::path() const noexcept
+{
+   return path_;
+}
+
+AES_TEST_INLINE uint32_t aes::test::result_log::writer::begin_test(const std::string& name) noexcept
+{
+   std::lock_guard<std::mutex> guard(lock_);
+   uint32_t test = next_test_++;
+   uint32_t name_id = intern(name);
+
+   put_type(record_type::begin);
+   put_varint(test);
+   put_varint(name_id);
+   put_varint(time_delta());
+   return test;
+}
+
+AES_TEST_INLINE void aes::test::result_log::writer::end_test(uint32_t test) noexcept
+{
+   std::lock_guard<std::mutex> guard(lock_);
+   put_type(record_type::end);
+   put_varint(test);
+   put_varint(time_delta());
+}
+
+AES_TEST_INLINE void aes::test::result_log::writer::log_result(uint32_t test, const std::string& file, int line, bool result) noexcept
+{
+   // Consecutive assertions almost always come from the same file, so the last id is
+   // kept to avoid hashing the file name on every call.
+   std::lock_guard<std::mutex> guard(lock_);
+   if (file != last_file_ || strings_.empty())
+   {
+      last_file_id_ = intern(file);
+      last_file_ = file;
+   }
+
+   put_type(result ? record_type::pass : record_type::fail);
+   put_varint(test);
+   put_varint(last_file_id_);
+   put_varint(uint64_t(line));
+   put_varint(time_delta());
+}
+
+// Writes the records through to the file, for a reader in another process.
+AES_TEST_INLINE void aes::test::result_log::writer::sync() noexcept
+{
+   std::lock_guard<std::mutex> guard(lock_);
+   flush();
+   if (file_)
+   {
+      std::fflush(file_);
+   }
+}
+
+// Copies the tests of another log, the one of a worker, after the records written so far.
+// The tests are numbered in this log, and their times keep their distance from the copy on.
+AES_TEST_INLINE bool aes::test::result_log::writer::append(const std::string& path) noexcept
+{
+   reader log;
+   record r = {};
+   std::vector<uint32_t> tests;
+
+   if (!file_ || !log.open(path))
+   {
+      return false;
+   }
+
+   std::lock_guard<std::mutex> guard(lock_);
+   time_delta();
+   uint64_t base = last_time_;
+   while (log.next(r))
+   {
+      if (r.type == record_type::begin && r.test == tests.size())
+      {
+         tests.push_back(next_test_++);
+      }
+      if (r.test >= tests.size())
+      {
+         continue;
+      }
+
+      uint32_t id = r.type == record_type::end ? 0 : intern(log.string(r.id));
+      put_type(r.type);
+      put_varint(tests[r.test]);
+      if (r.type != record_type::end)
+      {
+         put_varint(id);
+      }
+      if (r.type == record_type::pass || r.type == record_type::fail)
+      {
+         put_varint(r.line);
+      }
+      put_varint(base + r.time - last_time_);
+      last_time_ = base + r.time;
+   }
+
+   return !log.corrupt();
+}
+
+AES_TEST_INLINE uint32_t aes::test::result_log::writer::intern(const std::string& value) noexcept
+{
+   auto it = strings_.find(value);
+   if (it != strings_.end())
+   {
+      return it->second;
+   }
+
+   uint32_t id = uint32_t(strings_.size());
+   strings_.emplace(value, id);
+   put_type(record_type::string);
+   put_varint(id);
+   put_varint(value.size());
+   put_bytes(value.data(), value.size());
+   return id;
+}
+
+AES_TEST_INLINE uint64_t aes::test::result_log::writer::time_delta() noexcept
+{
+   // The records appended from another log may be ahead of the clock of this one.
+   uint64_t now = std::max(last_time_, uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count()));
+   uint64_t delta = now - last_time_;
+   last_time_ = now;
+   return delta;
+}
+
+AES_TEST_INLINE void aes::test::result_log::writer::put_type(record_type type) noexcept
+{
+   if (used_ + 64 > buffer_.size())
+   {
+      flush();
+   }
+   buffer_[used_++] = char(type);
+}
+
+AES_TEST_INLINE void aes::test::result_log::writer::put_varint(uint64_t value) noexcept
+{
+   while (value >= 0x80)
+   {
+      buffer_[used_++] = char((value & 0x7f) | 0x80);
+      value >>= 7;
+   }
+   buffer_[used_++] = char(value);
+}
+
+AES_TEST_INLINE void aes::test::result_log::writer::put_bytes(const char* data, size_t size) noexcept
+{
+   if (used_ + size > buffer_.size())
+   {
+      flush();
+   }
+
+   if (size > buffer_.size())
+   {
+      if (file_)
+      {
+         std::fwrite(data, 1, size, file_);
+      }
+   }
+   else
+   {
+      std::memcpy(&buffer_[used_], data, size);
+      used_ += size;
+   }
+}
+
+AES_TEST_INLINE void aes::test::result_log::writer::flush() noexcept
+{
+   if (file_ && used_ > 0)
+   {
+      std::fwrite(buffer_.data(), 1, used_, file_);
+   }
+   used_ = 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// reader class implementation
+
+AES_TEST_INLINE aes::test::result_log::reader::reader() noexcept
+   : file_(nullptr)
+   , strings_()
+   , time_(0)
+   , size_(0)
+   , tests_(0)
+   , corrupt_(false)
+{
+}
+
+AES_TEST_INLINE aes::test::result_log::reader::~reader() noexcept
+{
+   close();
+}
+
+AES_TEST_INLINE bool aes::test::result_log::reader::open(const std::string& path) noexcept
+{
+   char header[magic_size];
+
+   close();
+   file_ = std::fopen(path.c_str(), "rb");
+   if (file_ && (std::fread(header, 1, magic_size, file_) != magic_size || std::memcmp(header, magic, magic_size) != 0))
+   {
+      close();
+   }
+
+   size_ = 0;
+   if (file_ && std::fseek(file_, 0, SEEK_END) == 0)
+   {
+      long end = std::ftell(file_);
+      size_ = end > 0 ? uint64_t(end) : 0;
+      std::fseek(file_, long(magic_size), SEEK_SET);
+   }
+
+   strings_.clear();
+   time_ = 0;
+   tests_ = 0;
+   corrupt_ = false;
+   return file_ != nullptr;
+}
+
+AES_TEST_INLINE void aes::test::result_log::reader::close() noexcept
+{
+   if (file_)
+   {
+      std::fclose(file_);
+      file_ = nullptr;
+   }
+}
+
+AES_TEST_INLINE bool aes::test::result_log::reader::next(record& result) noexcept
+{
+   uint64_t values[4] = {};
+   int type = 0;
+
+   while (file_ && (type = std::fgetc(file_)) != EOF)
+   {
+      if (record_type(type) == record_type::string)
+      {
+         // The strings are numbered in the order they are written and fit in the rest of the file.
+         if (!get_varint(values[0]) || !get_varint(values[1]))
+         {
+            return fail();
+         }
+         long position = std::ftell(file_);
+         if (values[0] > strings_.size() || position < 0 || values[1] > size_ - uint64_t(position))
+         {
+            return fail();
+         }
+
+         std::string value(size_t(values[1]), '\0');
+         if (values[1] > 0 && std::fread(&value[0], 1, value.size(), file_) != value.size())
+         {
+            return fail();
+         }
+         if (values[0] == strings_.size())
+         {
+            strings_.emplace_back();
+         }
+         strings_[size_t(values[0])] = std::move(value);
+         continue;
+      }
+
+      size_t count = record_type(type) == record_type::begin ? 3 :
+                     record_type(type) == record_type::end ? 2 :
+                     record_type(type) == record_type::pass || record_type(type) == record_type::fail ? 4 : 0;
+      if (count == 0)
+      {
+         return fail();
+      }
+      for (size_t i = 0; i < count; ++i)
+      {
+         if (!get_varint(values[i]))
+         {
+            return fail();
+         }
+      }
+      if (values[0] > UINT32_MAX || (record_type(type) == record_type::begin && values[0] > tests_))
+      {
+         return fail();
+      }
+      tests_ += record_type(type) == record_type::begin && values[0] == tests_ ? 1 : 0;
+
+      time_ += values[count - 1];
+      result.type = record_type(type);
+      result.test = uint32_t(values[0]);
+      result.id = count > 2 ? uint32_t(values[1]) : 0;
+      result.line = count > 3 ? uint32_t(values[2]) : 0;
+      result.time = time_;
+      return true;
+   }
+
+   return false;
+}
+
+AES_TEST_INLINE bool aes::test::result_log::reader::corrupt() const noexcept
+{
+   return corrupt_;
+}
+
+AES_TEST_INLINE const std::string& aes::test::result_log::reader::string(uint32_t id) const noexcept
+{
+   static const std::string empty;
+   return id < strings_.size() ? strings_[id] : empty;
+}
+
+AES_TEST_INLINE bool aes::test::result_log::reader::get_varint(uint64_t& value) noexcept
+{
+   int shift = 0;
+   int byte = 0;
+
+   value = 0;
+   while ((byte = std::fgetc(file_)) != EOF && shift < 64)
+   {
+      value |= uint64_t(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0)
+      {
+         return true;
+      }
+      shift += 7;
+   }
+
+   return false;
+}
+
+AES_TEST_INLINE bool aes::test::result_log::reader::fail() noexcept
+{
+   corrupt_ = true;
+   close();
+   return false;
+}
+#endif
@@ -0,0 +1,408 @@
+/****
+ * Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "unit_test_config.h"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#if defined(AES_TEST_IMPLEMENTATION)
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////
+// Snapshot files
+//
+// A snapshot is a golden file <directory>/<name>.snap with an index beside it,
+// <name>.snap.idx, holding a hash of every chunk of the snapshot together with
+// its size and modification time. The actual buffer is hashed chunk by chunk and
+// only the chunks whose hash differs from the index are compared with the
+// snapshot, which is memory mapped, so the pages of unchanged regions are never
+// read. Without a valid index the whole snapshot is compared.
+//
+// In update mode the snapshot and its index are written to temporary files and
+// renamed over the previous ones, a reader never sees half of a snapshot.
+
+namespace aes
+{
+   namespace test
+   {
+      namespace snapshot
+      {
+         struct options
+         {
+            std::string directory_;
+            bool update_;
+         };
+
+         struct difference
+         {
+            uint64_t begin_;
+            uint64_t end_;              // one past the last differing byte
+         };
+
+         struct result
+         {
+            bool found_;                // the snapshot exists, or was written in update mode
+            bool matched_;
+            bool updated_;              // the snapshot was written in update mode
+            uint64_t expected_size_;
+            uint64_t skipped_bytes_;    // not read from the snapshot thanks to the index
+            uint64_t difference_count_;
+            std::vector<difference> differences_;   // the first max_differences_ regions
+         };
+
+         static const size_t chunk_size_ = 1024 * 1024;
+         static const size_t max_differences_ = 8;
+
+         options& settings() noexcept;
+         uint64_t hash(const unsigned char* data, size_t size) noexcept;
+         std::string path(const std::string& name);
+         result compare(const std::string& name, const void* data, size_t size);
+         bool write(const std::string& name, const void* data, size_t size);
+      }
+   }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// snapshot functions implementation
+
+#if defined(AES_TEST_IMPLEMENTATION)
+namespace aes
+{
+   namespace test
+   {
+      namespace snapshot
+      {
+         namespace detail
+         {
+            static const char index_magic[8] = { 'C', 'T', 'S', 'N', 'A', 'P', '0', '1' };
+
+            struct index
+            {
+               uint64_t size_;
+               int64_t modified_;
+               std::vector<uint64_t> hashes_;
+            };
+
+            // A read only view of a file, memory mapped where the platform allows it.
+            class mapping
+            {
+            public:
+               mapping(const std::string& file_path) noexcept;
+               mapping(const mapping&) = delete;
+               ~mapping() noexcept;
+
+            public:
+               mapping& operator=(const mapping&) = delete;
+
+            public:
+               bool is_open() const noexcept { return opened_; }
+               const unsigned char* data() const noexcept { return data_; }
+               uint64_t size() const noexcept { return size_; }
+               int64_t modified() const noexcept { return modified_; }
+
+            private:
+               bool opened_;
+               const unsigned char* data_;
+               uint64_t size_;
+               int64_t modified_;
+               std::vector<unsigned char> copy_;
+            };
+
+            inline mapping::mapping(const std::string& file_path) noexcept
+               : opened_(false)
+               , data_(nullptr)
+               , size_(0)
+               , modified_(0)
+               , copy_()
+            {
+#if defined(__unix__) || defined(__APPLE__)
+               int fd = ::open(file_path.c_str(), O_RDONLY);
+               struct stat status = {};
+               if (fd < 0 || ::fstat(fd, &status) != 0)
+               {
+                  if (fd >= 0)
+                  {
+                     ::close(fd);
+                  }
+                  return;
+               }
+
+               size_ = static_cast<uint64_t>(status.st_size);
+#if defined(__APPLE__)
+               modified_ = static_cast<int64_t>(status.st_mtimespec.tv_sec) * 1000000000 + status.st_mtimespec.tv_nsec;
+#else
+               modified_ = static_cast<int64_t>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+#endif
+               if (size_ > 0)
+               {
+                  void* mapped = ::mmap(nullptr, size_t(size_), PROT_READ, MAP_PRIVATE, fd, 0);
+                  if (mapped == MAP_FAILED)
+                  {
+                     ::close(fd);
+                     return;
+                  }
+                  data_ = static_cast<const unsigned char*>(mapped);
+               }
+               ::close(fd);
+               opened_ = true;
+#else
+               std::ifstream file(file_path, std::ios::binary);
+               if (file)
+               {
+                  copy_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+                  data_ = copy_.data();
+                  size_ = copy_.size();
+                  opened_ = true;
+               }
+#endif
+            }
+
+            inline mapping::~mapping() noexcept
+            {
+#if defined(__unix__) || defined(__APPLE__)
+               if (data_)
+               {
+                  ::munmap(const_cast<unsigned char*>(data_), size_t(size_));
+               }
+#endif
+            }
+
+            inline bool read_index(const std::string& file_path, index& values)
+            {
+               std::ifstream file(file_path, std::ios::binary);
+               char magic[sizeof(index_magic)] = {};
+               uint64_t count = 0;
+
+               if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, index_magic, sizeof(magic)) != 0 ||
+                   !file.read(reinterpret_cast<char*>(&values.size_), sizeof(values.size_)) ||
+                   !file.read(reinterpret_cast<char*>(&values.modified_), sizeof(values.modified_)) ||
+                   !file.read(reinterpret_cast<char*>(&count), sizeof(count)) ||
+                   count != (values.size_ + chunk_size_ - 1) / chunk_size_)
+               {
+                  return false;
+               }
+
+               values.hashes_.resize(size_t(count));
+               return count == 0 || bool(file.read(reinterpret_cast<char*>(values.hashes_.data()), std::streamsize(count * sizeof(uint64_t))));
+            }
+
+            inline bool replace(const std::string& file_path, const void* data, size_t size)
+            {
+               std::string temporary(file_path + ".tmp");
+               {
+                  std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+                  file.write(static_cast<const char*>(data), std::streamsize(size));
+                  if (!file)
+                  {
+                     return false;
+                  }
+               }
+               return std::rename(temporary.c_str(), file_path.c_str()) == 0;
+            }
+
+            // Appends the regions of a differing chunk, the equal blocks are skipped with memcmp.
+            inline void find_differences(const unsigned char* expected, const unsigned char* actual, size_t size, uint64_t offset, result& values)
+            {
+               const size_t block = 64;
+               size_t i = 0;
+
+               while (i < size)
+               {
+                  size_t length = std::min(block, size - i);
+                  if (std::memcmp(expected + i, actual + i, length) == 0)
+                  {
+                     i += length;
+                     continue;
+                  }
+
+                  while (expected[i] == actual[i])
+                  {
+                     i++;
+                  }
+                  size_t begin = i;
+                  while (i < size && expected[i] != actual[i])
+                  {
+                     i++;
+                  }
+
+                  // A region touching the previous one extends it, across chunks too.
+                  if (!values.differences_.empty() && values.differences_.back().end_ == offset + begin)
+                  {
+                     values.differences_.back().end_ = offset + i;
+                  }
+                  else if (values.differences_.size() < max_differences_)
+                  {
+                     values.differences_.push_back(difference{ offset + begin, offset + i });
+                     values.difference_count_++;
+                  }
+                  else
+                  {
+                     values.difference_count_++;
+                  }
+               }
+            }
+         }
+      }
+   }
+}
+
+AES_TEST_INLINE aes::test::snapshot::options& aes::test::snapshot::settings() noexcept
+{
+   static options values = { "snapshots", false };
+   return values;
+}
+
+AES_TEST_INLINE uint64_t aes::test::snapshot::hash(const unsigned char* data, size_t size) noexcept
+{
+   // Four independent lanes of 8 bytes the compiler keeps in vector registers, folded at the end.
+   const uint64_t prime = 0x100000001b3ULL;
+   uint64_t lanes[4] = { 0xcbf29ce484222325ULL, 0x84222325cbf29ce4ULL, 0x9e3779b97f4a7c15ULL, 0xc2b2ae3d27d4eb4fULL };
+   size_t i = 0;
+
+   for (; i + 32 <= size; i += 32)
+   {
+      for (size_t lane = 0; lane < 4; lane++)
+      {
+         uint64_t word;
+         std::memcpy(&word, data + i + lane * 8, sizeof(word));
+         lanes[lane] = (lanes[lane] ^ word) * prime;
+      }
+   }
+
+   uint64_t value = size;
+   for (uint64_t lane : lanes)
+   {
+      value = (value ^ (lane >> 29) ^ lane) * prime;
+   }
+   for (; i < size; i++)
+   {
+      value = (value ^ data[i]) * prime;
+   }
+   return value ^ (value >> 32);
+}
+
+AES_TEST_INLINE std::string aes::test::snapshot::path(const std::string& name)
+{
+   const std::string& directory = settings().directory_;
+   return directory.empty() ? name + ".snap" : directory + "/" + name + ".snap";
+}
+
+AES_TEST_INLINE aes::test::snapshot::result aes::test::snapshot::compare(const std::string& name, const void* data, size_t size)
+{
+   const unsigned char* actual = static_cast<const unsigned char*>(data);
+   std::string file_path(path(name));
+   result values = { false, false, false, 0, 0, 0, {} };
+
+   if (settings().update_)
+   {
+      values.updated_ = true;
+      values.found_ = values.matched_ = write(name, data, size);
+      values.expected_size_ = size;
+      return values;
+   }
+
+   detail::mapping expected(file_path);
+   if (!expected.is_open())
+   {
+      return values;
+   }
+   values.found_ = true;
+   values.expected_size_ = expected.size();
+
+   // The index only stands for the snapshot it was written with.
+   detail::index stored;
+   bool indexed = detail::read_index(file_path + ".idx", stored) && stored.size_ == expected.size() && stored.modified_ == expected.modified();
+
+   uint64_t common = std::min<uint64_t>(size, expected.size());
+   for (uint64_t offset = 0; offset < common; offset += chunk_size_)
+   {
+      size_t length = size_t(std::min<uint64_t>(chunk_size_, common - offset));
+      size_t chunk = size_t(offset / chunk_size_);
+      bool same_chunk = std::min<uint64_t>(chunk_size_, expected.size() - offset) == length;
+      if (indexed && same_chunk && stored.hashes_[chunk] == hash(actual + offset, length))
+      {
+         values.skipped_bytes_ += length;
+         continue;
+      }
+      if (std::memcmp(expected.data() + offset, actual + offset, length) != 0)
+      {
+         detail::find_differences(expected.data() + offset, actual + offset, length, offset, values);
+      }
+   }
+
+   if (size != expected.size())
+   {
+      if (!values.differences_.empty() && values.differences_.back().end_ == common)
+      {
+         values.differences_.back().end_ = std::max<uint64_t>(size, expected.size());
+      }
+      else if (values.differences_.size() < max_differences_)
+      {
+         values.differences_.push_back(difference{ common, std::max<uint64_t>(size, expected.size()) });
+         values.difference_count_++;
+      }
+      else
+      {
+         values.difference_count_++;
+      }
+   }
+
+   values.matched_ = values.difference_count_ == 0;
+   return values;
+}
+
+AES_TEST_INLINE bool aes::test::snapshot::write(const std::string& name, const void* data, size_t size)
+{
+   const unsigned char* bytes = static_cast<const unsigned char*>(data);
+   std::string file_path(path(name));
+
+   if (!detail::replace(file_path, data, size))
+   {
+      return false;
+   }
+
+   // The index records the modification time of the snapshot as written.
+   detail::mapping written(file_path);
+   uint64_t count = (uint64_t(size) + chunk_size_ - 1) / chunk_size_;
+   uint64_t file_size = size;
+   int64_t modified = written.modified();
+   std::string index(detail::index_magic, sizeof(detail::index_magic));
+
+   index.append(reinterpret_cast<const char*>(&file_size), sizeof(file_size));
+   index.append(reinterpret_cast<const char*>(&modified), sizeof(modified));
+   index.append(reinterpret_cast<const char*>(&count), sizeof(count));
+   for (uint64_t offset = 0; offset < size; offset += chunk_size_)
+   {
+      uint64_t value = hash(bytes + offset, size_t(std::min<uint64_t>(chunk_size_, size - offset)));
+      index.append(reinterpret_cast<const char*>(&value), sizeof(value));
+   }
+   return written.is_open() && detail::replace(file_path + ".idx", index.data(), index.size());
+}
+#endif
@@ -0,0 +1,300 @@
+/****
+ * Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "unit_test_config.h"
+#include <string>
+#include <vector>
+#if defined(__linux__)
+#include <sched.h>
+#endif
+#if defined(AES_TEST_IMPLEMENTATION)
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////
+// CPU and NUMA topology
+//
+// The topology is read from sysfs: the online CPUs, the core and package of each,
+// its SMT siblings and the NUMA node owning it. A placement spreads the local
+// workers of a distributed run over the nodes, one CPU each, whole cores first so
+// that two workers share a core only once every core has one. With SMT siblings
+// left idle only the first thread of each core is handed out.
+//
+// A placed worker is pinned to its CPU and prefers the memory of its node, so the
+// pages it touches come from the local node as long as the node has memory left.
+
+namespace aes
+{
+   namespace test
+   {
+      namespace topology
+      {
+         struct cpu
+         {
+            int id_;
+            int core_;
+            int package_;
+            int node_;
+            bool primary_;                   // first thread of its core, the others are its SMT siblings
+         };
+
+         struct machine
+         {
+            std::vector<cpu> cpus_;          // by id
+            int nodes_;
+         };
+
+         struct slot
+         {
+            int cpu_;
+            int node_;
+         };
+
+         std::vector<int> parse_list(const std::string& list);
+         machine read(const std::string& root);
+         machine current();
+         std::vector<slot> plan(const machine& topology, unsigned count, bool smt_idle);
+         bool bind(const slot& placement) noexcept;
+         std::string describe(const machine& topology);
+      }
+   }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// topology functions implementation
+
+#if defined(AES_TEST_IMPLEMENTATION)
+namespace aes
+{
+   namespace test
+   {
+      namespace topology
+      {
+         namespace detail
+         {
+            inline bool read_line(const std::string& path, std::string& line)
+            {
+               std::ifstream file(path);
+               return bool(std::getline(file, line));
+            }
+
+            inline int read_number(const std::string& path, int fallback)
+            {
+               std::string line;
+               return read_line(path, line) && !line.empty() ? std::atoi(line.c_str()) : fallback;
+            }
+         }
+      }
+   }
+}
+
+// "0-3,8,10-11" as written by the kernel for CPU and node lists.
+AES_TEST_INLINE std::vector<int> aes::test::topology::parse_list(const std::string& list)
+{
+   std::vector<int> values;
+   std::stringstream ss(list);
+   std::string range;
+   while (std::getline(ss, range, ','))
+   {
+      size_t dash = range.find('-');
+      if (range.find_first_of("0123456789") == std::string::npos)
+      {
+         continue;
+      }
+      int first = std::atoi(range.c_str());
+      int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+      for (int value = first; value <= last; ++value)
+      {
+         values.push_back(value);
+      }
+   }
+   return values;
+}
+
+AES_TEST_INLINE aes::test::topology::machine aes::test::topology::read(const std::string& root)
+{
+   machine topology{ std::vector<cpu>(), 0 };
+   std::string list;
+   if (!detail::read_line(root + "/cpu/online", list))
+   {
+      return topology;
+   }
+
+   std::map<int, int> nodes;
+   std::string online;
+   if (detail::read_line(root + "/node/online", online))
+   {
+      for (int node : parse_list(online))
+      {
+         std::string cpus;
+         if (detail::read_line(root + "/node/node" + std::to_string(node) + "/cpulist", cpus))
+         {
+            for (int id : parse_list(cpus))
+            {
+               nodes[id] = node;
+            }
+         }
+      }
+   }
+
+   std::set<int> found;
+   for (int id : parse_list(list))
+   {
+      std::string base(root + "/cpu/cpu" + std::to_string(id) + "/topology/");
+      std::string siblings;
+      std::vector<int> threads = detail::read_line(base + "thread_siblings_list", siblings) ? parse_list(siblings) : std::vector<int>(1, id);
+      auto node = nodes.find(id);
+
+      cpu entry;
+      entry.id_ = id;
+      entry.core_ = detail::read_number(base + "core_id", id);
+      entry.package_ = detail::read_number(base + "physical_package_id", 0);
+      entry.node_ = node == nodes.end() ? 0 : node->second;
+      entry.primary_ = threads.empty() || *std::min_element(threads.begin(), threads.end()) == id;
+      topology.cpus_.push_back(entry);
+      found.insert(entry.node_);
+   }
+
+   topology.nodes_ = int(found.size());
+   return topology;
+}
+
+AES_TEST_INLINE aes::test::topology::machine aes::test::topology::current()
+{
+   machine topology = read("/sys/devices/system");
+#if defined(__linux__)
+   // Only the CPUs the process may run on, a container or taskset may hand out a part of the machine.
+   cpu_set_t allowed;
+   CPU_ZERO(&allowed);
+   if (::sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+   {
+      topology.cpus_.erase(std::remove_if(topology.cpus_.begin(), topology.cpus_.end(), [&allowed](const cpu& entry)
+      {
+         return entry.id_ >= CPU_SETSIZE || !CPU_ISSET(entry.id_, &allowed);
+      }), topology.cpus_.end());
+   }
+#endif
+   std::set<int> nodes;
+   for (const cpu& entry : topology.cpus_)
+   {
+      nodes.insert(entry.node_);
+   }
+   topology.nodes_ = int(nodes.size());
+   return topology;
+}
+
+AES_TEST_INLINE std::vector<aes::test::topology::slot> aes::test::topology::plan(const machine& topology, unsigned count, bool smt_idle)
+{
+   // The CPUs of each node, the first thread of every core before the SMT siblings.
+   std::map<int, std::vector<cpu>> nodes;
+   for (const cpu& entry : topology.cpus_)
+   {
+      if (entry.primary_ || !smt_idle)
+      {
+         nodes[entry.node_].push_back(entry);
+      }
+   }
+   for (auto& node : nodes)
+   {
+      std::stable_sort(node.second.begin(), node.second.end(), [](const cpu& left, const cpu& right)
+      {
+         return left.primary_ != right.primary_ ? left.primary_ : left.package_ != right.package_ ? left.package_ < right.package_ : left.core_ < right.core_;
+      });
+   }
+
+   // Round robin over the nodes, so that the workers are balanced between them.
+   std::vector<slot> order;
+   for (size_t index = 0; order.size() < topology.cpus_.size(); ++index)
+   {
+      bool added = false;
+      for (const auto& node : nodes)
+      {
+         if (index < node.second.size())
+         {
+            order.push_back(slot{ node.second[index].id_, node.first });
+            added = true;
+         }
+      }
+      if (!added)
+      {
+         break;
+      }
+   }
+
+   std::vector<slot> placements;
+   for (unsigned i = 0; i < count && !order.empty(); ++i)
+   {
+      placements.push_back(order[i % order.size()]);
+   }
+   return placements;
+}
+
+AES_TEST_INLINE bool aes::test::topology::bind(const slot& placement) noexcept
+{
+#if defined(__linux__)
+   cpu_set_t cpus;
+   CPU_ZERO(&cpus);
+   if (placement.cpu_ < 0 || placement.cpu_ >= CPU_SETSIZE)
+   {
+      return false;
+   }
+   CPU_SET(placement.cpu_, &cpus);
+   bool pinned = ::sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+
+#if defined(SYS_set_mempolicy)
+   // MPOL_PREFERRED, the allocations fall back to the other nodes rather than failing once the node is full.
+   const int preferred = 1;
+   const int bits = int(sizeof(unsigned long) * 8);
+   unsigned long nodes[16] = {};
+   if (placement.node_ >= 0 && placement.node_ < bits * 16 - 1)
+   {
+      nodes[placement.node_ / bits] |= 1ul << (placement.node_ % bits);
+      ::syscall(SYS_set_mempolicy, preferred, nodes, (unsigned long)(bits * 16));
+   }
+#endif
+   return pinned;
+#else
+   (void)placement;
+   return false;
+#endif
+}
+
+AES_TEST_INLINE std::string aes::test::topology::describe(const machine& topology)
+{
+   std::set<std::pair<int, int>> cores;
+   for (const cpu& entry : topology.cpus_)
+   {
+      cores.insert(std::make_pair(entry.package_, entry.core_));
+   }
+
+   std::stringstream ss;
+   ss << topology.nodes_ << (topology.nodes_ == 1 ? " node, " : " nodes, ") << cores.size() << (cores.size() == 1 ? " core, " : " cores, ") << topology.cpus_.size() << (topology.cpus_.size() == 1 ? " cpu" : " cpus");
+   return ss.str();
+}
+#endif
@@ -0,0 +1,392 @@
+/****
+ * Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "unit_test_config.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#if defined(AES_TEST_IMPLEMENTATION)
+#include <fstream>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////
+// Timeline of a test run
+//
+// The recorder keeps the spans and instant events of the run in the Chrome
+// trace-event format, which chrome://tracing and the Perfetto UI both load. Every
+// thread appends to a buffer of its own, so recording takes no lock once the
+// first event of the thread is in; the buffers are only read when the trace is
+// written, after the run. When the recorder is disabled an event costs a relaxed
+// load.
+//
+// Events are placed on lanes, shown as threads: each thread has a lane and the
+// coordinator of a distributed run adds one per worker process.
+
+namespace aes
+{
+   namespace test
+   {
+      namespace trace
+      {
+         struct event
+         {
+            char phase_;                     // 'X' for a span, 'i' for an instant event
+            uint32_t lane_;
+            int64_t start_ns_;
+            int64_t duration_ns_;
+            const char* category_;
+            std::string name_;
+         };
+
+         class recorder
+         {
+         public:
+            recorder() noexcept;
+            recorder(const recorder&) = delete;
+            ~recorder() noexcept = default;
+
+         public:
+            recorder& operator=(const recorder&) = delete;
+
+         public:
+            static recorder& get() noexcept;
+
+         public:
+            bool enabled() const noexcept
+            {
+               return enabled_.load(std::memory_order_relaxed);
+            }
+
+            void enable(bool enable) noexcept;
+            uint32_t lane(const std::string& name);
+            void name_thread(const std::string& name);
+            void complete(const char* category, const std::string& name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+            void complete(const char* category, const std::string& name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end, uint32_t lane);
+            void instant(const char* category, const std::string& name);
+            void instant(const char* category, const std::string& name, uint32_t lane);
+
+         public:
+            size_t size() const;
+            void write(std::ostream& out) const;
+            bool write(const std::string& path) const;
+
+         private:
+            struct thread_buffer
+            {
+               uint32_t lane_;
+               std::vector<event> events_;
+            };
+
+         private:
+            thread_buffer& local();
+            int64_t since_start(std::chrono::steady_clock::time_point time) const noexcept;
+
+         private:
+            std::atomic<bool> enabled_;
+            const uint64_t id_;                                     // tells the recorders apart in the thread caches
+            const std::chrono::steady_clock::time_point start_;
+            mutable std::mutex lock_;                               // taken for the first event of a thread and for new lanes
+            std::vector<std::unique_ptr<thread_buffer>> buffers_;
+            std::vector<std::string> lanes_;
+         };
+
+         // Records the lifetime of the span on the lane of the thread.
+         class span
+         {
+         public:
+            span(const char* category, const std::string& name);
+            span(const span&) = delete;
+            ~span() noexcept;
+
+         public:
+            span& operator=(const span&) = delete;
+
+         private:
+            const char* category_;
+            std::string name_;
+            std::chrono::steady_clock::time_point start_;
+            bool enabled_;
+         };
+      }
+   }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// recorder class implementation
+
+#if defined(AES_TEST_IMPLEMENTATION)
+namespace aes
+{
+   namespace test
+   {
+      namespace trace
+      {
+         namespace detail
+         {
+            inline uint64_t next_recorder_id() noexcept
+            {
+               static std::atomic<uint64_t> next(0);
+               return ++next;
+            }
+
+            inline void append_microseconds(std::string& out, int64_t ns)
+            {
+               // Microseconds with three decimals, without going through the locale.
+               if (ns < 0)
+               {
+                  out += '-';
+                  ns = -ns;
+               }
+               std::string fraction(std::to_string(ns % 1000));
+               out += std::to_string(ns / 1000);
+               out += '.';
+               out.append(3 - fraction.size(), '0');
+               out += fraction;
+            }
+
+            inline void append_string(std::string& out, const std::string& text)
+            {
+               size_t first = text.find_first_not_of(' ');
+               size_t last = text.find_last_not_of(' ');
+               static const char digits[] = "0123456789abcdef";
+
+               out += '"';
+               for (size_t i = first; first != std::string::npos && i <= last; i++)
+               {
+                  unsigned char c = static_cast<unsigned char>(text[i]);
+                  switch (c)
+                  {
+                  case '"': out += "\\\""; break;
+                  case '\\': out += "\\\\"; break;
+                  case '\n': out += "\\n"; break;
+                  case '\r': out += "\\r"; break;
+                  case '\t': out += "\\t"; break;
+                  default:
+                     if (c < 0x20)
+                     {
+                        out += "\\u00";
+                        out += digits[c >> 4];
+                        out += digits[c & 0xf];
+                     }
+                     else
+                     {
+                        out += static_cast<char>(c);
+                     }
+                  }
+               }
+               out += '"';
+            }
+         }
+      }
+   }
+}
+
+AES_TEST_INLINE aes::test::trace::recorder::recorder() noexcept
+   : enabled_(false)
+   , id_(detail::next_recorder_id())
+   , start_(std::chrono::steady_clock::now())
+   , lock_()
+   , buffers_()
+   , lanes_()
+{
+}
+
+AES_TEST_INLINE aes::test::trace::recorder& aes::test::trace::recorder::get() noexcept
+{
+   static recorder trace;
+   return trace;
+}
+
+AES_TEST_INLINE void aes::test::trace::recorder::enable(bool enable) noexcept
+{
+   enabled_.store(enable, std::memory_order_relaxed);
+}
+
+AES_TEST_INLINE uint32_t aes::test::trace::recorder::lane(const std::string& name)
+{
+   std::lock_guard<std::mutex> lock(lock_);
+   lanes_.push_back(name);
+   return static_cast<uint32_t>(lanes_.size());
+}
+
+AES_TEST_INLINE void aes::test::trace::recorder::name_thread(const std::string& name)
+{
+   uint32_t lane = local().lane_;
+   std::lock_guard<std::mutex> lock(lock_);
+   lanes_[lane - 1] = name;
+}
+
+AES_TEST_INLINE void aes::test::trace::recorder::complete(const char* category, const std::string& name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+   if (enabled())
+   {
+      thread_buffer& buffer = local();
+      int64_t begin = since_start(start);
+      buffer.events_.push_back(event{ 'X', buffer.lane_, begin, since_start(end) - begin, category, name });
+   }
+}
+
+AES_TEST_INLINE void aes::test::trace::recorder::complete(const char* category, const std::string& name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end, uint32_t lane)
+{
+   if (enabled())
+   {
+      int64_t begin = since_start(start);
+      local().events_.push_back(event{ 'X', lane, begin, since_start(end) - begin, category, name });
+   }
+}
+
+AES_TEST_INLINE void aes::test::trace::recorder::instant(const char* category, const std::string& name)
+{
+   if (enabled())
+   {
+      thread_buffer& buffer = local();
+      buffer.events_.push_back(event{ 'i', buffer.lane_, since_start(std::chrono::steady_clock::now()), 0, category, name });
+   }
+}
+
+AES_TEST_INLINE void aes::test::trace::recorder::instant(const char* category, const std::string& name, uint32_t lane)
+{
+   if (enabled())
+   {
+      local().events_.push_back(event{ 'i', lane, since_start(std::chrono::steady_clock::now()), 0, category, name });
+   }
+}
+
+AES_TEST_INLINE size_t aes::test::trace::recorder::size() const
+{
+   std::lock_guard<std::mutex> lock(lock_);
+   size_t events = 0;
+   for (const std::unique_ptr<thread_buffer>& buffer : buffers_)
+   {
+      events += buffer->events_.size();
+   }
+   return events;
+}
+
+AES_TEST_INLINE void aes::test::trace::recorder::write(std::ostream& out) const
+{
+   std::lock_guard<std::mutex> lock(lock_);
+   std::string text("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+   bool first = true;
+
+   for (size_t i = 0; i < lanes_.size(); i++)
+   {
+      text += first ? "" : ",\n";
+      text += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(i + 1) + ",\"args\":{\"name\":";
+      detail::append_string(text, lanes_[i]);
+      text += "}}";
+      first = false;
+   }
+
+   for (const std::unique_ptr<thread_buffer>& buffer : buffers_)
+   {
+      for (const event& e : buffer->events_)
+      {
+         text += first ? "{\"name\":" : ",\n{\"name\":";
+         detail::append_string(text, e.name_);
+         text += ",\"cat\":\"";
+         text += e.category_;
+         text += e.phase_ == 'X' ? "\",\"ph\":\"X\"" : "\",\"ph\":\"i\",\"s\":\"t\"";
+         text += ",\"pid\":1,\"tid\":" + std::to_string(e.lane_) + ",\"ts\":";
+         detail::append_microseconds(text, e.start_ns_);
+         if (e.phase_ == 'X')
+         {
+            text += ",\"dur\":";
+            detail::append_microseconds(text, e.duration_ns_);
+         }
+         text += '}';
+         first = false;
+      }
+
+      // Written in slices, a long run does not hold its whole trace twice.
+      out << text;
+      text.clear();
+   }
+   out << text << "\n]}\n";
+}
+
+AES_TEST_INLINE bool aes::test::trace::recorder::write(const std::string& path) const
+{
+   std::ofstream file(path, std::ios::binary | std::ios::trunc);
+   write(file);
+   file.flush();
+   return bool(file);
+}
+
+AES_TEST_INLINE aes::test::trace::recorder::thread_buffer& aes::test::trace::recorder::local()
+{
+   struct cache
+   {
+      uint64_t owner_;
+      thread_buffer* buffer_;
+   };
+   static thread_local cache last = { 0, nullptr };
+
+   if (last.owner_ != id_)
+   {
+      std::lock_guard<std::mutex> lock(lock_);
+      lanes_.push_back("thread " + std::to_string(buffers_.size() + 1));
+      buffers_.emplace_back(new thread_buffer{ static_cast<uint32_t>(lanes_.size()), std::vector<event>() });
+      last = cache{ id_, buffers_.back().get() };
+   }
+   return *last.buffer_;
+}
+
+AES_TEST_INLINE int64_t aes::test::trace::recorder::since_start(std::chrono::steady_clock::time_point time) const noexcept
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(time - start_).count();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// span class implementation
+
+AES_TEST_INLINE aes::test::trace::span::span(const char* category, const std::string& name)
+   : category_(category)
+   , name_()
+   , start_()
+   , enabled_(recorder::get().enabled())
+{
+   if (enabled_)
+   {
+      name_ = name;
+      start_ = std::chrono::steady_clock::now();
+   }
+}
+
+AES_TEST_INLINE aes::test::trace::span::~span() noexcept
+{
+   if (enabled_)
+   {
+      try
+      {
+         recorder::get().complete(category_, name_, start_, std::chrono::steady_clock::now());
+      }
+      catch (...)
+      {
+      }
+   }
+}
+#endif
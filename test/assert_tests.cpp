@@ -16,6 +16,10 @@
 * along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "unit_test.h"
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <stdexcept>
 
 using namespace aes::test;
 using namespace aes::test::log;
@@ -325,3 +329,227 @@ test_method(assert_tests, "Testing the assert methods")
       assert_uint64_t_equal("Total count is now 1", 4, a.total());
    }
 }
+
+test_method(assert_range_tests, "Testing the range assertions")
+{
+   std::vector<int> values;
+   for (int i = 0; i < 100; ++i)
+   {
+      values.push_back(i);
+   }
+
+   test_section("Testing a range matching the predicate is one passed assertion")
+   {
+      std::stringstream out;
+      std::stringstream error;
+      my_logger log(out, error, level::verbose);
+      my_assert a(log);
+
+      int current_line = __LINE__;
+      std::stringstream ss;
+      ss << "PASS " << expected_file_name << " " << current_line << " All of: Values are small." << std::endl;
+
+      assert_is_true("All of the values match", a.all_of(__FILE__, current_line, "Values are small", values, [](int value) { return value < 100; }, 1));
+      assert_equal("Output string is correct", ss.str(), out.str());
+      assert_uint64_t_equal("Range is one assertion", 1, a.total());
+   }
+   test_section("Testing the first offenders of a range are reported")
+   {
+      std::stringstream out;
+      std::stringstream error;
+      my_logger log(out, error);
+      my_assert a(log);
+      size_t max_offenders = format::settings().max_offenders_;
+      format::settings().max_offenders_ = 3;
+
+      int current_line = __LINE__;
+      std::stringstream ss;
+      ss << "FAIL " << expected_file_name << " " << current_line << " All of: Values do not end with 3. 10 of 100 elements do not match: [3] 3, [13] 13, [23] 23 and 7 more." << std::endl;
+
+      bool result = a.all_of(__FILE__, current_line, "Values do not end with 3", values, [](int value) { return value % 10 != 3; }, 1);
+      format::settings().max_offenders_ = max_offenders;
+      assert_is_false("Range with offenders fails", result);
+      assert_equal("Error string is correct", ss.str(), error.str());
+      assert_uint64_t_equal("Failed count is 1", 1, a.failed());
+   }
+   test_section("Testing none of a range without random access")
+   {
+      std::stringstream out;
+      std::stringstream error;
+      my_logger log(out, error);
+      my_assert a(log);
+      std::list<std::string> names({ "one", "three", "two", "seven" });
+
+      int current_line = __LINE__;
+      std::stringstream ss;
+      ss << "FAIL " << expected_file_name << " " << current_line << " None of: Names are short. 2 of 4 elements match: [1] three, [3] seven." << std::endl;
+
+      assert_is_false("Long names are found", a.none_of(__FILE__, current_line, "Names are short", names, [](const std::string& name) { return name.size() > 3; }, 0));
+      assert_equal("Error string is correct", ss.str(), error.str());
+      assert_is_true("Names without a match pass", a.none_of(__FILE__, current_line, "Names are not empty", names, [](const std::string& name) { return name.empty(); }, 1));
+   }
+   test_section("Testing the count of the matching elements")
+   {
+      std::stringstream out;
+      std::stringstream error;
+      my_logger log(out, error);
+      my_assert a(log);
+
+      int current_line = __LINE__;
+      std::stringstream ss;
+      ss << "FAIL " << expected_file_name << " " << current_line << " Count if: Values above 97. Expected: 3. Actual: 2. 2 of 100 elements match: [98] 98, [99] 99." << std::endl;
+
+      assert_is_true("Count of the matches is checked", a.count_if(__FILE__, current_line, "Even values", 50, values, [](int value) { return value % 2 == 0; }, 1));
+      assert_is_false("Wrong count fails", a.count_if(__FILE__, current_line, "Values above 97", 3, values, [](int value) { return value > 97; }, 1));
+      assert_equal("Error string is correct", ss.str(), error.str());
+      assert_uint64_t_equal("Each range is one assertion", 2, a.total());
+   }
+   test_section("Testing a range split between threads reports the offenders in order")
+   {
+      std::stringstream out;
+      std::stringstream error;
+      my_logger log(out, error);
+      my_assert a(log);
+      std::vector<uint32_t> large(200000, 1);
+      large[10] = 0;
+      large[100000] = 0;
+      large[199999] = 0;
+
+      int current_line = __LINE__;
+      std::stringstream ss;
+      ss << "FAIL " << expected_file_name << " " << current_line << " All of: Values are set. 3 of 200000 elements do not match: [10] 0, [100000] 0, [199999] 0." << std::endl;
+
+      assert_is_false("Offenders of every thread are found", a.all_of(__FILE__, current_line, "Values are set", large, [](uint32_t value) { return value != 0; }, 4));
+      assert_equal("Error string is correct", ss.str(), error.str());
+      assert_is_true("Count of every thread is summed", a.count_if(__FILE__, current_line, "Values are unset", 3, large, [](uint32_t value) { return value == 0; }, 0));
+      assert_uint64_t_equal("Each range is one assertion", 2, a.total());
+   }
+   test_section("Testing a throwing predicate fails the range at its element")
+   {
+      std::stringstream out;
+      std::stringstream error;
+      my_logger log(out, error);
+      my_assert a(log);
+      auto throws_at_3 = [](int value) { if (value == 3) throw std::runtime_error("bad"); return true; };
+
+      int current_line = __LINE__;
+      std::stringstream ss;
+      ss << "FAIL " << expected_file_name << " " << current_line << " All of: Values are checked. Predicate threw at element [3]: bad." << std::endl;
+
+      bool result = a.all_of(__FILE__, current_line, "Values are checked", values, throws_at_3, 1);
+      assert_is_false("Throwing predicate fails", result);
+      assert_equal("Error string is correct", ss.str(), error.str());
+      result = a.none_of(__FILE__, current_line, "Values are checked", values, throws_at_3, 1);
+      assert_is_false("Throwing predicate fails none of", result);
+      result = a.count_if(__FILE__, current_line, "Values are checked", 100, values, throws_at_3, 1);
+      assert_is_false("Throwing predicate fails count if", result);
+      assert_uint64_t_equal("Each range is one failed assertion", 3, a.failed());
+   }
+   test_section("Testing a predicate throwing on a thread fails the range at its first element")
+   {
+      std::stringstream out;
+      std::stringstream error;
+      my_logger log(out, error);
+      my_assert a(log);
+      std::vector<uint32_t> large(200000, 1);
+      large[150000] = 2;
+      large[190000] = 2;
+
+      int current_line = __LINE__;
+      std::stringstream ss;
+      ss << "FAIL " << expected_file_name << " " << current_line << " All of: Values are checked. Predicate threw at element [150000]: bad." << std::endl;
+
+      bool result = a.all_of(__FILE__, current_line, "Values are checked", large, [](uint32_t value) { if (value == 2) throw std::runtime_error("bad"); return true; }, 4);
+      assert_is_false("Throwing predicate on a thread fails", result);
+      assert_equal("Error string is correct", ss.str(), error.str());
+   }
+}
+
+test_method(assert_site_tests, "Testing the assertions of a lean site")
+{
+   test_section("Testing a passing site is counted without being logged")
+   {
+      std::stringstream out;
+      std::stringstream error;
+      my_logger log(out, error);
+      my_assert a(log);
+      static const site where = { "Values are equal", __FILE__, __LINE__ };
+
+      assert_is_true("Equal values pass", a.equal(site_ref{ &where, nullptr }, 1, 1));
+      assert_is_true("True value passes", a.is_true(site_ref{ &where, nullptr }, true));
+      assert_is_true("Pass passes", a.pass(site_ref{ &where, nullptr }));
+      assert_string_empty("Output is still empty", out.str());
+      assert_uint64_t_equal("Passed count is 3", 3, a.passed());
+   }
+   test_section("Testing a failing site is logged with the text of its entry")
+   {
+      std::stringstream out;
+      std::stringstream error;
+      my_logger log(out, error);
+      my_assert a(log);
+      int current_line = __LINE__;
+      static const site where = { "Values are equal", __FILE__, current_line };
+
+      std::stringstream ss;
+      ss << "FAIL " << expected_file_name << " " << current_line << " Equal: Values are equal. Expected: 1. Actual: 2." << std::endl;
+      ss << "FAIL " << expected_file_name << " " << current_line << " Not null: Values are equal. Expected: nullptr. Actual: nullptr." << std::endl;
+
+      assert_is_false("Different values fail", a.equal(site_ref{ &where, nullptr }, 1, 2));
+      assert_is_false("Null pointer fails", a.not_null(site_ref{ &where, nullptr }, nullptr));
+      assert_equal("Error string is correct", ss.str(), error.str());
+      assert_uint64_t_equal("Failed count is 2", 2, a.failed());
+   }
+   test_section("Testing a site logs the message of the call when it is not a literal")
+   {
+      std::stringstream out;
+      std::stringstream error;
+      my_logger log(out, error, level::verbose);
+      my_assert a(log);
+      int current_line = __LINE__;
+      static const site where = { nullptr, __FILE__, current_line };
+      std::string message("Value " + std::to_string(3) + " is false");
+
+      std::stringstream ss;
+      ss << "PASS " << expected_file_name << " " << current_line << " Is false: " << message << "." << std::endl;
+
+      assert_is_true("False value passes", a.is_false(site_ref{ &where, &message }, false));
+      assert_equal("Output string is correct", ss.str(), out.str());
+   }
+   test_section("Testing the literal message of a site is told apart")
+   {
+      std::string message("built");
+      assert_equal("Literal is kept by the entry", std::string("literal"), std::string(site_literal("literal")));
+      assert_ptr_null("Literal is not passed by the call", site_text("literal"));
+      assert_ptr_null("Built message is not kept by the entry", site_literal(message));
+      assert_ptr_equal("Built message is passed by the call", &message, site_text(message));
+   }
+   test_section("Testing a message in a char buffer is passed by the call")
+   {
+      char buffer[16] = "buffer";
+      assert_ptr_null("Buffer is not kept by the entry", site_literal(buffer));
+      assert_equal("Buffer is copied for the call", std::string("buffer"), *site_text(buffer));
+   }
+#if defined(AES_TEST_SITE)
+   test_section("Testing a site logs the current text of a char buffer")
+   {
+      std::stringstream out;
+      std::stringstream error;
+      my_logger log(out, error);
+      my_assert a(log);
+      char buffers[2][16];
+
+      std::stringstream ss;
+      for (int index = 0; index < 2; ++index)
+      {
+         char (&buffer)[16] = buffers[index];
+         std::snprintf(buffer, sizeof(buffer), "Value %d", index);
+         int current_line = __LINE__ + 1;
+         a.is_false(AES_TEST_SITE(buffer), true);
+         ss << "FAIL " << expected_file_name << " " << current_line << " Is false: Value " << index << ". Expected: false. Actual: true." << std::endl;
+         std::strcpy(buffer, "Stale");
+      }
+
+      assert_equal("Error string is correct", ss.str(), error.str());
+   }
+#endif
+}
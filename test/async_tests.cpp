@@ -0,0 +1,439 @@
+/****
+* Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+* All rights reserved.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "unit_test.h"
+
+using namespace aes::test;
+using namespace aes::test::log;
+using namespace aes::test::async;
+
+using my_logger = logger_base<std::stringstream, std::stringstream>;
+
+namespace
+{
+   std::stringstream out;
+   std::stringstream err;
+
+   template <int _Id>
+   class mock_async_suite_singleton
+   {
+   public:
+      static test_suite_base<mock_async_suite_singleton, my_logger>& get()
+      {
+         static my_logger log(out, err);
+         static test_suite_base<mock_async_suite_singleton, my_logger> test_suite(log);
+         return test_suite;
+      }
+   };
+
+   // Sleeps the given delays one after the other, recording its name in the trace after each one
+   template <int _Id>
+   class mock_async_test : public async_test_base<mock_async_suite_singleton<_Id>, my_logger>
+   {
+   public:
+      using async_test_base<mock_async_suite_singleton<_Id>, my_logger>::name;
+
+   public:
+      mock_async_test(const std::string& test_name, std::vector<duration> delays, std::string& trace, bool complete = true) noexcept
+         : async_test_base<mock_async_suite_singleton<_Id>, my_logger>(test_name, "description")
+         , delays_(delays)
+         , trace_(trace)
+         , complete_(complete)
+      {
+      }
+
+   private:
+      void run_async(assert_base<my_logger>& assert, event_loop& loop, completion done)
+      {
+         step(assert, loop, done, 0);
+      }
+
+      void step(assert_base<my_logger>& assert, event_loop& loop, completion done, size_t index)
+      {
+         if (index == delays_.size())
+         {
+            assert.pass(__FILE__, __LINE__, name());
+            if (complete_)
+            {
+               done();
+            }
+            return;
+         }
+
+         loop.schedule(delays_[index], [this, &assert, &loop, done, index]()
+         {
+            trace_ += name()[0];
+            step(assert, loop, done, index + 1);
+         });
+      }
+
+   private:
+      std::vector<duration> delays_;
+      std::string& trace_;
+      bool complete_;
+   };
+
+   // Throws from its first scheduled callback, once the test has been started
+   template <int _Id>
+   class throwing_async_test : public async_test_base<mock_async_suite_singleton<_Id>, my_logger>
+   {
+   public:
+      throwing_async_test(const std::string& test_name) noexcept
+         : async_test_base<mock_async_suite_singleton<_Id>, my_logger>(test_name, "description")
+      {
+      }
+
+   private:
+      void run_async(assert_base<my_logger>&, event_loop& loop, completion done)
+      {
+         loop.schedule(std::chrono::milliseconds(1), []() { throw std::runtime_error("callback failed"); });
+         loop.schedule(std::chrono::milliseconds(2), [done]() { done(); });
+      }
+   };
+
+#if defined(AES_TEST_COROUTINES)
+   // Counts the coroutine frames alive through a local of the coroutine
+   int coroutine_frames = 0;
+
+   struct frame_counter
+   {
+      frame_counter() { coroutine_frames++; }
+      ~frame_counter() { coroutine_frames--; }
+   };
+
+   // Sleeps the given delay, then throws when asked to
+   template <int _Id>
+   class mock_coroutine_test : public async_test_base<mock_async_suite_singleton<_Id>, my_logger>
+   {
+   public:
+      mock_coroutine_test(const std::string& test_name, duration delay, bool throws) noexcept
+         : async_test_base<mock_async_suite_singleton<_Id>, my_logger>(test_name, "description")
+         , delay_(delay)
+         , throws_(throws)
+      {
+      }
+
+   private:
+      void run_async(assert_base<my_logger>& assert, event_loop& loop, completion done)
+      {
+         task_ = run_coroutine(assert, loop);
+         task_.start(done);
+      }
+
+      void end_async()
+      {
+         task_ = task();
+      }
+
+      task run_coroutine(assert_base<my_logger>& assert, event_loop& loop)
+      {
+         frame_counter counter;
+         co_await sleep(loop, delay_);
+         if (throws_)
+         {
+            throw std::runtime_error("coroutine failed");
+         }
+         assert.pass(__FILE__, __LINE__, "Coroutine resumed");
+      }
+
+   private:
+      duration delay_;
+      bool throws_;
+      task task_;
+   };
+#endif
+
+   int async_callbacks = 0;
+}
+
+test_method(event_loop_tests, "Testing the event loop")
+{
+   test_section("Testing posted callbacks and timers run in order")
+   {
+      event_loop loop(true);
+      std::string trace;
+
+      loop.schedule(std::chrono::milliseconds(20), [&trace]() { trace += "3"; });
+      loop.schedule(std::chrono::milliseconds(10), [&trace]() { trace += "2"; });
+      loop.post([&trace]() { trace += "1"; });
+      loop.schedule(std::chrono::milliseconds(20), [&trace]() { trace += "4"; });
+
+      assert_uint64_t_equal("Every callback has been executed", 4, loop.run());
+      assert_equal("Callbacks ran by due time, then in scheduling order", std::string("1234"), trace);
+      assert_is_true("Loop is empty", loop.empty());
+   }
+   test_section("Testing virtual time does not wait")
+   {
+      event_loop loop(true);
+      bool woken = false;
+      auto start = std::chrono::steady_clock::now();
+
+      loop.schedule(std::chrono::hours(1), [&woken]() { woken = true; });
+      loop.run();
+
+      assert_is_true("Timer of one hour has been executed", woken);
+      assert_is_true("Virtual clock advanced by one hour", loop.now() >= std::chrono::hours(1));
+      assert_is_true("No wall clock time has been spent", std::chrono::steady_clock::now() - start < std::chrono::seconds(10));
+   }
+   test_section("Testing real time waits for the timers")
+   {
+      event_loop loop;
+      auto start = std::chrono::steady_clock::now();
+
+      loop.schedule(std::chrono::milliseconds(5), []() {});
+      loop.run();
+
+      assert_is_true("Wall clock time has been spent", std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(5));
+   }
+}
+
+test_method(event_loop_context_tests, "Testing the contexts of the event loop")
+{
+   test_section("Testing an exception ends the context of the callback")
+   {
+      event_loop loop(true);
+      std::string trace;
+      std::string error;
+      std::shared_ptr<context> owner = std::make_shared<context>([&error](std::exception_ptr e)
+      {
+         try
+         {
+            std::rethrow_exception(e);
+         }
+         catch (const std::exception& ex)
+         {
+            error = ex.what();
+         }
+      }, std::chrono::seconds(10));
+
+      loop.start(owner, [&loop, &trace]()
+      {
+         loop.schedule(std::chrono::milliseconds(1), []() { throw std::runtime_error("thrown"); });
+         loop.schedule(std::chrono::milliseconds(2), [&trace]() { trace += "dropped"; });
+      });
+      loop.schedule(std::chrono::milliseconds(3), [&trace]() { trace += "other"; });
+
+      assert_uint64_t_equal("Callbacks of the context up to the exception have been executed", 3, loop.run());
+      assert_equal("Exception has been passed to the context", std::string("thrown"), error);
+      assert_is_true("Context has ended", owner->cancelled());
+      assert_equal("Callback left in the context has been dropped", std::string("other"), trace);
+   }
+   test_section("Testing an exception without context is thrown out of the loop")
+   {
+      event_loop loop(true);
+      bool thrown = false;
+
+      loop.post([]() { throw std::runtime_error("thrown"); });
+      try
+      {
+         loop.run();
+      }
+      catch (const std::runtime_error&)
+      {
+         thrown = true;
+      }
+      assert_is_true("Exception has been thrown by run", thrown);
+   }
+   test_section("Testing a context expires at its deadline")
+   {
+      event_loop loop(true);
+      std::string error;
+      duration expired;
+      bool late = false;
+      std::shared_ptr<context> owner = std::make_shared<context>([&error, &expired, &loop](std::exception_ptr e)
+      {
+         try
+         {
+            std::rethrow_exception(e);
+         }
+         catch (const timeout_error& ex)
+         {
+            error = ex.what();
+            expired = loop.now();
+         }
+      }, std::chrono::milliseconds(50));
+
+      loop.start(owner, [&loop, &late]() { loop.schedule(std::chrono::hours(1), [&late]() { late = true; }); });
+      loop.run();
+
+      assert_equal("Timeout has been passed to the context", std::string("timed out after 50 ms"), error);
+      assert_is_false("Timer past the deadline has been dropped", late);
+      assert_is_true("Context expired at its deadline", expired == std::chrono::milliseconds(50));
+   }
+   test_section("Testing a cancelled context does not hold the loop")
+   {
+      event_loop loop;
+      std::shared_ptr<context> owner = std::make_shared<context>(failure(), std::chrono::hours(1));
+      auto start = std::chrono::steady_clock::now();
+
+      loop.start(owner, [&loop, owner]()
+      {
+         loop.schedule(std::chrono::hours(1), []() {});
+         owner->cancel();
+      });
+      loop.run();
+
+      assert_is_true("Loop ended without waiting for the timer", std::chrono::steady_clock::now() - start < std::chrono::seconds(10));
+   }
+}
+
+test_method(async_test_base_tests, "Testing the asynchronous test base class")
+{
+   test_section("Testing a test runs on its own loop")
+   {
+      std::string trace;
+      mock_async_test<0> test("a_own_loop", { std::chrono::milliseconds(1), std::chrono::milliseconds(1) }, trace);
+
+      assert_is_true("Running the asynchronous test is successful", test.run_test());
+      assert_equal("Every step has been executed", std::string("aa"), trace);
+      assert_uint64_t_equal("Assert of the test has been counted", 1, test.passed());
+   }
+   test_section("Testing a test that never completes fails")
+   {
+      std::string trace;
+      mock_async_test<0> test("b_incomplete", { std::chrono::milliseconds(1) }, trace, false);
+
+      assert_is_false("Running the incomplete test fails", test.run_test());
+      assert_uint64_t_equal("Incomplete test has been reported", 1, test.failed());
+      assert_is_true("Reason of the failure is logged", err.str().find("Asynchronous test did not complete") != std::string::npos);
+   }
+   test_section("Testing the asserts of a test are written to the result log")
+   {
+      const std::string file = "async_tests.bin";
+      std::string trace;
+      result_log::writer writer;
+      mock_async_test<0> test("e_logged", { std::chrono::milliseconds(1) }, trace);
+
+      assert_is_true("Result log has been opened", writer.open(file));
+      test.result_log(&writer, writer.begin_test("e_logged"));
+      test.run_test();
+      test.result_log(nullptr, 0);
+      writer.close();
+
+      result_log::reader reader;
+      result_log::record r = {};
+      uint64_t passed = 0;
+      assert_is_true("Result log has been opened for reading", reader.open(file));
+      while (reader.next(r))
+      {
+         passed += r.type == result_log::record_type::pass;
+      }
+      assert_uint64_t_equal("Assert run from the loop has been logged", 1, passed);
+      std::remove(file.c_str());
+   }
+   test_section("Testing an exception of a scheduled callback fails the test")
+   {
+      throwing_async_test<0> test("f_throwing");
+
+      assert_is_false("Running the throwing test fails", test.run_test());
+      assert_uint64_t_equal("Exception has been reported", 1, test.failed());
+      assert_is_true("Exception is logged", err.str().find("Unhandled exception: callback failed") != std::string::npos);
+   }
+   test_section("Testing a test fails at its timeout")
+   {
+      std::string trace;
+      mock_async_test<0> test("g_slow", { std::chrono::milliseconds(1), std::chrono::hours(1) }, trace);
+      auto start = std::chrono::steady_clock::now();
+
+      test.timeout(std::chrono::milliseconds(20));
+      assert_is_false("Running the slow test fails", test.run_test());
+      assert_equal("Steps before the timeout have been executed", std::string("g"), trace);
+      assert_is_true("Timeout is logged", err.str().find("Asynchronous test timed out after 20 ms") != std::string::npos);
+      assert_is_true("Loop did not wait for the dropped step", std::chrono::steady_clock::now() - start < std::chrono::seconds(10));
+   }
+#if defined(AES_TEST_COROUTINES)
+   test_section("Testing an exception of a coroutine fails the test")
+   {
+      mock_coroutine_test<0> test("h_coroutine_throwing", std::chrono::milliseconds(1), true);
+
+      assert_is_false("Running the throwing coroutine fails", test.run_test());
+      assert_is_true("Exception is logged", err.str().find("Unhandled exception: coroutine failed") != std::string::npos);
+      assert_equal("Coroutine frame has been destroyed", 0, coroutine_frames);
+   }
+   test_section("Testing the frame of a coroutine that timed out is destroyed")
+   {
+      mock_coroutine_test<0> test("i_coroutine_slow", std::chrono::hours(1), false);
+
+      test.timeout(std::chrono::milliseconds(5));
+      assert_is_false("Running the slow coroutine fails", test.run_test());
+      assert_equal("Coroutine frame has been destroyed", 0, coroutine_frames);
+   }
+   test_section("Testing the frame of a coroutine that completed is destroyed")
+   {
+      mock_coroutine_test<0> test("j_coroutine", std::chrono::milliseconds(1), false);
+
+      assert_is_true("Running the coroutine is successful", test.run_test());
+      assert_uint64_t_equal("Assert after the sleep has been counted", 1, test.passed());
+      assert_equal("Coroutine frame has been destroyed", 0, coroutine_frames);
+   }
+#endif
+   test_section("Testing the tests of a suite are in flight together")
+   {
+      std::string trace;
+      test_suite_base<mock_async_suite_singleton<1>, my_logger>& test_suite = mock_async_suite_singleton<1>::get();
+      test_suite.virtual_time(true);
+
+      mock_async_test<1> first("c_first", { std::chrono::seconds(10), std::chrono::seconds(20) }, trace);
+      mock_async_test<1> second("d_second", { std::chrono::seconds(15), std::chrono::seconds(10) }, trace);
+
+      // Steps end at 10s, 15s, 25s and 30s on the virtual clock
+      assert_is_true("Running the suite is successful", test_suite.run("title"));
+      assert_equal("Steps of both tests have been interleaved", std::string("cddc"), trace);
+      assert_is_true("Both tests are reported", out.str().find("c_first") != std::string::npos && out.str().find("d_second") != std::string::npos);
+   }
+   test_section("Testing the tests of a suite are metered until their completion")
+   {
+      std::string trace;
+      test_suite_base<mock_async_suite_singleton<2>, my_logger>& test_suite = mock_async_suite_singleton<2>::get();
+      test_suite.virtual_time(true);
+
+      mock_async_test<2> completing("h_completing", { std::chrono::seconds(10) }, trace);
+      mock_async_test<2> incomplete("i_incomplete", { std::chrono::seconds(10) }, trace, false);
+
+      metrics::snapshot before(metrics::registry::get().sample());
+      bool result = test_suite.run("title");
+      metrics::snapshot after(metrics::registry::get().sample());
+      assert_is_false("Running the suite fails", result);
+      assert_uint64_t_equal("Both tests have completed", 2, after.completed_ - before.completed_);
+      assert_uint64_t_equal("Incomplete test has failed", 1, after.failed_tests_ - before.failed_tests_);
+      assert_is_true("No test is left running", after.running_ == before.running_);
+   }
+}
+
+async_test_method(async_test_method_tests, "Testing the asynchronous test method")
+{
+   loop.schedule(std::chrono::milliseconds(1), [&assert, &loop, done]()
+   {
+      async_callbacks++;
+      loop.post([&assert, done]()
+      {
+         async_callbacks++;
+         assert_equal("Both callbacks have been executed", 2, async_callbacks);
+         done();
+      });
+   });
+}
+
+#if defined(AES_TEST_COROUTINES)
+coroutine_test_method(coroutine_test_method_tests, "Testing the coroutine test method")
+{
+   duration start = loop.now();
+   co_await sleep(loop, std::chrono::milliseconds(2));
+   co_await sleep(loop, std::chrono::milliseconds(2));
+   assert_is_true("Coroutine resumed after both sleeps", loop.now() - start >= std::chrono::milliseconds(4));
+}
+#endif
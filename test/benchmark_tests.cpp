@@ -0,0 +1,207 @@
+/****
+* Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+* All rights reserved.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "unit_test.h"
+#include <cmath>
+#include <numeric>
+
+using namespace aes::test;
+using namespace aes::test::benchmark;
+using namespace aes::test::log;
+
+using my_logger = logger_base<std::stringstream, std::stringstream>;
+
+namespace
+{
+   std::stringstream out;
+   std::stringstream err;
+
+   class mock_benchmark_suite_singleton
+   {
+   public:
+      static test_suite_base<mock_benchmark_suite_singleton, my_logger>& get()
+      {
+         static my_logger log(out, err);
+         static test_suite_base<mock_benchmark_suite_singleton, my_logger> test_suite(log);
+         return test_suite;
+      }
+   };
+
+   // Records the time of a curve instead of timing its body, so the fit does not depend on the load of the machine.
+   class mock_complexity_test : public complexity_test_base<mock_benchmark_suite_singleton, my_logger>
+   {
+   public:
+      mock_complexity_test(complexity declared, double (*curve)(double)) noexcept
+         : complexity_test_base("complexity", "description", declared, 64, 1024)
+         , curve_(curve)
+      {
+      }
+
+   private:
+      void run_complexity(assert_base<my_logger>&, state& state)
+      {
+         state.record(3.0 * curve_(double(state.size())) + 50.0);
+      }
+
+   private:
+      double (*curve_)(double);
+   };
+
+   double quadratic_curve(double n)
+   {
+      return n * n;
+   }
+
+   std::vector<sample> make_samples(double (*curve)(double))
+   {
+      std::vector<sample> samples;
+      for (uint64_t size : sizes(16, 1 << 20, 2.0))
+      {
+         samples.push_back(sample{ size, 3.0 * curve(double(size)) + 50.0 });
+      }
+      return samples;
+   }
+}
+
+test_method(benchmark_fit_tests, "Testing the complexity fits of the benchmark samples")
+{
+   test_section("Testing the sweep is geometric and ends on the last size")
+   {
+      assert_vector_equal("Sizes double", std::vector<uint64_t>({ 8, 16, 32, 64, 100 }), sizes(8, 100, 2.0));
+      assert_vector_equal("Single size", std::vector<uint64_t>({ 10 }), sizes(10, 10, 2.0));
+   }
+   test_section("Testing every class is recognized")
+   {
+      assert_equal("Constant", std::string("O(1)"), std::string(benchmark::name(best_fit(make_samples([](double) { return 1000.0; })).complexity_)));
+      assert_equal("Logarithmic", std::string("O(log n)"), std::string(benchmark::name(best_fit(make_samples([](double n) { return 100.0 * std::log2(n); })).complexity_)));
+      assert_equal("Linear", std::string("O(n)"), std::string(benchmark::name(best_fit(make_samples([](double n) { return n; })).complexity_)));
+      assert_equal("Linearithmic", std::string("O(n log n)"), std::string(benchmark::name(best_fit(make_samples([](double n) { return n * std::log2(n); })).complexity_)));
+      assert_equal("Quadratic", std::string("O(n^2)"), std::string(benchmark::name(best_fit(make_samples([](double n) { return n * n; })).complexity_)));
+   }
+   test_section("Testing the coefficient and the error of a fit")
+   {
+      std::vector<sample> samples = { { 10, 20.0 }, { 20, 40.0 }, { 40, 80.0 } };
+      fit linear = fit_to(samples, complexity::linear);
+      assert_is_true("Coefficient is the time per element", std::fabs(linear.coefficient_ - 2.0) < 1e-9);
+      assert_is_true("Exact fit has no error", linear.rms_ < 1e-9);
+      assert_is_true("Constant fit has an error", fit_to(samples, complexity::constant).rms_ > 0.3);
+   }
+}
+
+test_method(benchmark_noise_tests, "Testing the warmup, the outliers and the environment of the benchmarks")
+{
+   test_section("Testing the warmup ends when the last runs agree")
+   {
+      assert_is_false("Too few runs", is_steady({ 100.0, 100.0 }));
+      assert_is_false("Runs still dropping", is_steady({ 500.0, 300.0, 200.0, 150.0, 120.0, 100.0 }));
+      assert_is_true("Runs within the spread", is_steady({ 500.0, 102.0, 100.0, 101.0, 103.0, 100.0 }));
+   }
+   test_section("Testing the outliers are rejected")
+   {
+      statistics values = robust({ 100.0, 101.0, 99.0, 100.0, 102.0, 98.0, 100.0, 950.0, 3.0 });
+      assert_size_t_equal("Outliers are rejected", 2, values.rejected_);
+      assert_size_t_equal("Other runs are kept", 7, values.kept_);
+      assert_is_true("Mean of the runs kept", std::fabs(values.mean_ns_ - 100.0) < 1e-9);
+      assert_is_true("Median", std::fabs(values.median_ns_ - 100.0) < 1e-9);
+      assert_is_true("Fastest run kept", std::fabs(values.fastest_ns_ - 98.0) < 1e-9);
+
+      statistics same = robust({ 7.0, 7.0, 7.0 });
+      assert_size_t_equal("Equal runs are kept", 3, same.kept_);
+   }
+   test_section("Testing the environment is captured with a stable fingerprint")
+   {
+      const environment& values = host();
+      std::string print = fingerprint(values);
+
+      assert_size_t_equal("Fingerprint is 16 hexadecimal digits", 16, print.size());
+      assert_is_true("Only hexadecimal digits", print.find_first_not_of("0123456789abcdef") == std::string::npos);
+      assert_equal("Fingerprint is stable", print, fingerprint(host()));
+      assert_is_true("Cores are counted", values.cores_ > 0);
+      assert_is_true("Timer resolution is measured", values.timer_resolution_ns_ > 0.0);
+      assert_is_true("Description starts with the fingerprint", describe(values).find("fingerprint " + print + ", cpu ") == 0);
+
+      environment other(values);
+      other.compiler_ += " other";
+      assert_not_equal("Another compiler is another fingerprint", print, fingerprint(other));
+      other = values;
+      other.governor_ = "other";
+      other.timer_overhead_ns_ += 1.0;
+      assert_equal("Governor and timer are not in the fingerprint", print, fingerprint(other));
+   }
+#if defined(__linux__)
+   test_section("Testing the thread is pinned and its affinity restored")
+   {
+      cpu_set_t before;
+      pthread_getaffinity_np(pthread_self(), sizeof(before), &before);
+      int allowed = 0;
+      while (allowed < CPU_SETSIZE && !CPU_ISSET(allowed, &before))
+      {
+         allowed++;
+      }
+      {
+         pinned_thread pinned(allowed);
+         assert_is_true("Thread is pinned", pinned.pinned());
+         assert_equal("Thread runs on the first allowed cpu", allowed, sched_getcpu());
+      }
+      cpu_set_t after;
+      pthread_getaffinity_np(pthread_self(), sizeof(after), &after);
+      assert_is_true("Affinity is restored", CPU_EQUAL(&before, &after));
+
+      pinned_thread unpinned(-1);
+      assert_is_false("Negative cpu does not pin", unpinned.pinned());
+   }
+#endif
+}
+
+test_method(complexity_test_base_tests, "Testing the complexity test base class")
+{
+   options previous = settings();
+   settings().min_time_ = 0.002;
+
+   test_section("Testing a body within its declared class passes")
+   {
+      mock_complexity_test test(complexity::quadratic, quadratic_curve);
+
+      assert_is_true("Running the benchmark is successful", test.run_test());
+      assert_size_t_equal("Every size is sampled", 5, test.samples().size());
+      assert_is_true("Complexity is reported", out.str().find("COMPLEXITY O(n^2) rms ") != std::string::npos);
+      assert_is_true("Sizes are reported", out.str().find("  n 1024: ") != std::string::npos);
+      assert_is_true("Environment is reported", out.str().find("  fingerprint " + fingerprint(host())) != std::string::npos);
+   }
+   test_section("Testing a body worse than its declared class fails")
+   {
+      err.str("");
+      mock_complexity_test test(complexity::linear, quadratic_curve);
+
+      assert_is_false("Running the benchmark fails", test.run_test());
+      assert_is_true("Failure names both classes", err.str().find("Complexity: Measured complexity is not worse than declared. Expected: O(n). Actual: O(n^2).") != std::string::npos);
+   }
+
+   settings() = previous;
+}
+
+// The comparisons of the sort are counted rather than timed, the count is the same on every run.
+complexity_method(complexity_method_tests, "Testing sorting counts within its bound", linearithmic, 1 << 6, 1 << 10)
+{
+   std::vector<uint32_t> input(state.size());
+   std::generate(input.begin(), input.end(), [&]() { return uint32_t(state.random()()); });
+
+   uint64_t comparisons = 0;
+   std::sort(input.begin(), input.end(), [&comparisons](uint32_t left, uint32_t right) { comparisons++; return left < right; });
+   state.record(double(comparisons));
+   assert_is_true("Input is sorted", std::is_sorted(input.begin(), input.end()));
+}
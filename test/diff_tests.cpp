@@ -0,0 +1,192 @@
+/****
+* Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+* All rights reserved.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "unit_test.h"
+#include <random>
+#include <sstream>
+
+using namespace aes::test;
+using namespace aes::test::log;
+
+using my_logger = logger_base<std::stringstream, std::stringstream>;
+
+namespace
+{
+   size_t longest_common_subsequence(const std::string& expected, const std::string& actual)
+   {
+      std::vector<std::vector<size_t>> lengths(expected.size() + 1, std::vector<size_t>(actual.size() + 1, 0));
+      for (size_t e = 1; e <= expected.size(); e++)
+      {
+         for (size_t a = 1; a <= actual.size(); a++)
+         {
+            lengths[e][a] = expected[e - 1] == actual[a - 1] ? lengths[e - 1][a - 1] + 1 : std::max(lengths[e - 1][a], lengths[e][a - 1]);
+         }
+      }
+      return lengths[expected.size()][actual.size()];
+   }
+
+   std::vector<diff::edit> compute(const std::string& expected, const std::string& actual)
+   {
+      return diff::compute(expected.size(), actual.size(), [&](size_t e, size_t a) { return expected[e] == actual[a]; });
+   }
+}
+
+test_method(diff_compute_tests, "Testing the edit scripts of the Myers algorithm")
+{
+   test_section("Testing the classic example of the paper")
+   {
+      std::vector<diff::edit> edits(compute("abcabba", "cbabac"));
+      size_t changed = 0;
+      for (const diff::edit& e : edits)
+      {
+         changed += e.operation_ != diff::operation::equal ? e.length_ : 0;
+      }
+      assert_size_t_equal("Shortest script has 5 edits", 5, changed);
+   }
+   test_section("Testing random sequences give a shortest script rebuilding the actual one")
+   {
+      std::mt19937 random(42);
+      bool all_rebuilt = true;
+      bool all_shortest = true;
+      for (int round = 0; round < 500; round++)
+      {
+         std::string expected(random() % 14, ' ');
+         std::string actual(random() % 14, ' ');
+         for (char& c : expected) c = static_cast<char>('a' + random() % 3);
+         for (char& c : actual) c = static_cast<char>('a' + random() % 3);
+
+         std::string rebuilt;
+         size_t kept = 0;
+         size_t expected_next = 0;
+         for (const diff::edit& e : compute(expected, actual))
+         {
+            all_rebuilt &= e.operation_ == diff::operation::insert || e.expected_ == expected_next;
+            switch (e.operation_)
+            {
+            case diff::operation::equal: rebuilt += expected.substr(e.expected_, e.length_); kept += e.length_; expected_next += e.length_; break;
+            case diff::operation::remove: expected_next += e.length_; break;
+            case diff::operation::insert: rebuilt += actual.substr(e.actual_, e.length_); break;
+            }
+         }
+         all_rebuilt &= rebuilt == actual && expected_next == expected.size();
+         all_shortest &= kept == longest_common_subsequence(expected, actual);
+      }
+      assert_is_true("Every script rebuilds the actual sequence", all_rebuilt);
+      assert_is_true("Every script keeps a longest common subsequence", all_shortest);
+   }
+   test_section("Testing the search gives up past its cost")
+   {
+      size_t cost = diff::settings().max_cost_;
+      diff::settings().max_cost_ = 10;
+      std::vector<diff::edit> edits(compute("xxabcdefghyy", "xxhgfedcbayy"));
+      diff::settings().max_cost_ = cost;
+
+      assert_size_t_equal("Prefix, replacement and suffix", 4, edits.size());
+      assert_size_t_equal("Whole middle removed", 8, edits[1].length_);
+      assert_size_t_equal("Whole middle inserted", 8, edits[2].length_);
+   }
+}
+
+test_method(diff_output_tests, "Testing the unified diff written for strings and vectors")
+{
+   format::buffer out;
+
+   test_section("Testing strings with lines are compared line by line")
+   {
+      diff::append(out, std::string("one\ntwo\nthree\nfour\nfive\nsix\nseven\neight\nnine\nten\n"),
+                        std::string("one\ntwo\nthree\nFOUR\nfive\nsix\nseven\neight\nnine\nten\n"));
+      assert_equal("Hunk with context", std::string("\n@@ -1,7 +1,7 @@\n one\n two\n three\n-four\n+FOUR\n five\n six\n seven"), out.str());
+   }
+   test_section("Testing strings on one line are compared character by character")
+   {
+      std::string expected("The quick brown fox jumps over the lazy dog, the quick brown fox jumps over the lazy dog");
+      std::string actual(expected);
+      actual.replace(4, 5, "slow");
+      actual.erase(60, 6);
+      diff::append(out, expected, actual);
+      assert_equal("Changes are marked inline", std::string("\n@@ -2,11 +2,10 @@\n he [-quick-]{+slow+} br\n@@ -59,12 +58,6 @@\n wn [-fox ju-]mps"), out.str());
+   }
+   test_section("Testing vectors are compared element by element")
+   {
+      diff::append(out, std::vector<int>{ 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 }, std::vector<int>{ 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13 });
+      assert_equal("Removal and insertion", std::string("\n@@ -1,4 +1,3 @@\n-1\n 2\n 3\n 4\n@@ -10,3 +9,4 @@\n 10\n 11\n 12\n+13"), out.str());
+   }
+   test_section("Testing a large string with one change is diffed quickly")
+   {
+      std::string expected;
+      for (int i = 0; i < 200000; i++)
+      {
+         expected += "line " + std::to_string(i) + "\n";
+      }
+      std::string actual(expected);
+      actual.replace(actual.find("line 123456\n"), 11, "line changed");
+
+      diff::append(out, expected, actual);
+      assert_equal("Only the change is written", std::string("\n@@ -123454,7 +123454,7 @@\n line 123453\n line 123454\n line 123455\n-line 123456\n+line changed\n line 123457\n line 123458\n line 123459"), out.str());
+   }
+   test_section("Testing the output is capped")
+   {
+      std::string expected;
+      std::string actual;
+      for (int i = 0; i < 10000; i++)
+      {
+         expected += "line " + std::to_string(i) + "\n";
+         actual += "line " + std::to_string(i % 10 ? i : -i) + "\n";
+      }
+
+      diff::append(out, expected, actual);
+      assert_is_true("Output stays near the cap", out.size() < diff::settings().max_output_ + 256);
+      assert_is_true("Truncation is reported", out.str().find("hunks not shown)") != std::string::npos);
+   }
+}
+
+test_method(diff_assert_tests, "Testing the failed assertions written as a diff")
+{
+   std::stringstream out;
+   std::stringstream error;
+   my_logger log(out, error, level::information);
+   assert_base<my_logger> check(log);
+
+   test_section("Testing short values are written whole")
+   {
+      check.equal(__FILE__, 1, "Short", std::string("abc"), std::string("abd"));
+      assert_equal("Values are written", std::string("FAIL diff_tests.cpp 1 Equal: Short. Expected: abc. Actual: abd.\n"), error.str());
+   }
+   test_section("Testing strings with lines are written as a diff")
+   {
+      check.equal(__FILE__, 2, "Lines", std::string("a\nb\nc"), std::string("a\nB\nc"));
+      assert_equal("Difference is written", std::string("FAIL diff_tests.cpp 2 Equal: Lines. Difference (-expected +actual):\n@@ -1,3 +1,3 @@\n a\n-b\n+B\n c\n"), error.str());
+   }
+   test_section("Testing vectors of different sizes are written as a diff")
+   {
+      check.vector_equal(__FILE__, 3, "Vectors", std::vector<int>{ 1, 2, 3, 4, 5, 6, 7, 8 }, std::vector<int>{ 1, 2, 3, 4, 0, 5, 6, 7, 8 });
+      assert_equal("Difference is written", std::string("FAIL diff_tests.cpp 3 Vector assert: Vectors: Size of the vectors are equal. Expected: 8. Actual: 9. Difference (-expected +actual):\n@@ -2,6 +2,7 @@\n 2\n 3\n 4\n+0\n 5\n 6\n 7\n"), error.str());
+      assert_uint64_t_equal("One failure", 1, check.failed());
+   }
+   test_section("Testing long strings that should not be equal are written whole")
+   {
+      std::string text(100, 'x');
+      check.not_equal(__FILE__, 4, "Long", text, text);
+      assert_equal("Values are written", "FAIL diff_tests.cpp 4 Not equal: Long. Expected: " + text + ". Actual: " + text + ".\n", error.str());
+   }
+   test_section("Testing vectors that should not be equal are written whole")
+   {
+      std::vector<int> values{ 1, 2, 3, 4, 5, 6, 7, 8 };
+      check.not_equal(__FILE__, 5, "Vectors", values, values);
+      assert_equal("Values are written", std::string("FAIL diff_tests.cpp 5 Not equal: Vectors. Expected: { 1, 2, 3, 4, 5, 6, 7, 8 }. Actual: { 1, 2, 3, 4, 5, 6, 7, 8 }.\n"), error.str());
+   }
+}
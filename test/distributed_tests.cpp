@@ -0,0 +1,441 @@
+/****
+* Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+* All rights reserved.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "unit_test.h"
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace aes::test;
+using namespace aes::test::log;
+
+using my_logger = logger_base<std::stringstream, std::stringstream>;
+
+namespace
+{
+   template <int _Id>
+   class mock_distributed_suite_singleton
+   {
+   public:
+      static test_suite_base<mock_distributed_suite_singleton, my_logger>& get()
+      {
+         static my_logger log(out(), error());
+         static test_suite_base<mock_distributed_suite_singleton, my_logger> test_suite(log);
+         return test_suite;
+      }
+
+      static std::stringstream& out()
+      {
+         static std::stringstream stream;
+         return stream;
+      }
+
+      static std::stringstream& error()
+      {
+         static std::stringstream stream;
+         return stream;
+      }
+   };
+
+   template <int _Id>
+   class mock_distributed_test : public unit_test_base<mock_distributed_suite_singleton<_Id>, my_logger>
+   {
+   public:
+      mock_distributed_test(const std::string& test_name, bool fail) noexcept
+         : unit_test_base<mock_distributed_suite_singleton<_Id>, my_logger>(test_name, "description")
+         , fail_(fail)
+      {
+      }
+
+   private:
+      void run_tests(assert_base<my_logger>& assert)
+      {
+         assert.pass(__FILE__, __LINE__, "Passing " + this->name());
+         if (fail_)
+         {
+            assert.fail(__FILE__, __LINE__, "Failing " + this->name());
+         }
+      }
+
+   private:
+      bool fail_;
+   };
+
+   std::atomic<unsigned> memory_heavy_running(0);
+   std::atomic<unsigned> memory_heavy_most(0);
+
+   // Records how many memory-heavy tests run at the same time, over every worker.
+   template <int _Id>
+   class mock_memory_heavy_test : public unit_test_base<mock_distributed_suite_singleton<_Id>, my_logger>
+   {
+   public:
+      mock_memory_heavy_test(const std::string& test_name) noexcept
+         : unit_test_base<mock_distributed_suite_singleton<_Id>, my_logger>(test_name, "description")
+      {
+         this->memory_heavy(true);
+      }
+
+   private:
+      void run_tests(assert_base<my_logger>& assert)
+      {
+         unsigned running = ++memory_heavy_running;
+         unsigned most = memory_heavy_most;
+         while (running > most && !memory_heavy_most.compare_exchange_weak(most, running))
+         {
+         }
+         std::this_thread::sleep_for(std::chrono::milliseconds(20));
+         --memory_heavy_running;
+         assert.pass(__FILE__, __LINE__, "Passing " + this->name());
+      }
+   };
+}
+
+test_method(shard_tests, "Testing the tests of a suite are sharded")
+{
+   test_suite_base<mock_distributed_suite_singleton<0>, my_logger>& test_suite = mock_distributed_suite_singleton<0>::get();
+   mock_distributed_test<0> first("a_first", false);
+   mock_distributed_test<0> second("b_second", false);
+   mock_distributed_test<0> third("c_third", false);
+   mock_distributed_test<0> fourth("d_fourth", false);
+
+   test_suite.shard(1, 2);
+   assert_is_true("Running the shard is successful", test_suite.run("title"));
+   assert_uint64_t_equal("Only the tests of the shard have been run", 2, test_suite.total());
+   assert_is_true("Second test is in the shard", mock_distributed_suite_singleton<0>::out().str().find("b_second") != std::string::npos);
+   assert_is_true("Fourth test is in the shard", mock_distributed_suite_singleton<0>::out().str().find("d_fourth") != std::string::npos);
+   assert_equal("First test is not in the shard", std::string::npos, mock_distributed_suite_singleton<0>::out().str().find("a_first"));
+}
+
+test_method(select_tests, "Testing only the selected tests of a suite are run")
+{
+   test_suite_base<mock_distributed_suite_singleton<6>, my_logger>& test_suite = mock_distributed_suite_singleton<6>::get();
+   mock_distributed_test<6> affected("affected_test", false);
+   mock_distributed_test<6> unaffected("unaffected_test", true);
+
+   test_suite.select({ "affected_test", "missing_test" });
+   assert_is_true("Running the selection is successful", test_suite.run("title"));
+   assert_uint64_t_equal("Only the selected test has been run", 1, test_suite.total());
+   assert_equal("Unselected test has not been run", std::string::npos, mock_distributed_suite_singleton<6>::out().str().find("unaffected_test"));
+}
+
+#if defined(AES_TEST_DISTRIBUTED)
+test_method(channel_tests, "Testing the socket channel")
+{
+   test_section("Testing lines and bytes are exchanged over a Unix socket")
+   {
+      distributed::listener listener;
+      distributed::channel client;
+      std::string line;
+      std::string bytes;
+      std::string address("unix:/tmp/cpp_test_channel_" + std::to_string(::getpid()));
+
+      assert_is_true("Listener is opened", listener.open(address));
+      assert_is_true("Client is connected", client.connect(listener.address()));
+      distributed::channel server(listener.accept());
+      assert_is_true("Connection has been accepted", server.is_open());
+
+      assert_is_true("Data is sent", client.send("first line\nsecond\n12345"));
+      while (!server.read_bytes(23, bytes) && server.receive())
+      {
+      }
+      assert_equal("Every byte has been received", std::string("first line\nsecond\n12345"), bytes);
+
+      assert_is_true("Line is sent", server.send("reply\n"));
+      while (!client.read_line(line) && client.receive())
+      {
+      }
+      assert_equal("Line has been received without its end of line", std::string("reply"), line);
+
+      server.close();
+      assert_is_false("Receiving from a closed connection fails", client.receive());
+   }
+   test_section("Testing the listener reports the port picked by the system")
+   {
+      distributed::listener listener;
+
+      assert_is_true("Listener is opened", listener.open("127.0.0.1:0"));
+      assert_not_equal("Actual port is reported", std::string("127.0.0.1:0"), listener.address());
+   }
+   test_section("Testing a listener on every interface advertises a host to connect to")
+   {
+      distributed::listener listener;
+      distributed::channel client;
+
+      assert_is_true("Listener is opened", listener.open(":0"));
+      assert_is_false("Host is advertised", listener.address()[0] == ':');
+      assert_is_true("Client is connected to the advertised address", client.connect(listener.address()));
+      assert_equal("Named host is kept", std::string("localhost"), distributed::advertised_host("localhost"));
+      assert_not_equal("Wildcard host is replaced", std::string("0.0.0.0"), distributed::advertised_host("0.0.0.0"));
+   }
+}
+
+test_method(coordinator_tests, "Testing the coordinator hands the tests out to workers")
+{
+   test_section("Testing the results of a worker are merged by the coordinator")
+   {
+      test_suite_base<mock_distributed_suite_singleton<1>, my_logger>& coordinator = mock_distributed_suite_singleton<1>::get();
+      test_suite_base<mock_distributed_suite_singleton<2>, my_logger>& worker = mock_distributed_suite_singleton<2>::get();
+      mock_distributed_test<1> coordinator_passing("passing_test", false);
+      mock_distributed_test<1> coordinator_failing("failing_test", true);
+      mock_distributed_test<2> worker_passing("passing_test", false);
+      mock_distributed_test<2> worker_failing("failing_test", true);
+      distributed::listener listener;
+      distributed::process_group processes;
+
+      assert_is_true("Listener is opened", listener.open("127.0.0.1:0"));
+      std::thread thread([&listener, &worker]()
+      {
+         distributed::channel channel;
+         if (channel.connect(listener.address()))
+         {
+            worker.run_worker(channel);
+         }
+      });
+      bool result = coordinator.run_coordinator("title", listener, processes);
+      thread.join();
+
+      assert_is_false("Running the suite with a failing test fails", result);
+      assert_uint64_t_equal("Asserts of the worker have been merged", 3, coordinator.total());
+      assert_uint64_t_equal("Failure of the worker has been merged", 1, coordinator.failed());
+      assert_is_true("Failure is reported by the coordinator", mock_distributed_suite_singleton<1>::error().str().find("Assert failed logged with message: Failing failing_test") != std::string::npos);
+      assert_is_true("Passing test is reported by the coordinator", mock_distributed_suite_singleton<1>::out().str().find("passing_test(0s)") != std::string::npos);
+      assert_equal("Worker logs nothing itself", std::string(), mock_distributed_suite_singleton<2>::out().str());
+   }
+   test_section("Testing the test of a lost worker is given to another worker")
+   {
+      test_suite_base<mock_distributed_suite_singleton<3>, my_logger>& coordinator = mock_distributed_suite_singleton<3>::get();
+      test_suite_base<mock_distributed_suite_singleton<4>, my_logger>& worker = mock_distributed_suite_singleton<4>::get();
+      mock_distributed_test<3> coordinator_test("requeued_test", false);
+      mock_distributed_test<4> worker_test("requeued_test", false);
+      distributed::listener listener;
+      distributed::process_group processes;
+      std::string first_request;
+
+      assert_is_true("Listener is opened", listener.open("127.0.0.1:0"));
+      std::thread thread([&listener, &worker, &first_request]()
+      {
+         distributed::channel lost;
+         if (lost.connect(listener.address()) && lost.send("NEXT\n"))
+         {
+            while (!lost.read_line(first_request) && lost.receive())
+            {
+            }
+         }
+         lost.close();
+
+         distributed::channel channel;
+         if (channel.connect(listener.address()))
+         {
+            worker.run_worker(channel);
+         }
+      });
+      bool result = coordinator.run_coordinator("title", listener, processes);
+      thread.join();
+
+      assert_equal("Test has been handed to the first worker by index", std::string("RUN 0 requeued_test"), first_request);
+      assert_is_true("Test has been run by the second worker", result);
+      assert_uint64_t_equal("Test has been counted once", 1, coordinator.passed());
+   }
+   test_section("Testing a test losing two workers fails")
+   {
+      test_suite_base<mock_distributed_suite_singleton<5>, my_logger>& coordinator = mock_distributed_suite_singleton<5>::get();
+      mock_distributed_test<5> coordinator_test("crashing_test", false);
+      distributed::listener listener;
+      distributed::process_group processes;
+
+      assert_is_true("Listener is opened", listener.open("127.0.0.1:0"));
+      std::thread thread([&listener]()
+      {
+         for (int i = 0; i < 2; ++i)
+         {
+            std::string line;
+            distributed::channel lost;
+            if (lost.connect(listener.address()) && lost.send("NEXT\n"))
+            {
+               while (!lost.read_line(line) && lost.receive())
+               {
+               }
+            }
+         }
+      });
+      bool result = coordinator.run_coordinator("title", listener, processes);
+      thread.join();
+
+      assert_is_false("Crashing test fails", result);
+      assert_uint64_t_equal("Crashing test is reported as one failure", 1, coordinator.failed());
+      assert_is_true("Reason is reported", mock_distributed_suite_singleton<5>::error().str().find("worker lost while running crashing_test") != std::string::npos);
+   }
+   test_section("Testing the tests sharing a name are told apart")
+   {
+      test_suite_base<mock_distributed_suite_singleton<10>, my_logger>& coordinator = mock_distributed_suite_singleton<10>::get();
+      test_suite_base<mock_distributed_suite_singleton<11>, my_logger>& worker = mock_distributed_suite_singleton<11>::get();
+      mock_distributed_test<10> coordinator_passing("twin_test", false);
+      mock_distributed_test<10> coordinator_failing("twin_test", true);
+      mock_distributed_test<11> worker_passing("twin_test", false);
+      mock_distributed_test<11> worker_failing("twin_test", true);
+      distributed::listener listener;
+      distributed::process_group processes;
+
+      assert_is_true("Listener is opened", listener.open("127.0.0.1:0"));
+      std::thread thread([&listener, &worker]()
+      {
+         distributed::channel channel;
+         if (channel.connect(listener.address()))
+         {
+            worker.run_worker(channel);
+         }
+      });
+      coordinator.run_coordinator("title", listener, processes);
+      thread.join();
+
+      assert_uint64_t_equal("Both tests have been run", 3, coordinator.total());
+      assert_uint64_t_equal("Failing test has been run", 1, coordinator.failed());
+   }
+   test_section("Testing the result logs of the workers are appended to the result log")
+   {
+      test_suite_base<mock_distributed_suite_singleton<12>, my_logger>& coordinator = mock_distributed_suite_singleton<12>::get();
+      test_suite_base<mock_distributed_suite_singleton<13>, my_logger>& worker = mock_distributed_suite_singleton<13>::get();
+      mock_distributed_test<12> coordinator_passing("logged_passing_test", false);
+      mock_distributed_test<12> coordinator_failing("logged_failing_test", true);
+      mock_distributed_test<13> worker_passing("logged_passing_test", false);
+      mock_distributed_test<13> worker_failing("logged_failing_test", true);
+      result_log::writer coordinator_log;
+      result_log::writer worker_log;
+      distributed::listener listener;
+      distributed::process_group processes;
+      const std::string worker_file = "distributed_worker_tests.bin";
+      const std::string coordinator_file = "distributed_coordinator_tests.bin";
+
+      assert_is_true("Result log of the coordinator is opened", coordinator_log.open(coordinator_file));
+      assert_is_true("Result log of the worker is opened", worker_log.open(worker_file));
+      coordinator.result_log(&coordinator_log);
+      worker.result_log(&worker_log);
+      assert_is_true("Listener is opened", listener.open("127.0.0.1:0"));
+      std::thread thread([&listener, &worker]()
+      {
+         distributed::channel channel;
+         if (channel.connect(listener.address()))
+         {
+            worker.run_worker(channel);
+         }
+      });
+      coordinator.run_coordinator("title", listener, processes);
+      thread.join();
+      coordinator.result_log(nullptr);
+      worker.result_log(nullptr);
+      coordinator_log.close();
+
+      result_log::reader reader;
+      result_log::record r = {};
+      std::vector<std::string> tests;
+      uint64_t passed = 0;
+      uint64_t failed = 0;
+      assert_is_true("Result log has been opened for reading", reader.open(coordinator_file));
+      while (reader.next(r))
+      {
+         if (r.type == result_log::record_type::begin)
+         {
+            tests.push_back(reader.string(r.id));
+         }
+         passed += r.type == result_log::record_type::pass;
+         failed += r.type == result_log::record_type::fail;
+      }
+      assert_is_false("Result log is not corrupt", reader.corrupt());
+      assert_vector_equal("Tests of the worker have been appended", std::vector<std::string>({ "logged_failing_test", "logged_passing_test" }), tests);
+      assert_uint64_t_equal("Passed asserts of the worker have been appended", 2, passed);
+      assert_uint64_t_equal("Failed assert of the worker has been appended", 1, failed);
+      assert_is_true("Result log of the worker has been removed", std::fopen(worker_file.c_str(), "rb") == nullptr);
+      std::remove(coordinator_file.c_str());
+   }
+   test_section("Testing the workers dump the coverage of their tests")
+   {
+      test_suite_base<mock_distributed_suite_singleton<14>, my_logger>& coordinator = mock_distributed_suite_singleton<14>::get();
+      test_suite_base<mock_distributed_suite_singleton<15>, my_logger>& worker = mock_distributed_suite_singleton<15>::get();
+      mock_distributed_test<14> coordinator_test("covered_test", false);
+      mock_distributed_test<15> worker_test("covered_test", false);
+      distributed::listener listener;
+      distributed::process_group processes;
+      const std::string directory = "/tmp/cpp_test_coverage_" + std::to_string(::getpid());
+
+      worker.coverage_dump(directory);
+      assert_is_true("Listener is opened", listener.open("127.0.0.1:0"));
+      std::thread thread([&listener, &worker]()
+      {
+         distributed::channel channel;
+         if (channel.connect(listener.address()))
+         {
+            worker.run_worker(channel);
+         }
+      });
+      coordinator.run_coordinator("title", listener, processes);
+      thread.join();
+
+      struct stat info = {};
+      bool dumped = ::stat((directory + "/covered_test").c_str(), &info) == 0;
+      assert_equal("Coverage of the test has been dumped when available", coverage::available(), dumped);
+      if (dumped)
+      {
+         std::system(("rm -rf " + directory).c_str());
+      }
+   }
+   test_section("Testing the memory-heavy tests of a node are limited")
+   {
+      test_suite_base<mock_distributed_suite_singleton<7>, my_logger>& coordinator = mock_distributed_suite_singleton<7>::get();
+      test_suite_base<mock_distributed_suite_singleton<8>, my_logger>& first_worker = mock_distributed_suite_singleton<8>::get();
+      test_suite_base<mock_distributed_suite_singleton<9>, my_logger>& second_worker = mock_distributed_suite_singleton<9>::get();
+      std::vector<std::unique_ptr<mock_memory_heavy_test<7>>> coordinator_tests;
+      std::vector<std::unique_ptr<mock_memory_heavy_test<8>>> first_tests;
+      std::vector<std::unique_ptr<mock_memory_heavy_test<9>>> second_tests;
+      for (const char* name : { "heavy_a", "heavy_b", "heavy_c", "heavy_d" })
+      {
+         coordinator_tests.emplace_back(new mock_memory_heavy_test<7>(name));
+         first_tests.emplace_back(new mock_memory_heavy_test<8>(name));
+         second_tests.emplace_back(new mock_memory_heavy_test<9>(name));
+      }
+      distributed::listener listener;
+      distributed::process_group processes;
+
+      assert_is_true("Listener is opened", listener.open("127.0.0.1:0"));
+      coordinator.memory_heavy_per_node(1);
+      std::thread first([&listener, &first_worker]()
+      {
+         distributed::channel channel;
+         if (channel.connect(listener.address()))
+         {
+            first_worker.run_worker(channel, 0);
+         }
+      });
+      std::thread second([&listener, &second_worker]()
+      {
+         distributed::channel channel;
+         if (channel.connect(listener.address()))
+         {
+            second_worker.run_worker(channel, 0);
+         }
+      });
+      bool result = coordinator.run_coordinator("title", listener, processes);
+      first.join();
+      second.join();
+
+      assert_is_true("Every test passes", result);
+      assert_uint64_t_equal("Every test has been run", 4, coordinator.passed());
+      assert_uint32_t_equal("Memory-heavy tests of the node have run one at a time", 1, memory_heavy_most.load());
+   }
+}
+#endif
@@ -0,0 +1,126 @@
+/****
+* Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+* All rights reserved.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "unit_test.h"
+#include <csignal>
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+using namespace aes::test;
+using namespace aes::test::log;
+
+using my_logger = logger_base<std::stringstream, std::stringstream>;
+
+test_method(flight_ring_tests, "Testing the ring of the flight recorder")
+{
+   test_section("Testing only the last records are kept")
+   {
+      flight::recorder recorder;
+      recorder.record(std::string("ignored"));
+      assert_vector_empty("Disabled recorder keeps nothing", recorder.take());
+
+      recorder.enable(4);
+      for (int i = 0; i < 6; i++)
+      {
+         recorder.record(i);
+      }
+
+      std::vector<std::string> expected = { "2", "3", "4", "5" };
+      assert_vector_equal("Last records are taken oldest first", expected, recorder.take());
+      assert_vector_empty("Taken records are not taken again", recorder.take());
+
+      recorder.record(std::string(1000, 'x'));
+      std::vector<std::string> records(recorder.take());
+      assert_size_t_equal("Record is taken", 1, records.size());
+      assert_size_t_equal("Long record is truncated", flight::recorder::record_size_ - 1, records[0].size());
+   }
+   test_section("Testing a ring given back by a thread starts empty for the next one")
+   {
+      flight::recorder recorder;
+      std::vector<std::string> first;
+      std::vector<std::string> second;
+
+      recorder.enable(8);
+      std::thread([&]() { recorder.record(std::string("first thread")); first = recorder.take(); recorder.record(std::string("left over")); }).join();
+      std::thread([&]() { recorder.record(std::string("second thread")); second = recorder.take(); }).join();
+
+      assert_vector_equal("First thread takes its record", std::vector<std::string>{ "first thread" }, first);
+      assert_vector_equal("Second thread only takes its own record", std::vector<std::string>{ "second thread" }, second);
+   }
+}
+
+test_method(flight_logger_tests, "Testing the hidden records come out before a failure")
+{
+   flight::recorder& recorder = flight::recorder::get();
+   size_t capacity = recorder.capacity();
+   std::stringstream out;
+   std::stringstream error;
+   my_logger log(out, error, level::information);
+   assert_base<my_logger> check(log);
+
+   recorder.enable(2);
+   recorder.take();
+   log.log_verbose("first hidden");
+   log.log_debug("second hidden");
+   log.log_trace("third hidden");
+   log.log_information("written");
+   check.fail(__FILE__, __LINE__, "failure");
+   check.fail(__FILE__, __LINE__, "second failure");
+   recorder.enable(capacity);
+
+   std::string errors(error.str());
+   assert_equal("Hidden records are not written", std::string("written\n"), out.str());
+   assert_equal("Last hidden records come before the failure", size_t(0), errors.find("FLIGHT 2 records before the failure\n  second hidden\n  third hidden\nFAIL flight_tests.cpp"));
+   assert_equal("Records are only dumped once", std::string::npos, errors.find("FLIGHT", 1));
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+test_method(flight_signal_tests, "Testing the records are dumped on a fatal signal")
+{
+   int fds[2];
+   assert_is_true("Pipe is created", ::pipe(fds) == 0);
+
+   pid_t child = ::fork();
+   if (child == 0)
+   {
+      ::dup2(fds[1], 2);
+      flight::recorder::get().enable(4);
+      flight::recorder::get().install_signal_handlers();
+      flight::recorder::get().record(std::string("last words"));
+      std::raise(SIGABRT);
+      ::_exit(0);
+   }
+   ::close(fds[1]);
+
+   std::string output;
+   char chunk[4096];
+   ssize_t size = 0;
+   while ((size = ::read(fds[0], chunk, sizeof(chunk))) > 0)
+   {
+      output.append(chunk, size_t(size));
+   }
+   ::close(fds[0]);
+
+   int status = 0;
+   ::waitpid(child, &status, 0);
+   assert_is_true("Child is killed by the signal", WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+   assert_is_true("Signal is reported", output.find("FLIGHT fatal signal " + std::to_string(SIGABRT) + "\n") != std::string::npos);
+   assert_is_true("Records are dumped", output.find("  last words\n") != std::string::npos);
+}
+#endif
@@ -0,0 +1,190 @@
+/****
+* Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+* All rights reserved.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "unit_test.h"
+#include <limits>
+#include <map>
+#include <sstream>
+#include <tuple>
+
+using namespace aes::test;
+using namespace aes::test::format;
+
+namespace
+{
+   enum class color : int
+   {
+      red = 1,
+      blue = -2,
+   };
+
+   struct point
+   {
+      int x_;
+      int y_;
+   };
+
+   struct streamed
+   {
+      int value_;
+   };
+
+   std::ostream& operator<<(std::ostream& out, const streamed& value)
+   {
+      return out << "streamed " << value.value_;
+   }
+
+   struct opaque
+   {
+      int value_;
+   };
+}
+
+template <>
+struct aes::test::format::formatter<point>
+{
+   static void format(buffer& out, const point& value)
+   {
+      out.append('<');
+      append(out, value.x_);
+      out.append(';');
+      append(out, value.y_);
+      out.append('>');
+   }
+};
+
+test_method(format_scalar_tests, "Testing the formatting of booleans, characters and integers")
+{
+   assert_equal("True is formatted", std::string("true"), to_string(true));
+   assert_equal("False is formatted", std::string("false"), to_string(false));
+   assert_equal("Character is formatted", std::string("a"), to_string('a'));
+   assert_equal("Control character is escaped", std::string("\\n"), to_string('\n'));
+   assert_equal("Zero is formatted", std::string("0"), to_string(0));
+   assert_equal("Negative integer is formatted", std::string("-42"), to_string(-42));
+   assert_equal("Smallest integer is formatted", std::string("-9223372036854775808"), to_string(std::numeric_limits<long long>::min()));
+   assert_equal("Largest unsigned is formatted", std::string("18446744073709551615"), to_string(std::numeric_limits<unsigned long long>::max()));
+   assert_equal("Unsigned char is a number", std::string("200"), to_string(static_cast<unsigned char>(200)));
+   assert_equal("Scoped enum is formatted", std::string("-2"), to_string(color::blue));
+}
+
+test_method(format_floating_tests, "Testing the shortest round trip formatting of floating points")
+{
+   assert_equal("Short decimal is formatted", std::string("0.1"), to_string(0.1));
+   assert_equal("Integral value is formatted", std::string("3"), to_string(3.0));
+   assert_equal("Sum keeps its last digits", std::string("0.30000000000000004"), to_string(0.1 + 0.2));
+   assert_equal("Float is formatted with its own precision", std::string("0.1"), to_string(0.1f));
+   assert_equal("Large exponent is formatted", std::string("1e+100"), to_string(1e100));
+   assert_equal("Infinity is formatted", std::string("-inf"), to_string(-std::numeric_limits<double>::infinity()));
+   assert_equal("NaN is formatted", std::string("nan"), to_string(std::numeric_limits<double>::quiet_NaN()));
+
+   double third = 1.0 / 3.0;
+   assert_is_true("Formatted value reads back the same", std::strtod(to_string(third).c_str(), nullptr) == third);
+}
+
+test_method(format_string_tests, "Testing the formatting of strings")
+{
+   const char* null_text = nullptr;
+
+   assert_equal("Plain string is unchanged", std::string("plain text"), to_string(std::string("plain text")));
+   assert_equal("Literal is formatted", std::string("literal"), to_string("literal"));
+   assert_equal("Null string is formatted", std::string("nullptr"), to_string(null_text));
+   assert_equal("Control characters are escaped", std::string("a\\tb\\r\\n\\x01"), to_string(std::string("a\tb\r\n\x01")));
+   assert_equal("Embedded terminator is escaped", std::string("a\\0b"), to_string(std::string("a\0b", 3)));
+
+   size_t max_length = settings().max_string_length_;
+   settings().max_string_length_ = 4;
+   std::string truncated = to_string(std::string("truncated"));
+   settings().max_string_length_ = max_length;
+   assert_equal("Long string is truncated", std::string("trun...(9 chars)"), truncated);
+}
+
+test_method(format_pointer_tests, "Testing the formatting of pointers")
+{
+   int value = 0;
+   std::stringstream ss;
+   ss << static_cast<void*>(&value);
+
+   assert_equal("Pointer is formatted in hexadecimal", ss.str(), to_string(&value));
+   assert_equal("Null pointer is formatted", std::string("nullptr"), to_string(static_cast<void*>(nullptr)));
+   assert_equal("nullptr is formatted", std::string("nullptr"), to_string(nullptr));
+}
+
+test_method(format_composite_tests, "Testing the formatting of containers and tuples")
+{
+   std::vector<int> empty;
+   std::map<int, std::string> map = { { 1, "one" }, { 2, "two" } };
+
+   assert_equal("Vector is formatted", std::string("{ 1, 2, 3 }"), to_string(std::vector<int>{ 1, 2, 3 }));
+   assert_equal("Empty vector is formatted", std::string("{ }"), to_string(empty));
+   assert_equal("Map is formatted", std::string("{ (1, one), (2, two) }"), to_string(map));
+   assert_equal("Tuple is formatted", std::string("(1, 2.5, x)"), to_string(std::make_tuple(1, 2.5, 'x')));
+   assert_equal("Nested containers are formatted", std::string("{ { 1 }, { } }"), to_string(std::vector<std::vector<int>>{ { 1 }, {} }));
+
+   size_t max_elements = settings().max_elements_;
+   settings().max_elements_ = 2;
+   std::string truncated = to_string(std::vector<int>{ 1, 2, 3 });
+   settings().max_elements_ = max_elements;
+   assert_equal("Long container is truncated", std::string("{ 1, 2, ... }"), truncated);
+}
+
+test_method(format_custom_tests, "Testing the formatting of user types")
+{
+   assert_equal("Specialized formatter is used", std::string("<1;-2>"), to_string(point{ 1, -2 }));
+   assert_equal("Stream operator is used", std::string("streamed 7"), to_string(streamed{ 7 }));
+   assert_equal("Formatter is used in containers", std::string("{ <0;0> }"), to_string(std::vector<point>{ point{ 0, 0 } }));
+   assert_equal("Type without formatter is formatted", std::string("<unprintable>"), to_string(opaque{ 1 }));
+}
+
+test_method(format_buffer_tests, "Testing the per thread buffers")
+{
+   std::string outer_text;
+   std::string inner_text;
+   {
+      buffer outer;
+      outer.append("outer");
+      {
+         buffer inner;
+         inner.append("inner");
+         inner_text = inner.str();
+      }
+      outer.append(' ');
+      outer.append(to_string(1));
+      outer_text = outer.str();
+   }
+
+   assert_equal("Nested buffers do not overlap", std::string("outer 1"), outer_text);
+   assert_equal("Inner buffer is correct", std::string("inner"), inner_text);
+   {
+      buffer reused;
+      assert_size_t_equal("Released buffer is cleared on reuse", 0, reused.size());
+   }
+
+   std::vector<buffer*> buffers;
+   for (int i = 0; i < 8; i++)
+   {
+      buffers.push_back(new buffer());
+      buffers.back()->append(to_string(i));
+   }
+   for (int i = 0; i < 8; i++)
+   {
+      assert_equal("Buffer beyond the pool is independent", to_string(i), buffers[i]->str());
+   }
+   for (int i = 7; i >= 0; i--)
+   {
+      delete buffers[i];
+   }
+}
@@ -0,0 +1,210 @@
+/****
+* Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+* All rights reserved.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "unit_test.h"
+#include "unit_test_linearizability.h"
+#include <deque>
+#include <mutex>
+#include <queue>
+
+using namespace aes::test::linearizability;
+
+namespace
+{
+   struct queue_input
+   {
+      bool enqueue_;
+      int value_;
+   };
+
+   struct queue_output
+   {
+      bool has_value_;
+      int value_;
+   };
+
+   struct queue_model
+   {
+      using state_type = std::deque<int>;
+      using input_type = queue_input;
+      using output_type = queue_output;
+
+      static bool step(state_type& state, const input_type& input, const output_type& output)
+      {
+         if (input.enqueue_)
+         {
+            state.push_back(input.value_);
+            return true;
+         }
+         if (state.empty())
+         {
+            return !output.has_value_;
+         }
+
+         int value = state.front();
+         state.pop_front();
+         return output.has_value_ && output.value_ == value;
+      }
+   };
+
+   using queue_operation = operation<queue_input, queue_output>;
+
+   queue_operation enqueue(unsigned thread, int value, uint64_t invoke, uint64_t response)
+   {
+      return queue_operation{ thread, queue_input{ true, value }, queue_output{ false, 0 }, invoke, response };
+   }
+
+   queue_operation dequeue(unsigned thread, bool has_value, int value, uint64_t invoke, uint64_t response)
+   {
+      return queue_operation{ thread, queue_input{ false, 0 }, queue_output{ has_value, value }, invoke, response };
+   }
+
+   template <typename _TQueue>
+   std::vector<queue_operation> record_queue_history(_TQueue& queue, unsigned threads, int operations)
+   {
+      history_recorder<queue_input, queue_output> recorder(threads, operations);
+      std::vector<std::thread> workers;
+
+      for (unsigned thread = 0; thread < threads; ++thread)
+      {
+         workers.emplace_back([&recorder, &queue, thread, operations]()
+         {
+            for (int i = 0; i < operations; ++i)
+            {
+               if (i % 2 == 0)
+               {
+                  int value = int(thread) * operations + i;
+                  size_t op = recorder.invoke(thread, queue_input{ true, value });
+                  queue.push(value);
+                  recorder.respond(thread, op, queue_output{ false, 0 });
+               }
+               else
+               {
+                  int value = 0;
+                  size_t op = recorder.invoke(thread, queue_input{ false, 0 });
+                  bool has_value = queue.pop(value);
+                  recorder.respond(thread, op, queue_output{ has_value, value });
+               }
+            }
+         });
+      }
+      std::for_each(workers.begin(), workers.end(), [](std::thread& worker) { worker.join(); });
+
+      return recorder.history();
+   }
+
+   class locked_queue
+   {
+   public:
+      void push(int value)
+      {
+         std::lock_guard<std::mutex> lock(mutex_);
+         queue_.push(value);
+      }
+      bool pop(int& value)
+      {
+         std::lock_guard<std::mutex> lock(mutex_);
+         if (queue_.empty())
+         {
+            return false;
+         }
+         value = queue_.front();
+         queue_.pop();
+         return true;
+      }
+
+   private:
+      std::mutex mutex_;
+      std::queue<int> queue_;
+   };
+}
+
+test_method(linearizability_checker_tests, "Testing the linearizability checker on hand written histories")
+{
+   test_section("Testing a sequential history")
+   {
+      std::vector<queue_operation> history = { enqueue(0, 1, 0, 1), enqueue(0, 2, 2, 3), dequeue(0, true, 1, 4, 5), dequeue(0, true, 2, 6, 7), dequeue(0, false, 0, 8, 9) };
+      checker<queue_model> check;
+      assert_is_true("Sequential queue history is linearizable", check.check(history));
+   }
+   test_section("Testing overlapping operations can be reordered")
+   {
+      std::vector<queue_operation> history = { enqueue(0, 1, 0, 10), enqueue(1, 2, 1, 9), dequeue(0, true, 2, 11, 12), dequeue(1, true, 1, 13, 14) };
+      checker<queue_model> check;
+      assert_is_true("Overlapping enqueues may take effect in any order", check.check(history));
+   }
+   test_section("Testing operations ordered in time cannot be reordered")
+   {
+      std::vector<queue_operation> history = { enqueue(0, 1, 0, 1), enqueue(1, 2, 2, 3), dequeue(0, true, 2, 4, 5), dequeue(1, true, 1, 6, 7) };
+      checker<queue_model> check;
+      assert_is_false("Enqueue of 1 completed before enqueue of 2 started", check.check(history));
+   }
+   test_section("Testing a dequeue of a value never enqueued")
+   {
+      std::vector<queue_operation> history = { enqueue(0, 1, 0, 5), dequeue(1, true, 3, 1, 6) };
+      checker<queue_model> check;
+      assert_is_false("Value 3 has never been enqueued", check.check(history));
+   }
+   test_section("Testing the empty history")
+   {
+      checker<queue_model> check;
+      assert_is_true("Empty history is linearizable", check.check(std::vector<queue_operation>()));
+   }
+}
+
+test_method(linearizability_recorder_tests, "Testing the linearizability checker on recorded histories")
+{
+   test_section("Testing a recorded history of a locked queue")
+   {
+      locked_queue queue;
+      std::vector<queue_operation> history = record_queue_history(queue, 4, 25000);
+      checker<queue_model> check;
+
+      assert_size_t_equal("All operations have been recorded", 100000, history.size());
+      assert_is_true("Locked queue is linearizable", check.check(history));
+   }
+   test_section("Testing a recorded history of a stack used as a queue")
+   {
+      history_recorder<queue_input, queue_output> recorder(2);
+      std::vector<int> stack;
+
+      std::thread producer([&]()
+      {
+         for (int i = 0; i < 3; ++i)
+         {
+            size_t op = recorder.invoke(0, queue_input{ true, i });
+            stack.push_back(i);
+            recorder.respond(0, op, queue_output{ false, 0 });
+         }
+      });
+      producer.join();
+      std::thread consumer([&]()
+      {
+         while (!stack.empty())
+         {
+            size_t op = recorder.invoke(1, queue_input{ false, 0 });
+            int value = stack.back();
+            stack.pop_back();
+            recorder.respond(1, op, queue_output{ true, value });
+         }
+      });
+      consumer.join();
+
+      checker<queue_model> check;
+      assert_is_false("Stack history is not linearizable as a queue", check.check(recorder.history()));
+   }
+}
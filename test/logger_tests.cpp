@@ -166,3 +166,197 @@ test_method(logger_log_tests, "Test all the log methods")
                 [](std::stringstream& out, std::stringstream& error) { return out.str(); },
                 [](std::stringstream& out, std::stringstream& error) { return error.str(); });
 }
+
+test_method(logger_capture_tests, "Test the capture of the log records")
+{
+   test_section("Testing captured records are discarded when not emitted")
+   {
+      std::stringstream out;
+      std::stringstream error;
+      my_logger log(out, error, level::verbose);
+      capture_buffer buffer(capture_mode::spill, 1024);
+
+      log.begin_capture(buffer);
+      assert_is_true("Logger is capturing", log.is_capturing());
+      log.log_verbose("verbose message");
+      log.log_error("error message");
+      assert_string_empty("Nothing has been written to the output", out.str());
+      assert_string_empty("Nothing has been written to the error", error.str());
+      log.end_capture(false);
+
+      assert_is_false("Logger is not capturing anymore", log.is_capturing());
+      assert_string_empty("Output is still empty", out.str());
+      assert_string_empty("Error is still empty", error.str());
+      assert_uint64_t_equal("Buffer has been cleared", 0, buffer.size());
+
+      log.log_information("information message");
+      assert_equal("Records are written directly after the capture", std::string("information message\n"), out.str());
+   }
+   test_section("Testing captured records are emitted on request")
+   {
+      std::stringstream out;
+      std::stringstream error;
+      my_logger log(out, error, level::verbose);
+      capture_buffer buffer(capture_mode::spill, 1024);
+
+      log.begin_capture(buffer);
+      log.log_verbose("first");
+      log.log_error("error message");
+      log.log_verbose("second");
+      log.log_debug("not logged");
+      log.end_capture(true);
+
+      assert_equal("Output records are emitted in order", std::string("first\nsecond\n"), out.str());
+      assert_equal("Error records are emitted", std::string("error message\n"), error.str());
+   }
+   test_section("Testing captured records of both streams keep their order")
+   {
+      std::stringstream merged;
+      my_logger log(merged, merged, level::verbose);
+      capture_buffer buffer(capture_mode::spill, 16);
+
+      log.begin_capture(buffer);
+      log.log_verbose("first");
+      log.log_error("error\non two lines");
+      log.log_verbose("second");
+      log.log_error("last error");
+      log.end_capture(true);
+
+      assert_equal("Records are emitted in the order they were logged", std::string("first\nerror\non two lines\nsecond\nlast error\n"), merged.str());
+   }
+   test_section("Testing captured records are spilled past the limit")
+   {
+      std::stringstream out;
+      std::stringstream error;
+      my_logger log(out, error, level::verbose);
+      capture_buffer buffer(capture_mode::spill, 16);
+
+      std::stringstream expected;
+      log.begin_capture(buffer);
+      for (int i = 0; i < 100; ++i)
+      {
+         log.log_verbose(i);
+         expected << i << std::endl;
+      }
+      assert_uint64_t_equal("All records are kept", expected.str().size(), buffer.size());
+      log.end_capture(true);
+
+      assert_equal("All the records are emitted", expected.str(), out.str());
+   }
+   test_section("Testing only the tail of the captured records is kept")
+   {
+      std::stringstream out;
+      std::stringstream error;
+      my_logger log(out, error, level::verbose);
+      capture_buffer buffer(capture_mode::tail, 8);
+
+      log.begin_capture(buffer);
+      for (int i = 0; i < 100; ++i)
+      {
+         log.log_verbose(i);
+      }
+      assert_is_true("Only the tail is kept", buffer.size() <= 16);
+      log.end_capture(true);
+
+      std::string output(out.str());
+      assert_equal("Truncation is reported", size_t(0), output.find("... "));
+      assert_equal("The last record is kept", output.size() - 3, output.rfind("99\n"));
+   }
+}
+
+namespace
+{
+   std::stringstream category_out;
+   std::stringstream category_error;
+
+   class mock_category_suite_singleton
+   {
+   public:
+      static test_suite_base<mock_category_suite_singleton, my_logger>& get()
+      {
+         static my_logger log(category_out, category_error);
+         static test_suite_base<mock_category_suite_singleton, my_logger> test_suite(log);
+         return test_suite;
+      }
+   };
+
+   class mock_category_test : public unit_test_base<mock_category_suite_singleton, my_logger>
+   {
+   public:
+      mock_category_test(const std::string& test_name) noexcept : unit_test_base(test_name, "description") { }
+      ~mock_category_test() noexcept = default;
+
+   private:
+      void run_tests(assert_base<my_logger>& assert)
+      {
+         assert.pass(__FILE__, __LINE__, "Passing " + name());
+      };
+   };
+}
+
+test_method(logger_category_tests, "Testing the levels of the log categories")
+{
+   test_section("Testing the rules are parsed")
+   {
+      level parsed = level::error;
+      assert_is_true("Level name is parsed", parse_level("debug", parsed));
+      assert_equal("Level is correct", level::debug, parsed);
+      assert_is_false("Unknown level is rejected", parse_level("loud", parsed));
+      assert_is_false("Rule without a level is rejected", categories::get().configure("parser"));
+      assert_is_false("Rule with an unknown level is rejected", categories::get().configure("parser:loud"));
+      assert_is_false("Rule without a name is rejected", categories::get().configure(":debug"));
+   }
+   test_section("Testing the longest rule sets the level of a category")
+   {
+      category parser("parser");
+      category parser_lexer("parser.lexer");
+      category network("network");
+
+      assert_is_true("Rules are configured", categories::get().configure("parser:debug,parser.*:verbose,*:error"));
+      category late("late");
+
+      assert_equal("Exact name wins", level::debug, parser.log_level());
+      assert_equal("Prefix wins over everything", level::verbose, parser_lexer.log_level());
+      assert_equal("Everything else takes the default", level::error, network.log_level());
+      assert_equal("Category created after the rules is configured", level::error, late.log_level());
+      assert_is_true("Debug is logged for the parser", parser.should_log(level::debug));
+      assert_is_false("Warning is not logged for the network", network.should_log(level::warning));
+      assert_is_true("Errors are always logged", network.should_log(level::error));
+
+      assert_is_true("Rules are cleared", categories::get().configure(""));
+      assert_equal("Category returns to information", level::information, parser.log_level());
+   }
+   test_section("Testing a logger logs through a category")
+   {
+      std::stringstream out;
+      std::stringstream error;
+      my_logger log(out, error, level::error);
+      category parser("parser");
+
+      parser.log_level(level::debug);
+      log.log(parser, level::debug, "parsed");
+      log.log(parser, level::error, "failed");
+      parser.log_level(level::warning);
+      log.log(parser, level::debug, "hidden");
+      assert_equal("Debug record is written despite the level of the logger", std::string("parsed\n"), out.str());
+      assert_equal("Error record goes to the error stream", std::string("failed\n"), error.str());
+   }
+   test_section("Testing the rules naming a test or its file apply while it runs")
+   {
+      test_suite_base<mock_category_suite_singleton, my_logger>& test_suite = mock_category_suite_singleton::get();
+      mock_category_test loud("loud_test");
+      mock_category_test quiet("quiet_test");
+      mock_category_test filed("filed_test");
+
+      filed.source_file("/path/to/filed_tests.cpp");
+      assert_is_true("Rules are configured", categories::get().configure("loud_test:verbose,filed_tests.cpp:verbose"));
+      assert_is_true("Running the suite is successful", test_suite.run("title"));
+      assert_is_true("Rules are cleared", categories::get().configure(""));
+
+      std::string output(category_out.str());
+      assert_is_true("Passing assertion of the named test is logged", output.find("Passing loud_test") != std::string::npos);
+      assert_is_true("Passing assertion of the named file is logged", output.find("Passing filed_test") != std::string::npos);
+      assert_is_true("Passing assertion of the other test is not logged", output.find("Passing quiet_test") == std::string::npos);
+      assert_equal("Level of the logger is restored", level::information, test_suite.test_logger().log_level());
+   }
+}
@@ -0,0 +1,135 @@
+/****
+* Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+* All rights reserved.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "unit_test.h"
+#include <chrono>
+#include <fstream>
+#include <thread>
+
+using namespace aes::test;
+
+test_method(metrics_render_tests, "Testing the metrics are rendered as OpenMetrics text")
+{
+   metrics::registry registry;
+   metrics::snapshot before(registry.sample());
+
+   registry.plan(1);
+   registry.plan(2);
+   registry.begin_test(0);
+   registry.assertion(true);
+   registry.assertion(true);
+   registry.assertion(false);
+   registry.end_test(0, "  slow_test  ", true);
+   registry.begin_test(1);
+
+   metrics::snapshot after(registry.sample());
+   std::string text(metrics::render(after, before));
+
+   assert_uint64_t_equal("Passed assertions are summed over the shards", 2, after.passed_);
+   assert_uint64_t_equal("Failed assertions are summed over the shards", 1, after.failed_);
+   assert_uint64_t_equal("Both workers are reported", 2, after.busy_ns_.size());
+   assert_is_true("Planned tests are rendered", text.find("cpp_test_tests_planned 3\n") != std::string::npos);
+   assert_is_true("Completed tests are rendered", text.find("cpp_test_tests_completed_total 1\n") != std::string::npos);
+   assert_is_true("Failed tests are rendered", text.find("cpp_test_tests_failed_total 1\n") != std::string::npos);
+   assert_is_true("Running tests are rendered", text.find("cpp_test_tests_running 1\n") != std::string::npos);
+   assert_is_true("Passed assertions are rendered", text.find("cpp_test_assertions_total{result=\"passed\"} 2\n") != std::string::npos);
+   assert_is_true("Utilization of each worker is rendered", text.find("cpp_test_worker_utilization{worker=\"1\"}") != std::string::npos);
+   assert_is_true("Slowest test is rendered", text.find("cpp_test_slowest_test_seconds{test=\"slow_test\"}") != std::string::npos);
+   assert_is_true("Exposition ends with EOF", text.size() >= 6 && text.compare(text.size() - 6, 6, "# EOF\n") == 0);
+}
+
+test_method(metrics_workers_tests, "Testing the metrics of many workers")
+{
+   metrics::registry registry;
+
+   registry.begin_test(5);
+   registry.begin_test(69);
+   registry.begin_test(1000);
+   std::this_thread::sleep_for(std::chrono::milliseconds(1));
+   registry.end_test(69, "second_test", false);
+   registry.assertions(3, 2);
+
+   metrics::snapshot after(registry.sample());
+   assert_uint64_t_equal("Table grows to the highest worker", 1001, after.busy_ns_.size());
+   assert_is_true("Worker sharing a slot modulo 64 is still busy", after.busy_ns_[5] > 0);
+   assert_is_true("Ended worker has been busy", after.busy_ns_[69] > 0);
+   assert_is_true("Worker of a later chunk is busy", after.busy_ns_[1000] > 0);
+   assert_uint64_t_equal("Idle worker in between is not busy", 0, after.busy_ns_[500]);
+   assert_is_true("Other tests are still running", after.running_ == 2);
+   assert_uint64_t_equal("Passed assertions are added", 3, after.passed_);
+   assert_uint64_t_equal("Failed assertions are added", 2, after.failed_);
+}
+
+test_method(metrics_publisher_tests, "Testing the metrics publisher")
+{
+   test_section("Testing the metrics are written to a file")
+   {
+      metrics::registry registry;
+      std::string path("/tmp/cpp_test_metrics_" + std::to_string(::getpid()) + ".prom");
+      {
+         metrics::publisher publisher(registry);
+         assert_is_true("File is opened", publisher.open(path));
+         publisher.start(std::chrono::milliseconds(10));
+         registry.plan(7);
+      }
+
+      std::ifstream file(path);
+      std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+      assert_is_true("Last sample is written when stopped", text.find("cpp_test_tests_planned 7\n") != std::string::npos);
+      assert_is_true("File is complete", text.find("# EOF\n") != std::string::npos);
+      std::remove(path.c_str());
+   }
+#if defined(AES_TEST_DISTRIBUTED)
+   test_section("Testing the metrics are served over HTTP")
+   {
+      metrics::registry registry;
+      metrics::publisher publisher(registry);
+      std::string address("unix:/tmp/cpp_test_metrics_" + std::to_string(::getpid()));
+      distributed::channel client;
+      std::string status;
+
+      assert_is_true("Socket is opened", publisher.open(address));
+      publisher.start(std::chrono::milliseconds(1000));
+      assert_is_true("Client is connected", client.connect(address));
+      assert_is_true("Request is sent", client.send("GET /metrics HTTP/1.0\r\n\r\n"));
+      while (!client.read_line(status) && client.receive())
+      {
+      }
+      assert_equal("Request is answered", std::string("HTTP/1.0 200 OK\r"), status);
+   }
+   test_section("Testing a client that does not read cannot hang the publisher")
+   {
+      metrics::registry registry;
+      metrics::publisher publisher(registry);
+      std::string address("unix:/tmp/cpp_test_metrics_stalled_" + std::to_string(::getpid()));
+      distributed::channel client;
+
+      // The name of the slowest test makes the answer larger than the buffer of the socket.
+      registry.begin_test(0);
+      registry.end_test(0, std::string(size_t(1) << 20, 'x'), false);
+      assert_is_true("Socket is opened", publisher.open(address));
+      publisher.start(std::chrono::milliseconds(1000));
+      assert_is_true("Client is connected", client.connect(address));
+      assert_is_true("Request is sent", client.send("GET /metrics HTTP/1.0\r\n\r\n"));
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      publisher.stop();
+      assert_is_true("Publisher stops while the client is connected", std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+   }
+#endif
+}
@@ -0,0 +1,285 @@
+/****
+* Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+* All rights reserved.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "unit_test.h"
+#include <fstream>
+#if defined(AES_TEST_MODULES)
+#include <unistd.h>
+
+using namespace aes::test;
+using namespace aes::test::log;
+
+using my_logger = logger_base<std::stringstream, std::stringstream>;
+
+namespace
+{
+   template <int _Id>
+   class mock_module_suite_singleton
+   {
+   public:
+      static test_suite_base<mock_module_suite_singleton, my_logger>& get()
+      {
+         static my_logger log(out(), error());
+         static test_suite_base<mock_module_suite_singleton, my_logger> test_suite(log);
+         return test_suite;
+      }
+
+      static std::stringstream& out()
+      {
+         static std::stringstream stream;
+         return stream;
+      }
+
+      static std::stringstream& error()
+      {
+         static std::stringstream stream;
+         return stream;
+      }
+   };
+
+   template <int _Id>
+   class mock_module_test : public unit_test_base<mock_module_suite_singleton<_Id>, my_logger>
+   {
+   public:
+      mock_module_test(const std::string& test_name, bool fail) noexcept
+         : unit_test_base<mock_module_suite_singleton<_Id>, my_logger>(test_name, "description")
+         , fail_(fail)
+      {
+         this->source_file("mock_module.cpp");
+      }
+
+   private:
+      void run_tests(assert_base<my_logger>& assert)
+      {
+         assert.pass(__FILE__, __LINE__, "Passing " + this->name());
+         if (fail_)
+         {
+            assert.fail(__FILE__, __LINE__, "Failing " + this->name());
+         }
+      }
+
+   private:
+      bool fail_;
+   };
+
+   struct counted
+   {
+      counted(int& destroyed) : destroyed_(destroyed) {}
+      ~counted() { destroyed_++; }
+      int& destroyed_;
+   };
+}
+
+test_method(module_fixtures_tests, "Testing the fixtures kept across the reloads of a module")
+{
+   test_section("Testing a fixture is built once and found again by its name")
+   {
+      module::fixtures kept;
+      int built = 0;
+      int& first = kept.keep<int>("answer", [&built]() { built++; return new int(42); });
+      int& second = kept.keep<int>("answer", [&built]() { built++; return new int(0); });
+
+      assert_equal("Fixture is built once", 1, built);
+      assert_ptr_equal("Same fixture is found again", &first, &second);
+      assert_equal("Value of the first build is kept", 42, second);
+      assert_size_t_equal("One fixture is kept", 1, kept.size());
+   }
+   test_section("Testing a fixture of another type is built again")
+   {
+      module::fixtures kept;
+      int destroyed = 0;
+      kept.keep<counted>("fixture", [&destroyed]() { return new counted(destroyed); });
+      double& replaced = kept.keep<double>("fixture", []() { return new double(1.5); });
+
+      assert_equal("Fixture of the previous type is destroyed", 1, destroyed);
+      assert_equal("Fixture of the new type is built", 1.5, replaced);
+   }
+   test_section("Testing the fixtures are destroyed with the runner")
+   {
+      int destroyed = 0;
+      {
+         module::fixtures kept;
+         kept.keep<counted>("first", [&destroyed]() { return new counted(destroyed); });
+         kept.keep<counted>("second", [&destroyed]() { return new counted(destroyed); });
+      }
+      assert_equal("Every fixture is destroyed", 2, destroyed);
+   }
+   test_section("Testing the fixtures of a module are those of its runner")
+   {
+      module::fixtures kept;
+      test_suite_base<mock_module_suite_singleton<0>, my_logger>& tests = mock_module_suite_singleton<0>::get();
+      std::unique_ptr<module::suite> entered(module::enter(tests, &kept, "title"));
+
+      module::fixtures::get().keep<int>("runner", []() { return new int(7); });
+      module::fixtures::runner(nullptr);
+      assert_size_t_equal("Fixture is kept by the runner", 1, kept.size());
+      assert_ptr_not_equal("Process has fixtures of its own", &kept, &module::fixtures::get());
+   }
+   test_section("Testing a fixture remembers the module that built it")
+   {
+      module::fixtures kept;
+      module::library unloaded;
+      kept.keep<int>("first", []() { return new int(1); });
+      kept.keep<int>("second", []() { return new int(2); });
+
+      std::vector<const void*> modules(kept.modules());
+      assert_size_t_equal("Module of every fixture is known", 2, modules.size());
+      assert_ptr_equal("Both fixtures are built by the same module", modules[0], modules[1]);
+      assert_is_false("Library not loaded has built nothing", unloaded.built(kept));
+   }
+#if defined(AES_TEST_MODULE_FILE)
+   test_section("Testing a replaced module stays loaded while a fixture it built remains")
+   {
+      module::fixtures kept;
+      module::library reloaded;
+      module::result outcome;
+      std::string error;
+
+      assert_is_true("Module is loaded again", reloaded.open(AES_TEST_MODULE_FILE, kept, error));
+      assert_is_true("Test keeping a fixture is run by the module", reloaded.get().run("module_fixture_owner_tests", outcome));
+      assert_is_true("Fixture is built by the module", reloaded.built(kept));
+      reloaded.retire();
+      assert_is_false("Tests of the replaced module are gone", reloaded.is_open());
+      assert_is_true("Replaced module stays loaded", reloaded.is_loaded());
+
+      kept.clear();
+      assert_is_false("Module has no fixture left", reloaded.built(kept));
+      reloaded.close();
+      assert_is_false("Module is unloaded", reloaded.is_loaded());
+   }
+#endif
+}
+
+// Keeps a fixture in the fixtures of its runner, the module tests load the module again to run it.
+test_method(module_fixture_owner_tests, "Testing a fixture is kept for the runner of the test")
+{
+   int& value = module::fixtures::get().keep<int>("module_fixture_owner", []() { return new int(1); });
+   assert_equal("Fixture is kept", 1, value);
+}
+
+test_method(module_suite_tests, "Testing the tests of a module are run by a runner")
+{
+   test_section("Testing the tests of a module are listed and run captured")
+   {
+      test_suite_base<mock_module_suite_singleton<1>, my_logger>& tests = mock_module_suite_singleton<1>::get();
+      mock_module_test<1> passing("passing_test", false);
+      mock_module_test<1> failing("failing_test", true);
+      module::suite_of<test_suite_base<mock_module_suite_singleton<1>, my_logger>> adapter(tests, "module");
+
+      std::vector<module::test_info> listed(adapter.tests());
+      assert_size_t_equal("Every test is listed", 2, listed.size());
+      assert_equal("Tests are listed by name", std::string("failing_test"), listed[0].name_);
+      assert_equal("Source file of a test is listed", std::string("mock_module.cpp"), listed[0].source_file_);
+
+      module::result outcome;
+      assert_is_false("Failing test fails", adapter.run("failing_test", outcome));
+      assert_uint64_t_equal("Passed asserts are reported", 1, outcome.passed_);
+      assert_uint64_t_equal("Failed asserts are reported", 1, outcome.failed_);
+      assert_is_true("Failure is in the output", outcome.error_.find("Failing failing_test") != std::string::npos);
+      assert_equal("Module logs nothing itself", std::string(), mock_module_suite_singleton<1>::error().str());
+
+      assert_is_false("Unknown test fails", adapter.run("unknown_test", outcome));
+      assert_is_true("Unknown test is reported", outcome.error_.find("unknown test unknown_test") != std::string::npos);
+   }
+   test_section("Testing the runner reports the tests of a module")
+   {
+      test_suite_base<mock_module_suite_singleton<2>, my_logger>& tests = mock_module_suite_singleton<2>::get();
+      test_suite_base<mock_module_suite_singleton<3>, my_logger>& runner = mock_module_suite_singleton<3>::get();
+      mock_module_test<2> passing("passing_test", false);
+      mock_module_test<2> failing("failing_test", true);
+      module::suite_of<test_suite_base<mock_module_suite_singleton<2>, my_logger>> adapter(tests, "module");
+      std::set<std::string> failed;
+
+      bool result = runner.run_module("module", adapter, std::vector<std::string>({ "passing_test", "failing_test" }), failed);
+      assert_is_false("Run with a failing test fails", result);
+      assert_uint64_t_equal("Asserts of the module are counted", 3, runner.total());
+      assert_is_true("Failing test is returned", failed.count("failing_test") == 1);
+      assert_is_true("Passing test is reported", mock_module_suite_singleton<3>::out().str().find("passing_test (0s)") != std::string::npos);
+
+      result = runner.run_module("module", adapter, std::vector<std::string>({ "passing_test" }), failed);
+      assert_is_true("Rerun of the passing test passes", result);
+      assert_uint64_t_equal("Totals are those of the rerun", 1, runner.total());
+      assert_is_true("No test is failing", failed.empty());
+   }
+}
+
+test_method(module_aggregate_tests, "Testing the tests of several modules are run by one pool")
+{
+   test_section("Testing the modules are reported with their totals")
+   {
+      test_suite_base<mock_module_suite_singleton<4>, my_logger>& first = mock_module_suite_singleton<4>::get();
+      test_suite_base<mock_module_suite_singleton<5>, my_logger>& second = mock_module_suite_singleton<5>::get();
+      test_suite_base<mock_module_suite_singleton<6>, my_logger>& runner = mock_module_suite_singleton<6>::get();
+      mock_module_test<4> first_a("first_a", false);
+      mock_module_test<4> first_b("first_b", false);
+      mock_module_test<4> first_c("first_c", false);
+      mock_module_test<5> second_a("second_a", true);
+      module::suite_of<test_suite_base<mock_module_suite_singleton<4>, my_logger>> first_module(first, "first module");
+      module::suite_of<test_suite_base<mock_module_suite_singleton<5>, my_logger>> second_module(second, "second module");
+      std::vector<module::suite*> modules({ &first_module, &second_module });
+
+      bool result = runner.run_modules("modules", modules, 4);
+      std::string report(mock_module_suite_singleton<6>::out().str());
+
+      assert_is_false("Run with a failing module fails", result);
+      assert_uint64_t_equal("Asserts of every module are counted", 5, runner.total());
+      assert_uint64_t_equal("Failure of a module is counted", 1, runner.failed());
+      assert_is_true("Totals of the first module are reported", report.find("MODULE 3     Passed 3     Failed 0     first module") != std::string::npos);
+      assert_is_true("Totals of the second module are reported", report.find("MODULE 2     Passed 1     Failed 1     second module") != std::string::npos);
+      assert_is_true("Tests of a module are reported in order", report.find("first_a") < report.find("first_b") && report.find("first_b") < report.find("first_c"));
+      assert_is_true("Totals of the run are reported", report.find("TOTAL 5     PASSED 4     FAILED 1") != std::string::npos);
+      assert_is_true("Failure is reported", mock_module_suite_singleton<6>::error().str().find("Failing second_a") != std::string::npos);
+   }
+   test_section("Testing a module without tests is reported")
+   {
+      test_suite_base<mock_module_suite_singleton<7>, my_logger>& empty = mock_module_suite_singleton<7>::get();
+      test_suite_base<mock_module_suite_singleton<8>, my_logger>& runner = mock_module_suite_singleton<8>::get();
+      module::suite_of<test_suite_base<mock_module_suite_singleton<7>, my_logger>> empty_module(empty, "empty module");
+      std::vector<module::suite*> modules({ &empty_module });
+
+      assert_is_true("Run without tests passes", runner.run_modules("modules", modules, 0));
+      assert_is_true("Empty module is reported", mock_module_suite_singleton<8>::out().str().find("MODULE 0     Passed 0     Failed 0     empty module") != std::string::npos);
+   }
+}
+
+test_method(module_library_tests, "Testing the loading and the watch of a module file")
+{
+   std::string path("/tmp/cpp_test_module_file_" + std::to_string(::getpid()) + ".so");
+   std::ofstream(path) << "not a module";
+
+   test_section("Testing a file that is not a module is refused")
+   {
+      module::fixtures kept;
+      module::library loaded;
+      std::string error;
+      assert_is_false("File is not loaded", loaded.open(path, kept, error));
+      assert_is_false("Library is not open", loaded.is_open());
+      assert_not_equal("Reason is given", std::string(), error);
+   }
+   test_section("Testing a rewritten file is reported by the watcher")
+   {
+      module::watcher watcher;
+      assert_is_true("File is watched", watcher.open(path));
+      assert_is_false("Unchanged file is not reported", watcher.wait(0));
+      std::ofstream(path) << "rebuilt";
+      assert_is_true("Rewritten file is reported", watcher.wait(2000));
+      assert_is_false("Change is reported once", watcher.wait(0));
+   }
+
+   ::unlink(path.c_str());
+}
+#endif
@@ -0,0 +1,190 @@
+/****
+* Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+* All rights reserved.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "unit_test.h"
+#include <csignal>
+
+using namespace aes::test;
+using namespace aes::test::log;
+
+using my_logger = logger_base<std::stringstream, std::stringstream>;
+
+#if defined(AES_TEST_RESOURCES)
+namespace
+{
+   template <int _Id>
+   class mock_resources_suite_singleton
+   {
+   public:
+      static test_suite_base<mock_resources_suite_singleton, my_logger>& get()
+      {
+         static my_logger log(out(), error());
+         static test_suite_base<mock_resources_suite_singleton, my_logger> test_suite(log);
+         return test_suite;
+      }
+
+      static std::stringstream& out()
+      {
+         static std::stringstream stream;
+         return stream;
+      }
+
+      static std::stringstream& error()
+      {
+         static std::stringstream stream;
+         return stream;
+      }
+   };
+
+   enum class behaviour
+   {
+      pass,
+      fail,
+      allocate,
+      crash,
+      spin
+   };
+
+   template <int _Id>
+   class mock_resources_test : public unit_test_base<mock_resources_suite_singleton<_Id>, my_logger>
+   {
+   public:
+      mock_resources_test(const std::string& test_name, behaviour action) noexcept
+         : unit_test_base<mock_resources_suite_singleton<_Id>, my_logger>(test_name, "description")
+         , action_(action)
+      {
+      }
+
+   private:
+      void run_tests(assert_base<my_logger>& assert)
+      {
+         assert.pass(__FILE__, __LINE__, "Passing " + this->name());
+         switch (action_)
+         {
+         case behaviour::fail:
+            assert.fail(__FILE__, __LINE__, "Failing " + this->name());
+            break;
+         case behaviour::allocate:
+         {
+            std::vector<char> memory(size_t(8) << 30);
+            assert.pass(__FILE__, __LINE__, "Allocated " + std::to_string(memory.size()));
+            break;
+         }
+         case behaviour::crash:
+            std::raise(SIGKILL);
+            break;
+         case behaviour::spin:
+            for (volatile uint64_t i = 0; ; )
+            {
+               i = i + 1;
+            }
+         default:
+            break;
+         }
+      }
+
+   private:
+      behaviour action_;
+   };
+}
+
+test_method(parse_size_tests, "Testing the sizes of the memory limit")
+{
+   uint64_t size = 0;
+
+   assert_is_true("Plain size is parsed", resources::parse_size("512", size));
+   assert_uint64_t_equal("Plain size is correct", 512, size);
+   assert_is_true("Kilobytes are parsed", resources::parse_size("4K", size));
+   assert_uint64_t_equal("Kilobytes are correct", 4096, size);
+   assert_is_true("Megabytes are parsed", resources::parse_size("2m", size));
+   assert_uint64_t_equal("Megabytes are correct", 2 * 1024 * 1024, size);
+   assert_is_true("Gigabytes are parsed", resources::parse_size("1G", size));
+   assert_uint64_t_equal("Gigabytes are correct", uint64_t(1) << 30, size);
+   assert_is_false("Missing number is rejected", resources::parse_size("G", size));
+   assert_is_false("Unknown unit is rejected", resources::parse_size("4Q", size));
+}
+
+test_method(resources_report_tests, "Testing the resources used by each test are reported")
+{
+   test_suite_base<mock_resources_suite_singleton<0>, my_logger>& test_suite = mock_resources_suite_singleton<0>::get();
+   mock_resources_test<0> test("reported_test", behaviour::pass);
+
+   test_suite.report_resources(true);
+   assert_is_true("Running the suite is successful", test_suite.run("title"));
+
+   std::string report = mock_resources_suite_singleton<0>::out().str();
+   assert_is_true("Peak RSS is reported", report.find("reported_test(0s) rss +") != std::string::npos);
+   assert_is_true("Page faults are reported", report.find(" faults ") != std::string::npos);
+   assert_is_true("Context switches are reported", report.find(" switches ") != std::string::npos);
+}
+
+test_method(isolated_tests, "Testing the tests isolated in a child process")
+{
+   test_section("Testing the results and output of isolated tests come back to the suite")
+   {
+      test_suite_base<mock_resources_suite_singleton<1>, my_logger>& test_suite = mock_resources_suite_singleton<1>::get();
+      mock_resources_test<1> passing("passing_test", behaviour::pass);
+      mock_resources_test<1> failing("failing_test", behaviour::fail);
+
+      test_suite.isolate(resources::limits{ 0, 0 });
+      metrics::snapshot before(metrics::registry::get().sample());
+      bool result = test_suite.run("title");
+      metrics::snapshot after(metrics::registry::get().sample());
+      assert_is_false("Running the suite fails", result);
+      assert_uint64_t_equal("Passed assertions of the children are in the metrics", 2, after.passed_ - before.passed_);
+      assert_uint64_t_equal("Failed assertion of the child is in the metrics", 1, after.failed_ - before.failed_);
+      assert_uint64_t_equal("Passed count is merged", 2, test_suite.passed());
+      assert_uint64_t_equal("Failed count is merged", 1, test_suite.failed());
+      assert_uint64_t_equal("Tests of the suite have not run in the process", 0, passing.total() + failing.total());
+      assert_is_true("Failure is reported", mock_resources_suite_singleton<1>::error().str().find("Failing failing_test") != std::string::npos);
+   }
+   test_section("Testing a test going over the memory limit fails alone")
+   {
+      test_suite_base<mock_resources_suite_singleton<2>, my_logger>& test_suite = mock_resources_suite_singleton<2>::get();
+      mock_resources_test<2> allocating("allocating_test", behaviour::allocate);
+      mock_resources_test<2> passing("passing_test", behaviour::pass);
+
+      test_suite.isolate(resources::limits{ uint64_t(1) << 30, 0 });
+      assert_is_false("Running the suite fails", test_suite.run("title"));
+      assert_uint64_t_equal("The other test passes", 2, test_suite.passed());
+      assert_uint64_t_equal("The allocating test fails", 1, test_suite.failed());
+      assert_is_true("Allocation failure is reported", mock_resources_suite_singleton<2>::error().str().find("Error: unhandled exception") != std::string::npos);
+   }
+   test_section("Testing a killed test fails alone")
+   {
+      test_suite_base<mock_resources_suite_singleton<3>, my_logger>& test_suite = mock_resources_suite_singleton<3>::get();
+      mock_resources_test<3> crashing("crashing_test", behaviour::crash);
+      mock_resources_test<3> passing("passing_test", behaviour::pass);
+
+      test_suite.isolate(resources::limits{ 0, 0 });
+      assert_is_false("Running the suite fails", test_suite.run("title"));
+      assert_uint64_t_equal("The other test passes", 1, test_suite.passed());
+      assert_uint64_t_equal("The killed test fails", 1, test_suite.failed());
+      assert_is_true("Signal is reported", mock_resources_suite_singleton<3>::error().str().find("Error: crashing_test killed by signal 9") != std::string::npos);
+   }
+   test_section("Testing a test going over the cpu limit is stopped")
+   {
+      test_suite_base<mock_resources_suite_singleton<4>, my_logger>& test_suite = mock_resources_suite_singleton<4>::get();
+      mock_resources_test<4> spinning("spinning_test", behaviour::spin);
+
+      test_suite.isolate(resources::limits{ 0, 1 });
+      assert_is_false("Running the suite fails", test_suite.run("title"));
+      assert_uint64_t_equal("The spinning test fails", 1, test_suite.failed());
+      assert_is_true("Cpu limit is reported", mock_resources_suite_singleton<4>::error().str().find("(cpu limit)") != std::string::npos);
+   }
+}
+#endif
@@ -0,0 +1,247 @@
+/****
+* Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+* All rights reserved.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "unit_test.h"
+#include "result_log_report.h"
+
+using namespace aes::test;
+using namespace aes::test::log;
+
+using my_logger = logger_base<std::stringstream, std::stringstream>;
+using my_assert = assert_base<my_logger>;
+
+namespace
+{
+   const std::string result_log_file = "result_log_tests.bin";
+
+   // Writes the magic header followed by the given records, bytes as they would be on disk
+   void write_raw_log(const std::string& records)
+   {
+      std::FILE* file = std::fopen(result_log_file.c_str(), "wb");
+      std::fwrite(result_log::magic, 1, result_log::magic_size, file);
+      std::fwrite(records.data(), 1, records.size(), file);
+      std::fclose(file);
+   }
+
+   // Reads every record of the raw log, true when the reader found it corrupt
+   bool read_raw_log(const std::string& records, size_t& count)
+   {
+      write_raw_log(records);
+
+      result_log::reader reader;
+      result_log::record r = {};
+      count = 0;
+      reader.open(result_log_file);
+      while (reader.next(r))
+      {
+         count++;
+      }
+      std::remove(result_log_file.c_str());
+      return reader.corrupt();
+   }
+}
+
+test_method(result_log_round_trip_tests, "Testing the binary result log writer and reader")
+{
+   test_section("Testing the records written are read back")
+   {
+      result_log::writer writer;
+      assert_is_true("Result log has been opened", writer.open(result_log_file));
+
+      uint32_t first = writer.begin_test("first_test");
+      writer.log_result(first, "/path/to/file.cpp", 10, true);
+      writer.log_result(first, "/path/to/file.cpp", 11, false);
+      writer.end_test(first);
+      uint32_t second = writer.begin_test("second_test");
+      writer.log_result(second, "/path/to/other.cpp", 1000000, true);
+      writer.end_test(second);
+      writer.close();
+
+      result_log::reader reader;
+      result_log::record r = {};
+      std::vector<result_log::record> records;
+      assert_is_true("Result log has been opened for reading", reader.open(result_log_file));
+      while (reader.next(r))
+      {
+         records.push_back(r);
+      }
+
+      if (assert_size_t_equal("All records have been read", 7, records.size()))
+      {
+         assert_enum_equal("First record begins a test", result_log::record_type::begin, records[0].type);
+         assert_equal("Test name is interned", std::string("first_test"), reader.string(records[0].id));
+         assert_enum_equal("Second record is a pass", result_log::record_type::pass, records[1].type);
+         assert_equal("File name is interned", std::string("/path/to/file.cpp"), reader.string(records[1].id));
+         assert_uint32_t_equal("Line is correct", 10, records[1].line);
+         assert_enum_equal("Third record is a fail", result_log::record_type::fail, records[2].type);
+         assert_uint32_t_equal("File name is reused", records[1].id, records[2].id);
+         assert_enum_equal("Fourth record ends a test", result_log::record_type::end, records[3].type);
+         assert_uint32_t_equal("Second test has its own id", second, records[4].test);
+         assert_uint32_t_equal("Large line is correct", 1000000, records[5].line);
+         assert_is_true("Timestamps are monotonic", records[6].time >= records[0].time);
+      }
+      std::remove(result_log_file.c_str());
+   }
+   test_section("Testing the assert results are written to the result log")
+   {
+      std::stringstream out;
+      std::stringstream error;
+      my_logger log(out, error);
+      my_assert a(log);
+      result_log::writer writer;
+      assert_is_true("Result log has been opened", writer.open(result_log_file));
+
+      a.result_log(&writer, writer.begin_test("test"));
+      a.pass(__FILE__, __LINE__, "passed");
+      a.fail(__FILE__, __LINE__, "failed");
+      a.result_log(nullptr, 0);
+      a.pass(__FILE__, __LINE__, "not logged");
+      writer.close();
+
+      result_log::reader reader;
+      result_log::record r = {};
+      uint64_t passed = 0;
+      uint64_t failed = 0;
+      assert_is_true("Result log has been opened for reading", reader.open(result_log_file));
+      while (reader.next(r))
+      {
+         passed += r.type == result_log::record_type::pass;
+         failed += r.type == result_log::record_type::fail;
+      }
+      assert_uint64_t_equal("Passed assert has been logged", 1, passed);
+      assert_uint64_t_equal("Failed assert has been logged", 1, failed);
+      std::remove(result_log_file.c_str());
+   }
+   test_section("Testing an invalid file is rejected by the reader")
+   {
+      result_log::reader reader;
+      assert_is_false("Missing file cannot be opened", reader.open("missing_result_log.bin"));
+   }
+}
+
+test_method(result_log_corrupt_tests, "Testing the result log reader rejects corrupt logs")
+{
+   // string 0 "t", begin test 0 named 0 at time 1
+   const std::string valid("\x01\x00\x01t\x02\x00\x00\x01", 8);
+   size_t count = 0;
+
+   test_section("Testing a valid log is not corrupt")
+   {
+      assert_is_false("Valid log is not corrupt", read_raw_log(valid, count));
+      assert_size_t_equal("Begin record has been read", 1, count);
+   }
+   test_section("Testing a string larger than the file is rejected")
+   {
+      // Length of 2^62 bytes
+      assert_is_true("Huge string is corrupt", read_raw_log(std::string("\x01\x00\x80\x80\x80\x80\x80\x80\x80\x80\x40t", 12), count));
+      assert_size_t_equal("No record has been read", 0, count);
+   }
+   test_section("Testing a string id out of sequence is rejected")
+   {
+      assert_is_true("String id far ahead is corrupt", read_raw_log(std::string("\x01\xff\xff\xff\xff\x0f\x01t", 8), count));
+      assert_size_t_equal("No record has been read", 0, count);
+   }
+   test_section("Testing an unknown record is rejected")
+   {
+      assert_is_true("Unknown record is corrupt", read_raw_log(valid + "\x09", count));
+      assert_size_t_equal("Records before the corruption have been read", 1, count);
+   }
+   test_section("Testing a truncated record is rejected")
+   {
+      assert_is_true("Truncated varint is corrupt", read_raw_log(valid + std::string("\x03\x00\x00\x80", 4), count));
+      assert_size_t_equal("Records before the corruption have been read", 1, count);
+   }
+   test_section("Testing a test id out of sequence is rejected")
+   {
+      assert_is_true("Test begun ahead of its turn is corrupt", read_raw_log(valid + std::string("\x02\x05\x00\x01", 4), count));
+      assert_is_true("Test id past 32 bits is corrupt", read_raw_log(valid + std::string("\x05\x80\x80\x80\x80\x10\x01", 7), count));
+   }
+}
+
+test_method(result_log_report_tests, "Testing the reports of cpp_test_log")
+{
+   result_log::writer writer;
+   assert_is_true("Result log has been opened", writer.open(result_log_file));
+   uint32_t first = writer.begin_test("first \"quoted\" \\ <test>\x01");
+   writer.log_result(first, "file.cpp", 10, true);
+   writer.log_result(first, "file.cpp", 11, false);
+   writer.log_result(first, "file.cpp", 11, false);
+   writer.end_test(first);
+   uint32_t second = writer.begin_test("second_test");
+   writer.log_result(second, "file.cpp", 12, false);
+   writer.end_test(second);
+   writer.close();
+
+   result_log::reader reader;
+   result_log::report::run_result run;
+   assert_is_true("Result log has been opened for reading", reader.open(result_log_file));
+   assert_is_true("Result log has been loaded", result_log::report::load(reader, run));
+   std::remove(result_log_file.c_str());
+
+   test_section("Testing the results are aggregated per test")
+   {
+      if (assert_size_t_equal("Both tests have been loaded", 2, run.tests_.size()))
+      {
+         assert_uint64_t_equal("First test has one pass", 1, run.tests_[0].passed_);
+         assert_uint64_t_equal("First test has two failures", 2, run.tests_[0].failed_);
+         assert_uint64_t_equal("Second test has one failure", 1, run.tests_[1].failed_);
+      }
+      assert_uint64_t_equal("Run has one pass", 1, run.passed_);
+      assert_uint64_t_equal("Run has three failures", 3, run.failed_);
+   }
+   test_section("Testing the text report")
+   {
+      std::stringstream out;
+      result_log::report::write_text(out, reader, run);
+
+      assert_is_true("Failing line is reported", out.str().find("FAIL file.cpp 11") != std::string::npos);
+      assert_is_true("Total is reported", out.str().find("TOTAL 4     PASSED 1     FAILED 3") != std::string::npos);
+   }
+   test_section("Testing the JSON report escapes the names")
+   {
+      std::stringstream out;
+      result_log::report::write_json(out, reader, run);
+
+      assert_is_true("Quote and backslash are escaped", out.str().find("first \\\"quoted\\\" \\\\ <test>") != std::string::npos);
+      assert_is_true("Control character is escaped", out.str().find("<test>\\u0001\"") != std::string::npos);
+      assert_is_true("Totals are reported", out.str().find("{\"passed\":1,\"failed\":3,") == 0);
+   }
+   test_section("Testing the JUnit report escapes the names")
+   {
+      std::stringstream out;
+      result_log::report::write_junit(out, reader, run);
+
+      assert_is_true("Markup is escaped", out.str().find("first &quot;quoted&quot; \\ &lt;test&gt;?\"") != std::string::npos);
+      assert_is_true("Failing tests are counted", out.str().find("tests=\"2\" failures=\"2\"") != std::string::npos);
+   }
+   test_section("Testing the most failing lines")
+   {
+      std::stringstream out;
+      result_log::report::write_failing(out, reader, run, 1);
+
+      assert_equal("Line failing twice is the only one reported", std::string("2 file.cpp 11\n"), out.str());
+   }
+   test_section("Testing the slowest tests")
+   {
+      std::stringstream out;
+      result_log::report::write_slowest(out, reader, run, 5);
+      std::string slowest = out.str();
+
+      assert_is_true("Second test is reported", slowest.find("s second_test\n") != std::string::npos);
+      assert_size_t_equal("Only the two tests are reported", 2, size_t(std::count(slowest.begin(), slowest.end(), '\n')));
+   }
+}
@@ -0,0 +1,200 @@
+/****
+* Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+* All rights reserved.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "unit_test.h"
+
+using namespace aes::test;
+using namespace aes::test::log;
+
+using my_logger = logger_base<std::stringstream, std::stringstream>;
+using my_assert = assert_base<my_logger>;
+using my_section = section_guard<my_assert>;
+
+namespace
+{
+   std::stringstream out;
+   std::stringstream err;
+
+   class mock_section_suite_singleton
+   {
+   public:
+      static test_suite_base<mock_section_suite_singleton, my_logger>& get()
+      {
+         static my_logger log(out, err);
+         static test_suite_base<mock_section_suite_singleton, my_logger> test_suite(log);
+         return test_suite;
+      }
+   };
+
+   class mock_section_test : public unit_test_base<mock_section_suite_singleton, my_logger>
+   {
+   public:
+      mock_section_test(const std::string& test_name) noexcept : unit_test_base(test_name, "description") { }
+      ~mock_section_test() noexcept = default;
+
+   private:
+      void run_tests(assert_base<my_logger>& assert)
+      {
+         assert.run_sections([&]()
+         {
+            if (my_section section{ assert, "first" })
+            {
+               assert.pass(__FILE__, __LINE__, "first");
+            }
+            if (my_section section{ assert, "second" })
+            {
+               assert.pass(__FILE__, __LINE__, "second");
+               if (my_section nested{ assert, "nested" })
+               {
+                  assert.fail(__FILE__, __LINE__, "nested");
+               }
+            }
+         });
+      };
+   };
+
+   // Runs the setup and one leaf section per run, the trace records the order.
+   void run_nested_sections(my_assert& a, std::string& trace)
+   {
+      a.run_sections([&]()
+      {
+         trace += "s";
+         if (my_section section{ a, "a" })
+         {
+            trace += "a";
+         }
+         if (my_section section{ a, "b" })
+         {
+            trace += "b";
+            if (my_section nested{ a, "b1" })
+            {
+               trace += "1";
+            }
+            if (my_section nested{ a, "b2" })
+            {
+               trace += "2";
+            }
+         }
+      });
+   }
+}
+
+test_method(section_run_tests, "Testing the sections of a test")
+{
+   test_section("Testing each run enters one section of each level")
+   {
+      std::stringstream out;
+      std::stringstream error;
+      my_logger log(out, error);
+      my_assert a(log);
+      std::string trace;
+
+      run_nested_sections(a, trace);
+      assert_equal("The setup is run again for every leaf section", std::string("sasb1sb2"), trace);
+
+      trace.clear();
+      run_nested_sections(a, trace);
+      assert_equal("The sections are run again by a new run", std::string("sasb1sb2"), trace);
+   }
+   test_section("Testing a section filter runs a single section")
+   {
+      std::stringstream out;
+      std::stringstream error;
+      my_logger log(out, error);
+      my_assert a(log);
+      std::string trace;
+
+      a.sections().filter({ "b", "b2" });
+      run_nested_sections(a, trace);
+      assert_equal("Only the filtered section is run", std::string("sb2"), trace);
+
+      a.sections().filter({ "b" });
+      trace.clear();
+      run_nested_sections(a, trace);
+      assert_equal("The sections nested in the filter are all run", std::string("sb1sb2"), trace);
+   }
+   test_section("Testing sections outside a run are always entered")
+   {
+      std::stringstream out;
+      std::stringstream error;
+      my_logger log(out, error);
+      my_assert a(log);
+      std::string trace;
+
+      if (my_section section{ a, "a" })
+      {
+         trace += "a";
+      }
+      if (my_section section{ a, "b" })
+      {
+         trace += "b";
+      }
+      assert_equal("Both sections are entered", std::string("ab"), trace);
+      assert_size_t_equal("No section is recorded", 0, a.sections().sections().size());
+   }
+}
+
+test_method(section_results_tests, "Testing the results recorded for each section")
+{
+   std::stringstream out;
+   std::stringstream error;
+   my_logger log(out, error);
+   my_assert a(log);
+
+   a.run_sections([&]()
+   {
+      a.pass(__FILE__, __LINE__, "setup");
+      if (my_section section{ a, "passing" })
+      {
+         a.pass(__FILE__, __LINE__, "passing");
+         a.pass(__FILE__, __LINE__, "passing");
+      }
+      if (my_section section{ a, "failing" })
+      {
+         std::this_thread::sleep_for(std::chrono::milliseconds(1));
+         a.fail(__FILE__, __LINE__, "failing");
+      }
+   });
+
+   const std::vector<section_tracker::section>& sections = a.sections().sections();
+   assert_size_t_equal("Test and both sections are recorded", 3, sections.size());
+   assert_equal("First section name is correct", std::string("passing"), sections[1].name_);
+   assert_uint64_t_equal("Passed count of the first section is correct", 2, sections[1].passed_);
+   assert_uint64_t_equal("Failed count of the first section is correct", 0, sections[1].failed_);
+   assert_equal("Second section name is correct", std::string("failing"), sections[2].name_);
+   assert_uint64_t_equal("Passed count of the second section is correct", 0, sections[2].passed_);
+   assert_uint64_t_equal("Failed count of the second section is correct", 1, sections[2].failed_);
+   assert_is_true("Time of the second section is measured", sections[2].elapsed_ >= std::chrono::milliseconds(1));
+   assert_uint64_t_equal("The setup is counted once per run", 4, a.passed());
+}
+
+test_method(section_report_tests, "Testing the sections in the report of the suite")
+{
+   test_suite_base<mock_section_suite_singleton, my_logger>& test_suite = mock_section_suite_singleton::get();
+   mock_section_test test("section_test");
+   mock_section_test other("other_test");
+
+   test_suite.filter("section_test", { "second" });
+   assert_is_false("The nested section fails", test_suite.run("title"));
+
+   std::string report = out.str();
+   assert_is_true("The filtered test is reported", report.find("TEST  2     Passed 1     Failed 1     section_test(0s)") != std::string::npos);
+   assert_is_true("Other tests are not run", report.find("other_test") == std::string::npos);
+   assert_is_true("The section out of the filter is not run", report.find(" first (") == std::string::npos);
+   assert_is_true("The filtered section is reported", report.find("SECT  2     Passed 1     Failed 1       second (") != std::string::npos);
+   assert_is_true("The nested section is reported", report.find("SECT  1     Passed 0     Failed 1         nested (") != std::string::npos);
+}
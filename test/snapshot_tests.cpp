@@ -0,0 +1,151 @@
+/****
+* Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+* All rights reserved.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "unit_test.h"
+#include <fstream>
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+using namespace aes::test;
+using namespace aes::test::log;
+
+using my_logger = logger_base<std::stringstream, std::stringstream>;
+
+#if defined(__unix__) || defined(__APPLE__)
+namespace
+{
+   // Points the snapshots to a directory of the test, the previous settings are restored after.
+   class snapshot_directory
+   {
+   public:
+      snapshot_directory(const std::string& name)
+         : previous_(snapshot::settings())
+      {
+         snapshot::settings().directory_ = "/tmp/cpp_test_" + name + "_" + std::to_string(::getpid());
+         snapshot::settings().update_ = false;
+         ::mkdir(snapshot::settings().directory_.c_str(), 0700);
+      }
+
+      ~snapshot_directory()
+      {
+         snapshot::settings() = previous_;
+      }
+
+   private:
+      snapshot::options previous_;
+   };
+
+   std::vector<unsigned char> make_buffer(size_t size)
+   {
+      std::vector<unsigned char> buffer(size);
+      for (size_t i = 0; i < size; i++)
+      {
+         buffer[i] = static_cast<unsigned char>(i * 31 + i / 251);
+      }
+      return buffer;
+   }
+}
+
+test_method(snapshot_compare_tests, "Testing the comparison of a buffer with its snapshot")
+{
+   snapshot_directory directory("snapshot_compare");
+   std::vector<unsigned char> buffer(make_buffer(snapshot::chunk_size_ * 3 + snapshot::chunk_size_ / 2));
+
+   test_section("Testing a missing snapshot is reported")
+   {
+      snapshot::result compared = snapshot::compare("missing", buffer.data(), buffer.size());
+      assert_is_false("Snapshot is not found", compared.found_);
+      assert_is_false("Snapshot does not match", compared.matched_);
+   }
+   test_section("Testing an unchanged buffer is skipped with the index")
+   {
+      snapshot::settings().update_ = true;
+      snapshot::result written = snapshot::compare("codec", buffer.data(), buffer.size());
+      snapshot::settings().update_ = false;
+      assert_is_true("Snapshot is written", written.found_ && written.updated_);
+
+      snapshot::result compared = snapshot::compare("codec", buffer.data(), buffer.size());
+      assert_is_true("Snapshot matches", compared.matched_);
+      assert_uint64_t_equal("Every chunk is skipped", buffer.size(), compared.skipped_bytes_);
+   }
+   test_section("Testing the differing regions are reported")
+   {
+      std::vector<unsigned char> changed(buffer);
+      changed[10] ^= 1;
+      changed[11] ^= 1;
+      changed[12] ^= 1;
+      changed[snapshot::chunk_size_ * 2 + 5] ^= 1;
+
+      snapshot::result compared = snapshot::compare("codec", changed.data(), changed.size());
+      assert_is_false("Snapshot does not match", compared.matched_);
+      assert_uint64_t_equal("Two regions differ", 2, compared.difference_count_);
+      assert_uint64_t_equal("First region begins", 10, compared.differences_[0].begin_);
+      assert_uint64_t_equal("First region ends", 13, compared.differences_[0].end_);
+      assert_uint64_t_equal("Second region begins", snapshot::chunk_size_ * 2 + 5, compared.differences_[1].begin_);
+      assert_uint64_t_equal("Unchanged chunks are skipped", snapshot::chunk_size_ + snapshot::chunk_size_ / 2, compared.skipped_bytes_);
+   }
+   test_section("Testing a different size is reported as a region at the end")
+   {
+      std::vector<unsigned char> shorter(buffer.begin(), buffer.end() - 100);
+
+      snapshot::result compared = snapshot::compare("codec", shorter.data(), shorter.size());
+      assert_is_false("Snapshot does not match", compared.matched_);
+      assert_uint64_t_equal("Expected size is reported", buffer.size(), compared.expected_size_);
+      assert_uint64_t_equal("Missing tail begins", shorter.size(), compared.differences_.back().begin_);
+      assert_uint64_t_equal("Missing tail ends", buffer.size(), compared.differences_.back().end_);
+   }
+   test_section("Testing a snapshot changed behind the index is compared in full")
+   {
+      std::vector<unsigned char> changed(buffer);
+      changed[100] ^= 1;
+      {
+         std::ofstream file(snapshot::path("codec"), std::ios::binary | std::ios::trunc);
+         file.write(reinterpret_cast<const char*>(changed.data()), std::streamsize(changed.size()));
+      }
+
+      snapshot::result compared = snapshot::compare("codec", buffer.data(), buffer.size());
+      assert_is_false("Change is found", compared.matched_);
+      assert_uint64_t_equal("Nothing is skipped", 0, compared.skipped_bytes_);
+      assert_uint64_t_equal("Changed byte is reported", 100, compared.differences_[0].begin_);
+   }
+}
+
+test_method(snapshot_assert_tests, "Testing the snapshot assertion")
+{
+   snapshot_directory directory("snapshot_assert");
+   std::stringstream out;
+   std::stringstream error;
+   my_logger log(out, error, level::verbose);
+   assert_base<my_logger> check(log);
+   std::string text("header\nbody\n");
+
+   assert_is_false("Missing snapshot fails", check.matches_snapshot(__FILE__, __LINE__, "text", text));
+   assert_is_true("Missing snapshot is reported", error.str().find("Snapshot: text not found at " + snapshot::path("text") + ", run with --update-snapshots to create it.") != std::string::npos);
+
+   snapshot::settings().update_ = true;
+   assert_is_true("Snapshot is updated", check.matches_snapshot(__FILE__, __LINE__, "text", text));
+   snapshot::settings().update_ = false;
+   assert_is_true("Snapshot matches", check.matches_snapshot(__FILE__, __LINE__, "text", text));
+   assert_is_true("Match is logged", out.str().find("Snapshot: text matches.") != std::string::npos);
+
+   text[2] = 'A';
+   assert_is_false("Changed text fails", check.matches_snapshot(__FILE__, __LINE__, "text", text + "tail"));
+   assert_is_true("Regions are reported", error.str().find("Snapshot: text differs. Expected size: 12. Actual size: 16. Differences at [2, 3), [12, 16).") != std::string::npos);
+}
+#endif
@@ -0,0 +1,211 @@
+/****
+* Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+* All rights reserved.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "unit_test.h"
+
+using namespace aes::test;
+using namespace aes::test::log;
+using namespace aes::test::utils;
+
+using my_logger = logger_base<std::stringstream, std::stringstream>;
+
+namespace
+{
+   std::stringstream out;
+   std::stringstream err;
+
+   class mock_test_suite_singleton
+   {
+   public:
+      static test_suite_base<mock_test_suite_singleton, my_logger>& get()
+      {
+         static my_logger log(out, err);
+         static test_suite_base<mock_test_suite_singleton, my_logger> test_suite(log);
+         return test_suite;
+      }
+   };
+
+   class mock_stress_test : public stress_test_base<mock_test_suite_singleton, my_logger>
+   {
+   public:
+      mock_stress_test(unsigned threads, uint64_t iterations, uint64_t failing_iteration) noexcept
+         : stress_test_base("stress", "description", threads, iterations)
+         , failing_iteration_(failing_iteration)
+         , calls_(0)
+      {
+      }
+
+   public:
+      uint64_t calls() const noexcept
+      {
+         return calls_;
+      }
+
+   private:
+      void run_stress(assert_base<my_logger>& assert, uint64_t iteration)
+      {
+         calls_++;
+         if (iteration == failing_iteration_)
+         {
+            assert.fail(__FILE__, __LINE__, "Failing iteration");
+         }
+         else
+         {
+            assert.pass(__FILE__, __LINE__, "Passing iteration");
+         }
+      }
+
+   private:
+      uint64_t failing_iteration_;
+      std::atomic<uint64_t> calls_;
+   };
+
+   std::atomic<uint64_t> stress_counter(0);
+}
+
+test_method(spin_barrier_tests, "Testing the spin barrier")
+{
+   const unsigned count = 4;
+   const int phases = 100;
+   spin_barrier barrier(count);
+   std::atomic<int> arrived(0);
+   std::atomic<bool> overtaken(false);
+   std::vector<std::thread> threads;
+
+   for (unsigned i = 0; i < count; ++i)
+   {
+      threads.emplace_back([&]()
+      {
+         for (int phase = 0; phase < phases; ++phase)
+         {
+            arrived++;
+            barrier.wait();
+            // No thread can leave the barrier before every thread arrived in this phase
+            if (arrived.load() < int(count) * (phase + 1))
+            {
+               overtaken = true;
+            }
+            barrier.wait();
+         }
+      });
+   }
+   std::for_each(threads.begin(), threads.end(), [](std::thread& thread) { thread.join(); });
+
+   assert_equal("All the threads arrived in every phase", int(count) * phases, arrived.load());
+   assert_is_false("No thread overtook the barrier", overtaken.load());
+}
+
+test_method(stress_test_base_tests, "Testing the stress test base class")
+{
+   // The tests below rely on the number of threads of the test, not on the command line
+   unsigned threads = stress_settings::get().threads();
+   stress_settings::get().threads(0);
+
+   test_section("Testing the body runs on every thread for every iteration")
+   {
+      mock_stress_test test(4, 50, 50);
+
+      assert_is_true("Running the stress test is successful", test.run_test());
+      assert_uint64_t_equal("Body has been called on every thread for every iteration", 4 * 50, test.calls());
+      assert_uint64_t_equal("Asserts of all the threads have been aggregated", 4 * 50, test.passed());
+      assert_uint64_t_equal("No assert failed", 0, test.failed());
+      assert_is_true("Throughput is reported", out.str().find("STRESS 4 threads x 50 iterations") != std::string::npos);
+   }
+   test_section("Testing the first failing iteration is reported")
+   {
+      out.str("");
+      err.str("");
+      mock_stress_test test(3, 20, 7);
+
+      assert_is_false("Running the failing stress test fails", test.run_test());
+      assert_uint64_t_equal("One assert failed per thread", 3, test.failed());
+      assert_uint64_t_equal("Other asserts passed", 3 * 19, test.passed());
+      assert_is_true("First failure is reported", out.str().find("first failure at iteration 7") != std::string::npos);
+      assert_is_true("Failures of the threads are logged", err.str().find("Failing iteration") != std::string::npos);
+      assert_is_true("First failure of every thread is reported", out.str().find("thread 0: ") != std::string::npos &&
+                                                                  out.str().find("thread 2: ") != std::string::npos &&
+                                                                  out.str().find("iterations/s, first failure at iteration 7") != std::string::npos);
+   }
+   test_section("Testing the output of the threads is captured with the output of the test")
+   {
+      my_logger& logger = mock_test_suite_singleton::get().test_logger();
+      level previous = logger.log_level();
+      capture_buffer buffer;
+
+      out.str("");
+      err.str("");
+      logger.log_level(level::verbose);
+      logger.begin_capture(buffer);
+      mock_stress_test passing(2, 10, 10);
+      assert_is_true("Running the passing stress test is successful", passing.run_test());
+      logger.end_capture(false);
+      assert_is_true("Output of the passing threads has been dropped", out.str().find("Passing iteration") == std::string::npos);
+
+      logger.begin_capture(buffer);
+      mock_stress_test failing(2, 10, 3);
+      assert_is_false("Running the failing stress test fails", failing.run_test());
+      logger.end_capture(true);
+      assert_is_true("Output of the failing threads has been emitted", out.str().find("Passing iteration") != std::string::npos);
+      assert_is_true("Failures of the threads have been emitted", err.str().find("Failing iteration") != std::string::npos);
+      logger.log_level(previous);
+   }
+   test_section("Testing the asserts of every thread are written to the result log")
+   {
+      const std::string file = "stress_tests.bin";
+      result_log::writer writer;
+      mock_stress_test test(4, 25, 3);
+
+      assert_is_true("Result log has been opened", writer.open(file));
+      test.result_log(&writer, writer.begin_test("stress"));
+      test.run_test();
+      test.result_log(nullptr, 0);
+      writer.close();
+
+      result_log::reader reader;
+      result_log::record r = {};
+      uint64_t passed = 0;
+      uint64_t failed = 0;
+      assert_is_true("Result log has been opened for reading", reader.open(file));
+      while (reader.next(r))
+      {
+         passed += r.type == result_log::record_type::pass;
+         failed += r.type == result_log::record_type::fail;
+      }
+      assert_is_false("Result log is not corrupt", reader.corrupt());
+      assert_uint64_t_equal("Passed asserts of all the threads have been logged", 4 * 24, passed);
+      assert_uint64_t_equal("Failed assert of every thread has been logged", 4, failed);
+      std::remove(file.c_str());
+   }
+   test_section("Testing the number of threads can be overridden")
+   {
+      mock_stress_test test(3, 1, 1);
+
+      stress_settings::get().threads(2);
+      assert_equal("Number of threads has been overridden", 2u, test.threads());
+      stress_settings::get().threads(0);
+      assert_equal("Number of threads is restored", 3u, test.threads());
+   }
+
+   stress_settings::get().threads(threads);
+}
+
+stress_method(stress_method_tests, "Testing the stress method runs concurrently", 4, 100)
+{
+   uint64_t value = ++stress_counter;
+   assert_is_true("Counter is always incremented", value > 0);
+   assert_is_true("Iteration is in range", iteration < 100);
+}
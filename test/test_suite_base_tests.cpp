@@ -53,6 +53,43 @@ namespace
    };
 }
 
+namespace
+{
+   std::stringstream capture_out;
+   std::stringstream capture_err;
+
+   class mock_capture_suite_singleton
+   {
+   public:
+      static test_suite_base<mock_capture_suite_singleton, my_logger>& get()
+      {
+         static my_logger log(capture_out, capture_err, level::verbose);
+         static test_suite_base<mock_capture_suite_singleton, my_logger> test_suite(log);
+         return test_suite;
+      }
+   };
+
+   class mock_capture_unit_test : public unit_test_base<mock_capture_suite_singleton, my_logger>
+   {
+   public:
+      mock_capture_unit_test(const std::string& test_name, bool fail) noexcept : unit_test_base(test_name, "description"), fail_(fail) { }
+      ~mock_capture_unit_test() noexcept = default;
+
+   private:
+      void run_tests(assert_base<my_logger>& assert)
+      {
+         assert.pass(__FILE__, __LINE__, name());
+         if (fail_)
+         {
+            assert.fail(__FILE__, __LINE__, name());
+         }
+      };
+
+   private:
+      bool fail_;
+   };
+}
+
 using my_test_suite = test_suite_base<mock_test_suite_singleton, my_logger>;
 
 test_method(test_suite_base_constructor_test, "Testing the constructor of test_suite_base class")
@@ -95,3 +132,21 @@ test_method(test_suite_register_and_run_test, "Testing the register and run test
       assert_equal("Total tests is correct", test.total(), test_suite.total());
    }
 }
+
+test_method(test_suite_capture_output_test, "Testing the output capture of the test suite")
+{
+   test_section("Testing only the output of failed tests is emitted")
+   {
+      test_suite_base<mock_capture_suite_singleton, my_logger>& test_suite = mock_capture_suite_singleton::get();
+      test_suite.capture_output(capture_mode::spill, 1024);
+
+      mock_capture_unit_test passing("passing_test", false);
+      mock_capture_unit_test failing("failing_test", true);
+
+      assert_is_false("Running the suite with a failing test fails", test_suite.run("title"));
+      assert_equal("Records of the passing test are discarded", std::string::npos, capture_out.str().find("message: passing_test"));
+      assert_is_true("Records of the failing test are emitted", capture_out.str().find("Assert passed logged with message: failing_test") != std::string::npos);
+      assert_is_true("Failure of the failing test is emitted", capture_err.str().find("Assert failed logged with message: failing_test") != std::string::npos);
+      assert_is_true("Summary of the passing test is still logged", capture_out.str().find("passing_test(0s)") != std::string::npos);
+   }
+}
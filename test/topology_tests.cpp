@@ -0,0 +1,127 @@
+/****
+* Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+* All rights reserved.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "unit_test.h"
+#include <fstream>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace aes::test;
+
+namespace
+{
+   // A sysfs tree of 2 nodes of 2 cores of 2 threads: the siblings of cpu N are N and N + 4.
+   class fake_sysfs
+   {
+   public:
+      fake_sysfs(const std::string& name)
+         : root_("/tmp/cpp_test_" + name + "_" + std::to_string(::getpid()))
+      {
+         write("cpu/online", "0-7");
+         write("node/online", "0-1");
+         write("node/node0/cpulist", "0-1,4-5");
+         write("node/node1/cpulist", "2-3,6-7");
+         for (int id = 0; id < 8; ++id)
+         {
+            std::string base("cpu/cpu" + std::to_string(id) + "/topology/");
+            write(base + "core_id", std::to_string(id % 2));
+            write(base + "physical_package_id", std::to_string((id % 4) / 2));
+            write(base + "thread_siblings_list", std::to_string(id % 4) + "," + std::to_string(id % 4 + 4));
+         }
+      }
+
+      const std::string& root() const
+      {
+         return root_;
+      }
+
+      void write(const std::string& path, const std::string& content)
+      {
+         ::mkdir(root_.c_str(), 0700);
+         for (size_t slash = path.find('/'); slash != std::string::npos; slash = path.find('/', slash + 1))
+         {
+            ::mkdir((root_ + "/" + path.substr(0, slash)).c_str(), 0700);
+         }
+         std::ofstream file(root_ + "/" + path, std::ios::trunc);
+         file << content << "\n";
+      }
+
+   private:
+      std::string root_;
+   };
+}
+
+test_method(topology_read_tests, "Testing the CPU and NUMA topology is read from sysfs")
+{
+   test_section("Testing the lists of the kernel are parsed")
+   {
+      std::vector<int> values(topology::parse_list("0-3,8,10-11\n"));
+      assert_vector_equal("Ranges and single values are expanded", std::vector<int>({ 0, 1, 2, 3, 8, 10, 11 }), values);
+      assert_is_true("Empty list has no values", topology::parse_list("\n").empty());
+   }
+   test_section("Testing the cores, packages, nodes and siblings are read")
+   {
+      fake_sysfs sysfs("topology_read");
+      topology::machine machine(topology::read(sysfs.root()));
+
+      assert_uint64_t_equal("Every online cpu is read", 8, machine.cpus_.size());
+      assert_equal("Both nodes are found", 2, machine.nodes_);
+      assert_equal("Node of a cpu is read", 1, machine.cpus_[6].node_);
+      assert_equal("Package of a cpu is read", 1, machine.cpus_[3].package_);
+      assert_is_true("First thread of a core is primary", machine.cpus_[1].primary_);
+      assert_is_false("SMT sibling is not primary", machine.cpus_[5].primary_);
+      assert_equal("Topology is described", std::string("2 nodes, 4 cores, 8 cpus"), topology::describe(machine));
+   }
+   test_section("Testing a missing sysfs gives an empty topology")
+   {
+      topology::machine machine(topology::read("/tmp/cpp_test_no_sysfs"));
+      assert_is_true("No cpu is read", machine.cpus_.empty());
+      assert_is_true("No worker is placed", topology::plan(machine, 4, false).empty());
+   }
+}
+
+test_method(topology_plan_tests, "Testing the workers are placed over the nodes and cores")
+{
+   fake_sysfs sysfs("topology_plan");
+   topology::machine machine(topology::read(sysfs.root()));
+
+   test_section("Testing the workers alternate between the nodes on whole cores first")
+   {
+      std::vector<topology::slot> slots(topology::plan(machine, 8, false));
+      std::vector<int> cpus;
+      std::vector<int> nodes;
+      for (const topology::slot& slot : slots)
+      {
+         cpus.push_back(slot.cpu_);
+         nodes.push_back(slot.node_);
+      }
+      assert_vector_equal("Cores come before their siblings", std::vector<int>({ 0, 2, 1, 3, 4, 6, 5, 7 }), cpus);
+      assert_vector_equal("Nodes alternate", std::vector<int>({ 0, 1, 0, 1, 0, 1, 0, 1 }), nodes);
+   }
+   test_section("Testing SMT siblings are left idle")
+   {
+      std::vector<topology::slot> slots(topology::plan(machine, 6, true));
+      std::vector<int> cpus;
+      for (const topology::slot& slot : slots)
+      {
+         cpus.push_back(slot.cpu_);
+      }
+      assert_vector_equal("Workers beyond the cores share them", std::vector<int>({ 0, 2, 1, 3, 0, 2 }), cpus);
+   }
+}
+#endif
@@ -0,0 +1,141 @@
+/****
+* Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+* All rights reserved.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "unit_test.h"
+
+using namespace aes::test;
+using namespace aes::test::log;
+
+using my_logger = logger_base<std::stringstream, std::stringstream>;
+using my_assert = assert_base<my_logger>;
+using my_section = section_guard<my_assert>;
+
+namespace
+{
+   std::stringstream out;
+   std::stringstream err;
+
+   class mock_trace_suite_singleton
+   {
+   public:
+      static test_suite_base<mock_trace_suite_singleton, my_logger>& get()
+      {
+         static my_logger log(out, err);
+         static test_suite_base<mock_trace_suite_singleton, my_logger> test_suite(log);
+         return test_suite;
+      }
+   };
+
+   class mock_trace_test : public unit_test_base<mock_trace_suite_singleton, my_logger>
+   {
+   public:
+      mock_trace_test(const std::string& test_name) noexcept : unit_test_base(test_name, "description") { }
+      ~mock_trace_test() noexcept = default;
+
+   private:
+      void run_tests(assert_base<my_logger>& assert)
+      {
+         assert.run_sections([&]()
+         {
+            if (my_section section{ assert, "traced_section" })
+            {
+               assert.fail(__FILE__, __LINE__, "traced failure");
+            }
+         });
+      };
+   };
+}
+
+test_method(trace_write_tests, "Testing the trace events are written in the Chrome format")
+{
+   trace::recorder recorder;
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+   std::stringstream ss;
+
+   recorder.complete("test", "ignored", start, start + std::chrono::nanoseconds(1500));
+   assert_uint64_t_equal("Disabled recorder records nothing", 0, recorder.size());
+
+   recorder.enable(true);
+   recorder.name_thread("main");
+   uint32_t lane = recorder.lane("worker 0");
+   recorder.complete("test", "  padded \"name\"  ", start, start + std::chrono::nanoseconds(1500));
+   recorder.complete("test", "remote", start, start + std::chrono::nanoseconds(20), lane);
+   recorder.instant("failure", "FAIL file 1 message");
+   recorder.write(ss);
+
+   std::string text(ss.str());
+   assert_uint64_t_equal("Events are recorded", 3, recorder.size());
+   assert_is_true("Trace is an object of events", text.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[") == 0);
+   assert_is_true("Thread is named", text.find("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"main\"}}") != std::string::npos);
+   assert_is_true("Lane is named", text.find("\"tid\":2,\"args\":{\"name\":\"worker 0\"}") != std::string::npos);
+   assert_is_true("Span name is trimmed and escaped", text.find("{\"name\":\"padded \\\"name\\\"\",\"cat\":\"test\",\"ph\":\"X\",\"pid\":1,\"tid\":1,") != std::string::npos);
+   assert_is_true("Span duration is in microseconds", text.find("\"dur\":1.500}") != std::string::npos);
+   assert_is_true("Span is on its lane", text.find("{\"name\":\"remote\",\"cat\":\"test\",\"ph\":\"X\",\"pid\":1,\"tid\":2,") != std::string::npos);
+   assert_is_true("Instant event is thread scoped", text.find("\"cat\":\"failure\",\"ph\":\"i\",\"s\":\"t\"") != std::string::npos);
+   assert_is_true("Trace is closed", text.compare(text.size() - 4, 4, "\n]}\n") == 0);
+}
+
+test_method(trace_threads_tests, "Testing every thread records on a lane of its own")
+{
+   trace::recorder recorder;
+   std::stringstream ss;
+
+   recorder.enable(true);
+   std::vector<std::thread> threads;
+   for (int i = 0; i < 4; i++)
+   {
+      threads.emplace_back([&recorder, i]()
+      {
+         recorder.name_thread("thread " + std::to_string(i));
+         for (int j = 0; j < 100; j++)
+         {
+            recorder.instant("iteration", std::to_string(j));
+         }
+      });
+   }
+   for (std::thread& thread : threads)
+   {
+      thread.join();
+   }
+   recorder.write(ss);
+
+   assert_uint64_t_equal("Events of every thread are kept", 400, recorder.size());
+   for (int i = 1; i <= 4; i++)
+   {
+      assert_is_true("Every thread has a lane", ss.str().find("\"tid\":" + std::to_string(i) + ",\"args\"") != std::string::npos);
+   }
+   assert_is_true("No other lane is added", ss.str().find("\"tid\":5") == std::string::npos);
+}
+
+test_method(trace_suite_tests, "Testing the suite records tests, sections and failures")
+{
+   test_suite_base<mock_trace_suite_singleton, my_logger>& test_suite = mock_trace_suite_singleton::get();
+   mock_trace_test test("traced_test");
+   trace::recorder& recorder = trace::recorder::get();
+   bool enabled = recorder.enabled();
+   std::stringstream ss;
+
+   recorder.enable(true);
+   test_suite.run("title");
+   recorder.enable(enabled);
+   recorder.write(ss);
+
+   std::string text(ss.str());
+   assert_is_true("Test span is recorded", text.find("{\"name\":\"traced_test\",\"cat\":\"test\",\"ph\":\"X\"") != std::string::npos);
+   assert_is_true("Section span is recorded", text.find("{\"name\":\"traced_section\",\"cat\":\"section\",\"ph\":\"X\"") != std::string::npos);
+   assert_is_true("Failure is recorded", text.find("traced failure.\",\"cat\":\"failure\",\"ph\":\"i\"") != std::string::npos);
+}
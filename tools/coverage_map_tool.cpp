@@ -0,0 +1,460 @@
+/****
+* Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+* All rights reserved.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+///////////////////////////////////////////////////////////////////////////////////
+// Test impact analysis
+//
+// 'map' reads the .gcda files dumped per test by 'cpp_test --coverage-dump=<dir>',
+// runs gcov on each of them and writes the lines covered by every test:
+//
+//    test <id> <name>
+//    file <path>
+//    <line> <test id> <test id> ...
+//
+// 'affected' reads a unified diff and prints the tests covering a changed line,
+// which is the list expected by 'cpp_test --tests=<file>'.
+
+namespace
+{
+   using line_map = std::map<std::string, std::map<uint32_t, std::set<uint32_t>>>;
+
+   // Minimal JSON reader for the output of 'gcov --json-format'
+   struct json
+   {
+      enum class kind { null, boolean, number, string, array, object };
+
+      kind kind_ = kind::null;
+      double number_ = 0;
+      std::string string_;
+      std::vector<json> array_;
+      std::vector<std::pair<std::string, json>> object_;
+
+      const json* find(const std::string& key) const
+      {
+         for (const std::pair<std::string, json>& member : object_)
+         {
+            if (member.first == key)
+            {
+               return &member.second;
+            }
+         }
+         return nullptr;
+      }
+   };
+
+   class json_parser
+   {
+   public:
+      json_parser(const std::string& text) : text_(text), position_(0) { }
+
+      bool parse(json& value)
+      {
+         skip_spaces();
+         if (position_ >= text_.size())
+         {
+            return false;
+         }
+
+         char c = text_[position_];
+         if (c == '{')
+         {
+            value.kind_ = json::kind::object;
+            ++position_;
+            while (skip_spaces() && text_[position_] != '}')
+            {
+               json key;
+               json member;
+               if (!parse_string(key.string_) || !skip_spaces() || text_[position_++] != ':' || !parse(member))
+               {
+                  return false;
+               }
+               value.object_.emplace_back(key.string_, std::move(member));
+               if (skip_spaces() && text_[position_] == ',')
+               {
+                  ++position_;
+               }
+            }
+            return position_++ < text_.size();
+         }
+         if (c == '[')
+         {
+            value.kind_ = json::kind::array;
+            ++position_;
+            while (skip_spaces() && text_[position_] != ']')
+            {
+               value.array_.emplace_back();
+               if (!parse(value.array_.back()))
+               {
+                  return false;
+               }
+               if (skip_spaces() && text_[position_] == ',')
+               {
+                  ++position_;
+               }
+            }
+            return position_++ < text_.size();
+         }
+         if (c == '"')
+         {
+            value.kind_ = json::kind::string;
+            return parse_string(value.string_);
+         }
+         if (text_.compare(position_, 4, "true") == 0 || text_.compare(position_, 5, "false") == 0 || text_.compare(position_, 4, "null") == 0)
+         {
+            value.kind_ = c == 'n' ? json::kind::null : json::kind::boolean;
+            value.number_ = c == 't' ? 1 : 0;
+            position_ += c == 'f' ? 5 : 4;
+            return true;
+         }
+
+         char* end = nullptr;
+         value.kind_ = json::kind::number;
+         value.number_ = std::strtod(text_.c_str() + position_, &end);
+         if (end == text_.c_str() + position_)
+         {
+            return false;
+         }
+         position_ = size_t(end - text_.c_str());
+         return true;
+      }
+
+   private:
+      bool skip_spaces()
+      {
+         while (position_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[position_])))
+         {
+            ++position_;
+         }
+         return position_ < text_.size();
+      }
+
+      bool parse_string(std::string& value)
+      {
+         if (text_[position_++] != '"')
+         {
+            return false;
+         }
+         while (position_ < text_.size() && text_[position_] != '"')
+         {
+            char c = text_[position_++];
+            if (c == '\\' && position_ < text_.size())
+            {
+               c = text_[position_++];
+               c = c == 'n' ? '\n' : c == 't' ? '\t' : c;
+            }
+            value += c;
+         }
+         return position_++ < text_.size();
+      }
+
+   private:
+      const std::string& text_;
+      size_t position_;
+   };
+
+   void find_files(const std::string& directory, const std::string& extension, std::vector<std::string>& files)
+   {
+      std::unique_ptr<DIR, int (*)(DIR*)> dir(::opendir(directory.c_str()), ::closedir);
+      dirent* entry = nullptr;
+
+      while (dir && (entry = ::readdir(dir.get())) != nullptr)
+      {
+         std::string name(entry->d_name);
+         std::string path(directory + "/" + name);
+         struct stat info;
+         if (name == "." || name == ".." || ::lstat(path.c_str(), &info) != 0)
+         {
+            continue;
+         }
+         if (S_ISDIR(info.st_mode))
+         {
+            find_files(path, extension, files);
+         }
+         else if (name.size() > extension.size() && name.compare(name.size() - extension.size(), extension.size(), extension) == 0)
+         {
+            files.push_back(path);
+         }
+      }
+   }
+
+   std::string run_gcov(const std::string& data_file)
+   {
+      std::string command("gcov --json-format --stdout '" + data_file + "' 2>/dev/null");
+      std::unique_ptr<FILE, int (*)(FILE*)> pipe(::popen(command.c_str(), "r"), ::pclose);
+      std::string output;
+      char chunk[64 * 1024];
+      size_t read = 0;
+
+      while (pipe && (read = std::fread(chunk, 1, sizeof(chunk), pipe.get())) > 0)
+      {
+         output.append(chunk, read);
+      }
+      return output;
+   }
+
+   // The data files of a test are dumped under <dump directory>/<test>/<absolute path>, next
+   // to which gcov expects the notes file that the compiler left in the build tree.
+   void map_test(const std::string& test_directory, uint32_t test, line_map& lines)
+   {
+      std::vector<std::string> data_files;
+      find_files(test_directory, ".gcda", data_files);
+
+      for (const std::string& data_file : data_files)
+      {
+         std::string notes = data_file.substr(test_directory.size(), data_file.size() - test_directory.size() - 5) + ".gcno";
+         std::string link = data_file.substr(0, data_file.size() - 5) + ".gcno";
+         ::unlink(link.c_str());
+         if (::symlink(notes.c_str(), link.c_str()) != 0)
+         {
+            continue;
+         }
+
+         std::string output = run_gcov(data_file);
+         json report;
+         json_parser parser(output);
+         if (!parser.parse(report))
+         {
+            continue;
+         }
+
+         const json* directory = report.find("current_working_directory");
+         const json* files = report.find("files");
+         for (const json& file : files ? files->array_ : std::vector<json>())
+         {
+            const json* name = file.find("file");
+            const json* file_lines = file.find("lines");
+            if (!name || !file_lines)
+            {
+               continue;
+            }
+
+            std::string path = name->string_[0] == '/' || !directory ? name->string_ : directory->string_ + "/" + name->string_;
+            for (const json& line : file_lines->array_)
+            {
+               const json* number = line.find("line_number");
+               const json* count = line.find("count");
+               if (number && count && count->number_ > 0)
+               {
+                  lines[path][uint32_t(number->number_)].insert(test);
+               }
+            }
+         }
+      }
+   }
+
+   int build_map(const std::string& dump_directory, const std::string& map_file)
+   {
+      std::vector<std::string> tests;
+      std::unique_ptr<DIR, int (*)(DIR*)> dir(::opendir(dump_directory.c_str()), ::closedir);
+      dirent* entry = nullptr;
+      line_map lines;
+
+      while (dir && (entry = ::readdir(dir.get())) != nullptr)
+      {
+         if (entry->d_name[0] != '.')
+         {
+            tests.push_back(entry->d_name);
+         }
+      }
+      if (tests.empty())
+      {
+         std::cerr << "Error: no test coverage found in " << dump_directory << std::endl;
+         return -1;
+      }
+      std::sort(tests.begin(), tests.end());
+
+      for (uint32_t i = 0; i < tests.size(); ++i)
+      {
+         map_test(dump_directory + "/" + tests[i], i, lines);
+      }
+
+      std::ofstream out(map_file);
+      for (uint32_t i = 0; i < tests.size(); ++i)
+      {
+         out << "test " << i << " " << tests[i] << "\n";
+      }
+      for (const auto& file : lines)
+      {
+         out << "file " << file.first << "\n";
+         for (const auto& line : file.second)
+         {
+            out << line.first;
+            for (uint32_t test : line.second)
+            {
+               out << " " << test;
+            }
+            out << "\n";
+         }
+      }
+
+      return out ? 0 : -1;
+   }
+
+   bool load_map(const std::string& map_file, std::vector<std::string>& tests, line_map& lines)
+   {
+      std::ifstream in(map_file);
+      std::string line;
+      std::string file;
+
+      while (std::getline(in, line))
+      {
+         std::stringstream ss(line);
+         if (line.compare(0, 5, "test ") == 0)
+         {
+            std::string keyword;
+            uint32_t id = 0;
+            std::string name;
+            ss >> keyword >> id >> name;
+            tests.resize(std::max<size_t>(tests.size(), id + 1));
+            tests[id] = name;
+         }
+         else if (line.compare(0, 5, "file ") == 0)
+         {
+            file = line.substr(5);
+         }
+         else
+         {
+            uint32_t number = 0;
+            uint32_t test = 0;
+            ss >> number;
+            std::set<uint32_t>& covering = lines[file][number];
+            while (ss >> test)
+            {
+               covering.insert(test);
+            }
+         }
+      }
+
+      return in.eof();
+   }
+
+   // Paths of the map are absolute build paths, paths of the diff are relative to the
+   // repository, so a file of the diff matches the mapped files ending with its path.
+   void mark_changed(const line_map& lines, const std::string& path, uint32_t line, std::set<uint32_t>& affected)
+   {
+      for (const auto& file : lines)
+      {
+         if (file.first.size() >= path.size() && file.first.compare(file.first.size() - path.size(), path.size(), path) == 0 &&
+             (file.first.size() == path.size() || file.first[file.first.size() - path.size() - 1] == '/'))
+         {
+            auto covering = file.second.find(line);
+            if (covering != file.second.end())
+            {
+               affected.insert(covering->second.begin(), covering->second.end());
+            }
+         }
+      }
+   }
+
+   int find_affected(const std::string& map_file, std::istream& diff)
+   {
+      std::vector<std::string> tests;
+      line_map lines;
+      std::set<uint32_t> affected;
+      std::string path;
+      std::string line;
+      uint32_t old_line = 0;
+
+      if (!load_map(map_file, tests, lines))
+      {
+         std::cerr << "Error: unable to read the coverage map " << map_file << std::endl;
+         return -1;
+      }
+
+      // Lines are tracked in the old version of the files, which is the version the map
+      // has been built from. An insertion changes the lines around it.
+      while (std::getline(diff, line))
+      {
+         if (line.compare(0, 4, "--- ") == 0)
+         {
+            path = line.substr(4, line.find('\t') == std::string::npos ? std::string::npos : line.find('\t') - 4);
+            path = path.compare(0, 2, "a/") == 0 ? path.substr(2) : path;
+         }
+         else if (line.compare(0, 4, "+++ ") == 0)
+         {
+         }
+         else if (line.compare(0, 3, "@@ ") == 0)
+         {
+            old_line = uint32_t(std::strtoul(line.c_str() + 4, nullptr, 10));
+         }
+         else if (!line.empty() && line[0] == '-')
+         {
+            mark_changed(lines, path, old_line++, affected);
+         }
+         else if (!line.empty() && line[0] == '+')
+         {
+            mark_changed(lines, path, old_line > 0 ? old_line - 1 : 0, affected);
+            mark_changed(lines, path, old_line, affected);
+         }
+         else if (!line.empty() && line[0] == ' ')
+         {
+            ++old_line;
+         }
+      }
+
+      for (uint32_t test : affected)
+      {
+         std::cout << tests[test] << std::endl;
+      }
+      return 0;
+   }
+}
+
+int main(int argc, char** argv)
+{
+   std::string command(argc > 1 ? argv[1] : "");
+
+   if (command == "map" && argc == 4)
+   {
+      return build_map(argv[2], argv[3]);
+   }
+   if (command == "affected" && (argc == 3 || argc == 4))
+   {
+      if (argc == 3)
+      {
+         return find_affected(argv[2], std::cin);
+      }
+
+      std::ifstream diff(argv[3]);
+      if (!diff)
+      {
+         std::cerr << "Error: unable to open the diff " << argv[3] << std::endl;
+         return -1;
+      }
+      return find_affected(argv[2], diff);
+   }
+
+   std::cerr << "Usage: " << argv[0] << " map <coverage dump directory> <map file>" << std::endl;
+   std::cerr << "       " << argv[0] << " affected <map file> [diff file]" << std::endl;
+   return -1;
+}
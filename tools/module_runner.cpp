@@ -0,0 +1,197 @@
+/****
+* Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+* All rights reserved.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "unit_test.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////////
+// Runner of test modules
+//
+// Loads a test module built with AES_TEST_MODULE and runs its tests in this
+// process. With --watch the runner stays up: when the module file is rebuilt it
+// is loaded again and only the affected tests are rerun, the tests that failed
+// last time, the new tests and the tests whose source file changed since the last
+// run. When nothing can be told apart, after a change of a header for instance,
+// every test is rerun. --filter=<test> runs the named tests only, on every reload.
+//
+// Given several modules, the runner aggregates them: they are all loaded, each
+// into a suite of its own, and their tests are scheduled on one pool of
+// --threads=<count> threads, the number of cores by default. A module runs one
+// test at a time, the pool runs the tests of different modules side by side. The
+// report lists the tests and the totals of each module as it completes, then the
+// totals of the run.
+
+namespace
+{
+   using namespace aes::test;
+
+   std::vector<std::string> affected(const std::vector<module::test_info>& tests,
+                                     const std::set<std::string>& filters,
+                                     const std::set<std::string>& failing,
+                                     const std::set<std::string>& known,
+                                     time_t since)
+   {
+      std::vector<std::string> all;
+      std::vector<std::string> selected;
+      for (const module::test_info& test : tests)
+      {
+         all.push_back(test.name_);
+         if (!filters.empty())
+         {
+            if (filters.count(test.name_))
+            {
+               selected.push_back(test.name_);
+            }
+         }
+         else if (failing.count(test.name_) || !known.count(test.name_) || module::modified(test.source_file_) >= since)
+         {
+            selected.push_back(test.name_);
+         }
+      }
+      return filters.empty() && (known.empty() || selected.empty()) ? all : selected;
+   }
+}
+
+int main(int argc, char** argv)
+{
+   std::vector<std::string> paths;
+   bool watch = false;
+   unsigned threads = 0;
+   std::set<std::string> filters;
+   for (int i = 1; i < argc; ++i)
+   {
+      std::string value;
+      if (utils::match_option(argv[i], "watch", value))
+      {
+         watch = true;
+      }
+      else if (utils::match_option(argv[i], "filter", value) && !value.empty())
+      {
+         filters.insert(value);
+      }
+      else if (utils::match_option(argv[i], "threads", value))
+      {
+         threads = unsigned(std::strtoul(value.c_str(), nullptr, 10));
+      }
+      else if (argv[i][0] != '-')
+      {
+         paths.push_back(argv[i]);
+      }
+      else
+      {
+         paths.clear();
+         break;
+      }
+   }
+   if (paths.empty() || (paths.size() > 1 && (watch || !filters.empty())))
+   {
+      std::cerr << "Usage: " << argv[0] << " [--watch] [--filter=<test>]... <module>" << std::endl;
+      std::cerr << "       " << argv[0] << " [--threads=<count>] <module>..." << std::endl;
+      return -1;
+   }
+
+   // The fixtures are destroyed before the modules, their destructors are in their code.
+   test_suite& runner = test_suite_singleton::get();
+   std::vector<std::unique_ptr<module::library>> modules;
+   std::unique_ptr<module::library> loaded(new module::library);
+   std::vector<std::unique_ptr<module::library>> replaced;
+   module::fixtures kept;
+   std::string error;
+   if (paths.size() > 1 || (!watch && filters.empty()))
+   {
+      std::vector<module::suite*> suites;
+      for (const std::string& path : paths)
+      {
+         modules.emplace_back(new module::library);
+         if (!modules.back()->open(path, kept, error))
+         {
+            runner.test_logger().log_error("Error: " + error);
+            return -1;
+         }
+         suites.push_back(&modules.back()->get());
+      }
+      runner.run_modules(paths.size() > 1 ? "Test modules" : suites.front()->title(), suites, threads);
+      return int(runner.failed());
+   }
+
+   const std::string& path = paths.front();
+   if (!loaded->open(path, kept, error))
+   {
+      runner.test_logger().log_error("Error: " + error);
+      return -1;
+   }
+
+   std::set<std::string> failing;
+   std::set<std::string> known;
+   time_t since = time(0);
+   std::vector<module::test_info> tests(loaded->get().tests());
+   runner.run_module(loaded->get().title(), loaded->get(), affected(tests, filters, failing, known, since), failing);
+   if (!watch)
+   {
+      return int(runner.failed());
+   }
+
+   module::watcher watcher;
+   if (!watcher.open(path))
+   {
+      runner.test_logger().log_error("Error: unable to watch " + path);
+      return -1;
+   }
+
+   for (;;)
+   {
+      if (!watcher.wait(-1))
+      {
+         continue;
+      }
+
+      auto start = std::chrono::steady_clock::now();
+      for (const module::test_info& test : tests)
+      {
+         known.insert(test.name_);
+      }
+
+      std::unique_ptr<module::library> reloaded(new module::library);
+      if (!reloaded->open(path, kept, error))
+      {
+         runner.test_logger().log_error("Error: " + error);
+         continue;
+      }
+      loaded->retire();
+      replaced.push_back(std::move(loaded));
+      loaded = std::move(reloaded);
+
+      // A replaced module stays loaded while a fixture it built remains, the fixture is destroyed by its code.
+      replaced.erase(std::remove_if(replaced.begin(), replaced.end(), [&kept](const std::unique_ptr<module::library>& previous) { return !previous->built(kept); }),
+                     replaced.end());
+
+      tests = loaded->get().tests();
+      std::vector<std::string> selected(affected(tests, filters, failing, known, since));
+      since = time(0);
+      runner.run_module(loaded->get().title(), loaded->get(), selected, failing);
+
+      std::stringstream ss;
+      ss << "RELOAD " << selected.size() << " of " << tests.size() << " tests in " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() << "ms";
+      runner.test_logger().log_information(ss.str());
+   }
+}
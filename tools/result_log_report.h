@@ -0,0 +1,229 @@
+/****
+* Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+* All rights reserved.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include "unit_test_result_log.h"
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <map>
+#include <ostream>
+
+///////////////////////////////////////////////////////////////////////////////////
+// Reports of cpp_test_log
+//
+// The records of a result log are loaded into the results of each test, then written
+// as text, JUnit XML or JSON, or as the slowest tests and the most failing lines.
+
+namespace aes
+{
+   namespace test
+   {
+      namespace result_log
+      {
+         namespace report
+         {
+            struct failure
+            {
+               uint32_t file_;
+               uint32_t line_;
+            };
+
+            struct test_result
+            {
+               uint32_t name_;
+               uint64_t passed_;
+               uint64_t failed_;
+               uint64_t begin_;
+               uint64_t end_;
+               std::vector<failure> failures_;
+            };
+
+            struct run_result
+            {
+               std::vector<test_result> tests_;
+               std::map<std::pair<uint32_t, uint32_t>, uint64_t> failing_lines_;
+               uint64_t passed_;
+               uint64_t failed_;
+            };
+
+            // False when the log is corrupt, the run then holds the records read before the corruption.
+            inline bool load(reader& log, run_result& run)
+            {
+               record r = {};
+
+               run.passed_ = 0;
+               run.failed_ = 0;
+               while (log.next(r))
+               {
+                  if (r.type == record_type::begin)
+                  {
+                     if (run.tests_.size() <= r.test)
+                     {
+                        run.tests_.resize(r.test + 1);
+                     }
+                     run.tests_[r.test] = test_result{ r.id, 0, 0, r.time, r.time, {} };
+                  }
+                  else if (r.test < run.tests_.size())
+                  {
+                     test_result& test = run.tests_[r.test];
+                     if (r.type == record_type::end)
+                     {
+                        test.end_ = r.time;
+                     }
+                     else if (r.type == record_type::pass)
+                     {
+                        test.passed_++;
+                        run.passed_++;
+                     }
+                     else if (r.type == record_type::fail)
+                     {
+                        test.failed_++;
+                        run.failed_++;
+                        test.failures_.push_back(failure{ r.id, r.line });
+                        run.failing_lines_[std::make_pair(r.id, r.line)]++;
+                     }
+                  }
+               }
+
+               return !log.corrupt();
+            }
+
+            // Control characters are written as \u00XX in JSON; XML 1.0 cannot hold them, they are replaced by '?'.
+            inline std::string escape(const std::string& value, bool xml)
+            {
+               std::string result;
+
+               for (char c : value)
+               {
+                  if (xml && c == '<') result += "&lt;";
+                  else if (xml && c == '>') result += "&gt;";
+                  else if (xml && c == '&') result += "&amp;";
+                  else if (xml && c == '"') result += "&quot;";
+                  else if (xml && (unsigned char)c < 0x20 && c != '\t' && c != '\n' && c != '\r') result += '?';
+                  else if (!xml && (c == '"' || c == '\\')) { result += '\\'; result += c; }
+                  else if (!xml && (unsigned char)c < 0x20)
+                  {
+                     char code[8];
+                     std::snprintf(code, sizeof(code), "\\u%04x", unsigned((unsigned char)c));
+                     result += code;
+                  }
+                  else result += c;
+               }
+
+               return result;
+            }
+
+            inline double seconds(const test_result& test)
+            {
+               return double(test.end_ - test.begin_) / 1e9;
+            }
+
+            inline void write_text(std::ostream& out, const reader& log, const run_result& run)
+            {
+               const int width = 5;
+
+               for (const test_result& test : run.tests_)
+               {
+                  for (const failure& f : test.failures_)
+                  {
+                     out << "FAIL " << log.string(f.file_) << " " << f.line_ << std::endl;
+                  }
+                  out << std::setiosflags(std::ios::left);
+                  out << "TEST  " << std::setw(width) << test.passed_ + test.failed_ << " Passed " << std::setw(width) << test.passed_ << " Failed " << std::setw(width) << test.failed_ << "   " << log.string(test.name_) << " (" << seconds(test) << "s)";
+                  out << std::resetiosflags(std::ios::left) << std::endl;
+               }
+               out << std::setiosflags(std::ios::left);
+               out << "TOTAL " << std::setw(width) << run.passed_ + run.failed_ << " PASSED " << std::setw(width) << run.passed_ << " FAILED " << std::setw(width) << run.failed_;
+               out << std::resetiosflags(std::ios::left) << std::endl;
+            }
+
+            inline void write_junit(std::ostream& out, const reader& log, const run_result& run)
+            {
+               uint64_t failed_tests = std::count_if(run.tests_.begin(), run.tests_.end(), [](const test_result& test) { return test.failed_ > 0; });
+
+               out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" << std::endl;
+               out << "<testsuite name=\"cpp_test\" tests=\"" << run.tests_.size() << "\" failures=\"" << failed_tests << "\">" << std::endl;
+               for (const test_result& test : run.tests_)
+               {
+                  out << "  <testcase name=\"" << escape(log.string(test.name_), true) << "\" time=\"" << seconds(test) << "\"";
+                  if (test.failures_.empty())
+                  {
+                     out << "/>" << std::endl;
+                     continue;
+                  }
+
+                  out << ">" << std::endl;
+                  for (const failure& f : test.failures_)
+                  {
+                     out << "    <failure message=\"" << escape(log.string(f.file_), true) << ":" << f.line_ << "\"/>" << std::endl;
+                  }
+                  out << "  </testcase>" << std::endl;
+               }
+               out << "</testsuite>" << std::endl;
+            }
+
+            inline void write_json(std::ostream& out, const reader& log, const run_result& run)
+            {
+               out << "{\"passed\":" << run.passed_ << ",\"failed\":" << run.failed_ << ",\"tests\":[";
+               for (size_t i = 0; i < run.tests_.size(); ++i)
+               {
+                  const test_result& test = run.tests_[i];
+                  out << (i ? "," : "") << "{\"name\":\"" << escape(log.string(test.name_), false) << "\",\"passed\":" << test.passed_
+                      << ",\"failed\":" << test.failed_ << ",\"seconds\":" << seconds(test) << ",\"failures\":[";
+                  for (size_t j = 0; j < test.failures_.size(); ++j)
+                  {
+                     out << (j ? "," : "") << "{\"file\":\"" << escape(log.string(test.failures_[j].file_), false) << "\",\"line\":" << test.failures_[j].line_ << "}";
+                  }
+                  out << "]}";
+               }
+               out << "]}" << std::endl;
+            }
+
+            inline void write_slowest(std::ostream& out, const reader& log, const run_result& run, size_t count)
+            {
+               std::vector<const test_result*> tests;
+               for (const test_result& test : run.tests_)
+               {
+                  tests.push_back(&test);
+               }
+
+               count = std::min(count, tests.size());
+               std::partial_sort(tests.begin(), tests.begin() + count, tests.end(), [](const test_result* t1, const test_result* t2) { return seconds(*t1) > seconds(*t2); });
+               for (size_t i = 0; i < count; ++i)
+               {
+                  out << std::fixed << std::setprecision(6) << seconds(*tests[i]) << "s " << log.string(tests[i]->name_) << std::endl;
+               }
+            }
+
+            inline void write_failing(std::ostream& out, const reader& log, const run_result& run, size_t count)
+            {
+               std::vector<std::pair<std::pair<uint32_t, uint32_t>, uint64_t>> lines(run.failing_lines_.begin(), run.failing_lines_.end());
+
+               count = std::min(count, lines.size());
+               std::partial_sort(lines.begin(), lines.begin() + count, lines.end(), [](const std::pair<std::pair<uint32_t, uint32_t>, uint64_t>& l1,
+                                                                                      const std::pair<std::pair<uint32_t, uint32_t>, uint64_t>& l2) { return l1.second > l2.second; });
+               for (size_t i = 0; i < count; ++i)
+               {
+                  out << lines[i].second << " " << log.string(lines[i].first.first) << " " << lines[i].first.second << std::endl;
+               }
+            }
+         }
+      }
+   }
+}
@@ -0,0 +1,77 @@
+/****
+* Copyright (c) 2015 - 2017 Advance Engineering Solutions Pty Ltd.
+* All rights reserved.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "result_log_report.h"
+#include <cstdlib>
+#include <iostream>
+
+using namespace aes::test::result_log;
+using namespace aes::test::result_log::report;
+
+int main(int argc, char** argv)
+{
+   if (argc < 2)
+   {
+      std::cerr << "Usage: " << argv[0] << " <result log> [text|junit|json|slowest [count]|failing [count]]" << std::endl;
+      return -1;
+   }
+
+   reader log;
+   if (!log.open(argv[1]))
+   {
+      std::cerr << "Error: unable to open the result log " << argv[1] << std::endl;
+      return -1;
+   }
+
+   // The records before a corruption, a run that crashed for instance, are still reported.
+   run_result run;
+   bool corrupt = !load(log, run);
+   if (corrupt)
+   {
+      std::cerr << "Error: the result log " << argv[1] << " is corrupt, only the records before the corruption are reported" << std::endl;
+   }
+
+   std::string command(argc > 2 ? argv[2] : "text");
+   size_t count = argc > 3 ? size_t(std::strtoull(argv[3], nullptr, 10)) : 10;
+   if (command == "text")
+   {
+      write_text(std::cout, log, run);
+   }
+   else if (command == "junit")
+   {
+      write_junit(std::cout, log, run);
+   }
+   else if (command == "json")
+   {
+      write_json(std::cout, log, run);
+   }
+   else if (command == "slowest")
+   {
+      write_slowest(std::cout, log, run, count);
+   }
+   else if (command == "failing")
+   {
+      write_failing(std::cout, log, run, count);
+   }
+   else
+   {
+      std::cerr << "Error: invalid or unknown command " << command << std::endl;
+      return -1;
+   }
+
+   return corrupt ? -1 : 0;
+}